@@ -12,6 +12,7 @@
 #include "Matrix.h"
 #include "Image.h"
 #include "ImagesBlock.h"
+#include "DepthImagesBlock.h"
 #include "VisibleListBlock.h"
 
 #ifndef PI
@@ -138,11 +139,7 @@ typedef class Basis::Vector6<float> Vector6f;
 #endif
 
 #ifndef ShortImagesBlock
-#define ShortImagesBlock Basis::ImagesBlock<short>
-#endif
-
-#ifndef BitVisibleListBlock
-#define BitVisibleListBlock Basis::VisibleListBlock<uchar>
+#define ShortImagesBlock Basis::DepthImagesBlock
 #endif
 
 //======================================================
@@ -154,8 +151,12 @@ typedef class Basis::Vector6<float> Vector6f;
 #define USE_VISIBLELIST_BLOCK
 #endif
 
-#ifndef	IMAGES_BLOCK_SIZE 
-#define IMAGES_BLOCK_SIZE 3000
+#ifndef	IMAGES_SEGMENT_SIZE
+#define IMAGES_SEGMENT_SIZE 32
+#endif
+
+#ifndef	IMAGES_CACHED_SEGMENTS
+#define IMAGES_CACHED_SEGMENTS 8
 #endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,310 @@
+//Copyright 2016 - 2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon
+
+#include "DepthImagesBlock.h"
+
+using namespace Basis;
+
+static const size_t minFileSize = 1 << 24;
+
+static unsigned char *putVarint(unsigned char *dst, unsigned int v){
+	while (v >= 0x80) { *dst++ = (unsigned char)(v | 0x80); v >>= 7; }
+	*dst++ = (unsigned char)v;
+	return dst;
+}
+
+static const unsigned char *getVarint(const unsigned char *src, unsigned int &v){
+	v = 0;
+	for (int shift = 0;; shift += 7){
+		unsigned char byte = *src++;
+		v |= (unsigned int)(byte & 0x7f) << shift;
+		if (byte < 0x80) return src;
+	}
+}
+
+// Upper bound of a coded frame: a 3 byte residual and a run token per pixel.
+static size_t maxCodedFrameSize(size_t noPixels){
+	return noPixels * 4 + 16;
+}
+
+// Each pixel is predicted by its left neighbour, the first one of a row by
+// the one above. Residuals are zigzag varints, runs of zero residuals (flat
+// or invalid depth) a single token. Returns the number of bytes.
+static size_t encodeFrame(unsigned char *dst, const short *frame, int width, int height){
+	unsigned char *ptr = dst;
+	unsigned int run = 0;
+
+	for (int y = 0; y < height; y++){
+		const short *row = frame + (size_t)y * width;
+		int prediction = y > 0 ? row[-width] : 0;
+
+		for (int x = 0; x < width; x++){
+			int residual = (int)row[x] - prediction;
+			prediction = row[x];
+
+			unsigned int code = ((unsigned int)residual << 1) ^ (unsigned int)(residual >> 31);
+			if (code == 0) { run++; continue; }
+
+			if (run > 0) { ptr = putVarint(ptr, (run << 1) | 1); run = 0; }
+			ptr = putVarint(ptr, code << 1);
+		}
+	}
+
+	if (run > 0) ptr = putVarint(ptr, (run << 1) | 1);
+
+	return ptr - dst;
+}
+
+static void decodeFrame(short *frame, const unsigned char *src, int width, int height){
+	unsigned int run = 0;
+
+	for (int y = 0; y < height; y++){
+		short *row = frame + (size_t)y * width;
+		int prediction = y > 0 ? row[-width] : 0;
+
+		for (int x = 0; x < width; x++){
+			if (run == 0){
+				unsigned int token;
+				src = getVarint(src, token);
+
+				if (token & 1) run = token >> 1;
+				else{
+					unsigned int code = token >> 1;
+					prediction += (int)(code >> 1) ^ -(int)(code & 1);
+					row[x] = (short)prediction;
+					continue;
+				}
+			}
+
+			run--;
+			row[x] = (short)prediction;
+		}
+	}
+}
+
+DepthImagesBlock::DepthImagesBlock(Vector2<int> noDims, int segmentSize, int noCachedSegments, const char *fileName)
+	: file(fileName)
+{
+	this->noDims = noDims;
+	this->segmentSize = segmentSize;
+	this->noCachedSegments = noCachedSegments;
+
+	noSegmentsInMemory = 0;
+	useClock = 0;
+	fileEnd = 0;
+	isStopping = false;
+
+	prefetchThread = std::thread(&DepthImagesBlock::prefetchProcess, this);
+}
+
+DepthImagesBlock::~DepthImagesBlock(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+	prefetchRequested.notify_all();
+	prefetchThread.join();
+
+	for (size_t i = 0; i < segments.size(); i++){
+		if (segments[i] == NULL) continue;
+		delete[] segments[i]->frames;
+		delete segments[i];
+	}
+}
+
+DepthImagesBlock::Segment *DepthImagesBlock::getSegment(int segmentId){
+	if (segmentId >= (int)segments.size()) segments.resize(segmentId + 1, NULL);
+
+	if (segments[segmentId] == NULL){
+		Segment *segment = new Segment;
+		segment->frames = NULL;
+		segment->isSaved.assign(segmentSize, false);
+		segment->fileOffset = 0;
+		segment->fileCapacity = 0;
+		segment->isStored = false;
+		segment->isLoading = false;
+		segment->lastUse = 0;
+		segments[segmentId] = segment;
+	}
+
+	return segments[segmentId];
+}
+
+void DepthImagesBlock::loadSegment(std::unique_lock<std::mutex> &lock, Segment *segment){
+	while (segment->isLoading) segmentLoaded.wait(lock);
+	if (segment->frames != NULL) return;
+
+	short *frames = new short[(size_t)segmentSize * frameSize()];
+
+	if (segment->isStored){
+		// the file may be remapped by a concurrent save, so the codes are copied before it is unlocked
+		segment->isLoading = true;
+		std::vector<unsigned int> codeOffsets = segment->codeOffsets;
+		std::vector<unsigned char> codes(file.GetData() + segment->fileOffset, file.GetData() + segment->fileOffset + codeOffsets.back());
+
+		lock.unlock();
+		for (int i = 0; i < segmentSize; i++){
+			if (codeOffsets[i + 1] == codeOffsets[i]) continue;
+			decodeFrame(frames + i * frameSize(), &codes[codeOffsets[i]], noDims.x, noDims.y);
+		}
+		lock.lock();
+
+		segment->isLoading = false;
+		segmentLoaded.notify_all();
+	}
+
+	segment->frames = frames;
+	noSegmentsInMemory++;
+}
+
+void DepthImagesBlock::storeSegment(Segment *segment){
+	size_t maxFrameSize = maxCodedFrameSize(frameSize());
+
+	segment->codeOffsets.resize(segmentSize + 1);
+	unsigned int offset = 0;
+
+	for (int i = 0; i < segmentSize; i++){
+		segment->codeOffsets[i] = offset;
+		if (!segment->isSaved[i]) continue;
+
+		size_t end = fileEnd + offset + maxFrameSize;
+		if (end > file.GetSize()){
+			size_t newSize = file.GetSize() * 2;
+			if (newSize < minFileSize) newSize = minFileSize;
+			if (newSize < end) newSize = end;
+			file.Resize(newSize);
+		}
+
+		offset += (unsigned int)encodeFrame(file.GetData() + fileEnd + offset, segment->frames + i * frameSize(), noDims.x, noDims.y);
+	}
+	segment->codeOffsets[segmentSize] = offset;
+
+	// the codes are written behind the end of the file first, a segment saved again replaces its old copy if it fits
+	if (offset <= segment->fileCapacity){
+		memcpy(file.GetData() + segment->fileOffset, file.GetData() + fileEnd, offset);
+	}
+	else{
+		segment->fileOffset = fileEnd;
+		segment->fileCapacity = offset;
+		fileEnd += offset;
+	}
+	segment->isStored = true;
+}
+
+void DepthImagesBlock::evictSegments(int keptSegmentId){
+	while (noSegmentsInMemory > noCachedSegments){
+		Segment *victim = NULL;
+		for (int i = 0; i < (int)segments.size(); i++){
+			Segment *segment = segments[i];
+			if (i == keptSegmentId || segment == NULL || segment->frames == NULL) continue;
+			if (victim == NULL || segment->lastUse < victim->lastUse) victim = segment;
+		}
+		if (victim == NULL) return;
+
+		// a segment read back from the file is only dropped again
+		if (!victim->isStored) storeSegment(victim);
+
+		delete[] victim->frames;
+		victim->frames = NULL;
+		noSegmentsInMemory--;
+	}
+}
+
+void DepthImagesBlock::requestPrefetch(int segmentId){
+	if (segmentId < 0 || segmentId >= (int)segments.size()) return;
+
+	Segment *segment = segments[segmentId];
+	if (segment == NULL || segment->frames != NULL || segment->isLoading) return;
+
+	prefetchQueue.push_back(segmentId);
+	prefetchRequested.notify_one();
+}
+
+void DepthImagesBlock::prefetchProcess(){
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true){
+		while (!isStopping && prefetchQueue.empty()) prefetchRequested.wait(lock);
+		if (isStopping) return;
+
+		int segmentId = prefetchQueue.front();
+		prefetchQueue.pop_front();
+
+		Segment *segment = segments[segmentId];
+		loadSegment(lock, segment);
+		segment->lastUse = ++useClock;
+		evictSegments(segmentId);
+	}
+}
+
+bool DepthImagesBlock::saveImageToBlock(int index, Image<short> *img){
+	if ((noDims.x != img->noDims.x) || (noDims.y != img->noDims.y) || index < 0){
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	int segmentId = index / segmentSize;
+	Segment *segment = getSegment(segmentId);
+	loadSegment(lock, segment);
+
+	memcpy(segment->frames + (index % segmentSize) * frameSize(), img->GetData(MEMORYDEVICE_CPU), frameSize() * sizeof(short));
+	segment->isSaved[index % segmentSize] = true;
+	segment->isStored = false;
+	segment->lastUse = ++useClock;
+
+	evictSegments(segmentId);
+
+	return true;
+}
+
+bool DepthImagesBlock::readImageToCpu(int index, Image<short> *img){
+	if ((noDims.x != img->noDims.x) || (noDims.y != img->noDims.y) || index < 0){
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	int segmentId = index / segmentSize;
+	if (segmentId >= (int)segments.size() || segments[segmentId] == NULL || !segments[segmentId]->isSaved[index % segmentSize]){
+		return false;
+	}
+
+	Segment *segment = segments[segmentId];
+	loadSegment(lock, segment);
+
+	memcpy(img->GetData(MEMORYDEVICE_CPU), segment->frames + (index % segmentSize) * frameSize(), frameSize() * sizeof(short));
+	segment->lastUse = ++useClock;
+
+	evictSegments(segmentId);
+
+	// frames are mostly read in order, so the next segment is likely needed soon
+	requestPrefetch(segmentId + 1);
+
+	return true;
+}
+
+bool DepthImagesBlock::readImageToGpu(int index, Image<short> *img){
+	if (!readImageToCpu(index, img)) return false;
+
+	img->UpdateDeviceFromHost();
+	return true;
+}
+
+void DepthImagesBlock::dropImage(int index){
+	if (index < 0) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	int segmentId = index / segmentSize;
+	if (segmentId >= (int)segments.size() || segments[segmentId] == NULL) return;
+
+	// a copy already in the file stays there, it is only skipped
+	segments[segmentId]->isSaved[index % segmentSize] = false;
+}
+
+void DepthImagesBlock::prefetchImage(int index){
+	if (index < 0) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	requestPrefetch(index / segmentSize);
+}
@@ -0,0 +1,119 @@
+/**
+* This file defines the store of all depth images of a scan.
+*
+* Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+*/
+
+#ifndef _DEPTHIMAGESBLOCK_H
+#define _DEPTHIMAGESBLOCK_H
+
+#include "Vector.h"
+#include "Image.h"
+#include "MappedFile.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Basis
+{
+	/** \brief
+	Keeps every depth image of a scan, without a bound on the
+	number of frames.
+
+	Frames are grouped into segments of @p segmentSize frames.
+	Up to @p noCachedSegments segments are held uncompressed in
+	memory, the least recently used one beyond that is compressed
+	losslessly and spilled to a memory-mapped file, from where it
+	is decompressed again when one of its frames is read. A
+	segment changed after it was spilled is compressed again into
+	its old place in the file if it still fits, else it is
+	appended and its old place stays unused, so the file only
+	grows with segments that outgrow their place.
+
+	Reading a frame prefetches the next segment on a worker
+	thread, so a scan read in order rarely waits for it. Frames
+	may be saved and read from different threads.
+	*/
+	class DepthImagesBlock
+	{
+	private:
+		struct Segment
+		{
+			/** Uncompressed frames, NULL while the segment is only in the file. */
+			short *frames;
+
+			/** Which frames have been saved. */
+			std::vector<bool> isSaved;
+
+			/** Compressed copy in the file, valid if isStored. */
+			size_t fileOffset, fileCapacity;
+			std::vector<unsigned int> codeOffsets;
+			bool isStored;
+
+			bool isLoading;
+			unsigned long long lastUse;
+		};
+
+		Vector2<int> noDims;
+		int segmentSize, noCachedSegments;
+
+		std::vector<Segment*> segments;
+		int noSegmentsInMemory;
+		unsigned long long useClock;
+
+		MappedFile file;
+		size_t fileEnd;
+
+		std::mutex mutex;
+		std::condition_variable segmentLoaded, prefetchRequested;
+
+		std::thread prefetchThread;
+		std::deque<int> prefetchQueue;
+		bool isStopping;
+
+		size_t frameSize() const { return (size_t)noDims.x * noDims.y; }
+
+		Segment *getSegment(int segmentId);
+
+		/** Make the frames of a segment available in memory, waits for a concurrent load. */
+		void loadSegment(std::unique_lock<std::mutex> &lock, Segment *segment);
+
+		/** Compress a segment to its place in the file, or to the end of the file if it does not fit. */
+		void storeSegment(Segment *segment);
+
+		/** Compress or drop the least recently used segments until at most noCachedSegments are held. */
+		void evictSegments(int keptSegmentId);
+
+		void requestPrefetch(int segmentId);
+		void prefetchProcess();
+
+	public:
+		/** Initialize an empty block for images of @p noDims, spilling to @p fileName or to a temporary file if NULL. */
+		DepthImagesBlock(Vector2<int> noDims, int segmentSize, int noCachedSegments, const char *fileName = NULL);
+		~DepthImagesBlock();
+
+		//save a image to the image block given an index
+		bool saveImageToBlock(int index, Image<short> *img);
+
+		//read a image to cpu from image block given an index
+		bool readImageToCpu(int index, Image<short> *img);
+
+		//read a image to cpu and gpu from image block given an index
+		bool readImageToGpu(int index, Image<short> *img);
+
+		//load the segment of the given index in the background, ahead of reading it
+		void prefetchImage(int index);
+
+		//forget the image of the given index, it is left out when its segment is compressed
+		void dropImage(int index);
+
+		// Suppress the default copy constructor and assignment operator
+		DepthImagesBlock(const DepthImagesBlock&);
+		DepthImagesBlock& operator=(const DepthImagesBlock&);
+	};
+}
+
+#endif
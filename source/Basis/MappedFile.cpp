@@ -0,0 +1,97 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#include "MappedFile.h"
+#include "PlatformIndependence.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Basis;
+
+MappedFile::MappedFile(const char *fileName, bool readOnly)
+{
+	data = NULL;
+	mapping = NULL;
+	size = 0;
+	isReadOnly = readOnly && fileName != NULL;
+
+	if (fileName == NULL) file = tmpfile();
+	else if (isReadOnly) file = fopen(fileName, "rb");
+	else
+	{
+		file = fopen(fileName, "r+b");
+		if (file == NULL) file = fopen(fileName, "w+b");
+	}
+	if (file == NULL) DIEWITHEXCEPTION("Failed to open the mapped file");
+
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx((HANDLE)_get_osfhandle(_fileno(file)), &fileSize);
+	size = (size_t)fileSize.QuadPart;
+#else
+	struct stat fileStat;
+	fstat(fileno(file), &fileStat);
+	size = (size_t)fileStat.st_size;
+#endif
+
+	if (size > 0) Map();
+}
+
+MappedFile::~MappedFile(void)
+{
+	Unmap();
+	fclose(file);
+}
+
+void MappedFile::Map(void)
+{
+#ifdef _WIN32
+	HANDLE fileHandle = (HANDLE)_get_osfhandle(_fileno(file));
+	unsigned long long mappedSize = size;
+
+	// the mapping object extends the file to the requested size
+	mapping = CreateFileMapping(fileHandle, NULL, isReadOnly ? PAGE_READONLY : PAGE_READWRITE, (DWORD)(mappedSize >> 32), (DWORD)(mappedSize & 0xffffffff), NULL);
+	if (mapping == NULL) DIEWITHEXCEPTION("Failed to map the file");
+
+	data = (unsigned char*)MapViewOfFile(mapping, isReadOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (data == NULL) DIEWITHEXCEPTION("Failed to map the file");
+#else
+	if (!isReadOnly && ftruncate(fileno(file), (off_t)size) != 0) DIEWITHEXCEPTION("Failed to grow the mapped file");
+
+	void *ptr = mmap(NULL, size, isReadOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fileno(file), 0);
+	if (ptr == MAP_FAILED) DIEWITHEXCEPTION("Failed to map the file");
+	data = (unsigned char*)ptr;
+#endif
+}
+
+void MappedFile::Unmap(void)
+{
+	if (data == NULL) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+	mapping = NULL;
+#else
+	munmap(data, size);
+#endif
+	data = NULL;
+}
+
+void MappedFile::Resize(size_t newSize)
+{
+	if (newSize <= size) return;
+	if (isReadOnly) DIEWITHEXCEPTION("Failed to grow a read-only mapped file");
+
+	Unmap();
+	size = newSize;
+	Map();
+}
@@ -0,0 +1,56 @@
+/**
+* This file is a wrapper about a memory-mapped file.
+*
+* Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+*/
+
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include <stdio.h>
+
+namespace Basis
+{
+	/** \brief
+		A file mapped into memory for reading and writing. The
+		mapping is recreated when the file grows, so pointers
+		into it are only valid until the next Resize. A file
+		opened read-only is mapped as it is and cannot grow.
+		*/
+	class MappedFile
+	{
+	private:
+		FILE *file;
+		unsigned char *data;
+		size_t size;
+		bool isReadOnly;
+
+		/** Handle of the file mapping object on Windows. */
+		void *mapping;
+
+		void Map(void);
+		void Unmap(void);
+
+	public:
+		/** Open @p fileName, keeping its content, or create a
+			temporary file that is deleted on close if NULL. An
+			existing @p fileName may be opened @p readOnly.
+			*/
+		explicit MappedFile(const char *fileName = NULL, bool readOnly = false);
+		~MappedFile(void);
+
+		unsigned char *GetData(void) { return data; }
+		const unsigned char *GetData(void) const { return data; }
+
+		size_t GetSize(void) const { return size; }
+
+		/** Grow the file to @p newSize bytes, never shrinks it. */
+		void Resize(size_t newSize);
+
+		// Suppress the default copy constructor and assignment operator
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+	};
+}
+
+#endif //_MAPPEDFILE_H
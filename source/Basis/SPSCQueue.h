@@ -0,0 +1,149 @@
+/**
+* This file defines a bounded queue between two threads.
+*
+* Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+*/
+
+#ifndef _SPSCQUEUE_H
+#define _SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace Basis
+{
+	/** \brief
+	A bounded queue with a single producer and a single consumer
+	thread.
+
+	Items are passed through a ring buffer without a lock. A
+	thread only takes the mutex to sleep on a full or an empty
+	queue, and the other thread only to wake it up, so neither
+	thread spins. Push blocks while the queue is full, which
+	holds the producer back to the pace of the consumer. After
+	Close the producer never blocks again and the consumer drains
+	the remaining items.
+	*/
+	template <typename T>
+	class SPSCQueue
+	{
+	private:
+		std::vector<T> items;
+		size_t capacity;
+
+		/** Number of items ever pushed and popped, the ring index is taken modulo the capacity. */
+		std::atomic<size_t> noPushed, noPopped;
+
+		std::atomic<bool> isClosed, isWoken;
+		std::atomic<bool> isProducerWaiting, isConsumerWaiting;
+
+		std::mutex mutex;
+		std::condition_variable notFull, notEmpty;
+
+		void notify(std::atomic<bool> &isWaiting, std::condition_variable &condition)
+		{
+			if (!isWaiting.load()) return;
+
+			// the waiting thread holds the mutex until it sleeps, so the notification cannot be lost
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+			}
+			condition.notify_one();
+		}
+
+	public:
+		explicit SPSCQueue(size_t capacity)
+			: items(capacity), capacity(capacity), noPushed(0), noPopped(0),
+			isClosed(false), isWoken(false), isProducerWaiting(false), isConsumerWaiting(false)
+		{
+		}
+
+		/** Appends an item, waits while the queue is full. Returns false if the queue was closed. */
+		bool Push(const T &item)
+		{
+			size_t pushed = noPushed.load(std::memory_order_relaxed);
+
+			if (pushed - noPopped.load() == capacity){
+				std::unique_lock<std::mutex> lock(mutex);
+				isProducerWaiting = true;
+				while (pushed - noPopped.load() == capacity && !isClosed) notFull.wait(lock);
+				isProducerWaiting = false;
+			}
+			if (isClosed) return false;
+
+			items[pushed % capacity] = item;
+			noPushed.store(pushed + 1);
+
+			notify(isConsumerWaiting, notEmpty);
+			return true;
+		}
+
+		/** Takes the oldest item without waiting. Returns false if the queue is empty. */
+		bool TryPop(T &item)
+		{
+			size_t popped = noPopped.load(std::memory_order_relaxed);
+			if (popped == noPushed.load()) return false;
+
+			item = items[popped % capacity];
+			items[popped % capacity] = T();
+			noPopped.store(popped + 1);
+
+			notify(isProducerWaiting, notFull);
+			return true;
+		}
+
+		/** Takes the oldest item, waits for one at most timeout. Returns false on timeout, Wake or a drained closed queue. */
+		template <typename Rep, typename Period>
+		bool Pop(T &item, const std::chrono::duration<Rep, Period> &timeout)
+		{
+			if (TryPop(item)) return true;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				isConsumerWaiting = true;
+				notEmpty.wait_for(lock, timeout, [this](){ return noPopped.load() != noPushed.load() || isClosed || isWoken; });
+				isConsumerWaiting = false;
+				isWoken = false;
+			}
+
+			return TryPop(item);
+		}
+
+		/** Wakes the consumer waiting in Pop without an item. */
+		void Wake()
+		{
+			isWoken = true;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+			}
+			notEmpty.notify_one();
+		}
+
+		/** No item is pushed after this, a waiting producer gives up and a waiting consumer returns. */
+		void Close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				isClosed = true;
+			}
+			notFull.notify_one();
+			notEmpty.notify_one();
+		}
+
+		bool IsClosed() const { return isClosed; }
+
+		bool IsEmpty() const { return noPopped.load() == noPushed.load(); }
+
+		void Clear()
+		{
+			T item;
+			while (TryPop(item));
+		}
+	};
+}
+
+#endif // _SPSCQUEUE_H
@@ -8,118 +8,194 @@
 #define _VISIBLELISTBLOCK_H
 
 #include "MemoryBlock.h"
-#include <iostream>
+#include <algorithm>
+#include <vector>
 
 namespace Basis
 {
 	/** \brief
-	Represents images, templated on the pixel type
+	Stores the list of visible hash entries of every frame.
+
+	A frame usually sees a few thousand of the hash entries, so
+	each list is kept sorted and coded as the varint gaps between
+	consecutive entry ids. The codes are appended to an arena of
+	host memory chunks, saving a list again for the same frame
+	appends a new copy.
+
+	Every list is stamped with the number of lists saved before
+	it. The id of an entry the garbage collection releases may be
+	handed to another block, so the next stamp is recorded for it
+	and the id is only valid in the lists stamped since.
 	*/
-	template <typename T>
-	class VisibleListBlock : public MemoryBlock < T >
+	class VisibleListBlock
 	{
-	public:
-		/** Length of the VisibleList. */
-		size_t visibleListSize;
+	private:
+		struct Record
+		{
+			int chunk, offset;
+			int noEntries;
+			int stamp;
+		};
 
-		/** Length of the VisibleListBlock. */
-		int visibleListBlockSize;
+		static const int chunkSize = 1 << 20;
 
-		/** offset of the VisibleList. */
-		int offset;
+		std::vector<Record> records;
+		std::vector<unsigned char*> chunks;
+		int chunkUsed;
 
-		/** Initialize an empty ImagesBlock of the given size, either
-		on CPU only or on both CPU and GPU.
-		*/
-		VisibleListBlock(size_t visibleListSize, int visibleListBlockSize, bool allocate_CPU, bool allocate_CUDA, bool metalCompatible = true)
-			: MemoryBlock<T>((size_t)(visibleListBlockSize) * visibleListSize, allocate_CPU, allocate_CUDA, metalCompatible)
-		{
-			this->visibleListSize = visibleListSize;
-			this->visibleListBlockSize = visibleListBlockSize;
-			offset = 0;
+		/** Number of lists saved so far, the stamp of the next one. */
+		int nextStamp;
+
+		/** Sorted entry ids and their codes, staged on the host. */
+		std::vector<int> entryIDs;
+		std::vector<unsigned char> codes;
+
+		unsigned char *allocate(int size){
+			if (chunks.empty() || chunkUsed + size > chunkSize){
+				chunks.push_back(new unsigned char[size > chunkSize ? size : chunkSize]);
+				chunkUsed = 0;
+			}
+
+			unsigned char *ptr = chunks.back() + chunkUsed;
+			chunkUsed += size;
+			return ptr;
 		}
 
-		VisibleListBlock(bool allocate_CPU, bool allocate_CUDA, bool metalCompatible = true)
-			: MemoryBlock<T>(0, allocate_CPU, allocate_CUDA, metalCompatible)
-		{
-			this->visibleListSize = 0;
-			this->visibleListBlockSize = 0;
+	public:
+		/** Index used by the next list saved without one. */
+		int offset;
+
+		VisibleListBlock(){
+			chunkUsed = 0;
 			offset = 0;
+			nextStamp = 0;
 		}
 
-		VisibleListBlock(size_t visibleListSize, int visibleListBlockSize, MemoryDeviceType memoryType)
-			: MemoryBlock<T>((size_t)(visibleListBlockSize) * visibleListSize, memoryType)
-		{
-			this->visibleListSize = visibleListSize;
-			this->visibleListBlockSize = visibleListBlockSize;
-			offset = 0;
+		~VisibleListBlock(){
+			for (size_t i = 0; i < chunks.size(); i++) delete[] chunks[i];
 		}
 
-		//save a visible list to cpu/gpu visible list block given an index
-		bool saveVisibleListToBlock(int index, MemoryBlock <T> *visibleList, MemoryDeviceType memoryType){
-			if (visibleListSize != visibleList->dataSize){
-				return false;
-			}
+		//save a visible list of the given memory to the block given an index
+		bool saveVisibleListToBlock(int index, const int *visibleEntryIDs, int noVisibleEntries, MemoryDeviceType memoryType){
+			if (index < 0) return false;
 
-			if (index < visibleListBlockSize){
-				DEVICEPTR(T)* vl = visibleList->GetData(memoryType);
-				DEVICEPTR(T)* vlb= this->GetData(MEMORYDEVICE_CPU);
-
-				switch (memoryType){
-				case MEMORYDEVICE_CPU:
-					memcpy(vlb + index*visibleListSize, vl, visibleList->dataSize*sizeof(T));
-					break;
-
-				case MEMORYDEVICE_CUDA:
-					BcudaSafeCall(cudaMemcpy(vlb + index*visibleListSize, vl, visibleList->dataSize*sizeof(T), cudaMemcpyDeviceToHost));
-					break;
-				default:
-					memcpy(vlb + index*visibleListSize, vl, visibleList->dataSize*sizeof(T));
-					break;
-				}
+			entryIDs.resize(noVisibleEntries);
+			if (noVisibleEntries > 0){
+				if (memoryType == MEMORYDEVICE_CUDA)
+					BcudaSafeCall(cudaMemcpy(&entryIDs[0], visibleEntryIDs, noVisibleEntries * sizeof(int), cudaMemcpyDeviceToHost));
+				else memcpy(&entryIDs[0], visibleEntryIDs, noVisibleEntries * sizeof(int));
+			}
 
-				offset++;
+			// the CUDA list is in the order of the prefix sum
+			std::sort(entryIDs.begin(), entryIDs.end());
+
+			codes.resize((size_t)noVisibleEntries * 5);
+			unsigned char *dst = codes.empty() ? NULL : &codes[0];
+			int prev = -1;
+			for (int i = 0; i < noVisibleEntries; i++){
+				unsigned int gap = (unsigned int)(entryIDs[i] - prev - 1);
+				while (gap >= 0x80) { *dst++ = (unsigned char)(gap | 0x80); gap >>= 7; }
+				*dst++ = (unsigned char)gap;
+				prev = entryIDs[i];
+			}
+			int size = codes.empty() ? 0 : (int)(dst - &codes[0]);
+
+			Record record;
+			record.noEntries = noVisibleEntries;
+			record.chunk = -1;
+			record.offset = 0;
+			record.stamp = nextStamp++;
+			if (size > 0){
+				memcpy(allocate(size), &codes[0], size);
+				record.chunk = (int)chunks.size() - 1;
+				record.offset = chunkUsed - size;
+			}
 
-				return true;
+			if (index >= (int)records.size()){
+				Record empty = { -1, 0, 0, 0 };
+				records.resize(index + 1, empty);
 			}
-			return false;
+			records[index] = record;
+
+			offset++;
+
+			return true;
 		}
 
-		bool saveVisibleListToBlock(MemoryBlock <T> *visibleList, MemoryDeviceType memoryType){
-			return saveVisibleListToBlock(offset, visibleList, memoryType);
+		bool saveVisibleListToBlock(const int *visibleEntryIDs, int noVisibleEntries, MemoryDeviceType memoryType){
+			return saveVisibleListToBlock(offset, visibleEntryIDs, noVisibleEntries, memoryType);
 		}
 
-		// read a visible list to cpu from visible list block given an index
-		bool readVisibleListToCpu(int index, MemoryBlock <T> *visibleList){
-			if (visibleListSize != visibleList->dataSize){
-				return false;
-			}
+		// the stamp an entry released now is given, lists saved from now on may hold its id again
+		int getNextStamp() const { return nextStamp; }
 
-			if (index < visibleListBlockSize){
-				DEVICEPTR(T)* vlCPU = visibleList->GetData(MEMORYDEVICE_CPU);
-				DEVICEPTR(T)* vlbCPU = this->GetData(MEMORYDEVICE_CPU);
+		// the stamp of the list given an index
+		int getStamp(int index) const {
+			if (index < 0 || index >= (int)records.size()) return 0;
+			return records[index].stamp;
+		}
+
+		// decode the visible list given an index to the given memory, returns the number of entries, 0 for a list never saved
+		int readVisibleList(int index, int *visibleEntryIDs, MemoryDeviceType memoryType){
+			if (index < 0 || index >= (int)records.size()) return 0;
 
-				memcpy(vlCPU, vlbCPU + index*visibleListSize, visibleList->dataSize*sizeof(T));
-				return true;
+			const Record &record = records[index];
+			if (record.noEntries == 0) return 0;
+
+			int *dst = visibleEntryIDs;
+			if (memoryType == MEMORYDEVICE_CUDA){
+				entryIDs.resize(record.noEntries);
+				dst = &entryIDs[0];
 			}
-			return false;
-		}
 
-		// read a visible list to gpu from visible list block given an index
-		bool readVisibleListToGpu(int index, MemoryBlock <T> *visibleList){
-			if (visibleListSize != visibleList->dataSize){
-				return false;
+			const unsigned char *src = chunks[record.chunk] + record.offset;
+			int prev = -1;
+			for (int i = 0; i < record.noEntries; i++){
+				unsigned int gap = 0;
+				for (int shift = 0;; shift += 7){
+					unsigned char byte = *src++;
+					gap |= (unsigned int)(byte & 0x7f) << shift;
+					if (byte < 0x80) break;
+				}
+				prev += (int)gap + 1;
+				dst[i] = prev;
 			}
 
-			if (index < visibleListBlockSize){
-				DEVICEPTR(T)* vlGPU = visibleList->GetData(MEMORYDEVICE_CUDA);
-				DEVICEPTR(T)* vlbCPU = this->GetData(MEMORYDEVICE_CPU);
+			if (memoryType == MEMORYDEVICE_CUDA)
+				BcudaSafeCall(cudaMemcpy(visibleEntryIDs, dst, record.noEntries * sizeof(int), cudaMemcpyHostToDevice));
+
+			return record.noEntries;
+		}
+
+		// save the union of the visible lists of [firstIndex, lastIndex] as the list of the given index,
+		// dropping the entries released since each list was saved, entriesReleaseStamp is on the host
+		bool mergeVisibleLists(int index, int firstIndex, int lastIndex, const int *entriesReleaseStamp){
+			if (index < 0 || firstIndex < 0) return false;
+
+			std::vector<int> merged, list;
+			for (int i = firstIndex; i <= lastIndex && i < (int)records.size(); i++){
+				list.resize(records[i].noEntries);
+				if (list.empty()) continue;
 
-				BcudaSafeCall(cudaMemcpy(vlGPU, vlbCPU + index*visibleListSize, visibleList->dataSize*sizeof(T), cudaMemcpyHostToDevice));
-				return true;
+				readVisibleList(i, &list[0], MEMORYDEVICE_CPU);
+				for (size_t j = 0; j < list.size(); j++)
+					if (entriesReleaseStamp[list[j]] <= records[i].stamp) merged.push_back(list[j]);
 			}
-			return false;
+
+			std::sort(merged.begin(), merged.end());
+			merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+
+			// a merged list does not advance the index of the next list
+			int nextOffset = offset;
+			bool result = saveVisibleListToBlock(index, merged.empty() ? NULL : &merged[0], (int)merged.size(), MEMORYDEVICE_CPU);
+			offset = nextOffset;
+
+			return result;
 		}
+
+		// Suppress the default copy constructor and assignment operator
+		VisibleListBlock(const VisibleListBlock&);
+		VisibleListBlock& operator=(const VisibleListBlock&);
 	};
 }
 
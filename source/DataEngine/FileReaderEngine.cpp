@@ -27,8 +27,7 @@ FileReaderEngine::FileReaderEngine(const std::string rgbPath, const std::string
 	rawDepthImage = new ShortImage(Vector2i(image_width, image_height), true, true);
 
 #ifdef USE_IMAGES_BLOCK
-	//rgbImagesBlock = new UChar4ImagesBlock(Vector2i(image_width, image_height), IMAGES_BLOCK_SIZE, MEMORYDEVICE_CPU);
-	depthImagesBlock = new ShortImagesBlock(Vector2i(image_width, image_height), IMAGES_BLOCK_SIZE, MEMORYDEVICE_CPU);
+	depthImagesBlock = new ShortImagesBlock(Vector2i(image_width, image_height), IMAGES_SEGMENT_SIZE, IMAGES_CACHED_SEGMENTS);
 #else
 	rgbImagesBlock = NULL;
 	depthImagesBlock = NULL;
@@ -51,7 +50,7 @@ FileReaderEngine::~FileReaderEngine(){
 	}
 
 	if (depthImagesBlock != NULL){
-		depthImagesBlock->Free();
+		delete depthImagesBlock;
 	}
 	rgbFileLists.clear();
 	depthFileLists.clear();
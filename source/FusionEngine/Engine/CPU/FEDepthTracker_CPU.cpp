@@ -0,0 +1,135 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+#include "FEDepthTracker_CPU.h"
+#include "../Common/FECDepthTracker.h"
+
+#include <string.h>
+
+#ifdef WITH_OPENMP
+#include <omp.h>
+#endif
+
+using namespace FE;
+
+struct FEDepthTracker_CPU::AccuCell {
+	int numPoints;
+	float f;
+	float g[6];
+	float h[6+5+4+3+2+1];
+};
+
+template<bool shortIteration, bool rotationOnly>
+static void depthTrackerOneLevel_g_rt(FEDepthTracker_CPU::AccuCell *accu_threads, const float *depth, const Matrix4f &approxInvPose,
+	const Vector4f *pointsMap, const Vector4f *normalsMap, const Vector4f &sceneIntrinsics, const Vector2i &sceneImageSize,
+	const Matrix4f &scenePose, const Vector4f &viewIntrinsics, const Vector2i &viewImageSize, float distThresh)
+{
+	const int noPara = shortIteration ? 3 : 6;
+	const int noParaSQ = shortIteration ? 3 + 2 + 1 : 6 + 5 + 4 + 3 + 2 + 1;
+
+#ifdef WITH_OPENMP
+#pragma omp parallel
+#endif
+	{
+		int threadId = 0;
+#ifdef WITH_OPENMP
+		threadId = omp_get_thread_num();
+#endif
+		// accumulate on the stack, adjacent cells of accu_threads would share cache lines
+		FEDepthTracker_CPU::AccuCell accu;
+		memset(&accu, 0, sizeof(accu));
+
+		float localNabla[noPara], localHessian[noParaSQ], localF;
+
+#ifdef WITH_OPENMP
+#pragma omp for
+#endif
+		for (int y = 0; y < viewImageSize.y; y++) for (int x = 0; x < viewImageSize.x; x++)
+		{
+			bool isValidPoint = computePerPointGH_Depth<shortIteration, rotationOnly>(localNabla, localHessian, localF, x, y,
+				depth[x + y * viewImageSize.x], viewImageSize, viewIntrinsics, sceneImageSize, sceneIntrinsics, approxInvPose, scenePose,
+				pointsMap, normalsMap, distThresh);
+
+			if (!isValidPoint) continue;
+
+			accu.numPoints++;
+			accu.f += localF;
+			for (int i = 0; i < noPara; i++) accu.g[i] += localNabla[i];
+			for (int i = 0; i < noParaSQ; i++) accu.h[i] += localHessian[i];
+		}
+
+		accu_threads[threadId] = accu;
+	}
+}
+
+// host methods
+
+FEDepthTracker_CPU::FEDepthTracker_CPU(Vector2i imgSize, TrackerIterationType *trackingRegime, int noHierarchyLevels, int noICPRunTillLevel,
+	float distThresh, float terminationThreshold, const FELowLevelEngine *lowLevelEngine)
+	:FEDepthTracker(imgSize, trackingRegime, noHierarchyLevels, noICPRunTillLevel, distThresh, terminationThreshold, lowLevelEngine, MEMORYDEVICE_CPU)
+{
+	noThreads = 1;
+#ifdef WITH_OPENMP
+	noThreads = omp_get_max_threads();
+#endif
+	accu_threads = new AccuCell[noThreads];
+}
+
+FEDepthTracker_CPU::~FEDepthTracker_CPU(void)
+{
+	delete[] accu_threads;
+}
+
+int FEDepthTracker_CPU::ComputeGandH(float &f, float *nabla, float *hessian, Matrix4f approxInvPose)
+{
+	Vector4f *pointsMap = sceneHierarchyLevel->pointsMap->GetData(MEMORYDEVICE_CPU);
+	Vector4f *normalsMap = sceneHierarchyLevel->normalsMap->GetData(MEMORYDEVICE_CPU);
+	Vector4f sceneIntrinsics = sceneHierarchyLevel->intrinsics;
+	Vector2i sceneImageSize = sceneHierarchyLevel->pointsMap->noDims;
+
+	float *depth = viewHierarchyLevel->depth->GetData(MEMORYDEVICE_CPU);
+	Vector4f viewIntrinsics = viewHierarchyLevel->intrinsics;
+	Vector2i viewImageSize = viewHierarchyLevel->depth->noDims;
+
+	if (iterationType == TRACKER_ITERATION_NONE) return 0;
+
+	bool shortIteration = (iterationType == TRACKER_ITERATION_ROTATION) || (iterationType == TRACKER_ITERATION_TRANSLATION);
+
+	int noPara = shortIteration ? 3 : 6;
+
+	memset(accu_threads, 0, noThreads * sizeof(AccuCell));
+
+	switch (iterationType)
+	{
+	case TRACKER_ITERATION_ROTATION:
+		depthTrackerOneLevel_g_rt<true, true>(accu_threads, depth, approxInvPose, pointsMap, normalsMap, sceneIntrinsics, sceneImageSize,
+			scenePose, viewIntrinsics, viewImageSize, distThresh[levelId]);
+		break;
+	case TRACKER_ITERATION_TRANSLATION:
+		depthTrackerOneLevel_g_rt<true, false>(accu_threads, depth, approxInvPose, pointsMap, normalsMap, sceneIntrinsics, sceneImageSize,
+			scenePose, viewIntrinsics, viewImageSize, distThresh[levelId]);
+		break;
+	case TRACKER_ITERATION_BOTH:
+		depthTrackerOneLevel_g_rt<false, false>(accu_threads, depth, approxInvPose, pointsMap, normalsMap, sceneIntrinsics, sceneImageSize,
+			scenePose, viewIntrinsics, viewImageSize, distThresh[levelId]);
+		break;
+	default: break;
+	}
+
+	// reduce the per-thread accumulators in a fixed order
+	AccuCell accu = accu_threads[0];
+	for (int threadId = 1; threadId < noThreads; threadId++)
+	{
+		const AccuCell &other = accu_threads[threadId];
+		accu.numPoints += other.numPoints;
+		accu.f += other.f;
+		for (int i = 0; i < 6; i++) accu.g[i] += other.g[i];
+		for (int i = 0; i < 6 + 5 + 4 + 3 + 2 + 1; i++) accu.h[i] += other.h[i];
+	}
+
+	for (int r = 0, counter = 0; r < noPara; r++) for (int c = 0; c <= r; c++, counter++) hessian[r + c * 6] = accu.h[counter];
+	for (int r = 0; r < noPara; ++r) for (int c = r + 1; c < noPara; c++) hessian[r + c * 6] = hessian[c + r * 6];
+
+	memcpy(nabla, accu.g, noPara * sizeof(float));
+	f = (accu.numPoints > 100) ? sqrt(accu.f) / accu.numPoints : 1e5f;
+
+	return accu.numPoints;
+}
@@ -0,0 +1,28 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+#ifndef _FE_DEPTHTRACKER_CPU_H
+#define _FE_DEPTHTRACKER_CPU_H
+
+#include "../FEDepthTracker.h"
+
+namespace FE
+{
+	class FEDepthTracker_CPU : public FEDepthTracker
+	{
+	public:
+		struct AccuCell;
+
+	private:
+		/** One accumulator per thread, summed up after each evaluation. */
+		AccuCell *accu_threads;
+		int noThreads;
+
+	protected:
+		int ComputeGandH(float &f, float *nabla, float *hessian, Matrix4f approxInvPose);
+
+	public:
+		FEDepthTracker_CPU(Vector2i imgSize, TrackerIterationType *trackingRegime, int noHierarchyLevels, int noICPRunTillLevel, float distThresh,
+			float terminationThreshold, const FELowLevelEngine *lowLevelEngine);
+		~FEDepthTracker_CPU(void);
+	};
+}
+#endif //_FE_DEPTHTRACKER_CPU_H
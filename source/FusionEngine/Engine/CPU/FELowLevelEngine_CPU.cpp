@@ -0,0 +1,258 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+#include "FELowLevelEngine_CPU.h"
+
+#include "../Common/FECLowLevelEngine.h"
+
+#include <string.h>
+#include <emmintrin.h>
+
+using namespace FE;
+
+FELowLevelEngine_CPU::FELowLevelEngine_CPU(void) { }
+FELowLevelEngine_CPU::~FELowLevelEngine_CPU(void) { }
+
+// sse helpers
+
+/** Signed 16 bit division by 8 rounding towards zero, as the integer division in gradientX/Y. */
+static inline __m128i div8_epi16(__m128i v)
+{
+	__m128i bias = _mm_and_si128(_mm_srai_epi16(v, 15), _mm_set1_epi16(7));
+	return _mm_srai_epi16(_mm_add_epi16(v, bias), 3);
+}
+
+/** Central difference of two pixels, d = img[x + 1] - img[x - 1], widened to 16 bit. */
+static inline __m128i centralDiffX(const Vector4u *row, int x)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + x + 1)), zero);
+	__m128i m = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + x - 1)), zero);
+	return _mm_sub_epi16(p, m);
+}
+
+// host methods
+
+void FELowLevelEngine_CPU::CopyImage(UChar4Image *image_out, const UChar4Image *image_in) const
+{
+	Vector4u *dest = image_out->GetData(MEMORYDEVICE_CPU);
+	const Vector4u *src = image_in->GetData(MEMORYDEVICE_CPU);
+
+	memcpy(dest, src, image_in->dataSize * sizeof(Vector4u));
+}
+
+void FELowLevelEngine_CPU::CopyImage(FloatImage *image_out, const FloatImage *image_in) const
+{
+	float *dest = image_out->GetData(MEMORYDEVICE_CPU);
+	const float *src = image_in->GetData(MEMORYDEVICE_CPU);
+
+	memcpy(dest, src, image_in->dataSize * sizeof(float));
+}
+
+void FELowLevelEngine_CPU::CopyImage(Float4Image *image_out, const Float4Image *image_in) const
+{
+	Vector4f *dest = image_out->GetData(MEMORYDEVICE_CPU);
+	const Vector4f *src = image_in->GetData(MEMORYDEVICE_CPU);
+
+	memcpy(dest, src, image_in->dataSize * sizeof(Vector4f));
+}
+
+void FELowLevelEngine_CPU::FilterSubsample(UChar4Image *image_out, const UChar4Image *image_in) const
+{
+	Vector2i oldDims = image_in->noDims;
+	Vector2i newDims; newDims.x = image_in->noDims.x / 2; newDims.y = image_in->noDims.y / 2;
+
+	image_out->ChangeDims(newDims);
+
+	const Vector4u *imageData_in = image_in->GetData(MEMORYDEVICE_CPU);
+	Vector4u *imageData_out = image_out->GetData(MEMORYDEVICE_CPU);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < newDims.y; y++)
+	{
+		const Vector4u *row0 = imageData_in + (y * 2) * oldDims.x;
+		const Vector4u *row1 = row0 + oldDims.x;
+		__m128i zero = _mm_setzero_si128();
+
+		// two output pixels from a 4x2 input patch per iteration
+		int x = 0;
+		for (; x + 1 < newDims.x; x += 2)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 2));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 2));
+
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+			lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+			hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+			__m128i sum = _mm_srli_epi16(_mm_unpacklo_epi64(lo, hi), 2);
+			_mm_storel_epi64((__m128i*)(imageData_out + x + y * newDims.x), _mm_packus_epi16(sum, sum));
+		}
+
+		for (; x < newDims.x; x++) filterSubsample(imageData_out, x, y, newDims, imageData_in, oldDims);
+	}
+}
+
+void FELowLevelEngine_CPU::FilterSubsampleWithHoles(FloatImage *image_out, const FloatImage *image_in) const
+{
+	Vector2i oldDims = image_in->noDims;
+	Vector2i newDims; newDims.x = image_in->noDims.x / 2; newDims.y = image_in->noDims.y / 2;
+
+	image_out->ChangeDims(newDims);
+
+	const float *imageData_in = image_in->GetData(MEMORYDEVICE_CPU);
+	float *imageData_out = image_out->GetData(MEMORYDEVICE_CPU);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < newDims.y; y++)
+	{
+		const float *row0 = imageData_in + (y * 2) * oldDims.x;
+		const float *row1 = row0 + oldDims.x;
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+		// four output pixels from an 8x2 input patch per iteration
+		int x = 0;
+		for (; x + 3 < newDims.x; x += 4)
+		{
+			__m128 a = _mm_loadu_ps(row0 + x * 2), b = _mm_loadu_ps(row0 + x * 2 + 4);
+			__m128 c = _mm_loadu_ps(row1 + x * 2), d = _mm_loadu_ps(row1 + x * 2 + 4);
+
+			__m128 ma = _mm_cmpgt_ps(a, zero), mb = _mm_cmpgt_ps(b, zero);
+			__m128 mc = _mm_cmpgt_ps(c, zero), md = _mm_cmpgt_ps(d, zero);
+
+			a = _mm_and_ps(a, ma); b = _mm_and_ps(b, mb); c = _mm_and_ps(c, mc); d = _mm_and_ps(d, md);
+			ma = _mm_and_ps(ma, one); mb = _mm_and_ps(mb, one); mc = _mm_and_ps(mc, one); md = _mm_and_ps(md, one);
+
+			__m128 sum = _mm_add_ps(
+				_mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))),
+				_mm_add_ps(_mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1))));
+			__m128 cnt = _mm_add_ps(
+				_mm_add_ps(_mm_shuffle_ps(ma, mb, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(ma, mb, _MM_SHUFFLE(3, 1, 3, 1))),
+				_mm_add_ps(_mm_shuffle_ps(mc, md, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(mc, md, _MM_SHUFFLE(3, 1, 3, 1))));
+
+			// pixels without any valid input stay 0
+			__m128 res = _mm_and_ps(_mm_cmpgt_ps(cnt, zero), _mm_div_ps(sum, _mm_max_ps(cnt, one)));
+			_mm_storeu_ps(imageData_out + x + y * newDims.x, res);
+		}
+
+		for (; x < newDims.x; x++) filterSubsampleWithHoles(imageData_out, x, y, newDims, imageData_in, oldDims);
+	}
+}
+
+void FELowLevelEngine_CPU::FilterSubsampleWithHoles(Float4Image *image_out, const Float4Image *image_in) const
+{
+	Vector2i oldDims = image_in->noDims;
+	Vector2i newDims; newDims.x = image_in->noDims.x / 2; newDims.y = image_in->noDims.y / 2;
+
+	image_out->ChangeDims(newDims);
+
+	const Vector4f *imageData_in = image_in->GetData(MEMORYDEVICE_CPU);
+	Vector4f *imageData_out = image_out->GetData(MEMORYDEVICE_CPU);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < newDims.y; y++)
+	{
+		const float *row0 = (const float*)(imageData_in + (y * 2) * oldDims.x);
+		const float *row1 = row0 + oldDims.x * 4;
+		float *rowOut = (float*)(imageData_out + y * newDims.x);
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		__m128 invalid = _mm_set_ps(-1.0f, 0.0f, 0.0f, 0.0f);
+
+		// one pixel is one register, the mask is the broadcast w >= 0 test
+		for (int x = 0; x < newDims.x; x++)
+		{
+			__m128 p[4];
+			p[0] = _mm_loadu_ps(row0 + x * 8); p[1] = _mm_loadu_ps(row0 + x * 8 + 4);
+			p[2] = _mm_loadu_ps(row1 + x * 8); p[3] = _mm_loadu_ps(row1 + x * 8 + 4);
+
+			__m128 sum = zero, cnt = zero;
+			for (int i = 0; i < 4; i++)
+			{
+				__m128 m = _mm_cmpge_ps(_mm_shuffle_ps(p[i], p[i], _MM_SHUFFLE(3, 3, 3, 3)), zero);
+				sum = _mm_add_ps(sum, _mm_and_ps(p[i], m));
+				cnt = _mm_add_ps(cnt, _mm_and_ps(one, m));
+			}
+
+			__m128 good = _mm_cmpgt_ps(cnt, zero);
+			__m128 res = _mm_or_ps(_mm_and_ps(good, _mm_div_ps(sum, _mm_max_ps(cnt, one))), _mm_andnot_ps(good, invalid));
+			_mm_storeu_ps(rowOut + x * 4, res);
+		}
+	}
+}
+
+void FELowLevelEngine_CPU::GradientX(Short4Image *grad_out, const UChar4Image *image_in) const
+{
+	grad_out->ChangeDims(image_in->noDims);
+	Vector2i imgSize = image_in->noDims;
+
+	Vector4s *grad = grad_out->GetData(MEMORYDEVICE_CPU);
+	const Vector4u *image = image_in->GetData(MEMORYDEVICE_CPU);
+
+	memset(grad, 0, imgSize.x * imgSize.y * sizeof(Vector4s));
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 2; y <= imgSize.y - 2; y++)
+	{
+		const Vector4u *rowM = image + (y - 1) * imgSize.x, *row = image + y * imgSize.x, *rowP = image + (y + 1) * imgSize.x;
+		__m128i wMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), wVal = _mm_set1_epi16(255);
+
+		// two pixels per iteration, the w channel is the constant (2 * 255 * 4) / 8
+		int x = 2;
+		for (; x + 1 <= imgSize.x - 2; x += 2)
+		{
+			__m128i d1 = centralDiffX(rowM, x), d2 = centralDiffX(row, x), d3 = centralDiffX(rowP, x);
+			__m128i d = div8_epi16(_mm_add_epi16(_mm_add_epi16(d1, d3), _mm_slli_epi16(d2, 1)));
+			d = _mm_or_si128(_mm_andnot_si128(wMask, d), _mm_and_si128(wMask, wVal));
+			_mm_storeu_si128((__m128i*)(grad + x + y * imgSize.x), d);
+		}
+
+		for (; x <= imgSize.x - 2; x++) gradientX(grad, x, y, image, imgSize);
+	}
+}
+
+void FELowLevelEngine_CPU::GradientY(Short4Image *grad_out, const UChar4Image *image_in) const
+{
+	grad_out->ChangeDims(image_in->noDims);
+	Vector2i imgSize = image_in->noDims;
+
+	Vector4s *grad = grad_out->GetData(MEMORYDEVICE_CPU);
+	const Vector4u *image = image_in->GetData(MEMORYDEVICE_CPU);
+
+	memset(grad, 0, imgSize.x * imgSize.y * sizeof(Vector4s));
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 2; y <= imgSize.y - 2; y++)
+	{
+		const Vector4u *rowM = image + (y - 1) * imgSize.x, *rowP = image + (y + 1) * imgSize.x;
+		__m128i zero = _mm_setzero_si128();
+		__m128i wMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), wVal = _mm_set1_epi16(255);
+
+		// vertical differences of the pixels x - 1 .. x + 2 give the two outputs x and x + 1
+		int x = 2;
+		for (; x + 1 <= imgSize.x - 2; x += 2)
+		{
+			__m128i p = _mm_loadu_si128((const __m128i*)(rowP + x - 1));
+			__m128i m = _mm_loadu_si128((const __m128i*)(rowM + x - 1));
+
+			__m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpacklo_epi8(m, zero));
+			__m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(p, zero), _mm_unpackhi_epi8(m, zero));
+			__m128i mid = _mm_or_si128(_mm_srli_si128(lo, 8), _mm_slli_si128(hi, 8));
+
+			__m128i d = div8_epi16(_mm_add_epi16(_mm_add_epi16(lo, hi), _mm_slli_epi16(mid, 1)));
+			d = _mm_or_si128(_mm_andnot_si128(wMask, d), _mm_and_si128(wMask, wVal));
+			_mm_storeu_si128((__m128i*)(grad + x + y * imgSize.x), d);
+		}
+
+		for (; x <= imgSize.x - 2; x++) gradientY(grad, x, y, image, imgSize);
+	}
+}
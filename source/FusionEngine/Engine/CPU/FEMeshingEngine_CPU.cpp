@@ -0,0 +1,87 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+#include "FEMeshingEngine_CPU.h"
+#include "../Common/FECMeshingEngine.h"
+
+#include <string.h>
+#include <vector>
+
+#ifdef WITH_OPENMP
+#include <omp.h>
+#endif
+
+using namespace FE;
+
+template<class TVoxel>
+void FEMeshingEngine_CPU<TVoxel, FEVoxelBlockHash>::MeshScene(FEMesh *mesh, const FEScene<TVoxel, FEVoxelBlockHash> *scene)
+{
+	FEMesh::Triangle *triangles = mesh->triangles->GetData(MEMORYDEVICE_CPU);
+	const TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	const FEHashEntry *hashTable = scene->index.GetEntries();
+
+	int noMaxTriangles = mesh->noMaxTriangles, noTotalEntries = scene->index.noTotalEntries;
+	float factor = scene->sceneParams->voxelSize;
+
+	// identify used voxel blocks
+	std::vector<int> allocatedEntryIDs;
+	allocatedEntryIDs.reserve(scene->localVBA.noBlocks);
+	for (int entryId = 0; entryId < noTotalEntries; entryId++)
+		if (hashTable[entryId].ptr >= 0) allocatedEntryIDs.push_back(entryId);
+
+	int noAllocatedEntries = (int)allocatedEntryIDs.size();
+
+	int noThreads = 1;
+#ifdef WITH_OPENMP
+	noThreads = omp_get_max_threads();
+#endif
+	std::vector< std::vector<FEMesh::Triangle> > threadTriangles(noThreads);
+
+	// mesh used voxel blocks
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int blockNo = 0; blockNo < noAllocatedEntries; blockNo++)
+	{
+		int threadId = 0;
+#ifdef WITH_OPENMP
+		threadId = omp_get_thread_num();
+#endif
+		std::vector<FEMesh::Triangle> &localTriangles = threadTriangles[threadId];
+
+		const FEHashEntry &currentHashEntry = hashTable[allocatedEntryIDs[blockNo]];
+		Vector3i globalPos = Vector3i(currentHashEntry.pos.x, currentHashEntry.pos.y, currentHashEntry.pos.z) * SDF_BLOCK_SIZE;
+
+		for (int z = 0; z < SDF_BLOCK_SIZE; z++) for (int y = 0; y < SDF_BLOCK_SIZE; y++) for (int x = 0; x < SDF_BLOCK_SIZE; x++)
+		{
+			Vector3f vertList[12];
+			int cubeIndex = buildVertList(vertList, globalPos, Vector3i(x, y, z), localVBA, hashTable);
+
+			if (cubeIndex < 0) continue;
+
+			for (int i = 0; triangleTable[cubeIndex][i] != -1; i += 3)
+			{
+				FEMesh::Triangle triangle;
+				triangle.p0 = vertList[triangleTable[cubeIndex][i]] * factor;
+				triangle.p1 = vertList[triangleTable[cubeIndex][i + 1]] * factor;
+				triangle.p2 = vertList[triangleTable[cubeIndex][i + 2]] * factor;
+				localTriangles.push_back(triangle);
+			}
+		}
+	}
+
+	// concatenate the per-thread buffers
+	int noTriangles = 0;
+	for (int threadId = 0; threadId < noThreads; threadId++)
+	{
+		int noCopy = MIN((int)threadTriangles[threadId].size(), noMaxTriangles - noTriangles);
+		if (noCopy <= 0) continue;
+
+		memcpy(triangles + noTriangles, &threadTriangles[threadId][0], noCopy * sizeof(FEMesh::Triangle));
+		noTriangles += noCopy;
+	}
+
+	mesh->noTotalTriangles = noTriangles;
+}
+
+template class FE::FEMeshingEngine_CPU<FEVoxel_s, FEVoxelIndex>;
+template class FE::FEMeshingEngine_CPU<FEVoxel_c, FEVoxelIndex>;
+template class FE::FEMeshingEngine_CPU<FEVoxel_c_rgb, FEVoxelIndex>;
@@ -0,0 +1,26 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+#ifndef _FE_MESHINGENGINE_CPU_H
+#define _FE_MESHINGENGINE_CPU_H
+
+#include "../FEMeshingEngine.h"
+
+namespace FE
+{
+	template<class TVoxel, class TIndex>
+	class FEMeshingEngine_CPU : public FEMeshingEngine < TVoxel, TIndex >
+	{};
+
+	template<class TVoxel>
+	class FEMeshingEngine_CPU<TVoxel, FEVoxelBlockHash> : public FEMeshingEngine < TVoxel, FEVoxelBlockHash >
+	{
+	public:
+		/** Meshes all allocated blocks, each thread writes its triangles into
+			its own buffer and the buffers are concatenated into the mesh at the end.
+			*/
+		void MeshScene(FEMesh *mesh, const FEScene<TVoxel, FEVoxelBlockHash> *scene);
+
+		FEMeshingEngine_CPU(void) { }
+		~FEMeshingEngine_CPU(void) { }
+	};
+}
+#endif //_FE_MESHINGENGINE_CPU_H
@@ -0,0 +1,603 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#include "FESceneReconstructionEngine_CPU.h"
+#include "../Common/FECSceneReconstructionEngine.h"
+#include "../../Objects/FERenderState_VH.h"
+
+using namespace FE;
+
+template<class TVoxel, bool stopMaxW, bool approximateIntegration>
+static void integrateIntoScene_host(TVoxel *localVBA, const FEHashEntry *hashTable, const int *visibleEntryIDs, int noVisibleEntries,
+	const Vector4u *rgb, Vector2i rgbImgSize, const float *depth, Vector2i depthImgSize, Matrix4f M_d, Matrix4f M_rgb, Vector4f projParams_d,
+	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW);
+
+template<class TVoxel, bool stopMaxW>
+static void reintegrateIntoScene_host(TVoxel *localVBA, const FEHashEntry *hashTable, const int *visibleEntryIDs, int noVisibleEntries,
+	const uchar *entriesVisibleType, const uchar *entriesRepealType, const Vector4u *rgb, Vector2i rgbImgSize, const float *depth,
+	const float *depthWeight, Vector2i depthImgSize, Matrix4f old_M, Matrix4f new_M, Matrix4f new_M_rgb, Vector4f projParams_d,
+	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW);
+
+// host methods
+
+template<class TVoxel>
+FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::FESceneReconstructionEngine_CPU(void)
+{
+	int noTotalEntries = FEVoxelBlockHash::noTotalEntries;
+	entriesAllocType = new Basis::MemoryBlock<unsigned char>(noTotalEntries, MEMORYDEVICE_CPU);
+	blockCoords = new Basis::MemoryBlock<Vector4s>(noTotalEntries, MEMORYDEVICE_CPU);
+	entriesRepealType = new Basis::MemoryBlock<unsigned char>(noTotalEntries, MEMORYDEVICE_CPU);
+}
+
+template<class TVoxel>
+FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::~FESceneReconstructionEngine_CPU(void)
+{
+	delete entriesAllocType;
+	delete blockCoords;
+	delete entriesRepealType;
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::ResetScene(FEScene<TVoxel, FEVoxelBlockHash> *scene)
+{
+	int numBlocks = scene->localVBA.noBlocks;
+	int blockSize = scene->index.getVoxelBlockSize();
+
+	TVoxel *voxelBlocks_ptr = scene->localVBA.GetVoxelBlocks();
+	for (int i = 0; i < numBlocks * blockSize; ++i) voxelBlocks_ptr[i] = TVoxel();
+	int *vbaAllocationList_ptr = scene->localVBA.GetAllocationList();
+	for (int i = 0; i < numBlocks; ++i) vbaAllocationList_ptr[i] = i;
+	scene->localVBA.lastFreeBlockId = numBlocks - 1;
+
+	FEHashEntry tmpEntry;
+	memset(&tmpEntry, 0, sizeof(FEHashEntry));
+	tmpEntry.ptr = -2;
+	FEHashEntry *hashEntry_ptr = scene->index.GetEntries();
+	for (int i = 0; i < scene->index.noTotalEntries; ++i) hashEntry_ptr[i] = tmpEntry;
+	int *excessList_ptr = scene->index.GetExcessAllocationList();
+	for (int i = 0; i < SDF_EXCESS_LIST_SIZE; ++i) excessList_ptr[i] = i;
+
+	scene->index.SetLastFreeExcessListId(SDF_EXCESS_LIST_SIZE - 1);
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view,
+	const FETrackingState *trackingState, const FERenderState *renderState, bool onlyUpdateVisibleList)
+{
+	Matrix4f M_d = trackingState->pose_d->GetM();
+
+	AllocateSceneFromDepth(scene, view, M_d, renderState, onlyUpdateVisibleList);
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::IntegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view,
+	const FETrackingState *trackingState, const FERenderState *renderState)
+{
+	Vector2i rgbImgSize = view->rgb->noDims;
+	Vector2i depthImgSize = view->depth->noDims;
+	float voxelSize = scene->sceneParams->voxelSize;
+
+	Matrix4f M_d, M_rgb;
+	Vector4f projParams_d, projParams_rgb;
+
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	M_d = trackingState->pose_d->GetM();
+	if (TVoxel::hasColorInformation) M_rgb = view->calib->trafo_rgb_to_depth.calib_inv * M_d;
+
+	projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
+	projParams_rgb = view->calib->intrinsics_rgb.projectionParamsSimple.all;
+
+	float mu = scene->sceneParams->mu; int maxW = scene->sceneParams->maxW;
+
+	float *depth = view->depth->GetData(MEMORYDEVICE_CPU);
+	Vector4u *rgb = view->rgb->GetData(MEMORYDEVICE_CPU);
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	FEHashEntry *hashTable = scene->index.GetEntries();
+
+	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	int noVisibleEntries = renderState_vh->noVisibleEntries;
+
+	if (scene->sceneParams->stopIntegratingAtMaxW)
+		if (trackingState->requiresFullRendering)
+			integrateIntoScene_host<TVoxel, true, false>(localVBA, hashTable, visibleEntryIDs, noVisibleEntries,
+			rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+		else
+			integrateIntoScene_host<TVoxel, true, true>(localVBA, hashTable, visibleEntryIDs, noVisibleEntries,
+			rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+	else
+		if (trackingState->requiresFullRendering)
+			integrateIntoScene_host<TVoxel, false, false>(localVBA, hashTable, visibleEntryIDs, noVisibleEntries,
+			rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+		else
+			integrateIntoScene_host<TVoxel, false, true>(localVBA, hashTable, visibleEntryIDs, noVisibleEntries,
+			rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
+	const FERenderState *renderState, bool onlyUpdateVisibleList)
+{
+	AllocateSceneFromDepth(scene, view, -1, M_d, renderState, onlyUpdateVisibleList);
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const int frameIndex,
+	const Matrix4f &M_d, const FERenderState *renderState, bool onlyUpdateVisibleList)
+{
+	Vector2i depthImgSize = view->depth->noDims;
+	float voxelSize = scene->sceneParams->voxelSize;
+
+	Matrix4f invM_d;
+	Vector4f projParams_d, invProjParams_d;
+
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+	M_d.inv(invM_d);
+
+	projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
+	invProjParams_d = projParams_d;
+	invProjParams_d.x = 1.0f / invProjParams_d.x;
+	invProjParams_d.y = 1.0f / invProjParams_d.y;
+
+	float mu = scene->sceneParams->mu;
+	float viewFrustum_min = scene->sceneParams->viewFrustum_min, viewFrustum_max = scene->sceneParams->viewFrustum_max;
+
+	float *depth = view->depth->GetData(MEMORYDEVICE_CPU);
+	int *excessAllocationList = scene->index.GetExcessAllocationList();
+	FEHashEntry *hashTable = scene->index.GetEntries();
+
+	int noTotalEntries = scene->index.noTotalEntries;
+
+	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+
+	uchar *entriesAllocType = this->entriesAllocType->GetData(MEMORYDEVICE_CPU);
+	Vector4s *blockCoords = this->blockCoords->GetData(MEMORYDEVICE_CPU);
+
+	float oneOverVoxelSize = 1.0f / (voxelSize * SDF_BLOCK_SIZE);
+
+	int lastFreeExcessListId = scene->index.GetLastFreeExcessListId();
+
+	memset(entriesAllocType, 0, sizeof(unsigned char)* noTotalEntries);
+
+	// entries that were visible in the last frame are dropped again when
+	// building the visible list, so they need not be marked here
+	memset(entriesVisibleType, 0, sizeof(uchar)* noTotalEntries);
+
+	// every pixel only writes constant flags into the tables, so concurrent rows are safe
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < depthImgSize.y; y++) for (int x = 0; x < depthImgSize.x; x++)
+	{
+		buildHashAllocAndVisibleTypePP(entriesAllocType, entriesVisibleType, x, y, blockCoords, depth, invM_d,
+			invProjParams_d, mu, depthImgSize, oneOverVoxelSize, hashTable, viewFrustum_min, viewFrustum_max);
+	}
+
+	if (!onlyUpdateVisibleList)
+	{
+		// grow the voxel block array by what this frame needs, so none of its blocks are dropped
+		int noRequiredBlocks = 0;
+		for (int targetIdx = 0; targetIdx < noTotalEntries; targetIdx++)
+		{
+			if (entriesAllocType[targetIdx] != 0 || (scene->useSwapping && entriesVisibleType[targetIdx] != 0 && hashTable[targetIdx].ptr == -1))
+				noRequiredBlocks++;
+		}
+		this->ReserveVoxelBlocks(scene, noRequiredBlocks);
+	}
+
+	int *voxelAllocationList = scene->localVBA.GetAllocationList();
+	int lastFreeVoxelBlockId = scene->localVBA.lastFreeBlockId;
+
+	if (!onlyUpdateVisibleList)
+	{
+		for (int targetIdx = 0; targetIdx < noTotalEntries; targetIdx++)
+		{
+			unsigned char hashChangeType = entriesAllocType[targetIdx];
+			if (hashChangeType == 0) continue;
+
+			int vbaIdx = lastFreeVoxelBlockId, exlIdx = lastFreeExcessListId;
+
+			switch (hashChangeType)
+			{
+			case 1: //needs allocation, fits in the ordered list
+				if (vbaIdx >= 0) //there is room in the voxel block array
+				{
+					Vector4s pt_block_all = blockCoords[targetIdx];
+
+					FEHashEntry hashEntry;
+					hashEntry.pos.x = pt_block_all.x; hashEntry.pos.y = pt_block_all.y; hashEntry.pos.z = pt_block_all.z;
+					hashEntry.ptr = voxelAllocationList[vbaIdx];
+					hashEntry.offset = hashTable[targetIdx].offset; //a released bucket keeps its excess list
+
+					hashTable[targetIdx] = hashEntry;
+					lastFreeVoxelBlockId--;
+				}
+				break;
+
+			case 2: //needs allocation in the excess list
+				if (vbaIdx >= 0 && exlIdx >= 0) //there is room in the voxel block array and excess list
+				{
+					Vector4s pt_block_all = blockCoords[targetIdx];
+
+					FEHashEntry hashEntry;
+					hashEntry.pos.x = pt_block_all.x; hashEntry.pos.y = pt_block_all.y; hashEntry.pos.z = pt_block_all.z;
+					hashEntry.ptr = voxelAllocationList[vbaIdx];
+					hashEntry.offset = 0;
+
+					int exlOffset = excessAllocationList[exlIdx];
+
+					hashTable[targetIdx].offset = exlOffset + 1; //connect to child
+
+					hashTable[SDF_BUCKET_NUM + exlOffset] = hashEntry; //add child to the excess list
+
+					entriesVisibleType[SDF_BUCKET_NUM + exlOffset] = 1; //make child visible
+
+					lastFreeVoxelBlockId--;
+					lastFreeExcessListId--;
+				}
+				break;
+			}
+		}
+
+		if (scene->useSwapping)
+		{
+			// visible entries that were swapped out get a block again, the swapping engine merges their data back
+			for (int targetIdx = 0; targetIdx < noTotalEntries && lastFreeVoxelBlockId >= 0; targetIdx++)
+			{
+				if (entriesVisibleType[targetIdx] == 0 || hashTable[targetIdx].ptr != -1) continue;
+
+				hashTable[targetIdx].ptr = voxelAllocationList[lastFreeVoxelBlockId];
+				lastFreeVoxelBlockId--;
+			}
+		}
+	}
+
+	renderState_vh->noVisibleEntries = BuildVisibleList(entriesVisibleType, visibleEntryIDs, noTotalEntries);
+	scene->localVBA.lastFreeBlockId = lastFreeVoxelBlockId;
+	scene->index.SetLastFreeExcessListId(lastFreeExcessListId);
+
+	if (frameIndex >= 0)
+		renderState_vh->GetVisibleListBlock()->saveVisibleListToBlock(frameIndex, visibleEntryIDs, renderState_vh->noVisibleEntries, MEMORYDEVICE_CPU);
+	else
+		renderState_vh->GetVisibleListBlock()->saveVisibleListToBlock(visibleEntryIDs, renderState_vh->noVisibleEntries, MEMORYDEVICE_CPU);
+}
+
+template<class TVoxel>
+int FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::BuildVisibleList(uchar *entriesVisibleType, int *visibleEntryIDs, int noTotalEntries)
+{
+	int noVisibleEntries = 0;
+
+	for (int targetIdx = 0; targetIdx < noTotalEntries; targetIdx++)
+	{
+		unsigned char hashVisibleType = entriesVisibleType[targetIdx];
+
+		if (hashVisibleType == 3)
+		{
+			hashVisibleType = 0;
+			entriesVisibleType[targetIdx] = 0;
+		}
+
+		if (hashVisibleType > 0)
+		{
+			visibleEntryIDs[noVisibleEntries] = targetIdx;
+			noVisibleEntries++;
+		}
+	}
+
+	return noVisibleEntries;
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::IntegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
+	const FERenderState *renderState)
+{
+	Vector2i rgbImgSize = view->rgb->noDims;
+	Vector2i depthImgSize = view->depth->noDims;
+	float voxelSize = scene->sceneParams->voxelSize;
+
+	Matrix4f M_rgb;
+	Vector4f projParams_d, projParams_rgb;
+
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	if (TVoxel::hasColorInformation) M_rgb = view->calib->trafo_rgb_to_depth.calib_inv * M_d;
+
+	projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
+	projParams_rgb = view->calib->intrinsics_rgb.projectionParamsSimple.all;
+
+	float mu = scene->sceneParams->mu; int maxW = scene->sceneParams->maxW;
+
+	float *depth = view->depth->GetData(MEMORYDEVICE_CPU);
+	Vector4u *rgb = view->rgb->GetData(MEMORYDEVICE_CPU);
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	FEHashEntry *hashTable = scene->index.GetEntries();
+
+	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	int noVisibleEntries = renderState_vh->noVisibleEntries;
+
+	if (scene->sceneParams->stopIntegratingAtMaxW)
+		integrateIntoScene_host<TVoxel, true, false>(localVBA, hashTable, visibleEntryIDs, noVisibleEntries,
+		rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+	else
+		integrateIntoScene_host<TVoxel, false, false>(localVBA, hashTable, visibleEntryIDs, noVisibleEntries,
+		rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::AllocateSceneForReintegration(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view,
+	const int frameIndex, const Matrix4f &new_M, const FERenderState *renderState)
+{
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	int noTotalEntries = scene->index.noTotalEntries;
+
+	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+	uchar *entriesRepealType = this->entriesRepealType->GetData(MEMORYDEVICE_CPU);
+
+	// the old list has to be read before the allocation stores the new one
+	memset(entriesRepealType, 0, sizeof(uchar)* noTotalEntries);
+
+	int noOldEntries = renderState_vh->GetVisibleListBlock()->readVisibleList(frameIndex, visibleEntryIDs, MEMORYDEVICE_CPU);
+
+	// entries released since the list was saved may hold other blocks by now
+	const int *entriesReleaseStamp = renderState_vh->GetEntriesReleaseStamp();
+	int oldStamp = renderState_vh->GetVisibleListBlock()->getStamp(frameIndex);
+	for (int i = 0; i < noOldEntries; i++)
+	{
+		int entryId = visibleEntryIDs[i];
+		if (entriesReleaseStamp[entryId] <= oldStamp) entriesRepealType[entryId] = 1;
+	}
+
+	AllocateSceneFromDepth(scene, view, frameIndex, new_M, renderState);
+
+	// append the blocks only the old pose saw
+	FEHashEntry *hashTable = scene->index.GetEntries();
+	int *voxelAllocationList = scene->localVBA.GetAllocationList();
+	int lastFreeVoxelBlockId = scene->localVBA.lastFreeBlockId;
+	int noVisibleEntries = renderState_vh->noVisibleEntries;
+
+	for (int targetIdx = 0; targetIdx < noTotalEntries; targetIdx++)
+	{
+		if (entriesRepealType[targetIdx] == 0 || entriesVisibleType[targetIdx] != 0) continue;
+
+		entriesVisibleType[targetIdx] = 6;
+		visibleEntryIDs[noVisibleEntries] = targetIdx;
+		noVisibleEntries++;
+
+		// the block may have been swapped out since, it needs a block to be repealed from
+		if (scene->useSwapping && hashTable[targetIdx].ptr == -1 && lastFreeVoxelBlockId >= 0)
+		{
+			hashTable[targetIdx].ptr = voxelAllocationList[lastFreeVoxelBlockId];
+			lastFreeVoxelBlockId--;
+		}
+	}
+
+	renderState_vh->noVisibleEntries = noVisibleEntries;
+	scene->localVBA.lastFreeBlockId = lastFreeVoxelBlockId;
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::ReintegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view,
+	const Matrix4f &old_M, const Matrix4f &new_M, const FERenderState *renderState, const FloatImage *depthWeight)
+{
+	Vector2i rgbImgSize = view->rgb->noDims;
+	Vector2i depthImgSize = view->depth->noDims;
+	float voxelSize = scene->sceneParams->voxelSize;
+
+	Matrix4f new_M_rgb;
+	Vector4f projParams_d, projParams_rgb;
+
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	if (TVoxel::hasColorInformation) new_M_rgb = view->calib->trafo_rgb_to_depth.calib_inv * new_M;
+
+	projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
+	projParams_rgb = view->calib->intrinsics_rgb.projectionParamsSimple.all;
+
+	float mu = scene->sceneParams->mu; int maxW = scene->sceneParams->maxW;
+
+	float *depth = view->depth->GetData(MEMORYDEVICE_CPU);
+	const float *weight = depthWeight != NULL ? depthWeight->GetData(MEMORYDEVICE_CPU) : NULL;
+	Vector4u *rgb = view->rgb->GetData(MEMORYDEVICE_CPU);
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	FEHashEntry *hashTable = scene->index.GetEntries();
+
+	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+	uchar *entriesRepealType = this->entriesRepealType->GetData(MEMORYDEVICE_CPU);
+
+	if (scene->sceneParams->stopIntegratingAtMaxW)
+		reintegrateIntoScene_host<TVoxel, true>(localVBA, hashTable, visibleEntryIDs, renderState_vh->noVisibleEntries, entriesVisibleType,
+		entriesRepealType, rgb, rgbImgSize, depth, weight, depthImgSize, old_M, new_M, new_M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+	else
+		reintegrateIntoScene_host<TVoxel, false>(localVBA, hashTable, visibleEntryIDs, renderState_vh->noVisibleEntries, entriesVisibleType,
+		entriesRepealType, rgb, rgbImgSize, depth, weight, depthImgSize, old_M, new_M, new_M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+}
+
+template<class TVoxel>
+void FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash>::CollectGarbage(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FERenderState *renderState,
+	int firstBucketId, int noBuckets)
+{
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	int *voxelAllocationList = scene->localVBA.GetAllocationList();
+	int *excessAllocationList = scene->index.GetExcessAllocationList();
+	FEHashEntry *hashTable = scene->index.GetEntries();
+
+	const uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+	// with swapping only blocks whose newest data is in the voxel block array may go, the others are waiting to be merged
+	uchar *swapStates = scene->useSwapping ? scene->globalCache->GetSwapStates() : NULL;
+
+	uchar *entriesGarbageType = this->entriesAllocType->GetData(MEMORYDEVICE_CPU);
+
+	// the stored visible lists keep the ids of the released entries, they are stale in those lists from now on
+	int *entriesReleaseStamp = renderState_vh->GetEntriesReleaseStamp();
+	int releaseStamp = renderState_vh->GetVisibleListBlock()->getNextStamp();
+
+	int lastBucketId = MIN(firstBucketId + noBuckets, SDF_BUCKET_NUM);
+
+	// mark and reset the empty blocks, every bucket and its excess list belong to one iteration
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int bucketId = firstBucketId; bucketId < lastBucketId; bucketId++)
+	{
+		for (int entryId = bucketId;;)
+		{
+			const FEHashEntry &hashEntry = hashTable[entryId];
+
+			bool isGarbage = hashEntry.ptr >= 0 && entriesVisibleType[entryId] == 0 && (swapStates == NULL || swapStates[entryId] == 1) &&
+				isVoxelBlockEmpty(localVBA + hashEntry.ptr * SDF_BLOCK_SIZE3);
+
+			entriesGarbageType[entryId] = isGarbage;
+			if (isGarbage)
+			{
+				TVoxel *localVoxelBlock = localVBA + hashEntry.ptr * SDF_BLOCK_SIZE3;
+				for (int vIdx = 0; vIdx < SDF_BLOCK_SIZE3; vIdx++) localVoxelBlock[vIdx] = TVoxel();
+			}
+
+			if (hashEntry.offset < 1) break;
+			entryId = SDF_BUCKET_NUM + hashEntry.offset - 1;
+		}
+	}
+
+	FEHashEntry emptyEntry;
+	memset(&emptyEntry, 0, sizeof(FEHashEntry));
+	emptyEntry.ptr = -2;
+
+	int lastFreeVoxelBlockId = scene->localVBA.lastFreeBlockId;
+	int lastFreeExcessListId = scene->index.GetLastFreeExcessListId();
+
+	for (int bucketId = firstBucketId; bucketId < lastBucketId; bucketId++)
+	{
+		// unlink the released excess entries from the list and hand their slots back
+		for (int prevId = bucketId, entryId; hashTable[prevId].offset >= 1;)
+		{
+			entryId = SDF_BUCKET_NUM + hashTable[prevId].offset - 1;
+			if (!entriesGarbageType[entryId]) { prevId = entryId; continue; }
+
+			lastFreeVoxelBlockId++;
+			voxelAllocationList[lastFreeVoxelBlockId] = hashTable[entryId].ptr;
+
+			lastFreeExcessListId++;
+			excessAllocationList[lastFreeExcessListId] = entryId - SDF_BUCKET_NUM;
+
+			hashTable[prevId].offset = hashTable[entryId].offset;
+			hashTable[entryId] = emptyEntry;
+			entriesReleaseStamp[entryId] = releaseStamp;
+			if (swapStates != NULL) swapStates[entryId] = 0;
+		}
+
+		// a released bucket keeps the link to its excess list
+		if (entriesGarbageType[bucketId])
+		{
+			lastFreeVoxelBlockId++;
+			voxelAllocationList[lastFreeVoxelBlockId] = hashTable[bucketId].ptr;
+
+			hashTable[bucketId].ptr = -2;
+			entriesReleaseStamp[bucketId] = releaseStamp;
+			if (swapStates != NULL) swapStates[bucketId] = 0;
+		}
+	}
+
+	scene->localVBA.lastFreeBlockId = lastFreeVoxelBlockId;
+	scene->index.SetLastFreeExcessListId(lastFreeExcessListId);
+}
+
+// per-block host functions, one voxel block per loop iteration on each core
+
+template<class TVoxel, bool stopMaxW, bool approximateIntegration>
+static void integrateIntoScene_host(TVoxel *localVBA, const FEHashEntry *hashTable, const int *visibleEntryIDs, int noVisibleEntries,
+	const Vector4u *rgb, Vector2i rgbImgSize, const float *depth, Vector2i depthImgSize, Matrix4f M_d, Matrix4f M_rgb, Vector4f projParams_d,
+	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW)
+{
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int entryId = 0; entryId < noVisibleEntries; entryId++)
+	{
+		const FEHashEntry &currentHashEntry = hashTable[visibleEntryIDs[entryId]];
+
+		if (currentHashEntry.ptr < 0) continue;
+
+		Vector3i globalPos = currentHashEntry.pos.toInt() * SDF_BLOCK_SIZE;
+
+		TVoxel *localVoxelBlock = &(localVBA[currentHashEntry.ptr * SDF_BLOCK_SIZE3]);
+
+		// voxels are visited in memory order, x innermost
+		for (int z = 0; z < SDF_BLOCK_SIZE; z++) for (int y = 0; y < SDF_BLOCK_SIZE; y++)
+		{
+			Vector4f pt_model;
+			pt_model.y = (float)(globalPos.y + y) * _voxelSize;
+			pt_model.z = (float)(globalPos.z + z) * _voxelSize;
+			pt_model.w = 1.0f;
+
+			TVoxel *voxelRow = &(localVoxelBlock[y * SDF_BLOCK_SIZE + z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE]);
+
+			for (int x = 0; x < SDF_BLOCK_SIZE; x++)
+			{
+				if (stopMaxW) if (voxelRow[x].w_depth == maxW) continue;
+				if (approximateIntegration) if (voxelRow[x].w_depth != 0) continue;
+
+				pt_model.x = (float)(globalPos.x + x) * _voxelSize;
+
+				ComputeUpdatedVoxelInfo<TVoxel::hasColorInformation, TVoxel>::compute(voxelRow[x], pt_model, M_d, projParams_d, M_rgb, projParams_rgb, mu, maxW, depth, depthImgSize, rgb, rgbImgSize);
+			}
+		}
+	}
+}
+
+template<class TVoxel, bool stopMaxW>
+static void reintegrateIntoScene_host(TVoxel *localVBA, const FEHashEntry *hashTable, const int *visibleEntryIDs, int noVisibleEntries,
+	const uchar *entriesVisibleType, const uchar *entriesRepealType, const Vector4u *rgb, Vector2i rgbImgSize, const float *depth,
+	const float *depthWeight, Vector2i depthImgSize, Matrix4f old_M, Matrix4f new_M, Matrix4f new_M_rgb, Vector4f projParams_d,
+	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW)
+{
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int entryId = 0; entryId < noVisibleEntries; entryId++)
+	{
+		int targetIdx = visibleEntryIDs[entryId];
+		const FEHashEntry &currentHashEntry = hashTable[targetIdx];
+
+		if (currentHashEntry.ptr < 0) continue;
+
+		// type 6 blocks were only seen from the old pose
+		bool isRepealed = entriesRepealType[targetIdx] != 0, isIntegrated = entriesVisibleType[targetIdx] != 6;
+
+		Vector3i globalPos = currentHashEntry.pos.toInt() * SDF_BLOCK_SIZE;
+
+		TVoxel *localVoxelBlock = &(localVBA[currentHashEntry.ptr * SDF_BLOCK_SIZE3]);
+
+		for (int z = 0; z < SDF_BLOCK_SIZE; z++) for (int y = 0; y < SDF_BLOCK_SIZE; y++)
+		{
+			Vector4f pt_model;
+			pt_model.y = (float)(globalPos.y + y) * _voxelSize;
+			pt_model.z = (float)(globalPos.z + z) * _voxelSize;
+			pt_model.w = 1.0f;
+
+			TVoxel *voxelRow = &(localVoxelBlock[y * SDF_BLOCK_SIZE + z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE]);
+
+			for (int x = 0; x < SDF_BLOCK_SIZE; x++)
+			{
+				pt_model.x = (float)(globalPos.x + x) * _voxelSize;
+
+				TVoxel voxel = voxelRow[x];
+
+				if (isRepealed) recoverVoxelDepthInfo(voxel, pt_model, old_M, projParams_d, mu, maxW, depth, depthImgSize, depthWeight);
+
+				if (isIntegrated && !(stopMaxW && voxel.w_depth == maxW))
+					ComputeUpdatedVoxelInfo<TVoxel::hasColorInformation, TVoxel>::compute(voxel, pt_model, new_M, projParams_d, new_M_rgb, projParams_rgb, mu, maxW, depth, depthImgSize, rgb, rgbImgSize, depthWeight);
+
+				voxelRow[x] = voxel;
+			}
+		}
+	}
+}
+
+template class FE::FESceneReconstructionEngine_CPU<FEVoxel_s, FEVoxelIndex>;
+template class FE::FESceneReconstructionEngine_CPU<FEVoxel_c, FEVoxelIndex>;
+template class FE::FESceneReconstructionEngine_CPU<FEVoxel_c_rgb, FEVoxelIndex>;
@@ -0,0 +1,59 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_SCENERECONSTRUCTIONENGINE_CPU_H
+#define _FE_SCENERECONSTRUCTIONENGINE_CPU_H
+
+#include "../FESceneReconstructionEngine.h"
+
+namespace FE
+{
+	template<class TVoxel, class TIndex>
+	class FESceneReconstructionEngine_CPU : public FESceneReconstructionEngine < TVoxel, TIndex >
+	{};
+
+	template<class TVoxel>
+	class FESceneReconstructionEngine_CPU<TVoxel, FEVoxelBlockHash> : public FESceneReconstructionEngine < TVoxel, FEVoxelBlockHash >
+	{
+	private:
+		Basis::MemoryBlock<unsigned char> *entriesAllocType;
+		Basis::MemoryBlock<Vector4s> *blockCoords;
+
+		/** Entries the frame being reintegrated was integrated into before. */
+		Basis::MemoryBlock<unsigned char> *entriesRepealType;
+
+		/** Compact the visible entries of the hash table into the visible entry list
+			and the binary visible list, returns the number of visible entries.
+			*/
+		int BuildVisibleList(uchar *entriesVisibleType, int *visibleEntryIDs, int noTotalEntries);
+
+	public:
+		void ResetScene(FEScene<TVoxel, FEVoxelBlockHash> *scene);
+
+		void AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const FETrackingState *trackingState,
+			const FERenderState *renderState, bool onlyUpdateVisibleList = false);
+
+		void IntegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const FETrackingState *trackingState,
+			const FERenderState *renderState);
+
+		void AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
+			const FERenderState *renderState, bool onlyUpdateVisibleList = false);
+
+		void AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const int frameIndex, const Matrix4f &M_d,
+			const FERenderState *renderState, bool onlyUpdateVisibleList = false);
+
+		void IntegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
+			const FERenderState *renderState);
+
+		void AllocateSceneForReintegration(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const int frameIndex,
+			const Matrix4f &new_M, const FERenderState *renderState);
+
+		void ReintegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &old_M,
+			const Matrix4f &new_M, const FERenderState *renderState, const FloatImage *depthWeight = NULL);
+
+		void CollectGarbage(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FERenderState *renderState, int firstBucketId, int noBuckets);
+
+		FESceneReconstructionEngine_CPU(void);
+		~FESceneReconstructionEngine_CPU(void);
+	};
+}
+#endif //_FE_SCENERECONSTRUCTIONENGINE_CPU_H
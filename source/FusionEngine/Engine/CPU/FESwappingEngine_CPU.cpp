@@ -0,0 +1,141 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#include "FESwappingEngine_CPU.h"
+#include "../Common/FECSwappingEngine.h"
+#include "../Common/FECSceneReconstructionEngine.h"
+#include "../../Objects/FERenderState_VH.h"
+
+using namespace FE;
+
+template<class TVoxel>
+void FESwappingEngine_CPU<TVoxel, FEVoxelBlockHash>::IntegrateGlobalIntoLocal(FEScene<TVoxel, FEVoxelBlockHash> *scene, FERenderState *renderState)
+{
+	FEGlobalCache<TVoxel> *globalCache = scene->globalCache;
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	FEHashEntry *hashTable = scene->index.GetEntries();
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	uchar *swapStates = globalCache->GetSwapStates();
+
+	TVoxel *transferBlocks = globalCache->GetTransferBlocks(MEMORYDEVICE_CPU);
+	int *transferEntryIDs = globalCache->GetTransferEntryIDs(MEMORYDEVICE_CPU);
+	Vector3s *transferBlockPos = globalCache->GetTransferBlockPos(MEMORYDEVICE_CPU);
+	uchar *hasTransferData = globalCache->GetHasTransferData(MEMORYDEVICE_CPU);
+
+	const int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	int noVisibleEntries = renderState_vh->noVisibleEntries;
+	int maxW = scene->sceneParams->maxW;
+
+	// all visible blocks have to be merged before they are used, so batches are repeated until the list is done
+	for (int visibleId = 0; visibleId < noVisibleEntries;)
+	{
+		int noNeededEntries = 0;
+		for (; visibleId < noVisibleEntries && noNeededEntries < SDF_TRANSFER_BLOCK_NUM; visibleId++)
+		{
+			int entryId = visibleEntryIDs[visibleId];
+			if (swapStates[entryId] != 0 || hashTable[entryId].ptr < 0) continue;
+
+			transferEntryIDs[noNeededEntries] = entryId;
+			transferBlockPos[noNeededEntries] = hashTable[entryId].pos;
+			noNeededEntries++;
+		}
+
+		globalCache->ReadTransferBlocks(noNeededEntries);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int transferId = 0; transferId < noNeededEntries; transferId++)
+		{
+			int entryId = transferEntryIDs[transferId];
+
+			if (hasTransferData[transferId])
+			{
+				const TVoxel *srcVoxelBlock = transferBlocks + transferId * SDF_BLOCK_SIZE3;
+				TVoxel *dstVoxelBlock = localVBA + hashTable[entryId].ptr * SDF_BLOCK_SIZE3;
+
+				for (int vIdx = 0; vIdx < SDF_BLOCK_SIZE3; vIdx++)
+					CombineVoxelInformation<TVoxel::hasColorInformation, TVoxel>::compute(srcVoxelBlock[vIdx], dstVoxelBlock[vIdx], maxW);
+			}
+
+			swapStates[entryId] = 1;
+		}
+	}
+}
+
+template<class TVoxel>
+void FESwappingEngine_CPU<TVoxel, FEVoxelBlockHash>::SaveToGlobalMemory(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
+	FERenderState *renderState)
+{
+	FEGlobalCache<TVoxel> *globalCache = scene->globalCache;
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	FEHashEntry *hashTable = scene->index.GetEntries();
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	int *voxelAllocationList = scene->localVBA.GetAllocationList();
+	uchar *swapStates = globalCache->GetSwapStates();
+
+	TVoxel *transferBlocks = globalCache->GetTransferBlocks(MEMORYDEVICE_CPU);
+	int *transferEntryIDs = globalCache->GetTransferEntryIDs(MEMORYDEVICE_CPU);
+	Vector3s *transferBlockPos = globalCache->GetTransferBlockPos(MEMORYDEVICE_CPU);
+
+	const uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+	int noTotalEntries = scene->index.noTotalEntries;
+
+	Vector2i depthImgSize = view->depth->noDims;
+	Vector4f projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
+	float voxelSize = scene->sceneParams->voxelSize;
+
+	int noNeededEntries = 0;
+	for (int entryId = 0; entryId < noTotalEntries && noNeededEntries < SDF_TRANSFER_BLOCK_NUM; entryId++)
+	{
+		if (swapStates[entryId] != 1 || entriesVisibleType[entryId] > 0) continue;
+
+		const FEHashEntry &hashEntry = hashTable[entryId];
+		if (hashEntry.ptr < 0) continue;
+
+		// keep a margin around the view, so blocks do not bounce in and out at its border
+		bool isVisible, isVisibleEnlarged;
+		checkBlockVisibility<true>(isVisible, isVisibleEnlarged, hashEntry.pos, M_d, projParams_d, voxelSize, depthImgSize);
+		if (isVisibleEnlarged) continue;
+
+		transferEntryIDs[noNeededEntries] = entryId;
+		transferBlockPos[noNeededEntries] = hashEntry.pos;
+		noNeededEntries++;
+	}
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int transferId = 0; transferId < noNeededEntries; transferId++)
+	{
+		TVoxel *localVoxelBlock = localVBA + hashTable[transferEntryIDs[transferId]].ptr * SDF_BLOCK_SIZE3;
+		TVoxel *transferVoxelBlock = transferBlocks + transferId * SDF_BLOCK_SIZE3;
+
+		for (int vIdx = 0; vIdx < SDF_BLOCK_SIZE3; vIdx++)
+		{
+			transferVoxelBlock[vIdx] = localVoxelBlock[vIdx];
+			localVoxelBlock[vIdx] = TVoxel();
+		}
+	}
+
+	globalCache->WriteTransferBlocks(noNeededEntries);
+
+	// hand the blocks back to the voxel block array
+	int lastFreeVoxelBlockId = scene->localVBA.lastFreeBlockId;
+	for (int transferId = 0; transferId < noNeededEntries; transferId++)
+	{
+		int entryId = transferEntryIDs[transferId];
+
+		lastFreeVoxelBlockId++;
+		voxelAllocationList[lastFreeVoxelBlockId] = hashTable[entryId].ptr;
+
+		hashTable[entryId].ptr = -1;
+		swapStates[entryId] = 0;
+	}
+	scene->localVBA.lastFreeBlockId = lastFreeVoxelBlockId;
+}
+
+template class FE::FESwappingEngine_CPU<FEVoxel_s, FEVoxelIndex>;
+template class FE::FESwappingEngine_CPU<FEVoxel_c, FEVoxelIndex>;
+template class FE::FESwappingEngine_CPU<FEVoxel_c_rgb, FEVoxelIndex>;
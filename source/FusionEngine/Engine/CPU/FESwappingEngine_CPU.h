@@ -0,0 +1,29 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_SWAPPINGENGINE_CPU_H
+#define _FE_SWAPPINGENGINE_CPU_H
+
+#include "../FESwappingEngine.h"
+
+namespace FE
+{
+	template<class TVoxel, class TIndex>
+	class FESwappingEngine_CPU : public FESwappingEngine < TVoxel, TIndex >
+	{
+	public:
+		void IntegrateGlobalIntoLocal(FEScene<TVoxel, TIndex> *scene, FERenderState *renderState) { }
+		void SaveToGlobalMemory(FEScene<TVoxel, TIndex> *scene, const FEView *view, const Matrix4f &M_d, FERenderState *renderState) { }
+	};
+
+	template<class TVoxel>
+	class FESwappingEngine_CPU<TVoxel, FEVoxelBlockHash> : public FESwappingEngine < TVoxel, FEVoxelBlockHash >
+	{
+	public:
+		void IntegrateGlobalIntoLocal(FEScene<TVoxel, FEVoxelBlockHash> *scene, FERenderState *renderState);
+		void SaveToGlobalMemory(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d, FERenderState *renderState);
+
+		FESwappingEngine_CPU(void) { }
+		~FESwappingEngine_CPU(void) { }
+	};
+}
+#endif //_FE_SWAPPINGENGINE_CPU_H
@@ -0,0 +1,247 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+#include "FEViewBuilder_CPU.h"
+
+#include "../Common/FECViewBuilder.h"
+#include "MemoryBlock.h"
+
+#include <string.h>
+#include <emmintrin.h>
+
+using namespace FE;
+using namespace Basis;
+
+FEViewBuilder_CPU::FEViewBuilder_CPU(const FERGBDCalib *calib):FEViewBuilder(calib) { }
+FEViewBuilder_CPU::~FEViewBuilder_CPU(void) { }
+
+//---------------------------------------------------------------------------
+//
+// sse helpers
+//
+//---------------------------------------------------------------------------
+
+/** Loads eight shorts and converts them to two float registers. */
+static inline void loadShort8AsFloat(const short *src, __m128 &lo, __m128 &hi)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*)src);
+	lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+	hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+}
+
+/** mask ? a : b */
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//---------------------------------------------------------------------------
+//
+// host methods
+//
+//---------------------------------------------------------------------------
+
+void FEViewBuilder_CPU::UpdateView(FEView **view_ptr, UChar4Image *rgbImage, ShortImage *rawDepthImage, bool useBilateralFilter, bool modelSensorNoise)
+{
+	if (*view_ptr == NULL)
+	{
+		*view_ptr = new FEView(calib, rgbImage->noDims, rawDepthImage->noDims, false);
+		if (this->shortImage != NULL) delete this->shortImage;
+		this->shortImage = new ShortImage(rawDepthImage->noDims, true, false);
+		if (this->floatImage != NULL) delete this->floatImage;
+		this->floatImage = new FloatImage(rawDepthImage->noDims, true, false);
+
+		if (modelSensorNoise)
+		{
+			(*view_ptr)->depthNormal = new Float4Image(rawDepthImage->noDims, true, false);
+			(*view_ptr)->depthUncertainty = new FloatImage(rawDepthImage->noDims, true, false);
+		}
+	}
+
+	FEView *view = *view_ptr;
+
+	view->rgb->SetFrom(rgbImage, MemoryBlock<Vector4u>::CPU_TO_CPU);
+	this->shortImage->SetFrom(rawDepthImage, MemoryBlock<short>::CPU_TO_CPU);
+
+	switch (view->calib->disparityCalib.type)
+	{
+	case FEDisparityCalib::TRAFO_KINECT:
+		this->ConvertDisparityToDepth(view->depth, this->shortImage, &(view->calib->intrinsics_d), view->calib->disparityCalib.params);
+		break;
+	case FEDisparityCalib::TRAFO_AFFINE:
+		this->ConvertDepthAffineToFloat(view->depth, this->shortImage, view->calib->disparityCalib.params);
+		break;
+	default:
+		break;
+	}
+
+	if (useBilateralFilter)
+	{
+		//5 steps of bilateral filtering
+		this->DepthFiltering(this->floatImage, view->depth);
+		this->DepthFiltering(view->depth, this->floatImage);
+		this->DepthFiltering(this->floatImage, view->depth);
+		this->DepthFiltering(view->depth, this->floatImage);
+		this->DepthFiltering(this->floatImage, view->depth);
+		view->depth->SetFrom(this->floatImage, MemoryBlock<float>::CPU_TO_CPU);
+	}
+
+	if (modelSensorNoise)
+	{
+		this->ComputeNormalAndWeights(view->depthNormal, view->depthUncertainty, view->depth, view->calib->intrinsics_d.projectionParamsSimple.all);
+	}
+}
+
+void FEViewBuilder_CPU::UpdateView(FEView **view_ptr, UChar4Image *rgbImage, FloatImage *depthImage)
+{
+	if (*view_ptr == NULL)
+		*view_ptr = new FEView(calib, rgbImage->noDims, depthImage->noDims, false);
+
+	FEView *view = *view_ptr;
+
+	view->rgb->SetFrom(rgbImage, MemoryBlock<Vector4u>::CPU_TO_CPU);
+	view->depth->SetFrom(depthImage, MemoryBlock<float>::CPU_TO_CPU);
+}
+
+void FEViewBuilder_CPU::ConvertDisparityToDepth(FloatImage *depth_out, const ShortImage *depth_in, const FEIntrinsics *depthIntrinsics,
+	Vector2f disparityCalibParams)
+{
+	Vector2i imgSize = depth_in->noDims;
+
+	const short *d_in = depth_in->GetData(MEMORYDEVICE_CPU);
+	float *d_out = depth_out->GetData(MEMORYDEVICE_CPU);
+
+	float fx_depth = depthIntrinsics->projectionParamsSimple.fx;
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < imgSize.y; y++)
+	{
+		const short *rowIn = d_in + y * imgSize.x;
+		float *rowOut = d_out + y * imgSize.x;
+
+		__m128 offset = _mm_set1_ps(disparityCalibParams.x), scale = _mm_set1_ps(8.0f * disparityCalibParams.y * fx_depth);
+		__m128 zero = _mm_setzero_ps(), invalid = _mm_set1_ps(-1.0f);
+
+		int x = 0;
+		for (; x + 7 < imgSize.x; x += 8)
+		{
+			__m128 disp[2];
+			loadShort8AsFloat(rowIn + x, disp[0], disp[1]);
+
+			for (int i = 0; i < 2; i++)
+			{
+				__m128 disparity_tmp = _mm_sub_ps(offset, disp[i]);
+				__m128 depth = _mm_div_ps(scale, disparity_tmp);
+				__m128 valid = _mm_and_ps(_mm_cmpneq_ps(disparity_tmp, zero), _mm_cmpgt_ps(depth, zero));
+				_mm_storeu_ps(rowOut + x + i * 4, select_ps(valid, depth, invalid));
+			}
+		}
+
+		for (; x < imgSize.x; x++) convertDisparityToDepth(d_out, x, y, d_in, disparityCalibParams, fx_depth, imgSize);
+	}
+}
+
+void FEViewBuilder_CPU::ConvertDepthAffineToFloat(FloatImage *depth_out, const ShortImage *depth_in, Vector2f depthCalibParams)
+{
+	Vector2i imgSize = depth_in->noDims;
+
+	const short *d_in = depth_in->GetData(MEMORYDEVICE_CPU);
+	float *d_out = depth_out->GetData(MEMORYDEVICE_CPU);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < imgSize.y; y++)
+	{
+		const short *rowIn = d_in + y * imgSize.x;
+		float *rowOut = d_out + y * imgSize.x;
+
+		__m128 a = _mm_set1_ps(depthCalibParams.x), b = _mm_set1_ps(depthCalibParams.y);
+		__m128 zero = _mm_setzero_ps(), maxDepth = _mm_set1_ps(32000.0f), invalid = _mm_set1_ps(-1.0f);
+
+		int x = 0;
+		for (; x + 7 < imgSize.x; x += 8)
+		{
+			__m128 depth[2];
+			loadShort8AsFloat(rowIn + x, depth[0], depth[1]);
+
+			for (int i = 0; i < 2; i++)
+			{
+				__m128 valid = _mm_and_ps(_mm_cmpgt_ps(depth[i], zero), _mm_cmple_ps(depth[i], maxDepth));
+				__m128 res = _mm_add_ps(_mm_mul_ps(depth[i], a), b);
+				_mm_storeu_ps(rowOut + x + i * 4, select_ps(valid, res, invalid));
+			}
+		}
+
+		for (; x < imgSize.x; x++) convertDepthAffineToFloat(d_out, x, y, d_in, imgSize, depthCalibParams);
+	}
+}
+
+void FEViewBuilder_CPU::DepthFiltering(FloatImage *image_out, const FloatImage *image_in)
+{
+	Vector2i imgDims = image_in->noDims;
+
+	const float *imageData_in = image_in->GetData(MEMORYDEVICE_CPU);
+	float *imageData_out = image_out->GetData(MEMORYDEVICE_CPU);
+
+	// the spatial part of the filterDepth weights only depends on the offset
+	float spatialWeights[25];
+	for (int i = -2, count = 0; i <= 2; i++) for (int j = -2; j <= 2; j++, count++)
+		spatialWeights[count] = expf(-0.5f * (abs(i) + abs(j)) * MEAN_SIGMA_L * MEAN_SIGMA_L);
+
+	// the window has to stay inside the image, border pixels are passed through
+	memcpy(imageData_out, imageData_in, imgDims.x * imgDims.y * sizeof(float));
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 2; y < imgDims.y - 2; y++) for (int x = 2; x < imgDims.x - 2; x++)
+	{
+		float z = imageData_in[x + y * imgDims.x];
+		if (z < 0.0f) { imageData_out[x + y * imgDims.x] = -1.0f; continue; }
+
+		float sigma_z = 1.0f / (0.0012f + 0.0019f*(z - 0.4f)*(z - 0.4f) + 0.0001f / sqrtf(z) * 0.25f);
+		float rangeFactor = -0.5f * sigma_z * sigma_z;
+		float final_depth = 0.0f, w_sum = 0.0f;
+
+		for (int i = -2, count = 0; i <= 2; i++)
+		{
+			const float *row = imageData_in + x + (y + i) * imgDims.x;
+			for (int j = -2; j <= 2; j++, count++)
+			{
+				float tmpz = row[j];
+				if (tmpz < 0.0f) continue;
+				float dz = tmpz - z;
+				float w = spatialWeights[count] * expf(dz * dz * rangeFactor);
+				w_sum += w;
+				final_depth += w * tmpz;
+			}
+		}
+
+		imageData_out[x + y * imgDims.x] = final_depth / w_sum;
+	}
+}
+
+void FEViewBuilder_CPU::ComputeNormalAndWeights(Float4Image *normal_out, FloatImage *sigmaZ_out, const FloatImage *depth_in, Vector4f intrinsic)
+{
+	Vector2i imgDims = depth_in->noDims;
+
+	const float *depthData_in = depth_in->GetData(MEMORYDEVICE_CPU);
+
+	float *sigmaZData_out = sigmaZ_out->GetData(MEMORYDEVICE_CPU);
+	Vector4f *normalData_out = normal_out->GetData(MEMORYDEVICE_CPU);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < imgDims.y; y++) for (int x = 0; x < imgDims.x; x++)
+	{
+		if (x < 2 || x > imgDims.x - 2 || y < 2 || y > imgDims.y - 2)
+		{
+			int idx = x + y * imgDims.x;
+			normalData_out[idx].w = -1.0f;
+			sigmaZData_out[idx] = -1;
+		}
+		else computeNormalAndWeight(depthData_in, normalData_out, sigmaZData_out, x, y, imgDims, intrinsic);
+	}
+}
@@ -0,0 +1,454 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Modified by authors of SLAMRecon.
+#include "FEVisualisationEngine_CPU.h"
+#include "../Common/FECRepresentationAccess.h"
+#include "../Common/FECVisualisationEngine.h"
+#include "../Common/FECSceneReconstructionEngine.h"
+
+#include "../../Objects/FERenderState_VH.h"
+
+#include <vector>
+
+using namespace FE;
+
+// class implementation
+
+template<class TVoxel, class TIndex>
+FEVisualisationEngine_CPU<TVoxel, TIndex>::FEVisualisationEngine_CPU(FEScene<TVoxel, TIndex> *scene)
+	: FEVisualisationEngine<TVoxel, TIndex>(scene)
+{
+}
+
+template<class TVoxel, class TIndex>
+FEVisualisationEngine_CPU<TVoxel, TIndex>::~FEVisualisationEngine_CPU(void)
+{
+}
+
+template<class TVoxel>
+FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::FEVisualisationEngine_CPU(FEScene<TVoxel, FEVoxelBlockHash> *scene)
+	: FEVisualisationEngine<TVoxel, FEVoxelBlockHash>(scene)
+{
+	renderingBlockList = new RenderingBlock[MAX_RENDERING_BLOCKS];
+}
+
+template<class TVoxel>
+FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::~FEVisualisationEngine_CPU(void)
+{
+	delete[] renderingBlockList;
+}
+
+template<class TVoxel, class TIndex>
+FERenderState* FEVisualisationEngine_CPU<TVoxel, TIndex>::CreateRenderState(const Vector2i & imgSize) const
+{
+	return new FERenderState(
+		imgSize, this->scene->sceneParams->viewFrustum_min, this->scene->sceneParams->viewFrustum_max, MEMORYDEVICE_CPU
+	);
+}
+
+template<class TVoxel>
+FERenderState_VH* FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::CreateRenderState(const Vector2i & imgSize) const
+{
+	return new FERenderState_VH(
+		FEVoxelBlockHash::noTotalEntries, imgSize, this->scene->sceneParams->viewFrustum_min, this->scene->sceneParams->viewFrustum_max, MEMORYDEVICE_CPU
+	);
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::FindVisibleBlocks(const FEPose *pose, const FEIntrinsics *intrinsics, FERenderState *renderState) const
+{
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::FindVisibleBlocks(const FEPose *pose, const FEIntrinsics *intrinsics, FERenderState *renderState) const
+{
+	const FEHashEntry *hashTable = this->scene->index.GetEntries();
+	int noTotalEntries = this->scene->index.noTotalEntries;
+	float voxelSize = this->scene->sceneParams->voxelSize;
+	Vector2i imgSize = renderState->renderingRangeImage->noDims;
+
+	Matrix4f M = pose->GetM();
+	Vector4f projParams = intrinsics->projectionParamsSimple.all;
+
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+
+	int noVisibleEntries = 0;
+	for (int targetIdx = 0; targetIdx < noTotalEntries; targetIdx++)
+	{
+		const FEHashEntry &hashEntry = hashTable[targetIdx];
+		if (hashEntry.ptr < 0) continue;
+
+		bool isVisible, isVisibleEnlarged;
+		checkBlockVisibility<false>(isVisible, isVisibleEnlarged, hashEntry.pos, M, projParams, voxelSize, imgSize);
+
+		if (isVisible) visibleEntryIDs[noVisibleEntries++] = targetIdx;
+	}
+
+	renderState_vh->noVisibleEntries = noVisibleEntries;
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::CreateExpectedDepths(const FEPose *pose, const FEIntrinsics *intrinsics, FERenderState *renderState) const
+{
+	Vector2f *minmaxData = renderState->renderingRangeImage->GetData(MEMORYDEVICE_CPU);
+
+	Vector2f init;
+	//TODO : this could be improved a bit...
+	init.x = 0.2f; init.y = 3.0f;
+	for (int locId = 0; locId < (int)renderState->renderingRangeImage->dataSize; ++locId) minmaxData[locId] = init;
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::CreateExpectedDepths(const FEPose *pose, const FEIntrinsics *intrinsics,
+	FERenderState *renderState) const
+{
+	float voxelSize = this->scene->sceneParams->voxelSize;
+
+	Vector2i imgSize = renderState->renderingRangeImage->noDims;
+	Vector2f *minmaxData = renderState->renderingRangeImage->GetData(MEMORYDEVICE_CPU);
+
+	Vector2f init;
+	init.x = FAR_AWAY; init.y = VERY_CLOSE;
+	for (int locId = 0; locId < imgSize.x * imgSize.y; ++locId) minmaxData[locId] = init;
+
+	FERenderState_VH* renderState_vh = (FERenderState_VH*)renderState;
+
+	//go through list of visible 8x8x8 blocks
+	int noTotalBlocks = 0;
+	{
+		const FEHashEntry *hash_entries = this->scene->index.GetEntries();
+		const int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+		int noVisibleEntries = renderState_vh->noVisibleEntries;
+
+		Matrix4f pose_M = pose->GetM();
+		Vector4f projParams = intrinsics->projectionParamsSimple.all;
+
+		for (int blockNo = 0; blockNo < noVisibleEntries; ++blockNo)
+		{
+			const FEHashEntry & blockData(hash_entries[visibleEntryIDs[blockNo]]);
+			if (blockData.ptr < 0) continue;
+
+			Vector2i upperLeft, lowerRight;
+			Vector2f zRange;
+			if (!ProjectSingleBlock(blockData.pos, pose_M, projParams, imgSize, voxelSize, upperLeft, lowerRight, zRange)) continue;
+
+			Vector2i requiredRenderingBlocks((int)ceilf((float)(lowerRight.x - upperLeft.x + 1) / renderingBlockSizeX),
+				(int)ceilf((float)(lowerRight.y - upperLeft.y + 1) / renderingBlockSizeY));
+
+			int requiredNumBlocks = requiredRenderingBlocks.x * requiredRenderingBlocks.y;
+			if (noTotalBlocks + requiredNumBlocks > MAX_RENDERING_BLOCKS) continue;
+
+			CreateRenderingBlocks(renderingBlockList, noTotalBlocks, upperLeft, lowerRight, zRange);
+			noTotalBlocks += requiredNumBlocks;
+		}
+	}
+
+	// go through rendering blocks and fill minmaxData
+	for (int blockNo = 0; blockNo < noTotalBlocks; ++blockNo)
+	{
+		const RenderingBlock & b(renderingBlockList[blockNo]);
+
+		for (int y = b.upperLeft.y; y <= b.lowerRight.y; ++y) for (int x = b.upperLeft.x; x <= b.lowerRight.x; ++x)
+		{
+			Vector2f & pixel(minmaxData[x + y*imgSize.x]);
+			if (pixel.x > b.zRange.x) pixel.x = b.zRange.x;
+			if (pixel.y < b.zRange.y) pixel.y = b.zRange.y;
+		}
+	}
+}
+
+/** Raycasts the image in tiles of minmaximg_subsample x minmaximg_subsample
+	pixels. All pixels of a tile share one entry of the expected depth image,
+	so tiles without any projected block are skipped as a whole, and the rays
+	of a tile reuse one hash lookup cache as they mostly hit the same blocks.
+	*/
+template <class TVoxel, class TIndex>
+static void GenericRaycast(const FEScene<TVoxel, TIndex> *scene, const Vector2i& imgSize, const Matrix4f& invM, Vector4f projParams, const FERenderState *renderState)
+{
+	float voxelSize = scene->sceneParams->voxelSize;
+	float oneOverVoxelSize = 1.0f / voxelSize;
+	float mu = scene->sceneParams->mu;
+
+	projParams.x = 1.0f / projParams.x;
+	projParams.y = 1.0f / projParams.y;
+
+	Vector4f *pointsRay = renderState->raycastResult->GetData(MEMORYDEVICE_CPU);
+	const Vector2f *minmaximg = renderState->renderingRangeImage->GetData(MEMORYDEVICE_CPU);
+	const TVoxel *voxelData = scene->localVBA.GetVoxelBlocks();
+	const typename TIndex::IndexData *voxelIndex = scene->index.getIndexData();
+
+	int noTilesX = (imgSize.x + minmaximg_subsample - 1) / minmaximg_subsample;
+	int noTilesY = (imgSize.y + minmaximg_subsample - 1) / minmaximg_subsample;
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int tileId = 0; tileId < noTilesX * noTilesY; tileId++)
+	{
+		int tileX = tileId % noTilesX, tileY = tileId / noTilesX;
+
+		int x0 = tileX * minmaximg_subsample, x1 = MIN(x0 + minmaximg_subsample, imgSize.x);
+		int y0 = tileY * minmaximg_subsample, y1 = MIN(y0 + minmaximg_subsample, imgSize.y);
+
+		const Vector2f &minmax = minmaximg[tileX + tileY * imgSize.x];
+
+		if (!(minmax.x < minmax.y))
+		{
+			Vector4f empty(0.0f, 0.0f, 0.0f, 0.0f);
+			for (int y = y0; y < y1; y++) for (int x = x0; x < x1; x++) pointsRay[x + y * imgSize.x] = empty;
+			continue;
+		}
+
+		typename TIndex::IndexCache cache;
+
+		for (int y = y0; y < y1; y++) for (int x = x0; x < x1; x++)
+		{
+			castRay<TVoxel, TIndex>(pointsRay[x + y * imgSize.x], x, y, voxelData, voxelIndex, invM, projParams, oneOverVoxelSize, mu,
+				minmax, cache);
+		}
+	}
+}
+
+template<class TVoxel, class TIndex>
+static void RenderImage_common(const FEScene<TVoxel, TIndex> *scene, const FEPose *pose, const FEIntrinsics *intrinsics, const FERenderState *renderState,
+	UChar4Image *outputImage, PFEVisualisationEngine::RenderImageType type)
+{
+	Vector2i imgSize = outputImage->noDims;
+	Matrix4f invM = pose->GetInvM();
+
+	GenericRaycast(scene, imgSize, invM, intrinsics->projectionParamsSimple.all, renderState);
+
+	Vector3f lightSource = -Vector3f(invM.getColumn(2));
+	Vector4u *outRendering = outputImage->GetData(MEMORYDEVICE_CPU);
+	const Vector4f *pointsRay = renderState->raycastResult->GetData(MEMORYDEVICE_CPU);
+	const TVoxel *voxelData = scene->localVBA.GetVoxelBlocks();
+	const typename TIndex::IndexData *voxelIndex = scene->index.getIndexData();
+
+	if ((type == PFEVisualisationEngine::RENDER_COLOUR_FROM_VOLUME) &&
+		(!TVoxel::hasColorInformation)) type = PFEVisualisationEngine::RENDER_SHADED_GREYSCALE;
+
+	switch (type) {
+	case PFEVisualisationEngine::RENDER_COLOUR_FROM_VOLUME:
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int locId = 0; locId < imgSize.x * imgSize.y; locId++)
+		{
+			Vector4f ptRay = pointsRay[locId];
+			processPixelColour<TVoxel, TIndex>(outRendering[locId], ptRay.toVector3(), ptRay.w > 0, voxelData, voxelIndex, lightSource);
+		}
+		break;
+	case PFEVisualisationEngine::RENDER_COLOUR_FROM_NORMAL:
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int locId = 0; locId < imgSize.x * imgSize.y; locId++)
+		{
+			Vector4f ptRay = pointsRay[locId];
+			processPixelNormal<TVoxel, TIndex>(outRendering[locId], ptRay.toVector3(), ptRay.w > 0, voxelData, voxelIndex, lightSource);
+		}
+		break;
+	case PFEVisualisationEngine::RENDER_SHADED_GREYSCALE:
+	default:
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int locId = 0; locId < imgSize.x * imgSize.y; locId++)
+		{
+			Vector4f ptRay = pointsRay[locId];
+			processPixelGrey<TVoxel, TIndex>(outRendering[locId], ptRay.toVector3(), ptRay.w > 0, voxelData, voxelIndex, lightSource);
+		}
+		break;
+	}
+}
+
+template<class TVoxel, class TIndex>
+static void CreateICPMaps_common(const FEScene<TVoxel, TIndex> *scene, const FEView *view, FETrackingState *trackingState, FERenderState *renderState)
+{
+	Vector2i imgSize = renderState->raycastResult->noDims;
+	Matrix4f invM = trackingState->pose_d->GetInvM();
+
+	GenericRaycast(scene, imgSize, invM, view->calib->intrinsics_d.projectionParamsSimple.all, renderState);
+	trackingState->pose_pointCloud->SetFrom(trackingState->pose_d);
+
+	Vector4f *pointsMap = trackingState->pointCloud->locations->GetData(MEMORYDEVICE_CPU);
+	Vector4f *normalsMap = trackingState->pointCloud->colours->GetData(MEMORYDEVICE_CPU);
+	Vector4u *outRendering = renderState->raycastImage->GetData(MEMORYDEVICE_CPU);
+	const Vector4f *pointsRay = renderState->raycastResult->GetData(MEMORYDEVICE_CPU);
+	Vector3f lightSource = -Vector3f(invM.getColumn(2));
+	float voxelSize = scene->sceneParams->voxelSize;
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < imgSize.y; y++) for (int x = 0; x < imgSize.x; x++)
+		processPixelICP<true>(outRendering, pointsMap, normalsMap, pointsRay, imgSize, x, y, voxelSize, lightSource);
+}
+
+template<class TVoxel, class TIndex>
+static void RenderCurrentView_common(const FEScene<TVoxel, TIndex> *scene, const FEView *view, const Matrix4f &M_d, FERenderState *renderState)
+{
+	Vector2i imgSize = renderState->raycastResult->noDims;
+	Matrix4f invM;
+	M_d.inv(invM);
+
+	GenericRaycast(scene, imgSize, invM, view->calib->intrinsics_d.projectionParamsSimple.all, renderState);
+
+	Vector4u *outRendering = renderState->raycastImage->GetData(MEMORYDEVICE_CPU);
+	const Vector4f *pointsRay = renderState->raycastResult->GetData(MEMORYDEVICE_CPU);
+	Vector3f lightSource = -Vector3f(invM.getColumn(2));
+	const TVoxel *voxelData = scene->localVBA.GetVoxelBlocks();
+	const typename TIndex::IndexData *voxelIndex = scene->index.getIndexData();
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int locId = 0; locId < imgSize.x * imgSize.y; locId++)
+	{
+		Vector4f ptRay = pointsRay[locId];
+		processPixelGrey<TVoxel, TIndex>(outRendering[locId], ptRay.toVector3(), ptRay.w > 0, voxelData, voxelIndex, lightSource);
+	}
+}
+
+template<class TVoxel, class TIndex>
+static void ForwardRender_common(const FEScene<TVoxel, TIndex> *scene, const FEView *view, FETrackingState *trackingState, FERenderState *renderState)
+{
+	Vector2i imgSize = renderState->raycastResult->noDims;
+	Matrix4f M = trackingState->pose_d->GetM();
+	Matrix4f invM = trackingState->pose_d->GetInvM();
+	Vector4f projParams = view->calib->intrinsics_d.projectionParamsSimple.all;
+	Vector4f invProjParams = view->calib->intrinsics_d.projectionParamsSimple.all;
+	invProjParams.x = 1.0f / invProjParams.x;
+	invProjParams.y = 1.0f / invProjParams.y;
+
+	Vector3f lightSource = -Vector3f(invM.getColumn(2));
+	const Vector4f *pointsRay = renderState->raycastResult->GetData(MEMORYDEVICE_CPU);
+	const float *currentDepth = view->depth->GetData(MEMORYDEVICE_CPU);
+	Vector4f *forwardProjection = renderState->forwardProjection->GetData(MEMORYDEVICE_CPU);
+	int *fwdProjMissingPoints = renderState->fwdProjMissingPoints->GetData(MEMORYDEVICE_CPU);
+	Vector4u *outRendering = renderState->raycastImage->GetData(MEMORYDEVICE_CPU);
+	const Vector2f *minmaximg = renderState->renderingRangeImage->GetData(MEMORYDEVICE_CPU);
+	float oneOverVoxelSize = 1.0f / scene->sceneParams->voxelSize;
+	float voxelSize = scene->sceneParams->voxelSize;
+	const TVoxel *voxelData = scene->localVBA.GetVoxelBlocks();
+	const typename TIndex::IndexData *voxelIndex = scene->index.getIndexData();
+
+	renderState->forwardProjection->Clear();
+
+	// forward projection, scattered writes so kept on one thread
+	for (int locId = 0; locId < imgSize.x * imgSize.y; locId++)
+	{
+		Vector4f pixel = pointsRay[locId];
+
+		int locId_new = forwardProjectPixel(pixel * voxelSize, M, projParams, imgSize);
+		if (locId_new >= 0) forwardProjection[locId_new] = pixel;
+	}
+
+	// find missing points
+	int noMissingPoints = 0;
+	for (int y = 0; y < imgSize.y; y++) for (int x = 0; x < imgSize.x; x++)
+	{
+		int locId = x + y * imgSize.x;
+		int locId2 = (int)floor((float)x / minmaximg_subsample) + (int)floor((float)y / minmaximg_subsample) * imgSize.x;
+
+		Vector4f fwdPoint = forwardProjection[locId];
+		Vector2f minmaxval = minmaximg[locId2];
+		float depth = currentDepth[locId];
+
+		if ((fwdPoint.w <= 0) && ((fwdPoint.x == 0 && fwdPoint.y == 0 && fwdPoint.z == 0) || (depth > 0)) && (minmaxval.x < minmaxval.y))
+			fwdProjMissingPoints[noMissingPoints++] = locId;
+	}
+
+	renderState->noFwdProjMissingPoints = noMissingPoints;
+
+	// render missing points
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int pointId = 0; pointId < noMissingPoints; pointId++)
+	{
+		int locId = fwdProjMissingPoints[pointId];
+		int y = locId / imgSize.x, x = locId - y*imgSize.x;
+		int locId2 = (int)floor((float)x / minmaximg_subsample) + (int)floor((float)y / minmaximg_subsample) * imgSize.x;
+
+		castRay<TVoxel, TIndex>(forwardProjection[locId], x, y, voxelData, voxelIndex, invM, invProjParams, oneOverVoxelSize,
+			scene->sceneParams->mu, minmaximg[locId2]);
+	}
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+	for (int y = 0; y < imgSize.y; y++) for (int x = 0; x < imgSize.x; x++)
+		processPixelForwardRender<true>(outRendering, forwardProjection, imgSize, x, y, voxelSize, lightSource);
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::RenderImage(const FEPose *pose, const FEIntrinsics *intrinsics, const FERenderState *renderState,
+	UChar4Image *outputImage, PFEVisualisationEngine::RenderImageType type) const
+{
+	RenderImage_common(this->scene, pose, intrinsics, renderState, outputImage, type);
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::RenderImage(const FEPose *pose, const FEIntrinsics *intrinsics,
+	const FERenderState *renderState, UChar4Image *outputImage, PFEVisualisationEngine::RenderImageType type) const
+{
+	RenderImage_common(this->scene, pose, intrinsics, renderState, outputImage, type);
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::FindSurface(const FEPose *pose, const FEIntrinsics *intrinsics, const FERenderState *renderState) const
+{
+	GenericRaycast(this->scene, renderState->raycastResult->noDims, pose->GetInvM(), intrinsics->projectionParamsSimple.all, renderState);
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::FindSurface(const FEPose *pose, const FEIntrinsics *intrinsics,
+	const FERenderState *renderState) const
+{
+	GenericRaycast(this->scene, renderState->raycastResult->noDims, pose->GetInvM(), intrinsics->projectionParamsSimple.all, renderState);
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::CreateICPMaps(const FEView *view, FETrackingState *trackingState,
+	FERenderState *renderState) const
+{
+	CreateICPMaps_common(this->scene, view, trackingState, renderState);
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::CreateICPMaps(const FEView *view, FETrackingState *trackingState,
+	FERenderState *renderState) const
+{
+	CreateICPMaps_common(this->scene, view, trackingState, renderState);
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::RenderCurrentView(const FEView *view, const Matrix4f &M_d, FERenderState *renderState) const
+{
+	RenderCurrentView_common(this->scene, view, M_d, renderState);
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::RenderCurrentView(const FEView *view, const Matrix4f &M_d, FERenderState *renderState) const
+{
+	RenderCurrentView_common(this->scene, view, M_d, renderState);
+}
+
+template<class TVoxel, class TIndex>
+void FEVisualisationEngine_CPU<TVoxel, TIndex>::ForwardRender(const FEView *view, FETrackingState *trackingState,
+	FERenderState *renderState) const
+{
+	ForwardRender_common(this->scene, view, trackingState, renderState);
+}
+
+template<class TVoxel>
+void FEVisualisationEngine_CPU<TVoxel, FEVoxelBlockHash>::ForwardRender(const FEView *view, FETrackingState *trackingState,
+	FERenderState *renderState) const
+{
+	ForwardRender_common(this->scene, view, trackingState, renderState);
+}
+
+template class FEVisualisationEngine_CPU < FEVoxel_s, FEVoxelIndex > ;
+template class FEVisualisationEngine_CPU < FEVoxel_c, FEVoxelIndex > ;
+template class FEVisualisationEngine_CPU < FEVoxel_c_rgb, FEVoxelIndex > ;
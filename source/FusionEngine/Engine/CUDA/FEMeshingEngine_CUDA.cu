@@ -16,14 +16,15 @@ __global__ void findAllocateBlocks(Vector4s *visibleBlockGlobalPos, const FEHash
 template<class TVoxel>
 FEMeshingEngine_CUDA<TVoxel,FEVoxelBlockHash>::FEMeshingEngine_CUDA(void) 
 {
-	FESafeCall(cudaMalloc((void**)&visibleBlockGlobalPos_device, SDF_LOCAL_BLOCK_NUM * sizeof(Vector4s)));
+	noVisibleBlockGlobalPos = 0;
+	visibleBlockGlobalPos_device = NULL;
 	FESafeCall(cudaMalloc((void**)&noTriangles_device, sizeof(unsigned int)));
 }
 
 template<class TVoxel>
 FEMeshingEngine_CUDA<TVoxel,FEVoxelBlockHash>::~FEMeshingEngine_CUDA(void) 
 {
-	FESafeCall(cudaFree(visibleBlockGlobalPos_device));
+	if (visibleBlockGlobalPos_device != NULL) FESafeCall(cudaFree(visibleBlockGlobalPos_device));
 	FESafeCall(cudaFree(noTriangles_device));
 }
 
@@ -37,8 +38,17 @@ void FEMeshingEngine_CUDA<TVoxel, FEVoxelBlockHash>::MeshScene(FEMesh *mesh, con
 	int noMaxTriangles = mesh->noMaxTriangles, noTotalEntries = scene->index.noTotalEntries;
 	float factor = scene->sceneParams->voxelSize;
 
+	// one slot per voxel block, rounded up to the 16 rows of the meshing grid
+	int noBlockRows = (scene->localVBA.noBlocks + 15) / 16;
+	if (noVisibleBlockGlobalPos < noBlockRows * 16)
+	{
+		if (visibleBlockGlobalPos_device != NULL) FESafeCall(cudaFree(visibleBlockGlobalPos_device));
+		noVisibleBlockGlobalPos = noBlockRows * 16;
+		FESafeCall(cudaMalloc((void**)&visibleBlockGlobalPos_device, noVisibleBlockGlobalPos * sizeof(Vector4s)));
+	}
+
 	FESafeCall(cudaMemset(noTriangles_device, 0, sizeof(unsigned int)));
-	FESafeCall(cudaMemset(visibleBlockGlobalPos_device, 0, sizeof(Vector4s) * SDF_LOCAL_BLOCK_NUM));
+	FESafeCall(cudaMemset(visibleBlockGlobalPos_device, 0, sizeof(Vector4s) * noVisibleBlockGlobalPos));
 
 	{ // identify used voxel blocks
 		dim3 cudaBlockSize(256); 
@@ -49,7 +59,7 @@ void FEMeshingEngine_CUDA<TVoxel, FEVoxelBlockHash>::MeshScene(FEMesh *mesh, con
 
 	{ // mesh used voxel blocks
 		dim3 cudaBlockSize(SDF_BLOCK_SIZE, SDF_BLOCK_SIZE, SDF_BLOCK_SIZE);
-		dim3 gridSize(SDF_LOCAL_BLOCK_NUM / 16, 16);
+		dim3 gridSize(noBlockRows, 16);
 
 		meshScene_device<TVoxel> << <gridSize, cudaBlockSize >> >(triangles, noTriangles_device, factor, noTotalEntries, noMaxTriangles,
 			visibleBlockGlobalPos_device, localVBA, hashTable);
@@ -97,4 +107,6 @@ __global__ void meshScene_device(FEMesh::Triangle *triangles, unsigned int *noTr
 	}
 }
 
-template class FE::FEMeshingEngine_CUDA<FEVoxel, FEVoxelIndex>;
+template class FE::FEMeshingEngine_CUDA<FEVoxel_s, FEVoxelIndex>;
+template class FE::FEMeshingEngine_CUDA<FEVoxel_c, FEVoxelIndex>;
+template class FE::FEMeshingEngine_CUDA<FEVoxel_c_rgb, FEVoxelIndex>;
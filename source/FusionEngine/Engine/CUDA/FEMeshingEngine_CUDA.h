@@ -16,6 +16,8 @@ namespace FE
 	private:
 		unsigned int  *noTriangles_device;
 		Vector4s *visibleBlockGlobalPos_device;
+		/** Capacity of visibleBlockGlobalPos_device, follows the size of the voxel block array. */
+		int noVisibleBlockGlobalPos;
 
 	public:
 		void MeshScene(FEMesh *mesh, const FEScene<TVoxel, FEVoxelBlockHash> *scene);
@@ -18,9 +18,10 @@ __global__ void integrateIntoScene_device(TVoxel *localVBA, const FEHashEntry *h
 	const Vector4u *rgb, Vector2i rgbImgSize, const float *depth, Vector2i imgSize, Matrix4f M_d, Matrix4f M_rgb, Vector4f projParams_d,
 	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW);
 
-template<class TVoxel, bool stopMaxW, bool approximateIntegration>
-__global__ void repealFromScene_device(TVoxel *localVBA, const FEHashEntry *hashTable, int *noVisibleEntryIDs,
-	const Vector4u *rgb, Vector2i rgbImgSize, const float *depth, Vector2i imgSize, Matrix4f M_d, Matrix4f M_rgb, Vector4f projParams_d,
+template<class TVoxel, bool stopMaxW>
+__global__ void reintegrateIntoScene_device(TVoxel *localVBA, const FEHashEntry *hashTable, const int *visibleEntryIDs,
+	const uchar *entriesVisibleType, const uchar *entriesRepealType, const Vector4u *rgb, Vector2i rgbImgSize, const float *depth,
+	const float *depthWeight, Vector2i depthImgSize, Matrix4f old_M, Matrix4f new_M, Matrix4f new_M_rgb, Vector4f projParams_d,
 	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW);
 
 __global__ void buildHashAllocAndVisibleType_device(uchar *entriesAllocType, uchar *entriesVisibleType, Vector4s *blockCoords, const float *depth,
@@ -35,13 +36,22 @@ __global__ void reAllocateSwappedOutVoxelBlocks_device(int *voxelAllocationList,
 
 __global__ void setToType3(uchar *entriesVisibleType, int *visibleEntryIDs, int noVisibleEntries);
 
+__global__ void markRepealedEntries_device(uchar *entriesRepealType, const int *visibleEntryIDs, int noVisibleEntries,
+	const int *entriesReleaseStamp, int stamp);
+
+__global__ void appendRepealedEntries_device(int *visibleEntryIDs, AllocationTempData *allocData, uchar *entriesVisibleType,
+	const uchar *entriesRepealType, int noTotalEntries);
+
 __global__ void buildVisibleList_device(FEHashEntry *hashTable, int noTotalEntries,
-	int *visibleEntryIDs, AllocationTempData *allocData, uchar *entriesVisibleType, uchar *temStructure,
+	int *visibleEntryIDs, AllocationTempData *allocData, uchar *entriesVisibleType,
 	Matrix4f M_d, Vector4f projParams_d, Vector2i depthImgSize, float voxelSize);
 
-__global__ void buildBinaryVisibleList_device(int noTotalEntries, uchar *temStructure, uchar *visibleListPtr);
+template<class TVoxel>
+__global__ void markGarbageEntries_device(TVoxel *localVBA, const FEHashEntry *hashTable, uchar *entriesGarbageType, const uchar *entriesVisibleType,
+	const uchar *swapStates, int firstBucketId);
 
-__global__ void buildVisibleListByBVLB_device(int noTotalEntries, int *visibleEntryIDs, uchar *entriesVisibleType, AllocationTempData *allocData, uchar *visibleListPtr);
+__global__ void releaseGarbageEntries_device(int *voxelAllocationList, int *excessAllocationList, FEHashEntry *hashTable, uchar *swapStates,
+	const uchar *entriesGarbageType, AllocationTempData *allocData, int *entriesReleaseStamp, int releaseStamp, int firstBucketId, int noBuckets);
 
 // host methods
 
@@ -54,8 +64,7 @@ FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::FESceneReconstructio
 	int noTotalEntries = FEVoxelBlockHash::noTotalEntries;
 	FESafeCall(cudaMalloc((void**)&entriesAllocType_device, noTotalEntries));
 	FESafeCall(cudaMalloc((void**)&blockCoords_device, noTotalEntries * sizeof(Vector4s)));
-
-	FESafeCall(cudaMalloc((void**)&temStructure_device, (noTotalEntries+1) * sizeof(unsigned char)));
+	FESafeCall(cudaMalloc((void**)&entriesRepealType_device, noTotalEntries));
 }
 
 template<class TVoxel>
@@ -65,13 +74,13 @@ FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::~FESceneReconstructi
 	FESafeCall(cudaFree(allocationTempData_device));
 	FESafeCall(cudaFree(entriesAllocType_device));
 	FESafeCall(cudaFree(blockCoords_device));
-	FESafeCall(cudaFree(temStructure_device));
+	FESafeCall(cudaFree(entriesRepealType_device));
 }
 
 template<class TVoxel>
 void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::ResetScene(FEScene<TVoxel, FEVoxelBlockHash> *scene)
 {
-	int numBlocks = scene->index.getNumAllocatedVoxelBlocks();
+	int numBlocks = scene->localVBA.noBlocks;
 	int blockSize = scene->index.getVoxelBlockSize();
 
 	TVoxel *voxelBlocks_ptr = scene->localVBA.GetVoxelBlocks();
@@ -158,6 +167,8 @@ template<class TVoxel>
 void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::AllocateSceneFromDepth(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const int frameIndex, 
 	const Matrix4f &M_d, const FERenderState *renderState, bool onlyUpdateVisibleList = false)
 {
+	if (!onlyUpdateVisibleList) this->ReserveVoxelBlocks(scene, 0);
+
 	Vector2i depthImgSize = view->depth->noDims;
 	float voxelSize = scene->sceneParams->voxelSize;
 
@@ -183,7 +194,6 @@ void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::AllocateSceneFr
 
 	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
 	uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
-	uchar *visibleListPtr = renderState_vh->CetVisibleListPtr();
 
 	dim3 cudaBlockSizeHV(16, 16);
 	dim3 gridSizeHV((int)ceil((float)depthImgSize.x / (float)cudaBlockSizeHV.x), (int)ceil((float)depthImgSize.y / (float)cudaBlockSizeHV.y));
@@ -191,9 +201,6 @@ void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::AllocateSceneFr
 	dim3 cudaBlockSizeAL(256, 1);
 	dim3 gridSizeAL((int)ceil((float)noTotalEntries / (float)cudaBlockSizeAL.x));
 
-	dim3 cudaBlockSizeBVL(256, 1);
-	dim3 gridSizeBVL((int)ceil((float)(noTotalEntries / 8 + 1) / (float)cudaBlockSizeAL.x));
-
 	dim3 cudaBlockSizeVS(256, 1);
 	dim3 gridSizeVS((int)ceil((float)renderState_vh->noVisibleEntries / (float)cudaBlockSizeVS.x));
 
@@ -207,8 +214,6 @@ void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::AllocateSceneFr
 
 	FESafeCall(cudaMemsetAsync(entriesAllocType_device, 0, sizeof(unsigned char)* noTotalEntries));
 
-	FESafeCall(cudaMemsetAsync(visibleListPtr, 0, sizeof(uchar)* (noTotalEntries / 8 + 1)));
-
 	FESafeCall(cudaMemsetAsync(entriesVisibleType, 0, sizeof(uchar)* noTotalEntries));
 
 	if (gridSizeVS.x > 0) setToType3 << <gridSizeVS, cudaBlockSizeVS >> > (entriesVisibleType, visibleEntryIDs, renderState_vh->noVisibleEntries);
@@ -222,27 +227,55 @@ void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::AllocateSceneFr
 		allocateVoxelBlocksList_device << <gridSizeAL, cudaBlockSizeAL >> >(voxelAllocationList, excessAllocationList, hashTable,
 			noTotalEntries, (AllocationTempData*)allocationTempData_device, entriesAllocType_device, entriesVisibleType,
 			blockCoords_device);
+
+		// visible entries that were swapped out get a block again, the swapping engine merges their data back
+		if (scene->useSwapping)
+			reAllocateSwappedOutVoxelBlocks_device << <gridSizeAL, cudaBlockSizeAL >> >(voxelAllocationList, hashTable, noTotalEntries,
+				(AllocationTempData*)allocationTempData_device, entriesVisibleType);
+
+		// the counter ran below -1 by the blocks the frame needed beyond the free ones, grow the array by them and allocate again
+		FESafeCall(cudaMemcpy(tempData, allocationTempData_device, sizeof(AllocationTempData), cudaMemcpyDeviceToHost));
+		int noMissingBlocks = -1 - tempData->noAllocatedVoxelEntries;
+		if (noMissingBlocks > 0 && scene->localVBA.noBlocks < scene->sceneParams->noMaxVoxelBlocks)
+		{
+			scene->localVBA.lastFreeBlockId = -1;
+			this->ReserveVoxelBlocks(scene, noMissingBlocks);
+			voxelAllocationList = scene->localVBA.GetAllocationList();
+
+			tempData->noAllocatedVoxelEntries = scene->localVBA.lastFreeBlockId;
+			tempData->noAllocatedExcessEntries = MAX(tempData->noAllocatedExcessEntries, -1);
+			FESafeCall(cudaMemcpy(allocationTempData_device, tempData, sizeof(AllocationTempData), cudaMemcpyHostToDevice));
+
+			// the blocks allocated before are found in the hash now, only the dropped ones are flagged again
+			FESafeCall(cudaMemset(entriesAllocType_device, 0, sizeof(unsigned char)* noTotalEntries));
+
+			buildHashAllocAndVisibleType_device << <gridSizeHV, cudaBlockSizeHV >> >(entriesAllocType_device, entriesVisibleType,
+				blockCoords_device, depth, invM_d, invProjParams_d, mu, depthImgSize, oneOverVoxelSize, hashTable,
+				scene->sceneParams->viewFrustum_min, scene->sceneParams->viewFrustum_max);
+
+			allocateVoxelBlocksList_device << <gridSizeAL, cudaBlockSizeAL >> >(voxelAllocationList, excessAllocationList, hashTable,
+				noTotalEntries, (AllocationTempData*)allocationTempData_device, entriesAllocType_device, entriesVisibleType,
+				blockCoords_device);
+
+			if (scene->useSwapping)
+				reAllocateSwappedOutVoxelBlocks_device << <gridSizeAL, cudaBlockSizeAL >> >(voxelAllocationList, hashTable, noTotalEntries,
+					(AllocationTempData*)allocationTempData_device, entriesVisibleType);
+		}
 	}
 
-	FESafeCall(cudaMemsetAsync(temStructure_device, 0, sizeof(unsigned char)* (noTotalEntries + 1)));
 	buildVisibleList_device << <gridSizeAL, cudaBlockSizeAL >> >(hashTable, noTotalEntries, visibleEntryIDs,
-		(AllocationTempData*)allocationTempData_device, entriesVisibleType, temStructure_device, M_d, projParams_d, depthImgSize, voxelSize);
-
-	buildBinaryVisibleList_device << <gridSizeBVL, cudaBlockSizeBVL >> >(noTotalEntries, temStructure_device, visibleListPtr);
+		(AllocationTempData*)allocationTempData_device, entriesVisibleType, M_d, projParams_d, depthImgSize, voxelSize);
 
 	FESafeCall(cudaMemcpy(tempData, allocationTempData_device, sizeof(AllocationTempData), cudaMemcpyDeviceToHost));
 	renderState_vh->noVisibleEntries = tempData->noVisibleEntries;
-	scene->localVBA.lastFreeBlockId = tempData->noAllocatedVoxelEntries;
-	scene->index.SetLastFreeExcessListId(tempData->noAllocatedExcessEntries);
+	// the counters run below -1 once the lists are exhausted, the free list indices must not
+	scene->localVBA.lastFreeBlockId = MAX(tempData->noAllocatedVoxelEntries, -1);
+	scene->index.SetLastFreeExcessListId(MAX(tempData->noAllocatedExcessEntries, -1));
 
-	if (frameIndex >= 0){
-		Basis::MemoryBlock<uchar> *visibleList = renderState_vh->CetVisibleList();
-		renderState_vh->GetVisibleListBlock()->saveVisibleListToBlock(frameIndex, visibleList, MEMORYDEVICE_CUDA);
-	}
-	else{
-		Basis::MemoryBlock<uchar> *visibleList = renderState_vh->CetVisibleList();
-		renderState_vh->GetVisibleListBlock()->saveVisibleListToBlock(visibleList, MEMORYDEVICE_CUDA);
-	}
+	if (frameIndex >= 0)
+		renderState_vh->GetVisibleListBlock()->saveVisibleListToBlock(frameIndex, visibleEntryIDs, renderState_vh->noVisibleEntries, MEMORYDEVICE_CUDA);
+	else
+		renderState_vh->GetVisibleListBlock()->saveVisibleListToBlock(visibleEntryIDs, renderState_vh->noVisibleEntries, MEMORYDEVICE_CUDA);
 }
 
 template<class TVoxel>
@@ -284,49 +317,70 @@ void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::IntegrateIntoSc
 }
 
 template<class TVoxel>
-void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::UpdateVisibleEntryIDsByBVLB(FEScene<TVoxel, FEVoxelBlockHash> *scene, const int index, const FERenderState *renderState){
+void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::AllocateSceneForReintegration(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view,
+	const int frameIndex, const Matrix4f &new_M, const FERenderState *renderState)
+{
 	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
 
 	int noTotalEntries = scene->index.noTotalEntries;
 
 	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
 	uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
-	Basis::MemoryBlock<uchar> *visibleList = renderState_vh->CetVisibleList();
-	renderState_vh->GetVisibleListBlock()->readVisibleListToGpu(index, visibleList);
 
-	uchar *visibleListPtr = renderState_vh->CetVisibleListPtr();
-	
+	// the old list has to be read before the allocation stores the new one
+	FESafeCall(cudaMemsetAsync(entriesRepealType_device, 0, sizeof(uchar)* noTotalEntries));
+
+	int noOldEntries = renderState_vh->GetVisibleListBlock()->readVisibleList(frameIndex, visibleEntryIDs, MEMORYDEVICE_CUDA);
+
+	// entries released since the list was saved may hold other blocks by now
+	int oldStamp = renderState_vh->GetVisibleListBlock()->getStamp(frameIndex);
+
+	dim3 cudaBlockSizeVS(256, 1);
+	dim3 gridSizeVS((int)ceil((float)noOldEntries / (float)cudaBlockSizeVS.x));
+	if (gridSizeVS.x > 0) markRepealedEntries_device << <gridSizeVS, cudaBlockSizeVS >> > (entriesRepealType_device, visibleEntryIDs, noOldEntries,
+		renderState_vh->GetEntriesReleaseStamp(), oldStamp);
+
+	// the list holds the old entries now, not those of the last frame
+	renderState_vh->noVisibleEntries = 0;
+	AllocateSceneFromDepth(scene, view, frameIndex, new_M, renderState);
+
 	AllocationTempData *tempData = (AllocationTempData*)allocationTempData_host;
 	tempData->noAllocatedVoxelEntries = scene->localVBA.lastFreeBlockId;
 	tempData->noAllocatedExcessEntries = scene->index.GetLastFreeExcessListId();
-	tempData->noVisibleEntries = 0;
+	tempData->noVisibleEntries = renderState_vh->noVisibleEntries;
 	FESafeCall(cudaMemcpyAsync(allocationTempData_device, tempData, sizeof(AllocationTempData), cudaMemcpyHostToDevice));
 
-	FESafeCall(cudaMemsetAsync(entriesVisibleType, 0, sizeof(uchar)* noTotalEntries));
+	dim3 cudaBlockSizeAL(256, 1);
+	dim3 gridSizeAL((int)ceil((float)noTotalEntries / (float)cudaBlockSizeAL.x));
+
+	// append the blocks only the old pose saw
+	appendRepealedEntries_device << <gridSizeAL, cudaBlockSizeAL >> >(visibleEntryIDs, (AllocationTempData*)allocationTempData_device,
+		entriesVisibleType, entriesRepealType_device, noTotalEntries);
 
-	dim3 cudaBlockSize(256, 1);
-	dim3 gridSize((int)ceil((float)noTotalEntries / (float)cudaBlockSize.x));
-	buildVisibleListByBVLB_device << <gridSize, cudaBlockSize >> >(noTotalEntries, visibleEntryIDs, entriesVisibleType, (AllocationTempData*)allocationTempData_device, visibleListPtr);
+	// they may have been swapped out since, they need a block to be repealed from
+	if (scene->useSwapping)
+		reAllocateSwappedOutVoxelBlocks_device << <gridSizeAL, cudaBlockSizeAL >> >(scene->localVBA.GetAllocationList(), scene->index.GetEntries(),
+			noTotalEntries, (AllocationTempData*)allocationTempData_device, entriesVisibleType);
 
 	FESafeCall(cudaMemcpy(tempData, allocationTempData_device, sizeof(AllocationTempData), cudaMemcpyDeviceToHost));
 	renderState_vh->noVisibleEntries = tempData->noVisibleEntries;
-	scene->localVBA.lastFreeBlockId = tempData->noAllocatedVoxelEntries;
-	scene->index.SetLastFreeExcessListId(tempData->noAllocatedExcessEntries);
+	scene->localVBA.lastFreeBlockId = MAX(tempData->noAllocatedVoxelEntries, -1);
 }
 
 template<class TVoxel>
-void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::RepealFromScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
-	const FERenderState *renderState){
+void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::ReintegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view,
+	const Matrix4f &old_M, const Matrix4f &new_M, const FERenderState *renderState, const FloatImage *depthWeight)
+{
 	Vector2i rgbImgSize = view->rgb->noDims;
 	Vector2i depthImgSize = view->depth->noDims;
 	float voxelSize = scene->sceneParams->voxelSize;
 
-	Matrix4f M_rgb;
+	Matrix4f new_M_rgb;
 	Vector4f projParams_d, projParams_rgb;
 
 	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
 
-	if (TVoxel::hasColorInformation) M_rgb = view->calib->trafo_rgb_to_depth.calib_inv * M_d;
+	if (TVoxel::hasColorInformation) new_M_rgb = view->calib->trafo_rgb_to_depth.calib_inv * new_M;
 
 	projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
 	projParams_rgb = view->calib->intrinsics_rgb.projectionParamsSimple.all;
@@ -334,17 +388,72 @@ void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::RepealFromScene
 	float mu = scene->sceneParams->mu; int maxW = scene->sceneParams->maxW;
 
 	float *depth = view->depth->GetData(MEMORYDEVICE_CUDA);
+	const float *weight = depthWeight != NULL ? depthWeight->GetData(MEMORYDEVICE_CUDA) : NULL;
 	Vector4u *rgb = view->rgb->GetData(MEMORYDEVICE_CUDA);
 	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
 	FEHashEntry *hashTable = scene->index.GetEntries();
 
 	int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
 
 	dim3 cudaBlockSize(SDF_BLOCK_SIZE, SDF_BLOCK_SIZE, SDF_BLOCK_SIZE);
 	dim3 gridSize(renderState_vh->noVisibleEntries);
+	if (gridSize.x == 0) return;
+
+	if (scene->sceneParams->stopIntegratingAtMaxW)
+		reintegrateIntoScene_device<TVoxel, true> << <gridSize, cudaBlockSize >> >(localVBA, hashTable, visibleEntryIDs, entriesVisibleType,
+		entriesRepealType_device, rgb, rgbImgSize, depth, weight, depthImgSize, old_M, new_M, new_M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+	else
+		reintegrateIntoScene_device<TVoxel, false> << <gridSize, cudaBlockSize >> >(localVBA, hashTable, visibleEntryIDs, entriesVisibleType,
+		entriesRepealType_device, rgb, rgbImgSize, depth, weight, depthImgSize, old_M, new_M, new_M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+}
 
-	repealFromScene_device<TVoxel, false, false> << <gridSize, cudaBlockSize >> >(localVBA, hashTable, visibleEntryIDs,
-	rgb, rgbImgSize, depth, depthImgSize, M_d, M_rgb, projParams_d, projParams_rgb, voxelSize, mu, maxW);
+template<class TVoxel>
+void FESceneReconstructionEngine_CUDA<TVoxel, FEVoxelBlockHash>::CollectGarbage(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FERenderState *renderState,
+	int firstBucketId, int noBuckets)
+{
+	noBuckets = MIN(noBuckets, SDF_BUCKET_NUM - firstBucketId);
+	if (noBuckets <= 0) return;
+
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	int *voxelAllocationList = scene->localVBA.GetAllocationList();
+	int *excessAllocationList = scene->index.GetExcessAllocationList();
+	FEHashEntry *hashTable = scene->index.GetEntries();
+
+	const uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+	// with swapping only blocks whose newest data is in the voxel block array may go, the others are waiting to be merged
+	uchar *swapStates = scene->useSwapping ? scene->globalCache->GetSwapStates() : NULL;
+
+	// the stored visible lists keep the ids of the released entries, they are stale in those lists from now on
+	int *entriesReleaseStamp = renderState_vh->GetEntriesReleaseStamp();
+	int releaseStamp = renderState_vh->GetVisibleListBlock()->getNextStamp();
+
+	AllocationTempData *tempData = (AllocationTempData*)allocationTempData_host;
+	tempData->noAllocatedVoxelEntries = scene->localVBA.lastFreeBlockId;
+	tempData->noAllocatedExcessEntries = scene->index.GetLastFreeExcessListId();
+	tempData->noVisibleEntries = 0;
+	FESafeCall(cudaMemcpyAsync(allocationTempData_device, tempData, sizeof(AllocationTempData), cudaMemcpyHostToDevice));
+
+	// mark and reset the empty blocks, one cuda block per bucket, launched in parts to stay within the grid size limit
+	dim3 cudaBlockSizeGM(SDF_BLOCK_SIZE, SDF_BLOCK_SIZE, SDF_BLOCK_SIZE);
+	for (int bucketId = firstBucketId; bucketId < firstBucketId + noBuckets; bucketId += 0x8000)
+	{
+		dim3 gridSizeGM(MIN(0x8000, firstBucketId + noBuckets - bucketId));
+		markGarbageEntries_device<TVoxel> << <gridSizeGM, cudaBlockSizeGM >> >(localVBA, hashTable, entriesAllocType_device, entriesVisibleType,
+			swapStates, bucketId);
+	}
+
+	// one thread per bucket, so every excess list is changed by a single thread
+	dim3 cudaBlockSizeGR(256, 1);
+	dim3 gridSizeGR((int)ceil((float)noBuckets / (float)cudaBlockSizeGR.x));
+	releaseGarbageEntries_device << <gridSizeGR, cudaBlockSizeGR >> >(voxelAllocationList, excessAllocationList, hashTable, swapStates,
+		entriesAllocType_device, (AllocationTempData*)allocationTempData_device, entriesReleaseStamp, releaseStamp, firstBucketId, noBuckets);
+
+	FESafeCall(cudaMemcpy(tempData, allocationTempData_device, sizeof(AllocationTempData), cudaMemcpyDeviceToHost));
+	scene->localVBA.lastFreeBlockId = tempData->noAllocatedVoxelEntries;
+	scene->index.SetLastFreeExcessListId(tempData->noAllocatedExcessEntries);
 }
 
 //template<class TVoxel>
@@ -385,9 +494,10 @@ __global__ void integrateIntoScene_device(TVoxel *localVBA, const FEHashEntry *h
 	ComputeUpdatedVoxelInfo<TVoxel::hasColorInformation, TVoxel>::compute(localVoxelBlock[locId], pt_model, M_d, projParams_d, M_rgb, projParams_rgb, mu, maxW, depth, depthImgSize, rgb, rgbImgSize);
 }
 
-template<class TVoxel, bool stopMaxW, bool approximateIntegration>
-__global__ void repealFromScene_device(TVoxel *localVBA, const FEHashEntry *hashTable, int *visibleEntryIDs,
-	const Vector4u *rgb, Vector2i rgbImgSize, const float *depth, Vector2i depthImgSize, Matrix4f M_d, Matrix4f M_rgb, Vector4f projParams_d,
+template<class TVoxel, bool stopMaxW>
+__global__ void reintegrateIntoScene_device(TVoxel *localVBA, const FEHashEntry *hashTable, const int *visibleEntryIDs,
+	const uchar *entriesVisibleType, const uchar *entriesRepealType, const Vector4u *rgb, Vector2i rgbImgSize, const float *depth,
+	const float *depthWeight, Vector2i depthImgSize, Matrix4f old_M, Matrix4f new_M, Matrix4f new_M_rgb, Vector4f projParams_d,
 	Vector4f projParams_rgb, float _voxelSize, float mu, int maxW)
 {
 	Vector3i globalPos;
@@ -397,6 +507,9 @@ __global__ void repealFromScene_device(TVoxel *localVBA, const FEHashEntry *hash
 
 	if (currentHashEntry.ptr < 0) return;
 
+	// type 6 blocks were only seen from the old pose
+	bool isRepealed = entriesRepealType[entryId] != 0, isIntegrated = entriesVisibleType[entryId] != 6;
+
 	globalPos = currentHashEntry.pos.toInt() * SDF_BLOCK_SIZE;
 
 	TVoxel *localVoxelBlock = &(localVBA[currentHashEntry.ptr * SDF_BLOCK_SIZE3]);
@@ -407,15 +520,19 @@ __global__ void repealFromScene_device(TVoxel *localVBA, const FEHashEntry *hash
 
 	locId = x + y * SDF_BLOCK_SIZE + z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE;
 
-	if (stopMaxW) if (localVoxelBlock[locId].w_depth == maxW) return;
-	if (approximateIntegration) if (localVoxelBlock[locId].w_depth != 0) return;
-
 	pt_model.x = (float)(globalPos.x + x) * _voxelSize;
 	pt_model.y = (float)(globalPos.y + y) * _voxelSize;
 	pt_model.z = (float)(globalPos.z + z) * _voxelSize;
 	pt_model.w = 1.0f;
 
-	recoverVoxelDepthInfo(localVoxelBlock[locId], pt_model, M_d, projParams_d, mu, maxW, depth, depthImgSize);
+	TVoxel voxel = localVoxelBlock[locId];
+
+	if (isRepealed) recoverVoxelDepthInfo(voxel, pt_model, old_M, projParams_d, mu, maxW, depth, depthImgSize, depthWeight);
+
+	if (isIntegrated && !(stopMaxW && voxel.w_depth == maxW))
+		ComputeUpdatedVoxelInfo<TVoxel::hasColorInformation, TVoxel>::compute(voxel, pt_model, new_M, projParams_d, new_M_rgb, projParams_rgb, mu, maxW, depth, depthImgSize, rgb, rgbImgSize, depthWeight);
+
+	localVoxelBlock[locId] = voxel;
 }
 
 __global__ void buildHashAllocAndVisibleType_device(uchar *entriesAllocType, uchar *entriesVisibleType, Vector4s *blockCoords, const float *depth,
@@ -437,6 +554,40 @@ __global__ void setToType3(uchar *entriesVisibleType, int *visibleEntryIDs, int
 	entriesVisibleType[visibleEntryIDs[entryId]] = 3;
 }
 
+__global__ void markRepealedEntries_device(uchar *entriesRepealType, const int *visibleEntryIDs, int noVisibleEntries,
+	const int *entriesReleaseStamp, int stamp)
+{
+	int entryId = threadIdx.x + blockIdx.x * blockDim.x;
+	if (entryId > noVisibleEntries - 1) return;
+	if (entriesReleaseStamp[visibleEntryIDs[entryId]] <= stamp) entriesRepealType[visibleEntryIDs[entryId]] = 1;
+}
+
+__global__ void appendRepealedEntries_device(int *visibleEntryIDs, AllocationTempData *allocData, uchar *entriesVisibleType,
+	const uchar *entriesRepealType, int noTotalEntries)
+{
+	int targetIdx = threadIdx.x + blockIdx.x * blockDim.x;
+	if (targetIdx > noTotalEntries - 1) return;
+
+	__shared__ bool shouldPrefix;
+	shouldPrefix = false;
+	__syncthreads();
+
+	bool isRepealedOnly = entriesRepealType[targetIdx] != 0 && entriesVisibleType[targetIdx] == 0;
+	if (isRepealedOnly)
+	{
+		entriesVisibleType[targetIdx] = 6;
+		shouldPrefix = true;
+	}
+
+	__syncthreads();
+
+	if (shouldPrefix)
+	{
+		int offset = computePrefixSum_device<int>(isRepealedOnly, &allocData->noVisibleEntries, blockDim.x * blockDim.y, threadIdx.x);
+		if (offset != -1) visibleEntryIDs[offset] = targetIdx;
+	}
+}
+
 __global__ void allocateVoxelBlocksList_device(int *voxelAllocationList, int *excessAllocationList, FEHashEntry *hashTable, int noTotalEntries,
 	AllocationTempData *allocData, uchar *entriesAllocType, uchar *entriesVisibleType, Vector4s *blockCoords)
 {
@@ -457,7 +608,7 @@ __global__ void allocateVoxelBlocksList_device(int *voxelAllocationList, int *ex
 			FEHashEntry hashEntry;
 			hashEntry.pos.x = pt_block_all.x; hashEntry.pos.y = pt_block_all.y; hashEntry.pos.z = pt_block_all.z;
 			hashEntry.ptr = voxelAllocationList[vbaIdx];
-			hashEntry.offset = 0;
+			hashEntry.offset = hashTable[targetIdx].offset; //a released bucket keeps its excess list
 
 			hashTable[targetIdx] = hashEntry;
 }
@@ -506,7 +657,7 @@ __global__ void reAllocateSwappedOutVoxelBlocks_device(int *voxelAllocationList,
 }
 
 __global__ void buildVisibleList_device(FEHashEntry *hashTable, int noTotalEntries,
-	int *visibleEntryIDs, AllocationTempData *allocData, uchar *entriesVisibleType, uchar *temStructure,
+	int *visibleEntryIDs, AllocationTempData *allocData, uchar *entriesVisibleType,
 	Matrix4f M_d, Vector4f projParams_d, Vector2i depthImgSize, float voxelSize)
 {
 	int targetIdx = threadIdx.x + blockIdx.x * blockDim.x;
@@ -532,19 +683,7 @@ __global__ void buildVisibleList_device(FEHashEntry *hashTable, int noTotalEntri
 		entriesVisibleType[targetIdx] = 0;
 	}
 
-	if (hashVisibleType > 0) {
-		int index = targetIdx / 8;
-		int offset = targetIdx % 8;
-
-		unsigned char value = 1;
-		for (int i = 1; i <= offset; i++){
-			value *= 2;
-		}
-
-		temStructure[index * 8 + offset] = value;
-		//visibleListPtr[index] += value;
-		shouldPrefix = true;
-	}
+	if (hashVisibleType > 0) shouldPrefix = true;
 
 	__syncthreads();
 
@@ -567,53 +706,78 @@ __global__ void buildVisibleList_device(FEHashEntry *hashTable, int noTotalEntri
 #endif
 }
 
-__global__ void buildBinaryVisibleList_device(int noTotalEntries, uchar *temStructure, uchar *visibleListPtr){
-	int targetIdx = threadIdx.x + blockIdx.x * blockDim.x;
-	if (targetIdx > noTotalEntries / 8) return;
+template<class TVoxel>
+__global__ void markGarbageEntries_device(TVoxel *localVBA, const FEHashEntry *hashTable, uchar *entriesGarbageType, const uchar *entriesVisibleType,
+	const uchar *swapStates, int firstBucketId)
+{
+	int bucketId = firstBucketId + blockIdx.x;
+	int locId = threadIdx.x + threadIdx.y * SDF_BLOCK_SIZE + threadIdx.z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE;
 
-	__syncthreads();
-	unsigned char value = 0;
+	for (int entryId = bucketId;;)
+	{
+		FEHashEntry hashEntry = hashTable[entryId];
 
-	for (int i = 0; i < 8; i++){
-		value += temStructure[targetIdx * 8 + i];
-	}
+		// the same for all threads of the block, so they all reach the barrier
+		bool isCandidate = hashEntry.ptr >= 0 && entriesVisibleType[entryId] == 0 && (swapStates == NULL || swapStates[entryId] == 1);
 
-	visibleListPtr[targetIdx] = value;
+		bool isGarbage = false;
+		if (isCandidate)
+		{
+			TVoxel *localVoxelBlock = localVBA + hashEntry.ptr * SDF_BLOCK_SIZE3;
 
-	__syncthreads();
+			isGarbage = __syncthreads_and(isVoxelEmpty(localVoxelBlock[locId])) != 0;
+			if (isGarbage) localVoxelBlock[locId] = TVoxel();
+		}
+
+		if (locId == 0) entriesGarbageType[entryId] = isGarbage;
+
+		if (hashEntry.offset < 1) break;
+		entryId = SDF_BUCKET_NUM + hashEntry.offset - 1;
+	}
 }
 
-__global__ void buildVisibleListByBVLB_device(int noTotalEntries, int *visibleEntryIDs, uchar *entriesVisibleType, AllocationTempData *allocData, uchar *visibleListPtr){
-	int targetIdx = threadIdx.x + blockIdx.x * blockDim.x;
-	if (targetIdx > noTotalEntries - 1) return;
+__global__ void releaseGarbageEntries_device(int *voxelAllocationList, int *excessAllocationList, FEHashEntry *hashTable, uchar *swapStates,
+	const uchar *entriesGarbageType, AllocationTempData *allocData, int *entriesReleaseStamp, int releaseStamp, int firstBucketId, int noBuckets)
+{
+	int bucketId = threadIdx.x + blockIdx.x * blockDim.x;
+	if (bucketId > noBuckets - 1) return;
+	bucketId += firstBucketId;
 
-	__shared__ bool shouldPrefix;
-	shouldPrefix = false;
-	__syncthreads();
+	FEHashEntry emptyEntry;
+	emptyEntry.pos.x = emptyEntry.pos.y = emptyEntry.pos.z = 0;
+	emptyEntry.offset = 0;
+	emptyEntry.ptr = -2;
 
-	int index = targetIdx / 8;
-	unsigned char offset = targetIdx % 8;
+	// unlink the released excess entries from the list and hand their slots back
+	for (int prevId = bucketId, entryId; hashTable[prevId].offset >= 1;)
+	{
+		entryId = SDF_BUCKET_NUM + hashTable[prevId].offset - 1;
+		if (!entriesGarbageType[entryId]) { prevId = entryId; continue; }
 
-	unsigned char vb = visibleListPtr[index];
-	unsigned char tem = vb >> offset;
+		int vbaIdx = atomicAdd(&allocData->noAllocatedVoxelEntries, 1);
+		voxelAllocationList[vbaIdx + 1] = hashTable[entryId].ptr;
 
-	unsigned char hashVisibleType = tem % 2;
+		int exlIdx = atomicAdd(&allocData->noAllocatedExcessEntries, 1);
+		excessAllocationList[exlIdx + 1] = entryId - SDF_BUCKET_NUM;
 
-	if (hashVisibleType > 0) {
-		entriesVisibleType[targetIdx] = 6;
-		shouldPrefix = true;
+		hashTable[prevId].offset = hashTable[entryId].offset;
+		hashTable[entryId] = emptyEntry;
+		entriesReleaseStamp[entryId] = releaseStamp;
+		if (swapStates != NULL) swapStates[entryId] = 0;
 	}
-	else{
-		entriesVisibleType[targetIdx] = 0;
-	}
-
-	__syncthreads();
 
-	if (shouldPrefix)
+	// a released bucket keeps the link to its excess list
+	if (entriesGarbageType[bucketId])
 	{
-		int offset = computePrefixSum_device<int>(hashVisibleType > 0, &allocData->noVisibleEntries, blockDim.x * blockDim.y, threadIdx.x);
-		if (offset != -1) visibleEntryIDs[offset] = targetIdx;
+		int vbaIdx = atomicAdd(&allocData->noAllocatedVoxelEntries, 1);
+		voxelAllocationList[vbaIdx + 1] = hashTable[bucketId].ptr;
+
+		hashTable[bucketId].ptr = -2;
+		entriesReleaseStamp[bucketId] = releaseStamp;
+		if (swapStates != NULL) swapStates[bucketId] = 0;
 	}
 }
 
-template class FE::FESceneReconstructionEngine_CUDA<FEVoxel, FEVoxelIndex>;
+template class FE::FESceneReconstructionEngine_CUDA<FEVoxel_s, FEVoxelIndex>;
+template class FE::FESceneReconstructionEngine_CUDA<FEVoxel_c, FEVoxelIndex>;
+template class FE::FESceneReconstructionEngine_CUDA<FEVoxel_c_rgb, FEVoxelIndex>;
@@ -20,7 +20,8 @@ namespace FE
 		unsigned char *entriesAllocType_device;
 		Vector4s *blockCoords_device;
 
-		unsigned char *temStructure_device;//temperal structure for building binary visible table
+		/** Entries the frame being reintegrated was integrated into before. */
+		unsigned char *entriesRepealType_device;
 
 	public:
 		void ResetScene(FEScene<TVoxel, FEVoxelBlockHash> *scene);
@@ -40,10 +41,13 @@ namespace FE
 		void IntegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
 			const FERenderState *renderState);
 
-		void UpdateVisibleEntryIDsByBVLB(FEScene<TVoxel, FEVoxelBlockHash> *scene, const int index, const FERenderState *renderState);
+		void AllocateSceneForReintegration(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const int frameIndex,
+			const Matrix4f &new_M, const FERenderState *renderState);
 
-		void RepealFromScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
-			const FERenderState *renderState);
+		void ReintegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &old_M,
+			const Matrix4f &new_M, const FERenderState *renderState, const FloatImage *depthWeight = NULL);
+
+		void CollectGarbage(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FERenderState *renderState, int firstBucketId, int noBuckets);
 
 		//void testVLB();
 		
@@ -0,0 +1,232 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#include "FESwappingEngine_CUDA.h"
+#include "../Common/FECSwappingEngine.h"
+#include "../Common/FECSceneReconstructionEngine.h"
+#include "../../Objects/FERenderState_VH.h"
+
+using namespace FE;
+
+__global__ void buildListToSwapIn_device(int *neededEntryIDs, Vector3s *neededBlockPos, int *noNeededEntries, const uchar *swapStates,
+	const FEHashEntry *hashTable, const int *visibleEntryIDs, int firstVisibleId, int noVisibleIds);
+
+template<class TVoxel>
+__global__ void integrateOldIntoActiveData_device(TVoxel *localVBA, uchar *swapStates, const FEHashEntry *hashTable, const TVoxel *transferBlocks,
+	const int *neededEntryIDs, const uchar *hasTransferData, int maxW);
+
+__global__ void buildListToSwapOut_device(int *neededEntryIDs, Vector3s *neededBlockPos, int *noNeededEntries, const uchar *swapStates,
+	const FEHashEntry *hashTable, const uchar *entriesVisibleType, int noTotalEntries, Matrix4f M_d, Vector4f projParams_d, float voxelSize,
+	Vector2i depthImgSize);
+
+template<class TVoxel>
+__global__ void moveActiveDataToTransferBuffer_device(TVoxel *transferBlocks, TVoxel *localVBA, const FEHashEntry *hashTable, const int *neededEntryIDs);
+
+__global__ void cleanMemory_device(int *voxelAllocationList, int *noAllocatedVoxelEntries, uchar *swapStates, FEHashEntry *hashTable,
+	const int *neededEntryIDs, int noNeededEntries);
+
+// host methods
+
+template<class TVoxel>
+FESwappingEngine_CUDA<TVoxel, FEVoxelBlockHash>::FESwappingEngine_CUDA(void)
+{
+	FESafeCall(cudaMalloc((void**)&noNeededEntries_device, sizeof(int)));
+	FESafeCall(cudaMalloc((void**)&noAllocatedVoxelEntries_device, sizeof(int)));
+}
+
+template<class TVoxel>
+FESwappingEngine_CUDA<TVoxel, FEVoxelBlockHash>::~FESwappingEngine_CUDA(void)
+{
+	FESafeCall(cudaFree(noNeededEntries_device));
+	FESafeCall(cudaFree(noAllocatedVoxelEntries_device));
+}
+
+template<class TVoxel>
+void FESwappingEngine_CUDA<TVoxel, FEVoxelBlockHash>::IntegrateGlobalIntoLocal(FEScene<TVoxel, FEVoxelBlockHash> *scene, FERenderState *renderState)
+{
+	FEGlobalCache<TVoxel> *globalCache = scene->globalCache;
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	FEHashEntry *hashTable = scene->index.GetEntries();
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	uchar *swapStates = globalCache->GetSwapStates();
+
+	TVoxel *transferBlocks = globalCache->GetTransferBlocks(MEMORYDEVICE_CUDA);
+	int *transferEntryIDs = globalCache->GetTransferEntryIDs(MEMORYDEVICE_CUDA);
+	Vector3s *transferBlockPos = globalCache->GetTransferBlockPos(MEMORYDEVICE_CUDA);
+	uchar *hasTransferData = globalCache->GetHasTransferData(MEMORYDEVICE_CUDA);
+
+	const int *visibleEntryIDs = renderState_vh->GetVisibleEntryIDs();
+	int noVisibleEntries = renderState_vh->noVisibleEntries;
+	int maxW = scene->sceneParams->maxW;
+
+	// all visible blocks have to be merged before they are used, so the visible list is walked in
+	// windows of SDF_TRANSFER_BLOCK_NUM entries, each of which fits into the transfer buffer
+	for (int firstVisibleId = 0; firstVisibleId < noVisibleEntries; firstVisibleId += SDF_TRANSFER_BLOCK_NUM)
+	{
+		int noVisibleIds = MIN(SDF_TRANSFER_BLOCK_NUM, noVisibleEntries - firstVisibleId);
+
+		FESafeCall(cudaMemset(noNeededEntries_device, 0, sizeof(int)));
+
+		dim3 cudaBlockSize(256, 1);
+		dim3 gridSize((int)ceil((float)noVisibleIds / (float)cudaBlockSize.x));
+		buildListToSwapIn_device << <gridSize, cudaBlockSize >> >(transferEntryIDs, transferBlockPos, noNeededEntries_device, swapStates,
+			hashTable, visibleEntryIDs, firstVisibleId, noVisibleIds);
+
+		int noNeededEntries;
+		FESafeCall(cudaMemcpy(&noNeededEntries, noNeededEntries_device, sizeof(int), cudaMemcpyDeviceToHost));
+		if (noNeededEntries <= 0) continue;
+
+		globalCache->ReadTransferBlocks(noNeededEntries);
+
+		dim3 blockSize(SDF_BLOCK_SIZE, SDF_BLOCK_SIZE, SDF_BLOCK_SIZE);
+		dim3 gridSizeBlocks(noNeededEntries);
+		integrateOldIntoActiveData_device << <gridSizeBlocks, blockSize >> >(localVBA, swapStates, hashTable, transferBlocks,
+			transferEntryIDs, hasTransferData, maxW);
+	}
+}
+
+template<class TVoxel>
+void FESwappingEngine_CUDA<TVoxel, FEVoxelBlockHash>::SaveToGlobalMemory(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
+	FERenderState *renderState)
+{
+	FEGlobalCache<TVoxel> *globalCache = scene->globalCache;
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState;
+
+	FEHashEntry *hashTable = scene->index.GetEntries();
+	TVoxel *localVBA = scene->localVBA.GetVoxelBlocks();
+	int *voxelAllocationList = scene->localVBA.GetAllocationList();
+	uchar *swapStates = globalCache->GetSwapStates();
+
+	TVoxel *transferBlocks = globalCache->GetTransferBlocks(MEMORYDEVICE_CUDA);
+	int *transferEntryIDs = globalCache->GetTransferEntryIDs(MEMORYDEVICE_CUDA);
+	Vector3s *transferBlockPos = globalCache->GetTransferBlockPos(MEMORYDEVICE_CUDA);
+
+	const uchar *entriesVisibleType = renderState_vh->GetEntriesVisibleType();
+	int noTotalEntries = scene->index.noTotalEntries;
+
+	Vector2i depthImgSize = view->depth->noDims;
+	Vector4f projParams_d = view->calib->intrinsics_d.projectionParamsSimple.all;
+	float voxelSize = scene->sceneParams->voxelSize;
+
+	FESafeCall(cudaMemset(noNeededEntries_device, 0, sizeof(int)));
+
+	{ // find blocks outside the enlarged view frustum
+		dim3 cudaBlockSize(256, 1);
+		dim3 gridSize((int)ceil((float)noTotalEntries / (float)cudaBlockSize.x));
+		buildListToSwapOut_device << <gridSize, cudaBlockSize >> >(transferEntryIDs, transferBlockPos, noNeededEntries_device, swapStates,
+			hashTable, entriesVisibleType, noTotalEntries, M_d, projParams_d, voxelSize, depthImgSize);
+	}
+
+	int noNeededEntries;
+	FESafeCall(cudaMemcpy(&noNeededEntries, noNeededEntries_device, sizeof(int), cudaMemcpyDeviceToHost));
+	noNeededEntries = MIN(noNeededEntries, SDF_TRANSFER_BLOCK_NUM);
+	if (noNeededEntries <= 0) return;
+
+	{ // copy them to the transfer buffer and reset them
+		dim3 blockSize(SDF_BLOCK_SIZE, SDF_BLOCK_SIZE, SDF_BLOCK_SIZE);
+		dim3 gridSize(noNeededEntries);
+		moveActiveDataToTransferBuffer_device << <gridSize, blockSize >> >(transferBlocks, localVBA, hashTable, transferEntryIDs);
+	}
+
+	globalCache->WriteTransferBlocks(noNeededEntries);
+
+	{ // hand the blocks back to the voxel block array
+		int lastFreeBlockId = scene->localVBA.lastFreeBlockId;
+		FESafeCall(cudaMemcpy(noAllocatedVoxelEntries_device, &lastFreeBlockId, sizeof(int), cudaMemcpyHostToDevice));
+
+		dim3 cudaBlockSize(256, 1);
+		dim3 gridSize((int)ceil((float)noNeededEntries / (float)cudaBlockSize.x));
+		cleanMemory_device << <gridSize, cudaBlockSize >> >(voxelAllocationList, noAllocatedVoxelEntries_device, swapStates, hashTable,
+			transferEntryIDs, noNeededEntries);
+
+		scene->localVBA.lastFreeBlockId = lastFreeBlockId + noNeededEntries;
+	}
+}
+
+// device functions
+
+__global__ void buildListToSwapIn_device(int *neededEntryIDs, Vector3s *neededBlockPos, int *noNeededEntries, const uchar *swapStates,
+	const FEHashEntry *hashTable, const int *visibleEntryIDs, int firstVisibleId, int noVisibleIds)
+{
+	int visibleId = threadIdx.x + blockIdx.x * blockDim.x;
+	if (visibleId > noVisibleIds - 1) return;
+
+	int entryId = visibleEntryIDs[firstVisibleId + visibleId];
+	if (swapStates[entryId] != 0 || hashTable[entryId].ptr < 0) return;
+
+	int transferId = atomicAdd(noNeededEntries, 1);
+	neededEntryIDs[transferId] = entryId;
+	neededBlockPos[transferId] = hashTable[entryId].pos;
+}
+
+template<class TVoxel>
+__global__ void integrateOldIntoActiveData_device(TVoxel *localVBA, uchar *swapStates, const FEHashEntry *hashTable, const TVoxel *transferBlocks,
+	const int *neededEntryIDs, const uchar *hasTransferData, int maxW)
+{
+	int transferId = blockIdx.x;
+	int entryId = neededEntryIDs[transferId];
+	int vIdx = threadIdx.x + threadIdx.y * SDF_BLOCK_SIZE + threadIdx.z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE;
+
+	if (vIdx == 0) swapStates[entryId] = 1;
+	if (!hasTransferData[transferId]) return;
+
+	const TVoxel *srcVoxelBlock = transferBlocks + transferId * SDF_BLOCK_SIZE3;
+	TVoxel *dstVoxelBlock = localVBA + hashTable[entryId].ptr * SDF_BLOCK_SIZE3;
+
+	CombineVoxelInformation<TVoxel::hasColorInformation, TVoxel>::compute(srcVoxelBlock[vIdx], dstVoxelBlock[vIdx], maxW);
+}
+
+__global__ void buildListToSwapOut_device(int *neededEntryIDs, Vector3s *neededBlockPos, int *noNeededEntries, const uchar *swapStates,
+	const FEHashEntry *hashTable, const uchar *entriesVisibleType, int noTotalEntries, Matrix4f M_d, Vector4f projParams_d, float voxelSize,
+	Vector2i depthImgSize)
+{
+	int entryId = threadIdx.x + blockIdx.x * blockDim.x;
+	if (entryId > noTotalEntries - 1) return;
+
+	if (swapStates[entryId] != 1 || entriesVisibleType[entryId] > 0) return;
+
+	FEHashEntry hashEntry = hashTable[entryId];
+	if (hashEntry.ptr < 0) return;
+
+	// keep a margin around the view, so blocks do not bounce in and out at its border
+	bool isVisible, isVisibleEnlarged;
+	checkBlockVisibility<true>(isVisible, isVisibleEnlarged, hashEntry.pos, M_d, projParams_d, voxelSize, depthImgSize);
+	if (isVisibleEnlarged) return;
+
+	int transferId = atomicAdd(noNeededEntries, 1);
+	if (transferId > SDF_TRANSFER_BLOCK_NUM - 1) return;
+
+	neededEntryIDs[transferId] = entryId;
+	neededBlockPos[transferId] = hashEntry.pos;
+}
+
+template<class TVoxel>
+__global__ void moveActiveDataToTransferBuffer_device(TVoxel *transferBlocks, TVoxel *localVBA, const FEHashEntry *hashTable, const int *neededEntryIDs)
+{
+	int transferId = blockIdx.x;
+	int vIdx = threadIdx.x + threadIdx.y * SDF_BLOCK_SIZE + threadIdx.z * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE;
+
+	TVoxel *localVoxelBlock = localVBA + hashTable[neededEntryIDs[transferId]].ptr * SDF_BLOCK_SIZE3;
+
+	transferBlocks[transferId * SDF_BLOCK_SIZE3 + vIdx] = localVoxelBlock[vIdx];
+	localVoxelBlock[vIdx] = TVoxel();
+}
+
+__global__ void cleanMemory_device(int *voxelAllocationList, int *noAllocatedVoxelEntries, uchar *swapStates, FEHashEntry *hashTable,
+	const int *neededEntryIDs, int noNeededEntries)
+{
+	int transferId = threadIdx.x + blockIdx.x * blockDim.x;
+	if (transferId > noNeededEntries - 1) return;
+
+	int entryId = neededEntryIDs[transferId];
+
+	int vbaIdx = atomicAdd(noAllocatedVoxelEntries, 1);
+	voxelAllocationList[vbaIdx + 1] = hashTable[entryId].ptr;
+
+	hashTable[entryId].ptr = -1;
+	swapStates[entryId] = 0;
+}
+
+template class FE::FESwappingEngine_CUDA<FEVoxel_s, FEVoxelIndex>;
+template class FE::FESwappingEngine_CUDA<FEVoxel_c, FEVoxelIndex>;
+template class FE::FESwappingEngine_CUDA<FEVoxel_c_rgb, FEVoxelIndex>;
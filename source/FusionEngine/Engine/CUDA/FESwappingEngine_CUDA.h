@@ -0,0 +1,33 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_SWAPPINGENGINE_CUDA_H
+#define _FE_SWAPPINGENGINE_CUDA_H
+
+#include "../FESwappingEngine.h"
+
+namespace FE
+{
+	template<class TVoxel, class TIndex>
+	class FESwappingEngine_CUDA : public FESwappingEngine < TVoxel, TIndex >
+	{
+	public:
+		void IntegrateGlobalIntoLocal(FEScene<TVoxel, TIndex> *scene, FERenderState *renderState) { }
+		void SaveToGlobalMemory(FEScene<TVoxel, TIndex> *scene, const FEView *view, const Matrix4f &M_d, FERenderState *renderState) { }
+	};
+
+	template<class TVoxel>
+	class FESwappingEngine_CUDA<TVoxel, FEVoxelBlockHash> : public FESwappingEngine < TVoxel, FEVoxelBlockHash >
+	{
+	private:
+		int *noNeededEntries_device;
+		int *noAllocatedVoxelEntries_device;
+
+	public:
+		void IntegrateGlobalIntoLocal(FEScene<TVoxel, FEVoxelBlockHash> *scene, FERenderState *renderState);
+		void SaveToGlobalMemory(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d, FERenderState *renderState);
+
+		FESwappingEngine_CUDA(void);
+		~FESwappingEngine_CUDA(void);
+	};
+}
+#endif //_FE_SWAPPINGENGINE_CUDA_H
@@ -709,4 +709,6 @@ __global__ void renderColour_device(Vector4u *outRendering, const Vector4f *ptsR
 	processPixelColour<TVoxel, TIndex>(outRendering[locId], ptRay.toVector3(), ptRay.w > 0, voxelData, voxelIndex, lightSource);
 }
 
-template class FEVisualisationEngine_CUDA < FEVoxel, FEVoxelIndex > ;
+template class FEVisualisationEngine_CUDA < FEVoxel_s, FEVoxelIndex > ;
+template class FEVisualisationEngine_CUDA < FEVoxel_c, FEVoxelIndex > ;
+template class FEVisualisationEngine_CUDA < FEVoxel_c_rgb, FEVoxelIndex > ;
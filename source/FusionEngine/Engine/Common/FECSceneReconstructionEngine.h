@@ -8,9 +8,11 @@
 #include "FECPixelUtils.h"
 #include "FECRepresentationAccess.h"
 
+/** @p depthWeight is the number of depth images fused into each depth value, NULL for a single image. */
 template<class TVoxel>
 _CPU_AND_GPU_CODE_ inline float computeUpdatedVoxelDepthInfo(DEVICEPTR(TVoxel) &voxel, const THREADPTR(Vector4f) & pt_model, const CONSTPTR(Matrix4f) & M_d,
-	const CONSTPTR(Vector4f) & projParams_d, float mu, int maxW, const CONSTPTR(float) *depth, const CONSTPTR(Vector2i) & imgSize)
+	const CONSTPTR(Vector4f) & projParams_d, float mu, int maxW, const CONSTPTR(float) *depth, const CONSTPTR(Vector2i) & imgSize,
+	const CONSTPTR(float) *depthWeight = NULL)
 {
 	Vector4f pt_camera; Vector2f pt_image;
 	float depth_measure, eta, oldF, newF;
@@ -25,7 +27,8 @@ _CPU_AND_GPU_CODE_ inline float computeUpdatedVoxelDepthInfo(DEVICEPTR(TVoxel) &
 	if ((pt_image.x < 1) || (pt_image.x > imgSize.x - 2) || (pt_image.y < 1) || (pt_image.y > imgSize.y - 2)) return -1;
 
 	// get measured depth from image
-	depth_measure = depth[(int)(pt_image.x + 0.5f) + (int)(pt_image.y + 0.5f) * imgSize.x];
+	int locId = (int)(pt_image.x + 0.5f) + (int)(pt_image.y + 0.5f) * imgSize.x;
+	depth_measure = depth[locId];
 	if (depth_measure <= 0.0) return -1;
 
 	// check whether voxel needs updating
@@ -36,7 +39,7 @@ _CPU_AND_GPU_CODE_ inline float computeUpdatedVoxelDepthInfo(DEVICEPTR(TVoxel) &
 	oldF = TVoxel::SDF_valueToFloat(voxel.sdf); oldW = voxel.w_depth;
 
 	newF = MIN(1.0f, eta / mu);
-	newW = 1;
+	newW = depthWeight != NULL ? (int)depthWeight[locId] : 1;
 
 	newF = oldW * oldF + newW * newF;
 	newW = oldW + newW;
@@ -52,7 +55,8 @@ _CPU_AND_GPU_CODE_ inline float computeUpdatedVoxelDepthInfo(DEVICEPTR(TVoxel) &
 
 template<class TVoxel>
 _CPU_AND_GPU_CODE_ inline float recoverVoxelDepthInfo(DEVICEPTR(TVoxel) &voxel, const THREADPTR(Vector4f) & pt_model, const CONSTPTR(Matrix4f) & M_d,
-	const CONSTPTR(Vector4f) & projParams_d, float mu, int maxW, const CONSTPTR(float) *depth, const CONSTPTR(Vector2i) & imgSize)
+	const CONSTPTR(Vector4f) & projParams_d, float mu, int maxW, const CONSTPTR(float) *depth, const CONSTPTR(Vector2i) & imgSize,
+	const CONSTPTR(float) *depthWeight = NULL)
 {
 	Vector4f pt_camera; Vector2f pt_image;
 	float depth_measure, eta, oldF, newF;
@@ -67,27 +71,29 @@ _CPU_AND_GPU_CODE_ inline float recoverVoxelDepthInfo(DEVICEPTR(TVoxel) &voxel,
 	if ((pt_image.x < 1) || (pt_image.x > imgSize.x - 2) || (pt_image.y < 1) || (pt_image.y > imgSize.y - 2)) return -1;
 
 	// get measured depth from image
-	depth_measure = depth[(int)(pt_image.x + 0.5f) + (int)(pt_image.y + 0.5f) * imgSize.x];
+	int locId = (int)(pt_image.x + 0.5f) + (int)(pt_image.y + 0.5f) * imgSize.x;
+	depth_measure = depth[locId];
 	if (depth_measure <= 0.0) return -1;
 
 	// check whether voxel needs updating
 	eta = depth_measure - pt_camera.z;
 	if (eta < -mu) return eta;
 
-	if (voxel.w_depth == 1){
-		voxel.resetValue();
-		return 0;
-	}
+	newW = depthWeight != NULL ? (int)depthWeight[locId] : 1;
 
 	if (voxel.w_depth < 1){
 		return -1;
 	}
 
+	if (voxel.w_depth <= newW){
+		voxel.resetValue();
+		return 0;
+	}
+
 	// compute updated SDF value and reliability
 	oldF = TVoxel::SDF_valueToFloat(voxel.sdf); oldW = voxel.w_depth;
 
 	newF = MIN(1.0f, eta / mu);
-	newW = 1;
 
 	newF = oldW * oldF - newW * newF;
 	newW = oldW - newW;
@@ -145,9 +151,10 @@ struct ComputeUpdatedVoxelInfo<false, TVoxel> {
 		const CONSTPTR(Matrix4f) & M_rgb, const CONSTPTR(Vector4f) & projParams_rgb,
 		float mu, int maxW,
 		const CONSTPTR(float) *depth, const CONSTPTR(Vector2i) & imgSize_d,
-		const CONSTPTR(Vector4u) *rgb, const CONSTPTR(Vector2i) & imgSize_rgb)
+		const CONSTPTR(Vector4u) *rgb, const CONSTPTR(Vector2i) & imgSize_rgb,
+		const CONSTPTR(float) *depthWeight = NULL)
 	{
-		computeUpdatedVoxelDepthInfo(voxel, pt_model, M_d, projParams_d, mu, maxW, depth, imgSize_d);
+		computeUpdatedVoxelDepthInfo(voxel, pt_model, M_d, projParams_d, mu, maxW, depth, imgSize_d, depthWeight);
 	}
 };
 
@@ -158,9 +165,10 @@ struct ComputeUpdatedVoxelInfo<true, TVoxel> {
 		const THREADPTR(Matrix4f) & M_rgb, const THREADPTR(Vector4f) & projParams_rgb,
 		float mu, int maxW,
 		const CONSTPTR(float) *depth, const CONSTPTR(Vector2i) & imgSize_d,
-		const CONSTPTR(Vector4u) *rgb, const THREADPTR(Vector2i) & imgSize_rgb)
+		const CONSTPTR(Vector4u) *rgb, const THREADPTR(Vector2i) & imgSize_rgb,
+		const CONSTPTR(float) *depthWeight = NULL)
 	{
-		float eta = computeUpdatedVoxelDepthInfo(voxel, pt_model, M_d, projParams_d, mu, maxW, depth, imgSize_d);
+		float eta = computeUpdatedVoxelDepthInfo(voxel, pt_model, M_d, projParams_d, mu, maxW, depth, imgSize_d, depthWeight);
 		if ((eta > mu) || (fabs(eta / mu) > 0.25f)) return;
 		computeUpdatedVoxelColorInfo(voxel, pt_model, M_rgb, projParams_rgb, mu, maxW, eta, rgb, imgSize_rgb);
 	}
@@ -204,6 +212,7 @@ _CPU_AND_GPU_CODE_ inline void buildHashAllocAndVisibleTypePP(DEVICEPTR(uchar) *
 		bool isFound = false;
 
 		FEHashEntry hashEntry = hashTable[hashIdx];
+		unsigned int bucketIdx = hashIdx;
 
 		if (IS_EQUAL3(hashEntry.pos, blockPos) && hashEntry.ptr >= -1)
 		{
@@ -216,8 +225,12 @@ _CPU_AND_GPU_CODE_ inline void buildHashAllocAndVisibleTypePP(DEVICEPTR(uchar) *
 		if (!isFound)
 		{
 			bool isExcess = false;
-			if (hashEntry.ptr >= -1) //seach excess list only if there is no room in ordered part
+			//seach excess list only if there is no room in ordered part, or if the bucket has been
+			//released by the garbage collection but still links to its excess list
+			if (hashEntry.ptr >= -1 || hashEntry.offset >= 1)
 			{
+				isExcess = hashEntry.ptr >= -1;
+
 				while (hashEntry.offset >= 1)
 				{
 					hashIdx = SDF_BUCKET_NUM + hashEntry.offset - 1;
@@ -232,12 +245,12 @@ _CPU_AND_GPU_CODE_ inline void buildHashAllocAndVisibleTypePP(DEVICEPTR(uchar) *
 						break;
 					}
 				}
-
-				isExcess = true;
 			}
 
 			if (!isFound) //still not found
 			{
+				if (!isExcess) hashIdx = bucketIdx;
+
 				entriesAllocType[hashIdx] = isExcess ? 2 : 1; //needs allocation 
 				if (!isExcess) entriesVisibleType[hashIdx] = 1; //new entry is visible
 
@@ -249,6 +262,20 @@ _CPU_AND_GPU_CODE_ inline void buildHashAllocAndVisibleTypePP(DEVICEPTR(uchar) *
 	}
 }
 
+/** A voxel holds no surface information if it has no weight, a truncated voxel still holds free space observations. */
+template<class TVoxel>
+_CPU_AND_GPU_CODE_ inline bool isVoxelEmpty(const CONSTPTR(TVoxel) &voxel)
+{
+	return voxel.w_depth == 0;
+}
+
+template<class TVoxel>
+_CPU_AND_GPU_CODE_ inline bool isVoxelBlockEmpty(const CONSTPTR(TVoxel) *voxelBlock)
+{
+	for (int vIdx = 0; vIdx < SDF_BLOCK_SIZE3; vIdx++) if (!isVoxelEmpty(voxelBlock[vIdx])) return false;
+	return true;
+}
+
 template<bool useSwapping>
 _CPU_AND_GPU_CODE_ inline void checkPointVisibility(THREADPTR(bool) &isVisible, THREADPTR(bool) &isVisibleEnlarged,
 	const THREADPTR(Vector4f) &pt_image, const CONSTPTR(Matrix4f) & M_d, const CONSTPTR(Vector4f) &projParams_d,
@@ -1,8 +1,9 @@
 // Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+#ifndef _FE_C_SWAPPINGENGINE_H
+#define _FE_C_SWAPPINGENGINE_H
 
-#pragma once
-
-#include "../../Utils/ITMLibDefines.h"
+#include "../../Utils/FELibDefines.h"
+#include "../../Utils/FEMathUtils.h"
 
 template<class TVoxel>
 _CPU_AND_GPU_CODE_ inline void combineVoxelDepthInformation(const CONSTPTR(TVoxel) & src, DEVICEPTR(TVoxel) & dst, int maxW)
@@ -62,3 +63,4 @@ struct CombineVoxelInformation<true,TVoxel> {
 	}
 };
 
+#endif //_FE_C_SWAPPINGENGINE_H
@@ -93,7 +93,7 @@ _CPU_AND_GPU_CODE_ inline void CreateRenderingBlocks(DEVICEPTR(RenderingBlock) *
 template<class TVoxel, class TIndex>
 _CPU_AND_GPU_CODE_ inline bool castRay(DEVICEPTR(Vector4f) &pt_out, int x, int y, const CONSTPTR(TVoxel) *voxelData,
 	const CONSTPTR(typename TIndex::IndexData) *voxelIndex, Matrix4f invM, Vector4f projParams, float oneOverVoxelSize, 
-	float mu, const CONSTPTR(Vector2f) & viewFrustum_minmax)
+	float mu, const CONSTPTR(Vector2f) & viewFrustum_minmax, THREADPTR(typename TIndex::IndexCache) & cache)
 {
 	Vector4f pt_camera_f; Vector3f pt_block_s, pt_block_e, rayDirection, pt_result;
 	bool pt_found, hash_found;
@@ -122,8 +122,6 @@ _CPU_AND_GPU_CODE_ inline bool castRay(DEVICEPTR(Vector4f) &pt_out, int x, int y
 
 	pt_result = pt_block_s;
 
-	typename TIndex::IndexCache cache;
-
 	while (totalLength < totalLengthMax) {
 		sdfValue = readFromSDF_float_uninterpolated(voxelData, voxelIndex, pt_result, hash_found, cache);
 
@@ -158,6 +156,20 @@ _CPU_AND_GPU_CODE_ inline bool castRay(DEVICEPTR(Vector4f) &pt_out, int x, int y
 	return pt_found;
 }
 
+/** Same as above, but with a fresh hash lookup cache for every ray. Callers
+	marching neighbouring rays on the same thread can pass their own cache
+	to the overload above instead.
+	*/
+template<class TVoxel, class TIndex>
+_CPU_AND_GPU_CODE_ inline bool castRay(DEVICEPTR(Vector4f) &pt_out, int x, int y, const CONSTPTR(TVoxel) *voxelData,
+	const CONSTPTR(typename TIndex::IndexData) *voxelIndex, Matrix4f invM, Vector4f projParams, float oneOverVoxelSize, 
+	float mu, const CONSTPTR(Vector2f) & viewFrustum_minmax)
+{
+	typename TIndex::IndexCache cache;
+
+	return castRay<TVoxel, TIndex>(pt_out, x, y, voxelData, voxelIndex, invM, projParams, oneOverVoxelSize, mu, viewFrustum_minmax, cache);
+}
+
 _CPU_AND_GPU_CODE_ inline int forwardProjectPixel(Vector4f pixel, const CONSTPTR(Matrix4f) &M, const CONSTPTR(Vector4f) &projParams,
 	const THREADPTR(Vector2i) &imgSize)
 {
@@ -2,17 +2,30 @@
 // Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
 #include "FEDenseMapper.h"
 #include "../Objects/FERenderState_VH.h"
+#include "CPU/FESceneReconstructionEngine_CPU.h"
 #include "CUDA/FESceneReconstructionEngine_CUDA.h"
+#include "CPU/FESwappingEngine_CPU.h"
+#include "CUDA/FESwappingEngine_CUDA.h"
 
 using namespace FE;
 
 template<class TVoxel, class TIndex>
 FEDenseMapper<TVoxel, TIndex>::FEDenseMapper(const FELibSettings *settings)
 {
+	swappingEngine = NULL;
+
+	garbageBucketId = 0;
+	noGarbageBuckets = settings->noGarbageCollectionBuckets;
+
 	switch (settings->deviceType)
 	{
+	case FELibSettings::DEVICE_CPU:
+		sceneRecoEngine = new FESceneReconstructionEngine_CPU<TVoxel,TIndex>();
+		if (settings->useSwapping) swappingEngine = new FESwappingEngine_CPU<TVoxel,TIndex>();
+		break;
 	case FELibSettings::DEVICE_CUDA:
 		sceneRecoEngine = new FESceneReconstructionEngine_CUDA<TVoxel,TIndex>();
+		if (settings->useSwapping) swappingEngine = new FESwappingEngine_CUDA<TVoxel,TIndex>();
 		break;
 	}
 }
@@ -21,12 +34,16 @@ template<class TVoxel, class TIndex>
 FEDenseMapper<TVoxel,TIndex>::~FEDenseMapper()
 {
 	delete sceneRecoEngine;
+	if (swappingEngine != NULL) delete swappingEngine;
 }
 
 template<class TVoxel, class TIndex>
 void FEDenseMapper<TVoxel,TIndex>::ResetScene(FEScene<TVoxel,TIndex> *scene)
 {
 	sceneRecoEngine->ResetScene(scene);
+	if (scene->globalCache != NULL) scene->globalCache->Reset();
+
+	garbageBucketId = 0;
 }
 
 template<class TVoxel, class TIndex>
@@ -35,8 +52,16 @@ void FEDenseMapper<TVoxel,TIndex>::ProcessFrame(const FEView *view, const FETrac
 	// allocation
 	sceneRecoEngine->AllocateSceneFromDepth(scene, view, trackingState, renderState);
 
+	// swap in
+	if (swappingEngine != NULL) swappingEngine->IntegrateGlobalIntoLocal(scene, renderState);
+
 	// integration
 	sceneRecoEngine->IntegrateIntoScene(scene, view, trackingState, renderState);
+
+	// swap out
+	if (swappingEngine != NULL) swappingEngine->SaveToGlobalMemory(scene, view, trackingState->pose_d->GetM(), renderState);
+
+	CollectGarbage(scene, renderState);
 }
 
 template<class TVoxel, class TIndex>
@@ -45,8 +70,16 @@ void FEDenseMapper<TVoxel, TIndex>::ProcessFrame(const FEView *view, const Matri
 	// allocation
 	sceneRecoEngine->AllocateSceneFromDepth(scene, view, M_d, renderState);
 
+	// swap in
+	if (swappingEngine != NULL) swappingEngine->IntegrateGlobalIntoLocal(scene, renderState);
+
 	// integration
 	sceneRecoEngine->IntegrateIntoScene(scene, view, M_d, renderState);
+
+	// swap out
+	if (swappingEngine != NULL) swappingEngine->SaveToGlobalMemory(scene, view, M_d, renderState);
+
+	CollectGarbage(scene, renderState);
 }
 
 template<class TVoxel, class TIndex>
@@ -55,27 +88,44 @@ void FEDenseMapper<TVoxel, TIndex>::ProcessFrame(const FEView *view, const int i
 	// allocation
 	sceneRecoEngine->AllocateSceneFromDepth(scene, view, index, M_d, renderState);
 
+	// swap in
+	if (swappingEngine != NULL) swappingEngine->IntegrateGlobalIntoLocal(scene, renderState);
+
 	// integration
 	sceneRecoEngine->IntegrateIntoScene(scene, view, M_d, renderState);
+
+	// swap out
+	if (swappingEngine != NULL) swappingEngine->SaveToGlobalMemory(scene, view, M_d, renderState);
+
+	CollectGarbage(scene, renderState);
 }
 
 template<class TVoxel, class TIndex>
-void FEDenseMapper<TVoxel, TIndex>::Reintegration(const FEView *view, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M, FEScene<TVoxel, TIndex> *scene, FERenderState *renderState)
+void FEDenseMapper<TVoxel, TIndex>::Reintegration(const FEView *view, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M, FEScene<TVoxel, TIndex> *scene, FERenderState *renderState,
+	const FloatImage *depthWeight)
 {
-	// allocation
-	//sceneRecoEngine->AllocateSceneFromDepth(scene, view, old_M, renderState);
+	// allocation, the visible list covers the blocks seen from the old and from the new pose
+	sceneRecoEngine->AllocateSceneForReintegration(scene, view, frameIndex, new_M, renderState);
 
-	// update visibleEntry IDs
-	sceneRecoEngine->UpdateVisibleEntryIDsByBVLB(scene, frameIndex, renderState);
+	// swap in, blocks seen by the old frame may have been swapped out since
+	if (swappingEngine != NULL) swappingEngine->IntegrateGlobalIntoLocal(scene, renderState);
 
-	// repeal
-	sceneRecoEngine->RepealFromScene(scene, view, old_M, renderState);
+	// repeal and integration in one pass
+	sceneRecoEngine->ReintegrateIntoScene(scene, view, old_M, new_M, renderState, depthWeight);
 
-	// allocation
-	sceneRecoEngine->AllocateSceneFromDepth(scene, view, frameIndex, new_M, renderState);
+	// release the blocks emptied by the repeal
+	CollectGarbage(scene, renderState);
+}
 
-	// integration
-	sceneRecoEngine->IntegrateIntoScene(scene, view, new_M, renderState);
+template<class TVoxel, class TIndex>
+void FEDenseMapper<TVoxel, TIndex>::CollectGarbage(FEScene<TVoxel, TIndex> *scene, FERenderState *renderState)
+{
+	if (noGarbageBuckets <= 0) return;
+
+	sceneRecoEngine->CollectGarbage(scene, renderState, garbageBucketId, noGarbageBuckets);
+
+	garbageBucketId += noGarbageBuckets;
+	if (garbageBucketId >= SDF_BUCKET_NUM) garbageBucketId = 0;
 }
 
 template<class TVoxel, class TIndex>
@@ -84,4 +134,6 @@ void FEDenseMapper<TVoxel,TIndex>::UpdateVisibleList(const FEView *view, const F
 	sceneRecoEngine->AllocateSceneFromDepth(scene, view, trackingState, renderState, true);
 }
 
-template class FE::FEDenseMapper<FEVoxel, FEVoxelIndex>;
+template class FE::FEDenseMapper<FEVoxel_s, FEVoxelIndex>;
+template class FE::FEDenseMapper<FEVoxel_c, FEVoxelIndex>;
+template class FE::FEDenseMapper<FEVoxel_c_rgb, FEVoxelIndex>;
@@ -11,6 +11,7 @@
 #include "../Objects/FERenderState.h"
 
 #include "FESceneReconstructionEngine.h"
+#include "FESwappingEngine.h"
 #include "FEVisualisationEngine.h"
 
 namespace FE
@@ -22,6 +23,12 @@ namespace FE
 	{
 	private:
 		FESceneReconstructionEngine<TVoxel, TIndex> *sceneRecoEngine;
+		FESwappingEngine<TVoxel, TIndex> *swappingEngine;
+
+		/// First hash bucket and number of buckets of the next garbage collection pass
+		int garbageBucketId, noGarbageBuckets;
+
+		void CollectGarbage(FEScene<TVoxel, TIndex> *scene, FERenderState *renderState);
 
 	public:
 		void ResetScene(FEScene<TVoxel, TIndex> *scene);
@@ -36,7 +43,8 @@ namespace FE
 		void ProcessFrame(const FEView *view, const int index, const Matrix4f &M_d, FEScene<TVoxel, TIndex> *scene, FERenderState *renderState_live);
 
 		/// reintegrate into scene
-		void Reintegration(const FEView *view, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M, FEScene<TVoxel, TIndex> *scene, FERenderState *renderState_live);
+		void Reintegration(const FEView *view, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M, FEScene<TVoxel, TIndex> *scene, FERenderState *renderState_live,
+			const FloatImage *depthWeight = NULL);
 
 		/// Update the visible list (this can be called to update the visible list when fusion is turned off)
 		void UpdateVisibleList(const FEView *view, const FETrackingState *trackingState, FEScene<TVoxel, TIndex> *scene, FERenderState *renderState);
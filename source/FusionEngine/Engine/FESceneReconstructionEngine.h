@@ -53,13 +53,61 @@ namespace FE
 		virtual void IntegrateIntoScene(FEScene<TVoxel, TIndex> *scene, const FEView *view, const Matrix4f &M_d,
 			const FERenderState *renderState) = 0;
 
-		virtual void UpdateVisibleEntryIDsByBVLB(FEScene<TVoxel, FEVoxelBlockHash> *scene, const int index, const FERenderState *renderState) = 0;
+		/** Allocate the blocks the depth image of frame
+			@p frameIndex sees from @p new_M and build the visible
+			list from them and from the blocks the frame was
+			integrated into before, as stored in the visible list
+			block. Only the new blocks are stored for the frame.
+			*/
+		virtual void AllocateSceneForReintegration(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const int frameIndex,
+			const Matrix4f &new_M, const FERenderState *renderState) = 0;
 
-		virtual void RepealFromScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &M_d,
-			const FERenderState *renderState) = 0;
+		/** Move the observation of the view from @p old_M to
+			@p new_M after AllocateSceneForReintegration(): each
+			voxel of the visible list is read once, the old
+			observation is removed and the new one added, and it
+			is written back once. A depth image fused from several
+			frames, e.g. a super-frame, counts with the number of
+			frames in @p depthWeight per pixel, otherwise with one.
+			*/
+		virtual void ReintegrateIntoScene(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FEView *view, const Matrix4f &old_M,
+			const Matrix4f &new_M, const FERenderState *renderState, const FloatImage *depthWeight = NULL) = 0;
+
+		/** Release the voxel blocks of the hash buckets
+			[firstBucketId, firstBucketId + noBuckets) and of their
+			excess lists that hold no depth weight any more, e.g.
+			after they have been repealed. Blocks in the visible list
+			of @p renderState are kept. Released excess entries are
+			unlinked from their lists. The ids of released entries
+			may be handed to other blocks, so they are stamped as
+			stale for the visible lists stored in @p renderState.
+			*/
+		virtual void CollectGarbage(FEScene<TVoxel, FEVoxelBlockHash> *scene, const FERenderState *renderState, int firstBucketId,
+			int noBuckets) = 0;
 
 		FESceneReconstructionEngine(void) { }
 		virtual ~FESceneReconstructionEngine(void) { }
+
+	protected:
+		/** Double the voxel block array of the scene, up to
+			sceneParams->noMaxVoxelBlocks, until a quarter of it
+			is still free after @p noRequiredBlocks more blocks
+			are allocated, so that the scene grows with the
+			scanned volume. The array is replaced, so no other
+			thread may read the scene meanwhile.
+			*/
+		void ReserveVoxelBlocks(FEScene<TVoxel, TIndex> *scene, int noRequiredBlocks)
+		{
+			FELocalVBA<TVoxel> &localVBA = scene->localVBA;
+			int noMaxVoxelBlocks = scene->sceneParams->noMaxVoxelBlocks;
+
+			int noUsedBlocks = localVBA.noBlocks - (localVBA.lastFreeBlockId + 1);
+			int newNoBlocks = localVBA.noBlocks;
+			while (newNoBlocks < noMaxVoxelBlocks && newNoBlocks - noUsedBlocks - noRequiredBlocks < newNoBlocks / 4) newNoBlocks *= 2;
+			if (newNoBlocks > noMaxVoxelBlocks) newNoBlocks = noMaxVoxelBlocks;
+
+			localVBA.Resize(newNoBlocks);
+		}
 	};
 }
 #endif //_FE_SCENERECONSTRUCTIONENGINE_H
@@ -0,0 +1,42 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM.
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_SWAPPINGENGINE_H
+#define _FE_SWAPPINGENGINE_H
+
+#include "../Utils/FELibDefines.h"
+
+#include "../Objects/FEScene.h"
+#include "../Objects/FEView.h"
+#include "../Objects/FERenderState.h"
+
+namespace FE
+{
+	/** \brief
+		Interface to engines that swap voxel blocks between the
+		local voxel block array of a scene and its global cache.
+
+		Blocks are swapped back in once they are on the visible
+		list again, and blocks that have left the view frustum
+		are swapped out in batches of SDF_TRANSFER_BLOCK_NUM.
+		*/
+	template<class TVoxel, class TIndex>
+	class FESwappingEngine
+	{
+	public:
+		/** Merge the cached data of all visible blocks that have
+			been (re)allocated since they were swapped out, so
+			they can be integrated into or repealed from.
+			*/
+		virtual void IntegrateGlobalIntoLocal(FEScene<TVoxel, TIndex> *scene, FERenderState *renderState) = 0;
+
+		/** Move up to SDF_TRANSFER_BLOCK_NUM blocks that are neither
+			visible nor inside the enlarged view frustum of the
+			given pose to the global cache and free them.
+			*/
+		virtual void SaveToGlobalMemory(FEScene<TVoxel, TIndex> *scene, const FEView *view, const Matrix4f &M_d, FERenderState *renderState) = 0;
+
+		FESwappingEngine(void) { }
+		virtual ~FESwappingEngine(void) { }
+	};
+}
+#endif //_FE_SWAPPINGENGINE_H
@@ -1,4 +1,6 @@
 // Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
 #include "FETrackerFactory.h"
 
-template class FE::FETrackerFactory<FEVoxel, FEVoxelIndex>;
+template class FE::FETrackerFactory<FEVoxel_s, FEVoxelIndex>;
+template class FE::FETrackerFactory<FEVoxel_c, FEVoxelIndex>;
+template class FE::FETrackerFactory<FEVoxel_c_rgb, FEVoxelIndex>;
@@ -9,6 +9,7 @@
 #include "FETracker.h"
 #include "../Objects/FEScene.h"
 #include "../Utils/FELibSettings.h"
+#include "CPU/FEDepthTracker_CPU.h"
 #include "CUDA/FEDepthTracker_CUDA.h"
 
 namespace FE
@@ -73,6 +74,18 @@ namespace FE
 		{
 			switch (settings->deviceType)
 			{
+			case FELibSettings::DEVICE_CPU:
+			{
+				return new FEDepthTracker_CPU(
+					trackedImageSize,
+					settings->trackingRegime,
+					settings->noHierarchyLevels,
+					settings->noICPRunTillLevel,
+					settings->depthTrackerICPThreshold,
+					settings->depthTrackerTerminationThreshold,
+					lowLevelEngine
+					);
+			}
 			case FELibSettings::DEVICE_CUDA:
 			{
 				return new FEDepthTracker_CUDA(
@@ -105,4 +105,6 @@ void PFEVisualisationEngine::WeightToUchar4(UChar4Image *dst, FloatImage *src)
 		}
 	}
 }
-template class FE::FEVisualisationEngine<FEVoxel, FEVoxelIndex>;
+template class FE::FEVisualisationEngine<FEVoxel_s, FEVoxelIndex>;
+template class FE::FEVisualisationEngine<FEVoxel_c, FEVoxelIndex>;
+template class FE::FEVisualisationEngine<FEVoxel_c_rgb, FEVoxelIndex>;
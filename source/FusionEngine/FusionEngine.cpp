@@ -2,6 +2,10 @@
 // Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
 #include "FusionEngine.h"
 
+#include "Engine/CPU/FEVisualisationEngine_CPU.h"
+#include "Engine/CPU/FELowLevelEngine_CPU.h"
+#include "Engine/CPU/FEMeshingEngine_CPU.h"
+#include "Engine/CPU/FEViewBuilder_CPU.h"
 #include "Engine/CUDA/FEVisualisationEngine_CUDA.h"
 #include "Engine/CUDA/FELowLevelEngine_CUDA.h"
 #include "Engine/CUDA/FEMeshingEngine_CUDA.h"
@@ -11,22 +15,44 @@
 
 using namespace FE;
 
-FusionEngine::FusionEngine(const FELibSettings *settings, const FERGBDCalib *calib, const Vector2i imgSize_rgb, const Vector2i imgSize_d){
+FusionEngine* FusionEngine::Make(const FELibSettings *settings, const FERGBDCalib *calib, const Vector2i imgSize_rgb, const Vector2i imgSize_d)
+{
+	switch (settings->voxelType)
+	{
+	case FELibSettings::VOXEL_CHAR:
+		return new FEBasicEngine<FEVoxel_c, FEVoxelIndex>(settings, calib, imgSize_rgb, imgSize_d);
+	case FELibSettings::VOXEL_CHAR_RGB:
+		return new FEBasicEngine<FEVoxel_c_rgb, FEVoxelIndex>(settings, calib, imgSize_rgb, imgSize_d);
+	case FELibSettings::VOXEL_SHORT:
+	default:
+		return new FEBasicEngine<FEVoxel_s, FEVoxelIndex>(settings, calib, imgSize_rgb, imgSize_d);
+	}
+}
+
+template<class TVoxel, class TIndex>
+FEBasicEngine<TVoxel, TIndex>::FEBasicEngine(const FELibSettings *settings, const FERGBDCalib *calib, const Vector2i imgSize_rgb, const Vector2i imgSize_d){
 	// create all the things required for marching cubes and mesh extraction
 	// - uses additional memory (lots!)
 	static const bool createMeshingEngine = true;
 
 	this->settings = settings;
-	this->scene = new FEScene<FEVoxel, FEVoxelIndex>(&(settings->sceneParams), MEMORYDEVICE_CUDA);
+	MemoryDeviceType memoryType = settings->deviceType == FELibSettings::DEVICE_CUDA ? MEMORYDEVICE_CUDA : MEMORYDEVICE_CPU;
+	this->scene = new FEScene<TVoxel, TIndex>(&(settings->sceneParams), settings->useSwapping, memoryType);
 
 	meshingEngine = NULL;
 	switch (settings->deviceType)
 	{
+	case FELibSettings::DEVICE_CPU:
+		lowLevelEngine = new FELowLevelEngine_CPU();
+		viewBuilder = new FEViewBuilder_CPU(calib);
+		visualisationEngine = new FEVisualisationEngine_CPU<TVoxel, TIndex>(scene);
+		if (createMeshingEngine) meshingEngine = new FEMeshingEngine_CPU<TVoxel, TIndex>();
+		break;
 	case FELibSettings::DEVICE_CUDA:
 		lowLevelEngine = new FELowLevelEngine_CUDA();
 		viewBuilder = new FEViewBuilder_CUDA(calib);
-		visualisationEngine = new FEVisualisationEngine_CUDA<FEVoxel, FEVoxelIndex>(scene);
-		if (createMeshingEngine) meshingEngine = new FEMeshingEngine_CUDA<FEVoxel, FEVoxelIndex>();
+		visualisationEngine = new FEVisualisationEngine_CUDA<TVoxel, TIndex>(scene);
+		if (createMeshingEngine) meshingEngine = new FEMeshingEngine_CUDA<TVoxel, TIndex>();
 		break;
 	}
 
@@ -37,18 +63,19 @@ FusionEngine::FusionEngine(const FELibSettings *settings, const FERGBDCalib *cal
 
 	renderState_live = visualisationEngine->CreateRenderState(trackedImageSize);
 	renderState_freeview = visualisationEngine->CreateRenderState(trackedImageSize);
-	renderState_freeview->setRenderingRangeImage(trackedImageSize, 0.2f, 10.0f, MEMORYDEVICE_CUDA);
+	renderState_freeview->setRenderingRangeImage(trackedImageSize, 0.2f, 10.0f, memoryType);
 
-	denseMapper = new FEDenseMapper<FEVoxel, FEVoxelIndex>(settings);
+	denseMapper = new FEDenseMapper<TVoxel, TIndex>(settings);
 	denseMapper->ResetScene(scene);
 
-	tracker = FETrackerFactory<FEVoxel, FEVoxelIndex>::Instance().Make(trackedImageSize, settings, lowLevelEngine, scene);
+	tracker = FETrackerFactory<TVoxel, TIndex>::Instance().Make(trackedImageSize, settings, lowLevelEngine, scene);
 	trackingController = new FETrackingController(tracker, visualisationEngine, lowLevelEngine, settings);
 
 	trackingState = trackingController->BuildTrackingState(trackedImageSize);
 	tracker->UpdateInitialPose(trackingState);
 
 	view = NULL; // will be allocated by the view builder
+	depthWeight = NULL;
 
 	fusionActive = true;
 	mainProcessingActive = true;
@@ -58,9 +85,14 @@ FusionEngine::FusionEngine(const FELibSettings *settings, const FERGBDCalib *cal
 	freePose.SetM(idenM);
 
 	currentM.setIdentity();
+
+	liveViewOutdated = false;
+	freeViewOutdated = false;
+	freeViewRequested = false;
 }
 
-FusionEngine::~FusionEngine()
+template<class TVoxel, class TIndex>
+FEBasicEngine<TVoxel, TIndex>::~FEBasicEngine()
 {
 	if (renderState_live != NULL) delete renderState_live;
 	if (renderState_freeview!=NULL) delete renderState_freeview;
@@ -77,6 +109,7 @@ FusionEngine::~FusionEngine()
 
 	delete trackingState;
 	if (view != NULL) delete view;
+	if (depthWeight != NULL) delete depthWeight;
 
 	delete visualisationEngine;
 
@@ -85,21 +118,30 @@ FusionEngine::~FusionEngine()
 	if (mesh != NULL) delete mesh;
 }
 
-FEMesh* FusionEngine::UpdateMesh(void)
+template<class TVoxel, class TIndex>
+FEMesh* FEBasicEngine<TVoxel, TIndex>::UpdateMesh(void)
 {
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	if (mesh != NULL) meshingEngine->MeshScene(mesh, scene);
 	return mesh;
 }
 
-void FusionEngine::SaveSceneToMesh(const char *objFileName)
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::SaveSceneToMesh(const char *objFileName)
 {
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	if (mesh == NULL) return;
 	meshingEngine->MeshScene(mesh, scene);
 	mesh->WriteSTL(objFileName);
 }
 
-void FusionEngine::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage)
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage)
 {
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	viewBuilder->UpdateView(&view, rgbImage, rawDepthImage, settings->useBilateralFilter,settings->modelSensorNoise);
 
 	if (!mainProcessingActive) return;
@@ -108,64 +150,108 @@ void FusionEngine::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage
 	trackingController->Track(trackingState, view);
 
 	// fusion
-	if (fusionActive) denseMapper->ProcessFrame(view, trackingState, scene, renderState_live);
+	if (fusionActive) {
+		denseMapper->ProcessFrame(view, trackingState, scene, renderState_live);
+		sceneChanged();
+	}
 
-	// raycast to renderState_live for tracking and free visualisation
+	// raycast to renderState_live for tracking, which leaves the live view up to date
 	currentM = trackingState->pose_d->GetM();
 	trackingController->Prepare(trackingState, view, renderState_live);
-
-	//raycast to renderState_freeview for visualisation
-	visualisationEngine->RenderCurrentView(view, freePose.GetM(), renderState_freeview);
+	liveViewOutdated = false;
 }
 
-void FusionEngine::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const Matrix4f &M_d){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const Matrix4f &M_d){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	viewBuilder->UpdateView(&view, rgbImage, rawDepthImage, settings->useBilateralFilter, settings->modelSensorNoise);
 
 	//fusion
-	if (fusionActive) denseMapper->ProcessFrame(view, M_d, scene, renderState_live);
+	if (fusionActive) {
+		denseMapper->ProcessFrame(view, M_d, scene, renderState_live);
+		sceneChanged();
+	}
 
-	//raycast to renderState_live for visualisation
 	currentM = M_d;
-	visualisationEngine->RenderCurrentView(view, M_d, renderState_live);
-
-	//raycast to renderState_freeview for visualisation
-	visualisationEngine->RenderCurrentView(view, freePose.GetM(), renderState_freeview);
+	liveViewOutdated = true;
 }
 
-void FusionEngine::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int index, const Matrix4f &M_d){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int index, const Matrix4f &M_d){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	viewBuilder->UpdateView(&view, rgbImage, rawDepthImage, settings->useBilateralFilter, settings->modelSensorNoise);
 
 	//fusion
-	if (fusionActive) denseMapper->ProcessFrame(view, index, M_d, scene, renderState_live);
+	if (fusionActive) {
+		denseMapper->ProcessFrame(view, index, M_d, scene, renderState_live);
+		sceneChanged();
+	}
 
-	// raycast to renderState_live for visualisation
 	currentM = M_d;
-	visualisationEngine->RenderCurrentView(view, M_d, renderState_live);
-
-	//raycast to renderState_freeview for visualisation
-	visualisationEngine->RenderCurrentView(view, freePose.GetM(), renderState_freeview);
+	liveViewOutdated = true;
 }
 
-void FusionEngine::ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	viewBuilder->UpdateView(&view, rgbImage, rawDepthImage, settings->useBilateralFilter, settings->modelSensorNoise);
 
 	//refusion
-	if (fusionActive) denseMapper->Reintegration(view, frameIndex, old_M, new_M, scene, renderState_live);
+	if (fusionActive) {
+		denseMapper->Reintegration(view, frameIndex, old_M, new_M, scene, renderState_live);
+		sceneChanged();
+	}
+}
+
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, ShortImage *rawDepthWeight, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
+	viewBuilder->UpdateView(&view, rgbImage, rawDepthImage, settings->useBilateralFilter, settings->modelSensorNoise);
+
+	if (depthWeight == NULL) depthWeight = new FloatImage(rawDepthWeight->noDims, true, settings->deviceType == FELibSettings::DEVICE_CUDA);
+
+	const short *weight_in = rawDepthWeight->GetData(MEMORYDEVICE_CPU);
+	float *weight_out = depthWeight->GetData(MEMORYDEVICE_CPU);
+	for (int locId = 0; locId < (int)depthWeight->dataSize; locId++) weight_out[locId] = (float)weight_in[locId];
+	if (settings->deviceType == FELibSettings::DEVICE_CUDA) depthWeight->UpdateDeviceFromHost();
+
+	//refusion, each pixel counts with the frames fused into it
+	if (fusionActive) {
+		denseMapper->Reintegration(view, frameIndex, old_M, new_M, scene, renderState_live, depthWeight);
+		sceneChanged();
+	}
+}
 
-	// raycast to renderState_live for visualisation
-	visualisationEngine->RenderCurrentView(view, currentM, renderState_live);
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::MergeVisibleLists(const int index, const int firstIndex, const int lastIndex){
+	std::lock_guard<std::mutex> lock(sceneMutex);
 
-	//raycast to renderState_freeview for visualisation
-	visualisationEngine->RenderCurrentView(view, freePose.GetM(), renderState_freeview);
+	FERenderState_VH *renderState_vh = (FERenderState_VH*)renderState_live;
+	renderState_vh->GetVisibleListBlock()->mergeVisibleLists(index, firstIndex, lastIndex, renderState_vh->GetEntriesReleaseStamp_host());
 }
 
-Vector2i FusionEngine::GetImageSize(void) const
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::sceneChanged(){
+	liveViewOutdated = true;
+	freeViewOutdated = true;
+}
+
+template<class TVoxel, class TIndex>
+Vector2i FEBasicEngine<TVoxel, TIndex>::GetImageSize(void) const
 {
 	return renderState_live->raycastImage->noDims;
 }
 
-void FusionEngine::GetImage(UChar4Image *out, GetImageType getImageType, FEPose *pose, FEIntrinsics *intrinsics)
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::GetImage(UChar4Image *out, GetImageType getImageType, FEPose *pose, FEIntrinsics *intrinsics)
 {
+	// the raycasts share the scene and renderState_live with the frame being processed
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	if (view == NULL) return;
 
 	out->Clear();
@@ -181,10 +267,15 @@ void FusionEngine::GetImage(UChar4Image *out, GetImageType getImageType, FEPose
 	case FusionEngine::IMAGE_ORIGINAL_DEPTH:
 		out->ChangeDims(view->depth->noDims);
 		if (settings->deviceType == FELibSettings::DEVICE_CUDA) view->depth->UpdateHostFromDevice();
-		FEVisualisationEngine<FEVoxel, FEVoxelIndex>::DepthToUchar4(out, view->depth);
+		FEVisualisationEngine<TVoxel, TIndex>::DepthToUchar4(out, view->depth);
 		break;
 	case FusionEngine::IMAGE_SCENERAYCAST:
 	{
+		if (liveViewOutdated) {
+			visualisationEngine->RenderCurrentView(view, currentM, renderState_live);
+			liveViewOutdated = false;
+		}
+
 		Basis::Image<Vector4u> *srcImage = renderState_live->raycastImage;
 		out->ChangeDims(srcImage->noDims);
 		if (settings->deviceType == FELibSettings::DEVICE_CUDA)
@@ -194,6 +285,16 @@ void FusionEngine::GetImage(UChar4Image *out, GetImageType getImageType, FEPose
 	}
 	case FusionEngine::IMAGE_FREECAMERA_CAST:
 	{
+		// a free view following the fusion is refreshed at most every freeViewRenderInterval, a moved one at once
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (freeViewRequested || (freeViewOutdated &&
+			std::chrono::duration<float, std::milli>(now - lastFreeViewRender).count() >= settings->freeViewRenderInterval)) {
+			visualisationEngine->RenderCurrentView(view, freePose.GetM(), renderState_freeview);
+			freeViewRequested = false;
+			freeViewOutdated = false;
+			lastFreeViewRender = now;
+		}
+
 		Basis::Image<Vector4u> *srcImage = renderState_freeview->raycastImage;
 		out->ChangeDims(srcImage->noDims);
 		if (settings->deviceType == FELibSettings::DEVICE_CUDA)
@@ -206,22 +307,37 @@ void FusionEngine::GetImage(UChar4Image *out, GetImageType getImageType, FEPose
 	};
 }
 
-void FusionEngine::turnOnIntegration() { fusionActive = true; }
-void FusionEngine::turnOffIntegration() { fusionActive = false; }
-void FusionEngine::turnOnMainProcessing() { mainProcessingActive = true; }
-void FusionEngine::turnOffMainProcessing() { mainProcessingActive = false; }
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::turnOnIntegration() { fusionActive = true; }
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::turnOffIntegration() { fusionActive = false; }
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::turnOnMainProcessing() { mainProcessingActive = true; }
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::turnOffMainProcessing() { mainProcessingActive = false; }
 
 //get all surface points
-void FusionEngine::getSurfacePoints(std::vector<Vector3f> &points, std::vector<Vector3f> &normals, std::vector<short> &sdf_s, const bool withNormals, const bool withSDFs){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::getSurfacePoints(std::vector<Vector3f> &points, std::vector<Vector3f> &normals, std::vector<short> &sdf_s, const bool withNormals, const bool withSDFs){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	points.clear();
 	normals.clear();
 
 	Basis::MemoryBlock<FEHashEntry> *hashEntries = new Basis::MemoryBlock<FEHashEntry>(SDF_BUCKET_NUM + SDF_EXCESS_LIST_SIZE, MEMORYDEVICE_CPU);
 	FEHashEntry *hashTable = hashEntries->GetData(MEMORYDEVICE_CPU);
-	FEVoxel *voxels = (FEVoxel*)malloc(SDF_LOCAL_BLOCK_NUM*SDF_BLOCK_SIZE3 * sizeof(FEVoxel));
+	TVoxel *voxels = (TVoxel*)malloc(scene->localVBA.allocatedSize * sizeof(TVoxel));
 
-	FESafeCall(cudaMemcpy(hashTable, scene->index.GetEntries(), (SDF_BUCKET_NUM + SDF_EXCESS_LIST_SIZE)*sizeof(FEHashEntry), cudaMemcpyDeviceToHost));
-	FESafeCall(cudaMemcpy(voxels, scene->localVBA.GetVoxelBlocks(), SDF_LOCAL_BLOCK_NUM*SDF_BLOCK_SIZE3*sizeof(FEVoxel), cudaMemcpyDeviceToHost));
+	if (settings->deviceType == FELibSettings::DEVICE_CUDA)
+	{
+		FESafeCall(cudaMemcpy(hashTable, scene->index.GetEntries(), (SDF_BUCKET_NUM + SDF_EXCESS_LIST_SIZE)*sizeof(FEHashEntry), cudaMemcpyDeviceToHost));
+		FESafeCall(cudaMemcpy(voxels, scene->localVBA.GetVoxelBlocks(), scene->localVBA.allocatedSize * sizeof(TVoxel), cudaMemcpyDeviceToHost));
+	}
+	else
+	{
+		memcpy(hashTable, scene->index.GetEntries(), (SDF_BUCKET_NUM + SDF_EXCESS_LIST_SIZE)*sizeof(FEHashEntry));
+		memcpy(voxels, scene->localVBA.GetVoxelBlocks(), scene->localVBA.allocatedSize * sizeof(TVoxel));
+	}
 
 	float mu = scene->sceneParams->mu;
 
@@ -230,9 +346,9 @@ void FusionEngine::getSurfacePoints(std::vector<Vector3f> &points, std::vector<V
 
 		if (hashEntry.ptr >= 0){
 			for (int j = 0; j < SDF_BLOCK_SIZE3; j++){
-				FEVoxel res = voxels[(hashEntry.ptr * SDF_BLOCK_SIZE3) + j];
+				TVoxel res = voxels[(hashEntry.ptr * SDF_BLOCK_SIZE3) + j];
 
-				float value = FEVoxel::SDF_valueToFloat(res.sdf);
+				float value = TVoxel::SDF_valueToFloat(res.sdf);
 				if (value<10 * mu&&value>-10 * mu){ //mu=0.02
 					if (withSDFs){
 						sdf_s.push_back(res.sdf);
@@ -283,7 +399,8 @@ void FusionEngine::getSurfacePoints(std::vector<Vector3f> &points, std::vector<V
 	hashTable = NULL;
 }
 
-void FusionEngine::SaveSurfacePoints(){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::SaveSurfacePoints(){
 	std::vector<Vector3f> points;
 	std::vector<Vector3f> normals;
 	std::vector<short> sdf_s;
@@ -292,19 +409,33 @@ void FusionEngine::SaveSurfacePoints(){
 	PointsIO::savePLYfile("surface_points.ply", points, normals, Vector3u(255, 255, 255));
 }
 
-FEPose FusionEngine::getFreePose(){
+template<class TVoxel, class TIndex>
+FEPose FEBasicEngine<TVoxel, TIndex>::getFreePose(){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	return this->freePose;
 }
 
-void FusionEngine::setFreePose(FEPose &freePose){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::setFreePose(FEPose &freePose){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	this->freePose = freePose;
 }
 
-void FusionEngine::renderFreeView(){
-	//raycast to renderState_freeview for visualisation
-	visualisationEngine->RenderCurrentView(view, freePose.GetM(), renderState_freeview);
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::renderFreeView(){
+	//raycast to renderState_freeview when the UI fetches it, mouse events come faster than the display is refreshed
+	freeViewRequested = true;
 }
 
-void FusionEngine::resetScene(){
+template<class TVoxel, class TIndex>
+void FEBasicEngine<TVoxel, TIndex>::resetScene(){
+	std::lock_guard<std::mutex> lock(sceneMutex);
+
 	denseMapper->ResetScene(scene);
-}
\ No newline at end of file
+}
+
+template class FE::FEBasicEngine<FEVoxel_s, FEVoxelIndex>;
+template class FE::FEBasicEngine<FEVoxel_c, FEVoxelIndex>;
+template class FE::FEBasicEngine<FEVoxel_c_rgb, FEVoxelIndex>;
@@ -15,19 +15,124 @@
 #include "Engine/FEViewBuilder.h"
 #include "Engine/FEDenseMapper.h"
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <vector>
 
 namespace FE
 {
+	/** \brief
+		Main engine of the dense fusion, the voxel type it stores
+		the scene with is chosen per instance by
+		FELibSettings::voxelType, see Make().
+
+		Processing a frame only raycasts the scene when the tracker
+		needs it, the live and free views are raycast when they are
+		fetched with GetImage().
+
+		The UI fetches images on another thread than the one that
+		processes the frames, so the scene, the view and the render
+		states are only used under one mutex and GetImage() waits
+		for the frame being processed.
+		*/
 	class FusionEngine
 	{
+	public:
+		enum GetImageType
+		{
+			IMAGE_ORIGINAL_RGB,
+			IMAGE_ORIGINAL_DEPTH,
+			IMAGE_SCENERAYCAST,
+			IMAGE_FREECAMERA_CAST,
+			IMAGE_UNKNOWN
+		};
+
+		/** \brief Create an engine for the voxel type of @p settings
+		Ommitting a separate image size for the depth images
+		will assume same resolution as for the RGB images.
+		*/
+		static FusionEngine* Make(const FELibSettings *settings, const FERGBDCalib *calib, const Vector2i imgSize_rgb = Vector2i(-1, -1), const Vector2i imgSize_d = Vector2i(-1, -1));
+
+		virtual ~FusionEngine() {}
+
+		/// Gives access to the current input frame
+		virtual FEView* GetView() = 0;
+
+		/// Gives access to the current camera pose and additional tracking information
+		virtual FETrackingState* GetTrackingState(void) = 0;
+
+		/// Process a frame with rgb and depth images and optionally a corresponding imu measurement
+		virtual void ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage) = 0;
+
+		/// Process a frame with rgb and depth images given a specific camera pose
+		virtual void ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const Matrix4f &M_d) = 0;
+
+		/// Process a frame with rgb and depth images given a specific camera pose and frameIndex
+		virtual void ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int index, const Matrix4f &M_d) = 0;
+
+		/// ReIntegration, never raycasts the scene
+		virtual void ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M) = 0;
+
+		/// ReIntegration of a depth image fused from several frames, rawDepthWeight holds the number of frames per pixel
+		virtual void ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, ShortImage *rawDepthWeight, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M) = 0;
+
+		/// Replace the visible list of frame index by the union of the lists of frames firstIndex to lastIndex
+		virtual void MergeVisibleLists(const int index, const int firstIndex, const int lastIndex) = 0;
+
+		// Gives access to the data structure used internally to store any created meshes
+		virtual FEMesh* GetMesh(void) = 0;
+
+		/// Update the internally stored mesh data structure and return a pointer to it
+		virtual FEMesh* UpdateMesh(void) = 0;
+
+		/// Extracts a mesh from the current scene and saves it to the obj file specified by the file name
+		virtual void SaveSceneToMesh(const char *objFileName) = 0;
+
+		/// Get a result image as output
+		virtual Vector2i GetImageSize(void) const = 0;
+
+		virtual void GetImage(UChar4Image *out, GetImageType getImageType, FEPose *pose = NULL, FEIntrinsics *intrinsics = NULL) = 0;
+
+		/// switch for turning intergration on/off
+		virtual void turnOnIntegration() = 0;
+		virtual void turnOffIntegration() = 0;
+
+		/// switch for turning main processing on/off
+		virtual void turnOnMainProcessing() = 0;
+		virtual void turnOffMainProcessing() = 0;
+
+		//save surface points
+		virtual void SaveSurfacePoints() = 0;
+		virtual void getSurfacePoints(std::vector<Vector3f> &points, std::vector<Vector3f> &normals, std::vector<short> &sdf_s, const bool withNormals, const bool withSDFs) = 0;
+
+		//get free pose
+		virtual FEPose getFreePose() = 0;
+
+		//set free pose
+		virtual void setFreePose(FEPose &freePose) = 0;
+
+		//render free view, when it is fetched next
+		virtual void renderFreeView() = 0;
+
+		//resetScene
+		virtual void resetScene() = 0;
+	};
+
+	/** \brief
+		FusionEngine for one voxel type, explicitly instantiated
+		for FEVoxel_s, FEVoxel_c and FEVoxel_c_rgb.
+		*/
+	template<class TVoxel, class TIndex>
+	class FEBasicEngine : public FusionEngine
+	{
 	public:
 		/** \brief Constructor
 		Ommitting a separate image size for the depth images
 		will assume same resolution as for the RGB images.
 		*/
-		FusionEngine(const FELibSettings *settings, const FERGBDCalib *calib, const Vector2i imgSize_rgb = Vector2i(-1, -1), const Vector2i imgSize_d = Vector2i(-1, -1));
-		~FusionEngine();
+		FEBasicEngine(const FELibSettings *settings, const FERGBDCalib *calib, const Vector2i imgSize_rgb = Vector2i(-1, -1), const Vector2i imgSize_d = Vector2i(-1, -1));
+		~FEBasicEngine();
 
 	private:
 		const FELibSettings *settings;
@@ -37,11 +142,11 @@ namespace FE
 		FELowLevelEngine *lowLevelEngine;
 		PFEVisualisationEngine *visualisationEngine;
 
-		FEMeshingEngine<FEVoxel, FEVoxelIndex> *meshingEngine;
+		FEMeshingEngine<TVoxel, TIndex> *meshingEngine;
 		FEMesh *mesh;
 
 		FEViewBuilder *viewBuilder;
-		FEDenseMapper<FEVoxel, FEVoxelIndex> *denseMapper;
+		FEDenseMapper<TVoxel, TIndex> *denseMapper;
 		FETrackingController *trackingController;
 
 		FETracker *tracker;
@@ -49,80 +154,62 @@ namespace FE
 		FEView *view;
 		FETrackingState *trackingState;
 
-		FEScene<FEVoxel, FEVoxelIndex> *scene;
+		FEScene<TVoxel, TIndex> *scene;
 		FERenderState *renderState_live;
 		FERenderState *renderState_freeview;
 
+		/// Number of frames per pixel of a fused depth image, allocated when needed
+		FloatImage *depthWeight;
+
 		FEPose freePose;
 		Matrix4f currentM;
 
-	public:
-		enum GetImageType
-		{
-			IMAGE_ORIGINAL_RGB,
-			IMAGE_ORIGINAL_DEPTH,
-			IMAGE_SCENERAYCAST,
-			IMAGE_FREECAMERA_CAST,
-			IMAGE_UNKNOWN
-		};
+		/// Held while the scene, the view, the render states or the free pose are used
+		std::mutex sceneMutex;
 
-		/// Gives access to the current input frame
+		/// The scene or pose changed since the view was raycast
+		std::atomic<bool> liveViewOutdated, freeViewOutdated;
+
+		/// The free view is raycast on the next fetch, regardless of freeViewRenderInterval
+		std::atomic<bool> freeViewRequested;
+		std::chrono::steady_clock::time_point lastFreeViewRender;
+
+		/// The scene changed, both views are raycast again when fetched
+		void sceneChanged();
+
+	public:
 		FEView* GetView() { return view; }
 
-		/// Gives access to the current camera pose and additional tracking information
 		FETrackingState* GetTrackingState(void) { return trackingState; }
 
 		/// Gives access to the internal world representation
-		FEScene<FEVoxel, FEVoxelIndex>* GetScene(void) { return scene; }
+		FEScene<TVoxel, TIndex>* GetScene(void) { return scene; }
 
-		/// Process a frame with rgb and depth images and optionally a corresponding imu measurement
 		void ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage);
-
-		/// Process a frame with rgb and depth images given a specific camera pose
 		void ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const Matrix4f &M_d);
-
-		/// Process a frame with rgb and depth images given a specific camera pose and frameIndex
 		void ProcessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int index, const Matrix4f &M_d);
-
-		/// ReIntegration
 		void ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M);
+		void ReprocessFrame(UChar4Image *rgbImage, ShortImage *rawDepthImage, ShortImage *rawDepthWeight, const int frameIndex, const Matrix4f &old_M, const Matrix4f &new_M);
+		void MergeVisibleLists(const int index, const int firstIndex, const int lastIndex);
 
-		// Gives access to the data structure used internally to store any created meshes
 		FEMesh* GetMesh(void) { return mesh; }
-
-		/// Update the internally stored mesh data structure and return a pointer to it
 		FEMesh* UpdateMesh(void);
-
-		/// Extracts a mesh from the current scene and saves it to the obj file specified by the file name
 		void SaveSceneToMesh(const char *objFileName);
 
-		/// Get a result image as output
 		Vector2i GetImageSize(void) const;
-
 		void GetImage(UChar4Image *out, GetImageType getImageType, FEPose *pose = NULL, FEIntrinsics *intrinsics = NULL);
 
-		/// switch for turning intergration on/off
 		void turnOnIntegration();
 		void turnOffIntegration();
-
-		/// switch for turning main processing on/off
 		void turnOnMainProcessing();
 		void turnOffMainProcessing();
 
-		//save surface points
 		void SaveSurfacePoints(); 
 		void getSurfacePoints(std::vector<Vector3f> &points, std::vector<Vector3f> &normals, std::vector<short> &sdf_s, const bool withNormals, const bool withSDFs);
-	
-		//get free pose
-		FEPose getFreePose();
 
-	    //set free pose
+		FEPose getFreePose();
 		void setFreePose(FEPose &freePose);
-
-		//render free view
 		void renderFreeView();
-
-		//resetScene
 		void resetScene();
 	};
 }
@@ -0,0 +1,319 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_BLOCKSTORE_H
+#define _FE_BLOCKSTORE_H
+
+#include <string.h>
+#include <unordered_map>
+
+#include "../Utils/FELibDefines.h"
+#include "MappedFile.h"
+
+namespace FE
+{
+	inline long long blockStoreSdfToCode(signed char sdf) { return sdf; }
+	inline long long blockStoreSdfToCode(short sdf) { return sdf; }
+	inline long long blockStoreSdfToCode(float sdf) { int bits; memcpy(&bits, &sdf, sizeof(int)); return bits; }
+	inline void blockStoreSdfFromCode(signed char &sdf, long long code) { sdf = (signed char)code; }
+	inline void blockStoreSdfFromCode(short &sdf, long long code) { sdf = (short)code; }
+	inline void blockStoreSdfFromCode(float &sdf, long long code) { int bits = (int)code; memcpy(&sdf, &bits, sizeof(int)); }
+
+	/** Colour part of the block encoding, stored raw since it only changes where the weight does. */
+	template<bool hasColor, class TVoxel> struct BlockStoreColor;
+
+	template<class TVoxel>
+	struct BlockStoreColor<false, TVoxel> {
+		static bool equal(const TVoxel &a, const TVoxel &b) { return true; }
+		static unsigned char *encode(unsigned char *dst, const TVoxel &voxel) { return dst; }
+		static const unsigned char *decode(const unsigned char *src, TVoxel &voxel) { return src; }
+	};
+
+	template<class TVoxel>
+	struct BlockStoreColor<true, TVoxel> {
+		static bool equal(const TVoxel &a, const TVoxel &b)
+		{
+			return a.clr.x == b.clr.x && a.clr.y == b.clr.y && a.clr.z == b.clr.z && a.w_color == b.w_color;
+		}
+		static unsigned char *encode(unsigned char *dst, const TVoxel &voxel)
+		{
+			*dst++ = voxel.clr.x; *dst++ = voxel.clr.y; *dst++ = voxel.clr.z; *dst++ = voxel.w_color;
+			return dst;
+		}
+		static const unsigned char *decode(const unsigned char *src, TVoxel &voxel)
+		{
+			voxel.clr.x = *src++; voxel.clr.y = *src++; voxel.clr.z = *src++; voxel.w_color = *src++;
+			return src;
+		}
+	};
+
+	/** \brief
+		Persistent store of voxel blocks keyed by their block
+		position, kept in a memory-mapped file so single blocks
+		are read and written without touching the rest of it.
+
+		Blocks are compressed: voxels are visited in memory order
+		and each one is coded as the zigzag varint delta of sdf and
+		weight to the previous voxel, runs of identical voxels as a
+		single token. Blocks that are entirely in their initial
+		state are not stored at all.
+
+		File layout: a FileHeader followed by records, each a
+		RecordHeader and @p capacity bytes of payload. Rewriting a
+		block reuses its record while the payload fits.
+		*/
+	template<class TVoxel>
+	class FEBlockStore
+	{
+	private:
+		struct FileHeader
+		{
+			char magic[4];
+			unsigned int version;
+			unsigned long long end;
+		};
+
+		struct RecordHeader
+		{
+			short x, y, z, pad;
+			/** Bytes reserved for the payload and bytes used, 0 for a block that has been erased. */
+			unsigned int capacity, size;
+		};
+
+		struct Record
+		{
+			unsigned long long offset;
+			unsigned int capacity, size;
+		};
+
+		static const unsigned int recordAlignment = 64;
+		static const size_t minFileSize = 1 << 24;
+
+		/** Upper bound of an encoded block: two 10 byte varints and the colour per voxel. */
+		static const int maxEncodedSize = SDF_BLOCK_SIZE3 * (2 * 10 + 4) + 10;
+
+		Basis::MappedFile file;
+		std::unordered_map<long long, Record> records;
+		unsigned char *encodeBuffer;
+
+		static long long Key(const Vector3s &pos)
+		{
+			return ((long long)(unsigned short)pos.x << 32) | ((long long)(unsigned short)pos.y << 16) | (long long)(unsigned short)pos.z;
+		}
+
+		static unsigned long long Zigzag(long long v) { return ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63); }
+		static long long Unzigzag(unsigned long long v) { return (long long)(v >> 1) ^ -(long long)(v & 1); }
+
+		static unsigned char *PutVarint(unsigned char *dst, unsigned long long v)
+		{
+			while (v >= 0x80) { *dst++ = (unsigned char)(v | 0x80); v >>= 7; }
+			*dst++ = (unsigned char)v;
+			return dst;
+		}
+
+		static const unsigned char *GetVarint(const unsigned char *src, unsigned long long &v)
+		{
+			v = 0;
+			for (int shift = 0;; shift += 7)
+			{
+				unsigned char byte = *src++;
+				v |= (unsigned long long)(byte & 0x7f) << shift;
+				if (byte < 0x80) return src;
+			}
+		}
+
+		static bool Equal(const TVoxel &a, const TVoxel &b)
+		{
+			return a.sdf == b.sdf && a.w_depth == b.w_depth && BlockStoreColor<TVoxel::hasColorInformation, TVoxel>::equal(a, b);
+		}
+
+		/** Encode a block into @p dst, returns the number of bytes, 0 if the block is in its initial state. */
+		static int Encode(unsigned char *dst, const TVoxel *block)
+		{
+			unsigned char *ptr = dst;
+			TVoxel prev;
+			int run = 0;
+			bool isInitial = true;
+
+			for (int vIdx = 0; vIdx < SDF_BLOCK_SIZE3; vIdx++)
+			{
+				const TVoxel &voxel = block[vIdx];
+				if (Equal(voxel, prev)) { run++; continue; }
+
+				isInitial = false;
+				if (run > 0) { ptr = PutVarint(ptr, ((unsigned long long)run << 1) | 1); run = 0; }
+
+				long long sdfDelta = blockStoreSdfToCode(voxel.sdf) - blockStoreSdfToCode(prev.sdf);
+				long long weightDelta = (long long)voxel.w_depth - (long long)prev.w_depth;
+
+				ptr = PutVarint(ptr, Zigzag(sdfDelta) << 1);
+				ptr = PutVarint(ptr, Zigzag(weightDelta));
+				ptr = BlockStoreColor<TVoxel::hasColorInformation, TVoxel>::encode(ptr, voxel);
+
+				prev = voxel;
+			}
+
+			if (isInitial) return 0;
+			if (run > 0) ptr = PutVarint(ptr, ((unsigned long long)run << 1) | 1);
+
+			return (int)(ptr - dst);
+		}
+
+		static void Decode(TVoxel *block, const unsigned char *src)
+		{
+			TVoxel prev;
+			int vIdx = 0;
+
+			while (vIdx < SDF_BLOCK_SIZE3)
+			{
+				unsigned long long token;
+				src = GetVarint(src, token);
+
+				if (token & 1)
+				{
+					for (int i = 0; i < (int)(token >> 1); i++) block[vIdx++] = prev;
+					continue;
+				}
+
+				unsigned long long weightCode;
+				src = GetVarint(src, weightCode);
+
+				TVoxel voxel = prev;
+				blockStoreSdfFromCode(voxel.sdf, blockStoreSdfToCode(prev.sdf) + Unzigzag(token >> 1));
+				voxel.w_depth = (decltype(voxel.w_depth))((long long)prev.w_depth + Unzigzag(weightCode));
+				src = BlockStoreColor<TVoxel::hasColorInformation, TVoxel>::decode(src, voxel);
+
+				block[vIdx++] = voxel;
+				prev = voxel;
+			}
+		}
+
+		FileHeader *GetFileHeader(void) { return (FileHeader*)file.GetData(); }
+		RecordHeader *GetRecordHeader(unsigned long long offset) { return (RecordHeader*)(file.GetData() + offset); }
+
+		void InitFile(void)
+		{
+			file.Resize(minFileSize);
+
+			FileHeader *header = GetFileHeader();
+			memcpy(header->magic, "FEBS", 4);
+			header->version = 1;
+			header->end = sizeof(FileHeader);
+		}
+
+		/** Rebuild the record index of an existing file, later records of a block supersede earlier ones. */
+		void ReadIndex(void)
+		{
+			const FileHeader *header = GetFileHeader();
+			if (memcmp(header->magic, "FEBS", 4) != 0 || header->version != 1) DIEWITHEXCEPTION("Not a voxel block store");
+
+			for (unsigned long long offset = sizeof(FileHeader); offset < header->end;)
+			{
+				const RecordHeader *recordHeader = GetRecordHeader(offset);
+
+				Record record;
+				record.offset = offset;
+				record.capacity = recordHeader->capacity;
+				record.size = recordHeader->size;
+				records[Key(Vector3s(recordHeader->x, recordHeader->y, recordHeader->z))] = record;
+
+				offset += sizeof(RecordHeader) + recordHeader->capacity;
+			}
+		}
+
+	public:
+		/** Open the store in @p fileName, or in a temporary file if NULL. */
+		explicit FEBlockStore(const char *fileName = NULL) : file(fileName)
+		{
+			encodeBuffer = new unsigned char[maxEncodedSize];
+
+			if (file.GetSize() < sizeof(FileHeader)) InitFile();
+			else ReadIndex();
+		}
+
+		~FEBlockStore(void)
+		{
+			delete[] encodeBuffer;
+		}
+
+		/** Remove all blocks, the file keeps its size. */
+		void Clear(void)
+		{
+			records.clear();
+			GetFileHeader()->end = sizeof(FileHeader);
+		}
+
+		/** Store the block at @p pos, replacing an older one. */
+		void Write(const Vector3s &pos, const TVoxel *block)
+		{
+			int size = Encode(encodeBuffer, block);
+			long long key = Key(pos);
+
+			typename std::unordered_map<long long, Record>::iterator it = records.find(key);
+			if (it != records.end() && (unsigned int)size <= it->second.capacity)
+			{
+				Record &record = it->second;
+				record.size = size;
+				GetRecordHeader(record.offset)->size = size;
+				memcpy(file.GetData() + record.offset + sizeof(RecordHeader), encodeBuffer, size);
+				return;
+			}
+
+			if (size == 0) return;
+
+			// the old record is too small, it stays behind as an erased one
+			if (it != records.end()) GetRecordHeader(it->second.offset)->size = 0;
+
+			unsigned int capacity = (size + recordAlignment - 1) / recordAlignment * recordAlignment;
+			unsigned long long offset = GetFileHeader()->end;
+			unsigned long long end = offset + sizeof(RecordHeader) + capacity;
+			if (end > file.GetSize()) file.Resize(file.GetSize() * 2 > end ? file.GetSize() * 2 : (size_t)end);
+
+			RecordHeader *recordHeader = GetRecordHeader(offset);
+			recordHeader->x = pos.x; recordHeader->y = pos.y; recordHeader->z = pos.z; recordHeader->pad = 0;
+			recordHeader->capacity = capacity;
+			recordHeader->size = size;
+			memcpy(file.GetData() + offset + sizeof(RecordHeader), encodeBuffer, size);
+			GetFileHeader()->end = end;
+
+			Record record;
+			record.offset = offset;
+			record.capacity = capacity;
+			record.size = size;
+			records[key] = record;
+		}
+
+		/** Read the block at @p pos into @p block, returns false if
+			no block is stored there, which means it is in its
+			initial state.
+			*/
+		bool Read(const Vector3s &pos, TVoxel *block)
+		{
+			typename std::unordered_map<long long, Record>::const_iterator it = records.find(Key(pos));
+			if (it == records.end() || it->second.size == 0) return false;
+
+			Decode(block, file.GetData() + it->second.offset + sizeof(RecordHeader));
+			return true;
+		}
+
+		bool Contains(const Vector3s &pos) const
+		{
+			typename std::unordered_map<long long, Record>::const_iterator it = records.find(Key(pos));
+			return it != records.end() && it->second.size > 0;
+		}
+
+		/** Drop the block at @p pos, its record is reused when the block is written again. */
+		void Erase(const Vector3s &pos)
+		{
+			typename std::unordered_map<long long, Record>::iterator it = records.find(Key(pos));
+			if (it == records.end() || it->second.size == 0) return;
+
+			it->second.size = 0;
+			GetRecordHeader(it->second.offset)->size = 0;
+		}
+
+		// Suppress the default copy constructor and assignment operator
+		FEBlockStore(const FEBlockStore&);
+		FEBlockStore& operator=(const FEBlockStore&);
+	};
+}
+
+#endif //_FE_BLOCKSTORE_H
@@ -0,0 +1,237 @@
+// Copyright 2014-2015 Isis Innovation Limited and the authors of InfiniTAM
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_GLOBALCACHE_H
+#define _FE_GLOBALCACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../Utils/FELibDefines.h"
+#include "FEBlockStore.h"
+
+namespace FE
+{
+	/** \brief
+		Stores the voxel blocks that have been swapped out of
+		the local voxel block array, addressed by their hash
+		entry. Blocks are kept in a host memory pool first, once
+		the pool is full the oldest ones are written to a
+		compressed FE::FEBlockStore on disk, so the size of a scan
+		is bounded by the disk rather than by the voxel block array.
+
+		The swap state of every hash entry lives in the memory of
+		the scene:
+		- 0 the newest data of the entry is in the global cache, or there is none yet
+		- 1 the newest data of the entry is in the local voxel block array
+		*/
+	template<class TVoxel>
+	class FEGlobalCache
+	{
+	private:
+		MemoryDeviceType memoryType;
+
+		int noTotalEntries, blockSize, noHostBlocks;
+
+		Basis::MemoryBlock<uchar> *swapStates;
+
+		/** Blocks moved in one swap operation, always on the host and also on the device for CUDA. */
+		Basis::MemoryBlock<TVoxel> *transferBlocks;
+		Basis::MemoryBlock<int> *transferEntryIDs;
+		Basis::MemoryBlock<Vector3s> *transferBlockPos;
+		Basis::MemoryBlock<uchar> *hasTransferData;
+
+		/** Host pool: slot of each entry (-1 for none), owner entry and block position of each slot. */
+		TVoxel *hostBlocks;
+		int *hostSlots, *hostSlotOwners;
+		Vector3s *hostSlotPos;
+		std::vector<int> freeHostSlots;
+		int nextEvictedSlot;
+
+		/** Disk tier, keyed by block position. */
+		FEBlockStore<TVoxel> *diskStore;
+
+		/** Make room in the host pool by writing the oldest stored block to disk. */
+		int EvictHostSlot(void)
+		{
+			int slot = nextEvictedSlot;
+			nextEvictedSlot = (nextEvictedSlot + 1) % noHostBlocks;
+
+			diskStore->Write(hostSlotPos[slot], hostBlocks + (size_t)slot * blockSize);
+
+			hostSlots[hostSlotOwners[slot]] = -1;
+			hostSlotOwners[slot] = -1;
+
+			return slot;
+		}
+
+	public:
+		/** The disk tier goes to @p fileName, or to a temporary file if NULL. */
+		FEGlobalCache(MemoryDeviceType memoryType, int noTotalEntries, int blockSize, int noHostBlocks = SDF_HOST_BLOCK_NUM,
+			const char *fileName = NULL)
+		{
+			this->memoryType = memoryType;
+			this->noTotalEntries = noTotalEntries;
+			this->blockSize = blockSize;
+			this->noHostBlocks = noHostBlocks;
+
+			bool useCUDA = memoryType == MEMORYDEVICE_CUDA;
+
+			swapStates = new Basis::MemoryBlock<uchar>(noTotalEntries, memoryType);
+
+			transferBlocks = new Basis::MemoryBlock<TVoxel>(SDF_TRANSFER_BLOCK_NUM * blockSize, true, useCUDA);
+			transferEntryIDs = new Basis::MemoryBlock<int>(SDF_TRANSFER_BLOCK_NUM, true, useCUDA);
+			transferBlockPos = new Basis::MemoryBlock<Vector3s>(SDF_TRANSFER_BLOCK_NUM, true, useCUDA);
+			hasTransferData = new Basis::MemoryBlock<uchar>(SDF_TRANSFER_BLOCK_NUM, true, useCUDA);
+
+			hostBlocks = (TVoxel*)malloc((size_t)noHostBlocks * blockSize * sizeof(TVoxel));
+			hostSlots = new int[noTotalEntries];
+			hostSlotOwners = new int[noHostBlocks];
+			hostSlotPos = new Vector3s[noHostBlocks];
+
+			diskStore = new FEBlockStore<TVoxel>(fileName);
+
+			Reset();
+		}
+
+		~FEGlobalCache(void)
+		{
+			delete swapStates;
+			delete transferBlocks;
+			delete transferEntryIDs;
+			delete transferBlockPos;
+			delete hasTransferData;
+
+			free(hostBlocks);
+			delete[] hostSlots;
+			delete[] hostSlotOwners;
+			delete[] hostSlotPos;
+
+			delete diskStore;
+		}
+
+		/** Forget all stored blocks, the disk store is cleared as well. */
+		void Reset(void)
+		{
+			swapStates->Clear();
+
+			for (int i = 0; i < noTotalEntries; i++) hostSlots[i] = -1;
+			for (int i = 0; i < noHostBlocks; i++) hostSlotOwners[i] = -1;
+
+			freeHostSlots.resize(noHostBlocks);
+			for (int i = 0; i < noHostBlocks; i++) freeHostSlots[i] = noHostBlocks - 1 - i;
+			nextEvictedSlot = 0;
+
+			diskStore->Clear();
+		}
+
+		uchar *GetSwapStates(void) { return swapStates->GetData(memoryType); }
+
+		TVoxel *GetTransferBlocks(MemoryDeviceType type) { return transferBlocks->GetData(type); }
+		int *GetTransferEntryIDs(MemoryDeviceType type) { return transferEntryIDs->GetData(type); }
+		Vector3s *GetTransferBlockPos(MemoryDeviceType type) { return transferBlockPos->GetData(type); }
+		uchar *GetHasTransferData(MemoryDeviceType type) { return hasTransferData->GetData(type); }
+
+		bool HasStoredData(int entryId, const Vector3s &pos) const { return hostSlots[entryId] >= 0 || diskStore->Contains(pos); }
+
+		/** Store a copy of the block of the given entry at @p pos, replacing any older one. */
+		void StoreBlock(int entryId, const Vector3s &pos, const TVoxel *block)
+		{
+			int slot = hostSlots[entryId];
+
+			if (slot < 0)
+			{
+				diskStore->Erase(pos);
+
+				if (!freeHostSlots.empty()) { slot = freeHostSlots.back(); freeHostSlots.pop_back(); }
+				else slot = EvictHostSlot();
+
+				hostSlots[entryId] = slot;
+				hostSlotOwners[slot] = entryId;
+				hostSlotPos[slot] = pos;
+			}
+
+			memcpy(hostBlocks + (size_t)slot * blockSize, block, blockSize * sizeof(TVoxel));
+		}
+
+		/** Copy the stored block of the given entry at @p pos to
+			@p block and release it from the cache. Returns false
+			if nothing is stored for the entry.
+			*/
+		bool LoadBlock(int entryId, const Vector3s &pos, TVoxel *block)
+		{
+			int slot = hostSlots[entryId];
+			if (slot >= 0)
+			{
+				memcpy(block, hostBlocks + (size_t)slot * blockSize, blockSize * sizeof(TVoxel));
+
+				hostSlots[entryId] = -1;
+				hostSlotOwners[slot] = -1;
+				freeHostSlots.push_back(slot);
+				return true;
+			}
+
+			if (!diskStore->Read(pos, block)) return false;
+
+			diskStore->Erase(pos);
+			return true;
+		}
+
+		/** Load the stored blocks of the first @p noBlocks entries of
+			the transfer entry list into the transfer blocks, the
+			entry list and positions are taken from and the blocks
+			are handed to the memory of the scene.
+			*/
+		void ReadTransferBlocks(int noBlocks)
+		{
+			if (noBlocks <= 0) return;
+
+			int *entryIDs = transferEntryIDs->GetData(MEMORYDEVICE_CPU);
+			Vector3s *blockPos = transferBlockPos->GetData(MEMORYDEVICE_CPU);
+			TVoxel *blocks = transferBlocks->GetData(MEMORYDEVICE_CPU);
+			uchar *hasData = hasTransferData->GetData(MEMORYDEVICE_CPU);
+
+			if (memoryType == MEMORYDEVICE_CUDA)
+			{
+				BcudaSafeCall(cudaMemcpy(entryIDs, transferEntryIDs->GetData(MEMORYDEVICE_CUDA), noBlocks * sizeof(int), cudaMemcpyDeviceToHost));
+				BcudaSafeCall(cudaMemcpy(blockPos, transferBlockPos->GetData(MEMORYDEVICE_CUDA), noBlocks * sizeof(Vector3s), cudaMemcpyDeviceToHost));
+			}
+
+			for (int i = 0; i < noBlocks; i++) hasData[i] = LoadBlock(entryIDs[i], blockPos[i], blocks + (size_t)i * blockSize);
+
+			if (memoryType == MEMORYDEVICE_CUDA)
+			{
+				BcudaSafeCall(cudaMemcpy(transferBlocks->GetData(MEMORYDEVICE_CUDA), blocks, (size_t)noBlocks * blockSize * sizeof(TVoxel), cudaMemcpyHostToDevice));
+				BcudaSafeCall(cudaMemcpy(hasTransferData->GetData(MEMORYDEVICE_CUDA), hasData, noBlocks * sizeof(uchar), cudaMemcpyHostToDevice));
+			}
+		}
+
+		/** Store the first @p noBlocks transfer blocks under the
+			entries and positions of the transfer entry list, all
+			taken from the memory of the scene.
+			*/
+		void WriteTransferBlocks(int noBlocks)
+		{
+			if (noBlocks <= 0) return;
+
+			int *entryIDs = transferEntryIDs->GetData(MEMORYDEVICE_CPU);
+			Vector3s *blockPos = transferBlockPos->GetData(MEMORYDEVICE_CPU);
+			TVoxel *blocks = transferBlocks->GetData(MEMORYDEVICE_CPU);
+
+			if (memoryType == MEMORYDEVICE_CUDA)
+			{
+				BcudaSafeCall(cudaMemcpy(entryIDs, transferEntryIDs->GetData(MEMORYDEVICE_CUDA), noBlocks * sizeof(int), cudaMemcpyDeviceToHost));
+				BcudaSafeCall(cudaMemcpy(blockPos, transferBlockPos->GetData(MEMORYDEVICE_CUDA), noBlocks * sizeof(Vector3s), cudaMemcpyDeviceToHost));
+				BcudaSafeCall(cudaMemcpy(blocks, transferBlocks->GetData(MEMORYDEVICE_CUDA), (size_t)noBlocks * blockSize * sizeof(TVoxel), cudaMemcpyDeviceToHost));
+			}
+
+			for (int i = 0; i < noBlocks; i++) StoreBlock(entryIDs[i], blockPos[i], blocks + (size_t)i * blockSize);
+		}
+
+		// Suppress the default copy constructor and assignment operator
+		FEGlobalCache(const FEGlobalCache&);
+		FEGlobalCache& operator=(const FEGlobalCache&);
+	};
+}
+
+#endif //_FE_GLOBALCACHE_H
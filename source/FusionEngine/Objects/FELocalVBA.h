@@ -3,6 +3,7 @@
 #define _FE_LOCALVBA_H
 
 #include <stdlib.h>
+#include <string.h>
 #include "../Utils/FELibDefines.h"
 
 namespace FE
@@ -29,9 +30,15 @@ namespace FE
 
 			int allocatedSize;
 
+			/** Number of voxel blocks currently held by the array. */
+			int noBlocks;
+			int blockSize;
+
 			FELocalVBA(MemoryDeviceType memoryType, int noBlocks, int blockSize)
 			{
 				this->memoryType = memoryType;
+				this->noBlocks = noBlocks;
+				this->blockSize = blockSize;
 
 				allocatedSize = noBlocks * blockSize;
 
@@ -39,6 +46,60 @@ namespace FE
 				allocationList = new Basis::MemoryBlock<int>(noBlocks, memoryType);
 			}
 
+			/** Grow the array to @p newNoBlocks voxel blocks. Allocated
+				blocks keep their index, so the hash table stays valid.
+				The new blocks are reset and appended to the free part
+				of the allocation list. The old buffers are freed, so
+				no other thread may hold pointers into them, the
+				FusionEngine only grows the scene under its scene
+				mutex.
+				*/
+			void Resize(int newNoBlocks)
+			{
+				if (newNoBlocks <= noBlocks) return;
+
+				int noNewBlocks = newNoBlocks - noBlocks;
+				bool useCUDA = memoryType == MEMORYDEVICE_CUDA;
+
+				Basis::MemoryBlock<TVoxel> *newVoxelBlocks = new Basis::MemoryBlock<TVoxel>(newNoBlocks * blockSize, memoryType);
+				newVoxelBlocks->SetFrom(voxelBlocks, useCUDA ? Basis::MemoryBlock<TVoxel>::CUDA_TO_CUDA : Basis::MemoryBlock<TVoxel>::CPU_TO_CPU);
+
+				Basis::MemoryBlock<int> *newAllocationList = new Basis::MemoryBlock<int>(newNoBlocks, memoryType);
+				newAllocationList->SetFrom(allocationList, useCUDA ? Basis::MemoryBlock<int>::CUDA_TO_CUDA : Basis::MemoryBlock<int>::CPU_TO_CPU);
+
+				// reset the new voxel blocks, staged through a small host buffer for the gpu
+				TVoxel *newVoxels = newVoxelBlocks->GetData(memoryType) + allocatedSize;
+				if (useCUDA)
+				{
+					const int stageBlocks = 256;
+					TVoxel *stage = new TVoxel[stageBlocks * blockSize];
+					for (int blockNo = 0; blockNo < noNewBlocks; blockNo += stageBlocks)
+					{
+						int noCopy = (noNewBlocks - blockNo < stageBlocks ? noNewBlocks - blockNo : stageBlocks) * blockSize;
+						BcudaSafeCall(cudaMemcpy(newVoxels + blockNo * blockSize, stage, noCopy * sizeof(TVoxel), cudaMemcpyHostToDevice));
+					}
+					delete[] stage;
+				}
+				else for (int i = 0; i < noNewBlocks * blockSize; i++) newVoxels[i] = TVoxel();
+
+				// free ids live in [0, lastFreeBlockId], the new ones go right after them
+				int *newIds = new int[noNewBlocks];
+				for (int i = 0; i < noNewBlocks; i++) newIds[i] = noBlocks + i;
+				int *freeListEnd = newAllocationList->GetData(memoryType) + lastFreeBlockId + 1;
+				if (useCUDA) BcudaSafeCall(cudaMemcpy(freeListEnd, newIds, noNewBlocks * sizeof(int), cudaMemcpyHostToDevice));
+				else memcpy(freeListEnd, newIds, noNewBlocks * sizeof(int));
+				delete[] newIds;
+
+				delete voxelBlocks;
+				delete allocationList;
+				voxelBlocks = newVoxelBlocks;
+				allocationList = newAllocationList;
+
+				lastFreeBlockId += noNewBlocks;
+				noBlocks = newNoBlocks;
+				allocatedSize = newNoBlocks * blockSize;
+			}
+
 			~FELocalVBA(void)
 			{
 				delete voxelBlocks;
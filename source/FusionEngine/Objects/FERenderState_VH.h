@@ -31,16 +31,16 @@ namespace FE
 		*/
 		Basis::MemoryBlock<uchar> *entriesVisibleType;
 
-		/** A bit list of "visible entries", that are
-		currently being processed by integration
-		and tracker.
+		/** The lists of "visible entries" of all frames,
+		that are processed by reintegration.
 		*/
-		Basis::MemoryBlock<uchar> *visibleList;
+		Basis::VisibleListBlock *bvlb;
 
-		/** A block of list of "visible entries", that are
-		currently being processed by reintegration.
+		/** The stamp of the visible list block each entry
+		was last released at by the garbage collection, kept
+		on the host as well to merge lists.
 		*/
-		BitVisibleListBlock *bvlb;
+		Basis::MemoryBlock<int> *entriesReleaseStamp;
 
 	public:
 		/** Number of entries in the live list. */
@@ -51,12 +51,12 @@ namespace FE
 		{
 			this->memoryType = memoryType;
 
-			visibleEntryIDs = new Basis::MemoryBlock<int>(SDF_LOCAL_BLOCK_NUM, memoryType);
+			visibleEntryIDs = new Basis::MemoryBlock<int>(noTotalEntries, memoryType);
 			entriesVisibleType = new Basis::MemoryBlock<uchar>(noTotalEntries, memoryType);
-			visibleList = new Basis::MemoryBlock<uchar>(noTotalEntries / 8 + 1, memoryType);
+			entriesReleaseStamp = new Basis::MemoryBlock<int>(noTotalEntries, true, memoryType == MEMORYDEVICE_CUDA);
 
 #ifdef USE_VISIBLELIST_BLOCK
-			bvlb = new BitVisibleListBlock(noTotalEntries / 8 + 1, IMAGES_BLOCK_SIZE, MEMORYDEVICE_CPU);
+			bvlb = new Basis::VisibleListBlock();
 #else
 			bvlb = NULL;
 #endif // USE_VISIBLELIST_BLOCK
@@ -68,7 +68,7 @@ namespace FE
 		{
 			delete visibleEntryIDs;
 			delete entriesVisibleType;
-			delete visibleList;
+			delete entriesReleaseStamp;
 			delete bvlb;
 		}
 
@@ -83,12 +83,22 @@ namespace FE
 		*/
 		uchar *GetEntriesVisibleType(void) { return entriesVisibleType->GetData(memoryType); }
 
-		/** A block of list of "visible entries".
+		/** The lists of "visible entries" of all frames.
+		*/
+		Basis::VisibleListBlock *GetVisibleListBlock(void) { return bvlb; }
+
+		/** Get the release stamps of the entries, an entry id
+		is stale in the lists stamped before.
 		*/
-		BitVisibleListBlock *GetVisibleListBlock(void) { return bvlb; }
+		int *GetEntriesReleaseStamp(void) { return entriesReleaseStamp->GetData(memoryType); }
 
-		Basis::MemoryBlock<uchar> *CetVisibleList(void) { return visibleList; }
-		uchar *CetVisibleListPtr(void) { return visibleList->GetData(memoryType); }
+		/** Get the release stamps of the entries on the host.
+		*/
+		const int *GetEntriesReleaseStamp_host(void)
+		{
+			if (memoryType == MEMORYDEVICE_CUDA) entriesReleaseStamp->UpdateHostFromDevice();
+			return entriesReleaseStamp->GetData(MEMORYDEVICE_CPU);
+		}
 	};
 }
 
@@ -6,6 +6,7 @@
 
 #include "FESceneParams.h"
 #include "FELocalVBA.h"
+#include "FEGlobalCache.h"
 
 namespace FE
 {
@@ -17,7 +18,7 @@ namespace FE
 		class FEScene
 		{
 		public:
-			/** Scene parameters like voxel size etc. */
+			/** Scene parameters like voxel size etc., maxW is limited to what the weight of TVoxel can hold. */
 			const FESceneParams *sceneParams;
 
 			/** Hash table to reference the 8x8x8 blocks */
@@ -26,14 +27,27 @@ namespace FE
 			/** Current local content of the 8x8x8 voxel blocks -- stored host or device */
 			FELocalVBA<TVoxel> localVBA;
 
-			FEScene(const FESceneParams *sceneParams, MemoryDeviceType memoryType)
-				: index(memoryType), localVBA(memoryType, index.getNumAllocatedVoxelBlocks(), index.getVoxelBlockSize())
+			/** Whether out of view blocks are swapped out to the global cache. */
+			bool useSwapping;
+
+			/** Swapped out voxel blocks, stored in host memory and on disk -- NULL without swapping */
+			FEGlobalCache<TVoxel> *globalCache;
+
+			FEScene(const FESceneParams *sceneParams, bool useSwapping, MemoryDeviceType memoryType)
+				: index(memoryType), localVBA(memoryType, sceneParams->noVoxelBlocks, index.getVoxelBlockSize())
 			{
-				this->sceneParams = sceneParams;
+				FESceneParams *params = new FESceneParams(sceneParams);
+				params->maxW = params->maxW < TVoxel::W_maxValue() ? params->maxW : TVoxel::W_maxValue();
+				this->sceneParams = params;
+				this->useSwapping = useSwapping;
+				if (useSwapping) globalCache = new FEGlobalCache<TVoxel>(memoryType, index.noTotalEntries, index.getVoxelBlockSize());
+				else globalCache = NULL;
 			}
 
 			~FEScene(void)
 			{
+				if (globalCache != NULL) delete globalCache;
+				delete sceneParams;
 			}
 
 			// Suppress the default copy constructor and assignment operator
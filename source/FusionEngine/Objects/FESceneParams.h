@@ -2,6 +2,8 @@
 #ifndef _FE_SCENEPARAMS_H
 #define _FE_SCENEPARAMS_H
 
+#include "../Utils/FELibDefines.h"
+
 namespace FE
 	{
 		/** \brief
@@ -42,14 +44,27 @@ namespace FE
 			/** Stop integration once maxW has been reached. */
 			bool stopIntegratingAtMaxW;
 
+			/** \brief
+			    Number of voxel blocks allocated when the scene is
+			    created. The voxel block array grows on demand
+			    up to @ref noMaxVoxelBlocks blocks.
+			*/
+			int noVoxelBlocks;
+
+			/** Upper bound for growing the voxel block array. */
+			int noMaxVoxelBlocks;
+
 			FESceneParams(float mu, int maxW, float voxelSize, 
-				float viewFrustum_min, float viewFrustum_max, bool stopIntegratingAtMaxW)
+				float viewFrustum_min, float viewFrustum_max, bool stopIntegratingAtMaxW,
+				int noVoxelBlocks = SDF_INITIAL_BLOCK_NUM, int noMaxVoxelBlocks = SDF_BUCKET_NUM)
 			{
 				this->mu = mu;
 				this->maxW = maxW;
 				this->voxelSize = voxelSize;
 				this->viewFrustum_min = viewFrustum_min; this->viewFrustum_max = viewFrustum_max;
 				this->stopIntegratingAtMaxW = stopIntegratingAtMaxW;
+				this->noVoxelBlocks = noVoxelBlocks;
+				this->noMaxVoxelBlocks = noMaxVoxelBlocks;
 			}
 
 			explicit FESceneParams(const FESceneParams *sceneParams) { this->SetFrom(sceneParams); }
@@ -62,6 +77,8 @@ namespace FE
 				this->mu = sceneParams->mu;
 				this->maxW = sceneParams->maxW;
 				this->stopIntegratingAtMaxW = sceneParams->stopIntegratingAtMaxW;
+				this->noVoxelBlocks = sceneParams->noVoxelBlocks;
+				this->noMaxVoxelBlocks = sceneParams->noMaxVoxelBlocks;
 			}
 		};
 }
@@ -73,8 +73,6 @@ namespace FE
 			int GetLastFreeExcessListId(void) { return lastFreeExcessListId; }
 			void SetLastFreeExcessListId(int lastFreeExcessListId) { this->lastFreeExcessListId = lastFreeExcessListId; }
 
-			/** Maximum number of total entries. */
-			int getNumAllocatedVoxelBlocks(void) { return SDF_LOCAL_BLOCK_NUM; }
 			int getVoxelBlockSize(void) { return SDF_BLOCK_SIZE3; }
 
 			// Suppress the default copy constructor and assignment operator
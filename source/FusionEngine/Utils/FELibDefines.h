@@ -23,10 +23,12 @@
 
 #define SDF_BLOCK_SIZE 8				// SDF block size
 #define SDF_BLOCK_SIZE3 512				// SDF_BLOCK_SIZE3 = SDF_BLOCK_SIZE * SDF_BLOCK_SIZE * SDF_BLOCK_SIZE
-#define SDF_LOCAL_BLOCK_NUM 0x40000		// Number of locally stored blocks, currently 2^17
+#define SDF_LOCAL_BLOCK_NUM 0x40000		// Nominal number of locally stored blocks, used to size the mesh buffer
+#define SDF_INITIAL_BLOCK_NUM 0x10000	// Default number of blocks allocated for a new scene, grown on demand, see FESceneParams
 
 #define SDF_GLOBAL_BLOCK_NUM 0x120000	// Number of globally stored blocks: SDF_BUCKET_NUM + SDF_EXCESS_LIST_SIZE
 #define SDF_TRANSFER_BLOCK_NUM 0x1000	// Maximum number of blocks transfered in one swap operation
+#define SDF_HOST_BLOCK_NUM 0x20000		// Number of swapped out blocks kept in host memory before they are written to disk
 
 #define SDF_BUCKET_NUM 0x100000			// Number of Hash Bucket, should be 2^n and bigger than SDF_LOCAL_BLOCK_NUM, SDF_HASH_MASK = SDF_BUCKET_NUM - 1
 #define SDF_HASH_MASK 0xfffff			// Used for get hashing value of the bucket index,  SDF_HASH_MASK = SDF_BUCKET_NUM - 1
@@ -61,6 +63,7 @@ struct FEVoxel_f_rgb
 	_CPU_AND_GPU_CODE_ static float SDF_initialValue() { return 1.0f; }
 	_CPU_AND_GPU_CODE_ static float SDF_valueToFloat(float x) { return x; }
 	_CPU_AND_GPU_CODE_ static float SDF_floatToValue(float x) { return x; }
+	_CPU_AND_GPU_CODE_ static int W_maxValue() { return 255; }
 
 	static const CONSTPTR(bool) hasColorInformation = true;
 
@@ -87,6 +90,7 @@ struct FEVoxel_s_rgb
 	_CPU_AND_GPU_CODE_ static short SDF_initialValue() { return 32767; }
 	_CPU_AND_GPU_CODE_ static float SDF_valueToFloat(float x) { return (float)(x) / 32767.0f; }
 	_CPU_AND_GPU_CODE_ static short SDF_floatToValue(float x) { return (short)((x) * 32767.0f); }
+	_CPU_AND_GPU_CODE_ static int W_maxValue() { return 255; }
 
 	static const CONSTPTR(bool) hasColorInformation = true;
 
@@ -115,6 +119,7 @@ struct FEVoxel_s
 	_CPU_AND_GPU_CODE_ static short SDF_initialValue() { return 32767; }
 	_CPU_AND_GPU_CODE_ static float SDF_valueToFloat(float x) { return (float)(x) / 32767.0f; }
 	_CPU_AND_GPU_CODE_ static short SDF_floatToValue(float x) { return (short)((x) * 32767.0f); }
+	_CPU_AND_GPU_CODE_ static int W_maxValue() { return 32767; }
 
 	static const CONSTPTR(bool) hasColorInformation = false;
 
@@ -143,6 +148,7 @@ struct FEVoxel_f
 	_CPU_AND_GPU_CODE_ static float SDF_initialValue() { return 1.0f; }
 	_CPU_AND_GPU_CODE_ static float SDF_valueToFloat(float x) { return x; }
 	_CPU_AND_GPU_CODE_ static float SDF_floatToValue(float x) { return x; }
+	_CPU_AND_GPU_CODE_ static int W_maxValue() { return 255; }
 
 	static const CONSTPTR(bool) hasColorInformation = false;
 
@@ -160,8 +166,75 @@ struct FEVoxel_f
 	}
 };
 
-/** This chooses the information stored at each voxel. At the moment, valid
-    options are FEVoxel_s, FEVoxel_f, FEVoxel_s_rgb and FEVoxel_f_rgb 
+/** Compact voxel, the sdf is quantised to 8 bits. Holds 2 bytes, half the
+    size of FEVoxel_s, at the cost of a coarser surface.
+*/
+struct FEVoxel_c
+{
+	_CPU_AND_GPU_CODE_ static signed char SDF_initialValue() { return 127; }
+	_CPU_AND_GPU_CODE_ static float SDF_valueToFloat(float x) { return (float)(x) / 127.0f; }
+	_CPU_AND_GPU_CODE_ static signed char SDF_floatToValue(float x) { return (signed char)((x) * 127.0f + ((x) < 0.0f ? -0.5f : 0.5f)); }
+	_CPU_AND_GPU_CODE_ static int W_maxValue() { return 255; }
+
+	static const CONSTPTR(bool) hasColorInformation = false;
+
+	/** Value of the truncated signed distance transformation, rounded
+	    to the nearest step, as truncation would stop the running
+	    average from moving once the weight is large. */
+	signed char sdf;
+	/** Number of fused observations that make up @p sdf. */
+	uchar w_depth;
+
+	_CPU_AND_GPU_CODE_ FEVoxel_c()
+	{
+		sdf = SDF_initialValue();
+		w_depth = 0;
+	}
+
+	_CPU_AND_GPU_CODE_ void resetValue(){
+		sdf = SDF_initialValue();
+		w_depth = 0;
+	}
+};
+
+/** FEVoxel_c with colour, 6 bytes. */
+struct FEVoxel_c_rgb
+{
+	_CPU_AND_GPU_CODE_ static signed char SDF_initialValue() { return 127; }
+	_CPU_AND_GPU_CODE_ static float SDF_valueToFloat(float x) { return (float)(x) / 127.0f; }
+	_CPU_AND_GPU_CODE_ static signed char SDF_floatToValue(float x) { return (signed char)((x) * 127.0f + ((x) < 0.0f ? -0.5f : 0.5f)); }
+	_CPU_AND_GPU_CODE_ static int W_maxValue() { return 255; }
+
+	static const CONSTPTR(bool) hasColorInformation = true;
+
+	/** Value of the truncated signed distance transformation. */
+	signed char sdf;
+	/** Number of fused observations that make up @p sdf. */
+	uchar w_depth;
+	/** RGB colour information stored for this voxel. */
+	Vector3u clr;
+	/** Number of observations that made up @p clr. */
+	uchar w_color;
+
+	_CPU_AND_GPU_CODE_ FEVoxel_c_rgb()
+	{
+		sdf = SDF_initialValue();
+		w_depth = 0;
+		clr = (uchar)0;
+		w_color = 0;
+	}
+
+	_CPU_AND_GPU_CODE_ void resetValue(){
+		sdf = SDF_initialValue();
+		w_depth = 0;
+		clr = (uchar)0;
+		w_color = 0;
+	}
+};
+
+/** The information stored at each voxel is chosen per engine by
+    FELibSettings::voxelType, the engines are instantiated for
+    FEVoxel_s, FEVoxel_c and FEVoxel_c_rgb. FEVoxel is the default.
 */
 typedef FEVoxel_s FEVoxel;
 
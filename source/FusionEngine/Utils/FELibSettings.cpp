@@ -27,9 +27,31 @@ FELibSettings::FELibSettings(void)
 
 	trackerType = TRACKER_ICP;
 
+	/// VOXEL_CHAR halves the voxel memory (2 instead of 4 bytes) with a coarser sdf, VOXEL_CHAR_RGB adds colour at 6 bytes, 1.5 times VOXEL_SHORT
+	voxelType = VOXEL_SHORT;
+
 	/// model the sensor noise as  the weight for weighted ICP
 	modelSensorNoise = false;
 
+	/// swap out of view voxel blocks to host memory and disk, scenes then grow beyond the voxel block array
+	useSwapping = false;
+
+	/// release the voxel blocks that hold no surface any more, the whole hash table is visited every 128 frames
+	noGarbageCollectionBuckets = 0x2000;
+
+	/// after a loop closure the corrected frames are reintegrated alongside the live frames, the largest corrections first
+	reintegrationBudget = 15.0f;
+
+	/// corrections smaller than a voxel do not change the surface
+	minReintegrationDelta = sceneParams.voxelSize;
+
+	/// frames are dropped from the depth history once they are fused into the super-frame of their keyframe, a correction then reintegrates the super-frame
+	useSuperFrames = false;
+	superFrameSize = 16;
+
+	/// the views are only raycast when the UI fetches them, a free view following the fusion is refreshed at display rate
+	freeViewRenderInterval = 1000.0f / 30.0f;
+
 	{
 		noHierarchyLevels = 5;
 		trackingRegime = new TrackerIterationType[noHierarchyLevels];
@@ -25,6 +25,40 @@ namespace FE
 
 		bool modelSensorNoise;
 
+		/// Enables swapping of out of view voxel blocks to host memory and disk
+		bool useSwapping;
+
+		/// Number of hash buckets checked for empty voxel blocks after each frame, 0 disables the garbage collection
+		int noGarbageCollectionBuckets;
+
+		/// Time in milliseconds spent on reintegrating frames with corrected poses after each live frame
+		float reintegrationBudget;
+
+		/// Frames whose corrected pose moves the surface by less than this distance in metres are not reintegrated
+		float minReintegrationDelta;
+
+		/// Keeps only the depth of the keyframes and of super-frames fused from their frames for the reintegration
+		bool useSuperFrames;
+
+		/// Maximum number of frames fused into one super-frame
+		int superFrameSize;
+
+		/// Minimum time in milliseconds between raycasts of the free view while only the scene changes
+		float freeViewRenderInterval;
+
+		/// Voxel types
+		typedef enum {
+			//! FEVoxel_s, 16 bit sdf and weight
+			VOXEL_SHORT,
+			//! FEVoxel_c, 8 bit sdf and weight
+			VOXEL_CHAR,
+			//! FEVoxel_c_rgb, FEVoxel_c with colour
+			VOXEL_CHAR_RGB
+		} VoxelType;
+
+		/// Select the information stored at each voxel
+		VoxelType voxelType;
+
 		/// Tracker types
 		typedef enum {
 			//! Identifies a tracker based on colour image
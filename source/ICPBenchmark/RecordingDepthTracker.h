@@ -0,0 +1,95 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _FE_RECORDINGDEPTHTRACKER_H
+#define _FE_RECORDINGDEPTHTRACKER_H
+
+#include <chrono>
+#include <vector>
+
+#include "Utils/FELibSettings.h"
+#include "Engine/FEDepthTracker.h"
+
+namespace FE
+{
+	/// One evaluation of the ICP error function, nabla and hessian are divided by the number of valid points
+	struct ICPIteration
+	{
+		int levelId;
+		int noPara;
+		int noValidPoints;
+		Matrix4f approxInvPose;
+		float f;
+		float nabla[6];
+		float hessian[6 * 6];
+
+		/// Milliseconds spent in ComputeGandH
+		float time;
+	};
+
+	/** \brief
+		Depth tracker that records and times every ICP iteration
+		of TTracker.
+
+		If replay holds the iterations of another tracker on the
+		same view and scene, the k-th iteration of a level is
+		evaluated at the pose of the k-th iteration of that level
+		in replay, so both trackers can be compared iteration by
+		iteration.
+		*/
+	template<class TTracker>
+	class RecordingDepthTracker : public TTracker
+	{
+	public:
+		std::vector<ICPIteration> iterations;
+		const std::vector<ICPIteration> *replay;
+
+		RecordingDepthTracker(Vector2i imgSize, const FELibSettings *settings, const FELowLevelEngine *lowLevelEngine)
+			: TTracker(imgSize, settings->trackingRegime, settings->noHierarchyLevels, settings->noICPRunTillLevel,
+			settings->depthTrackerICPThreshold, settings->depthTrackerTerminationThreshold, lowLevelEngine)
+		{
+			replay = NULL;
+		}
+
+	protected:
+		int ComputeGandH(float &f, float *nabla, float *hessian, Matrix4f approxInvPose)
+		{
+			size_t iterNo = 0;
+			for (size_t i = 0; i < iterations.size(); i++) if (iterations[i].levelId == this->levelId) iterNo++;
+
+			if (replay != NULL)
+			{
+				for (size_t i = 0, levelIterNo = 0; i < replay->size(); i++)
+				{
+					if ((*replay)[i].levelId != this->levelId) continue;
+					if (levelIterNo++ == iterNo) { approxInvPose = (*replay)[i].approxInvPose; break; }
+				}
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int noValidPoints = TTracker::ComputeGandH(f, nabla, hessian, approxInvPose);
+			float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			ICPIteration iteration;
+			iteration.levelId = this->levelId;
+			iteration.noPara = this->iterationType == TRACKER_ITERATION_BOTH ? 6 : 3;
+			iteration.noValidPoints = noValidPoints;
+			iteration.approxInvPose = approxInvPose;
+			iteration.f = f;
+			iteration.time = time;
+
+			// only the first noPara rows and columns are written by ComputeGandH
+			float scale = noValidPoints > 0 ? 1.0f / noValidPoints : 0.0f;
+			for (int r = 0; r < 6; r++)
+			{
+				iteration.nabla[r] = r < iteration.noPara ? nabla[r] * scale : 0.0f;
+				for (int c = 0; c < 6; c++)
+					iteration.hessian[r + c * 6] = (r < iteration.noPara && c < iteration.noPara) ? hessian[r + c * 6] * scale : 0.0f;
+			}
+
+			iterations.push_back(iteration);
+
+			return noValidPoints;
+		}
+	};
+}
+
+#endif //_FE_RECORDINGDEPTHTRACKER_H
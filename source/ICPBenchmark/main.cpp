@@ -0,0 +1,178 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+//
+// Fuses the first frames of a TUM sequence with the CUDA engine, then tracks the next frame
+// with the CUDA and the CPU ICP trackers against that scene. Reports the time of each ICP
+// iteration per level and checks that the CPU and CUDA hessian, nabla and residual agree.
+//
+// Usage: ICPBenchmark <sequence folder> <settings file> [scene frames] [tolerance]
+
+#include <opencv2/core/core.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+#include "FileReaderEngine.h"
+#include "FusionEngine.h"
+#include "Engine/CPU/FELowLevelEngine_CPU.h"
+#include "Engine/CPU/FEDepthTracker_CPU.h"
+#include "Engine/CUDA/FELowLevelEngine_CUDA.h"
+#include "Engine/CUDA/FEDepthTracker_CUDA.h"
+#include "Engine/CUDA/FEViewBuilder_CUDA.h"
+#include "RecordingDepthTracker.h"
+
+using namespace std;
+using namespace FE;
+
+/// Largest difference of a and b relative to the largest magnitude in b
+static float relativeError(const float *a, const float *b, int n)
+{
+	float maxDiff = 0.0f, maxValue = 0.0f;
+	for (int i = 0; i < n; i++)
+	{
+		maxDiff = max(maxDiff, fabsf(a[i] - b[i]));
+		maxValue = max(maxValue, fabsf(b[i]));
+	}
+	return maxValue > 0.0f ? maxDiff / maxValue : maxDiff;
+}
+
+/// Iterations of one level, in the order they were run
+static vector<const ICPIteration*> levelIterations(const vector<ICPIteration> &iterations, int levelId)
+{
+	vector<const ICPIteration*> result;
+	for (size_t i = 0; i < iterations.size(); i++)
+		if (iterations[i].levelId == levelId) result.push_back(&iterations[i]);
+	return result;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "Usage: ICPBenchmark <sequence folder> <settings file> [scene frames] [tolerance]" << endl;
+		return 1;
+	}
+
+	string sequencePath = argv[1];
+	int noSceneFrames = argc > 3 ? atoi(argv[3]) : 10;
+	float tolerance = argc > 4 ? (float)atof(argv[4]) : 1e-3f;
+
+	cv::FileStorage fSettings(argv[2], cv::FileStorage::READ);
+	if (!fSettings.isOpened())
+	{
+		cerr << "Failed to open settings file at: " << argv[2] << endl;
+		return 1;
+	}
+	int width = fSettings["Camera.width"];
+	int height = fSettings["Camera.height"];
+	FERGBDCalib calib;
+	calib.intrinsics_d.SetFrom(fSettings["Camera.fx"], fSettings["Camera.fy"], fSettings["Camera.cx"], fSettings["Camera.cy"]);
+	fSettings.release();
+
+	FileReaderEngine dataEngine(sequencePath, sequencePath, sequencePath + "/associations.txt", width, height);
+
+	// the scene is fused on the GPU, the CPU tracker gets a host copy of its point cloud
+	FELibSettings settings;
+	settings.deviceType = FELibSettings::DEVICE_CUDA;
+	FusionEngine *fusionEngine = FusionEngine::Make(&settings, &calib, dataEngine.getRGBImageSize(), dataEngine.getDepthImageSize());
+
+	for (int i = 0; i <= noSceneFrames; i++)
+	{
+		if (!dataEngine.hasMoreImages() || !dataEngine.getNewImages())
+		{
+			cerr << "The sequence has less than " << noSceneFrames + 1 << " frames" << endl;
+			delete fusionEngine;
+			return 1;
+		}
+		if (i < noSceneFrames) fusionEngine->ProcessFrame(dataEngine.getCurrentRgbImage(), dataEngine.getCurrentDepthImage());
+	}
+
+	FEViewBuilder_CUDA viewBuilder(&calib);
+	FEView *view = NULL;
+	viewBuilder.UpdateView(&view, dataEngine.getCurrentRgbImage(), dataEngine.getCurrentDepthImage(), settings.useBilateralFilter, settings.modelSensorNoise);
+	view->depth->UpdateHostFromDevice();
+
+	Vector2i trackedImageSize = FETrackingController::GetTrackedImageSize(&settings, dataEngine.getRGBImageSize(), dataEngine.getDepthImageSize());
+
+	FETrackingState *trackingState_cuda = fusionEngine->GetTrackingState();
+	FETrackingState trackingState_cpu(trackedImageSize, MEMORYDEVICE_CPU);
+	trackingState_cpu.pointCloud->locations->SetFrom(trackingState_cuda->pointCloud->locations, Basis::MemoryBlock<Vector4f>::CUDA_TO_CPU);
+	trackingState_cpu.pointCloud->colours->SetFrom(trackingState_cuda->pointCloud->colours, Basis::MemoryBlock<Vector4f>::CUDA_TO_CPU);
+	trackingState_cpu.pose_pointCloud->SetFrom(trackingState_cuda->pose_pointCloud);
+
+	// both trackers start from the pose of the last fused frame
+	FEPose initialPose(*(trackingState_cuda->pose_d));
+
+	FELowLevelEngine_CUDA lowLevelEngine_cuda;
+	FELowLevelEngine_CPU lowLevelEngine_cpu;
+	RecordingDepthTracker<FEDepthTracker_CUDA> tracker_cuda(trackedImageSize, &settings, &lowLevelEngine_cuda);
+	RecordingDepthTracker<FEDepthTracker_CPU> tracker_cpu(trackedImageSize, &settings, &lowLevelEngine_cpu);
+	tracker_cpu.replay = &tracker_cuda.iterations;
+
+	// the first run warms up the caches and the CUDA context, only the second one is reported
+	for (int run = 0; run < 2; run++)
+	{
+		tracker_cuda.iterations.clear();
+		trackingState_cuda->pose_d->SetFrom(&initialPose);
+		tracker_cuda.TrackCamera(trackingState_cuda, view);
+
+		tracker_cpu.iterations.clear();
+		trackingState_cpu.pose_d->SetFrom(&initialPose);
+		tracker_cpu.TrackCamera(&trackingState_cpu, view);
+	}
+
+	int noCompared = 0, noMismatches = 0;
+
+	cout << fixed << setprecision(3);
+	cout << "level  iter  points(CPU/CUDA)    CPU(ms)  CUDA(ms)   err f    err nabla  err hessian" << endl;
+
+	for (int levelId = settings.noHierarchyLevels - 1; levelId >= 0; levelId--)
+	{
+		vector<const ICPIteration*> iterations_cuda = levelIterations(tracker_cuda.iterations, levelId);
+		vector<const ICPIteration*> iterations_cpu = levelIterations(tracker_cpu.iterations, levelId);
+		if (iterations_cuda.empty() && iterations_cpu.empty()) continue;
+
+		float time_cpu = 0.0f, time_cuda = 0.0f;
+		for (size_t i = 0; i < iterations_cpu.size(); i++) time_cpu += iterations_cpu[i]->time;
+		for (size_t i = 0; i < iterations_cuda.size(); i++) time_cuda += iterations_cuda[i]->time;
+
+		// the CPU tracker may converge an iteration earlier or later, only the common ones were run at the same poses
+		size_t noIterations = min(iterations_cpu.size(), iterations_cuda.size());
+		for (size_t i = 0; i < noIterations; i++)
+		{
+			const ICPIteration &cpu = *iterations_cpu[i], &cuda = *iterations_cuda[i];
+
+			float err_f = relativeError(&cpu.f, &cuda.f, 1);
+			float err_nabla = relativeError(cpu.nabla, cuda.nabla, 6);
+			float err_hessian = relativeError(cpu.hessian, cuda.hessian, 6 * 6);
+			float points_cpu = (float)cpu.noValidPoints, points_cuda = (float)cuda.noValidPoints;
+			float err_points = relativeError(&points_cpu, &points_cuda, 1);
+
+			bool agree = err_f <= tolerance && err_nabla <= tolerance && err_hessian <= tolerance && err_points <= tolerance;
+			noCompared++;
+			if (!agree) noMismatches++;
+
+			cout << setw(5) << levelId << setw(6) << i << setw(9) << cpu.noValidPoints << "/" << setw(9) << cuda.noValidPoints
+				<< setw(10) << cpu.time << setw(10) << cuda.time << scientific << setprecision(2)
+				<< setw(10) << err_f << setw(11) << err_nabla << setw(13) << err_hessian << fixed << setprecision(3)
+				<< (agree ? "" : "  <- differs") << endl;
+		}
+
+		cout << "level " << levelId << ": " << iterations_cpu.size() << " CPU and " << iterations_cuda.size()
+			<< " CUDA iterations, mean per iteration CPU " << time_cpu / max((int)iterations_cpu.size(), 1)
+			<< " ms, CUDA " << time_cuda / max((int)iterations_cuda.size(), 1) << " ms" << endl;
+	}
+
+	cout << endl << "iterations compared: " << noCompared << ", outside tolerance " << scientific << tolerance << fixed
+		<< ": " << noMismatches << endl;
+
+	trackingState_cuda->pose_d->SetFrom(&initialPose);
+	delete view;
+	delete fusionEngine;
+
+	return noMismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,350 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Ral Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <vector>
+#include <chrono>
+
+#include "ORBextractorReference.h"
+
+
+using namespace cv;
+using namespace std;
+
+namespace SLAMRecon {
+
+	const int PATCH_SIZE = 31;
+	const int HALF_PATCH_SIZE = 15;
+	const int EDGE_THRESHOLD = 19;
+
+
+	static double ElapsedMs(const chrono::steady_clock::time_point &start)
+	{
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+
+	static float IC_Angle(const Mat& image, Point2f pt, const vector<int> & u_max)
+	{
+		int m_01 = 0, m_10 = 0;
+
+		const uchar* center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+
+		// Treat the center line differently, v=0
+		for (int u = -HALF_PATCH_SIZE; u <= HALF_PATCH_SIZE; ++u)
+			m_10 += u * center[u];
+
+		// Go line by line in the circuI853lar patch
+		int step = (int)image.step1();
+		for (int v = 1; v <= HALF_PATCH_SIZE; ++v)
+		{
+			// Proceed over the two lines
+			int v_sum = 0;
+			int d = u_max[v];
+			for (int u = -d; u <= d; ++u)
+			{
+				int val_plus = center[u + v*step], val_minus = center[u - v*step];
+				v_sum += (val_plus - val_minus);
+				m_10 += u * (val_plus + val_minus);
+			}
+			m_01 += v * v_sum;
+		}
+
+		return fastAtan2((float)m_01, (float)m_10);
+	}
+
+
+	const float factorPI = (float)(CV_PI / 180.f);
+	static void computeOrbDescriptor(const KeyPoint& kpt,
+		const Mat& img, const Point* pattern,
+		uchar* desc)
+	{
+		float angle = (float)kpt.angle*factorPI;
+		float a = (float)cos(angle), b = (float)sin(angle);
+
+		const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+		const int step = (int)img.step;
+
+#define GET_VALUE(idx) \
+    center[cvRound(pattern[idx].x*b + pattern[idx].y*a)*step + \
+            cvRound(pattern[idx].x*a - pattern[idx].y*b)]
+
+
+		for (int i = 0; i < 32; ++i, pattern += 16)
+		{
+			int t0, t1, val;
+			t0 = GET_VALUE(0); t1 = GET_VALUE(1);
+			val = t0 < t1;
+			t0 = GET_VALUE(2); t1 = GET_VALUE(3);
+			val |= (t0 < t1) << 1;
+			t0 = GET_VALUE(4); t1 = GET_VALUE(5);
+			val |= (t0 < t1) << 2;
+			t0 = GET_VALUE(6); t1 = GET_VALUE(7);
+			val |= (t0 < t1) << 3;
+			t0 = GET_VALUE(8); t1 = GET_VALUE(9);
+			val |= (t0 < t1) << 4;
+			t0 = GET_VALUE(10); t1 = GET_VALUE(11);
+			val |= (t0 < t1) << 5;
+			t0 = GET_VALUE(12); t1 = GET_VALUE(13);
+			val |= (t0 < t1) << 6;
+			t0 = GET_VALUE(14); t1 = GET_VALUE(15);
+			val |= (t0 < t1) << 7;
+
+			desc[i] = (uchar)val;
+		}
+
+#undef GET_VALUE
+	}
+
+	static void computeOrientation(const Mat& image, vector<KeyPoint>& keypoints, const vector<int>& umax)
+	{
+		for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
+			keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
+		{
+			keypoint->angle = IC_Angle(image, keypoint->pt, umax);
+		}
+	}
+
+	static void computeDescriptors(const Mat& image, vector<KeyPoint>& keypoints, Mat& descriptors,
+		const vector<Point>& pattern)
+	{
+		descriptors = Mat::zeros((int)keypoints.size(), 32, CV_8UC1);
+
+		for (size_t i = 0; i < keypoints.size(); i++)
+			computeOrbDescriptor(keypoints[i], image, &pattern[0], descriptors.ptr((int)i));
+	}
+
+	ORBextractorReference::ORBextractorReference(int _nfeatures, float _scaleFactor, int _nlevels,
+		int _iniThFAST, int _minThFAST) :
+		ORBextractor(_nfeatures, _scaleFactor, _nlevels, _iniThFAST, _minThFAST)
+	{
+	}
+
+	void ORBextractorReference::ComputeKeyPointsReference(vector<vector<KeyPoint> >& allKeypoints)
+	{
+		allKeypoints.resize(nlevels);
+
+		const float W = 30;
+
+		// FAST cells of all levels, detected in parallel.
+		struct FASTCell
+		{
+			int level;
+			int iniY, maxY, iniX, maxX;
+			int offsetX, offsetY;
+		};
+
+		vector<FASTCell> vCells;
+		vector<int> vFirstCells(nlevels + 1);
+
+		for (int level = 0; level < nlevels; ++level)
+		{
+			vFirstCells[level] = (int)vCells.size();
+
+			const int minBorderX = EDGE_THRESHOLD - 3;
+			const int minBorderY = minBorderX;
+			const int maxBorderX = mvImagePyramid[level].cols - EDGE_THRESHOLD + 3;
+			const int maxBorderY = mvImagePyramid[level].rows - EDGE_THRESHOLD + 3;
+
+			const float width = (maxBorderX - minBorderX);
+			const float height = (maxBorderY - minBorderY);
+
+			const int nCols = width / W;
+			const int nRows = height / W;
+			const int wCell = ceil(width / nCols);
+			const int hCell = ceil(height / nRows);
+
+			for (int i = 0; i < nRows; i++)
+			{
+				const float iniY = minBorderY + i*hCell;
+				float maxY = iniY + hCell + 6;
+
+				if (iniY >= maxBorderY - 3)
+					continue;
+				if (maxY > maxBorderY)
+					maxY = maxBorderY;
+
+				for (int j = 0; j < nCols; j++)
+				{
+					const float iniX = minBorderX + j*wCell;
+					float maxX = iniX + wCell + 6;
+					if (iniX >= maxBorderX - 6)
+						continue;
+					if (maxX > maxBorderX)
+						maxX = maxBorderX;
+
+					FASTCell cell;
+					cell.level = level;
+					cell.iniY = iniY;
+					cell.maxY = maxY;
+					cell.iniX = iniX;
+					cell.maxX = maxX;
+					cell.offsetX = j*wCell;
+					cell.offsetY = i*hCell;
+					vCells.push_back(cell);
+				}
+			}
+		}
+		vFirstCells[nlevels] = (int)vCells.size();
+
+		vector<vector<cv::KeyPoint> > vCellKeys(vCells.size());
+		vector<double> vCellTimes(vCells.size());
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int c = 0; c < (int)vCells.size(); c++)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			const FASTCell &cell = vCells[c];
+			const Mat cellImage = mvImagePyramid[cell.level].rowRange(cell.iniY, cell.maxY).colRange(cell.iniX, cell.maxX);
+
+			vector<cv::KeyPoint> &vKeysCell = vCellKeys[c];
+			FAST(cellImage, vKeysCell, iniThFAST, true);
+
+			if (vKeysCell.empty())
+			{
+				FAST(cellImage, vKeysCell, minThFAST, true);
+			}
+
+			for (vector<cv::KeyPoint>::iterator vit = vKeysCell.begin(); vit != vKeysCell.end(); vit++)
+			{
+				(*vit).pt.x += cell.offsetX;
+				(*vit).pt.y += cell.offsetY;
+			}
+			vCellTimes[c] = ElapsedMs(start);
+		}
+
+		// The cells of a level are gathered in order, so the keypoints do not depend on the number of threads.
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int level = 0; level < nlevels; ++level)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			const int minBorderX = EDGE_THRESHOLD - 3;
+			const int minBorderY = minBorderX;
+			const int maxBorderX = mvImagePyramid[level].cols - EDGE_THRESHOLD + 3;
+			const int maxBorderY = mvImagePyramid[level].rows - EDGE_THRESHOLD + 3;
+
+			vector<cv::KeyPoint> vToDistributeKeys;
+			vToDistributeKeys.reserve(nfeatures * 10);
+
+			for (int c = vFirstCells[level]; c < vFirstCells[level + 1]; c++)
+				vToDistributeKeys.insert(vToDistributeKeys.end(), vCellKeys[c].begin(), vCellKeys[c].end());
+
+			vector<KeyPoint> & keypoints = allKeypoints[level];
+			keypoints.reserve(nfeatures);
+
+			keypoints = DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX,
+				minBorderY, maxBorderY, mnFeaturesPerLevel[level], level);
+
+			const int scaledPatchSize = PATCH_SIZE*mvScaleFactor[level];
+
+			// Add border to coordinates and scale information
+			const int nkps = keypoints.size();
+			for (int i = 0; i < nkps; i++)
+			{
+				keypoints[i].pt.x += minBorderX;
+				keypoints[i].pt.y += minBorderY;
+				keypoints[i].octave = level;
+				keypoints[i].size = scaledPatchSize;
+			}
+
+			// compute orientations
+			computeOrientation(mvImagePyramid[level], keypoints, umax);
+
+			mvLevelTimes[level] += ElapsedMs(start);
+			for (int c = vFirstCells[level]; c < vFirstCells[level + 1]; c++)
+				mvLevelTimes[level] += vCellTimes[c];
+		}
+	}
+
+	void ORBextractorReference::detectReference(const Mat &image, vector<KeyPoint>& _keypoints,
+		Mat &_descriptors)
+	{
+		if (image.empty())
+			return;
+
+		assert(image.type() == CV_8UC1);
+
+		// Pre-compute the scale pyramid
+		ComputePyramid(image);
+
+		vector < vector<KeyPoint> > allKeypoints;
+		mvLevelTimes.assign(nlevels, 0.0);
+		ComputeKeyPointsReference(allKeypoints);
+
+		Mat descriptors;
+
+		// The descriptor rows of each level are known up front, so the levels are described in parallel.
+		vector<int> vLevelOffsets(nlevels + 1, 0);
+		for (int level = 0; level < nlevels; ++level)
+			vLevelOffsets[level + 1] = vLevelOffsets[level] + (int)allKeypoints[level].size();
+
+		int nkeypoints = vLevelOffsets[nlevels];
+		if (nkeypoints == 0)
+			_descriptors.release();
+		else
+		{
+			_descriptors.create(nkeypoints, 32, CV_8U);
+			descriptors = _descriptors;
+		}
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int level = 0; level < nlevels; ++level)
+		{
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			vector<KeyPoint>& keypoints = allKeypoints[level];
+			int nkeypointsLevel = (int)keypoints.size();
+
+			if (nkeypointsLevel == 0)
+				continue;
+
+			// preprocess the resized image
+			Mat workingMat = mvImagePyramid[level].clone();
+			GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
+
+			// Compute the descriptors
+			Mat desc = descriptors.rowRange(vLevelOffsets[level], vLevelOffsets[level + 1]);
+			computeDescriptors(workingMat, keypoints, desc, pattern);
+
+			// Scale keypoint coordinates
+			if (level != 0)
+			{
+				float scale = mvScaleFactor[level]; //getScale(level, firstLevel, scaleFactor);
+				for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
+					keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
+					keypoint->pt *= scale;
+			}
+			mvLevelTimes[level] += ElapsedMs(start);
+		}
+
+		// And add the keypoints to the output
+		_keypoints.clear();
+		_keypoints.reserve(nkeypoints);
+
+		for (int level = 0; level < nlevels; ++level)
+			_keypoints.insert(_keypoints.end(), allKeypoints[level].begin(), allKeypoints[level].end());
+	}
+}
@@ -0,0 +1,52 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Ral Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ORBEXTRACTORREFERENCE_H
+#define ORBEXTRACTORREFERENCE_H
+
+#include "ORBextractor.h"
+
+namespace SLAMRecon
+{
+
+	// The ORB extractor before the FAST scores were shared by the cells of a level:
+	// every cell runs cv::FAST, and the orientations and descriptors are computed
+	// with the scalar kernels. Used as the reference of ORBBenchmark.
+	class ORBextractorReference : public ORBextractor
+	{
+	public:
+
+		ORBextractorReference(int nfeatures, float scaleFactor, int nlevels,
+			int iniThFAST, int minThFAST);
+
+		~ORBextractorReference(){}
+
+		// Same as ORBextractor::detect, mvLevelTimes is filled the same way.
+		void detectReference(const cv::Mat &image, std::vector<cv::KeyPoint>& keypoints,
+			cv::Mat &descriptors);
+
+	protected:
+
+		void ComputeKeyPointsReference(std::vector<std::vector<cv::KeyPoint> >& allKeypoints);
+	};
+
+} //namespace ORB_SLAM
+
+#endif
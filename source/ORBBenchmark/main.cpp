@@ -0,0 +1,178 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+//
+// Runs the ORB extractor and the cv::FAST reference on the frames of a TUM sequence,
+// checks that both give the same keypoints and descriptors and reports their timings.
+//
+// Usage: ORBBenchmark <sequence folder> <association file> [settings file] [max frames]
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ORBextractor.h"
+#include "ORBextractorReference.h"
+
+using namespace std;
+using namespace SLAMRecon;
+
+static vector<string> readRgbFiles(const string &assoFilePath)
+{
+	vector<string> rgbFiles;
+
+	ifstream assoFile(assoFilePath.c_str());
+	string line;
+	while (getline(assoFile, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		stringstream ss(line);
+		string rgbTime, rgbFile;
+		ss >> rgbTime >> rgbFile;
+		if (!rgbFile.empty())
+			rgbFiles.push_back(rgbFile);
+	}
+
+	return rgbFiles;
+}
+
+// Index of the first keypoint or descriptor that differs, -1 if there is none.
+static int findMismatch(const vector<cv::KeyPoint> &keys, const cv::Mat &desc,
+	const vector<cv::KeyPoint> &refKeys, const cv::Mat &refDesc)
+{
+	if (keys.size() != refKeys.size())
+		return (int)min(keys.size(), refKeys.size());
+
+	for (int i = 0; i < (int)keys.size(); i++)
+	{
+		const cv::KeyPoint &kp = keys[i], &refKp = refKeys[i];
+		if (kp.pt.x != refKp.pt.x || kp.pt.y != refKp.pt.y || kp.response != refKp.response ||
+			kp.angle != refKp.angle || kp.octave != refKp.octave || kp.size != refKp.size)
+			return i;
+
+		if (memcmp(desc.ptr(i), refDesc.ptr(i), desc.cols) != 0)
+			return i;
+	}
+
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3)
+	{
+		cerr << "Usage: ORBBenchmark <sequence folder> <association file> [settings file] [max frames]" << endl;
+		return 1;
+	}
+
+	string sequencePath = argv[1];
+	vector<string> rgbFiles = readRgbFiles(argv[2]);
+
+	int nFeatures = 1000, nLevels = 8, iniThFAST = 20, minThFAST = 7;
+	float scaleFactor = 1.2f;
+	if (argc > 3)
+	{
+		cv::FileStorage fSettings(argv[3], cv::FileStorage::READ);
+		if (!fSettings.isOpened())
+		{
+			cerr << "Failed to open settings file at: " << argv[3] << endl;
+			return 1;
+		}
+		nFeatures = fSettings["ORBextractor.nFeatures"];
+		scaleFactor = fSettings["ORBextractor.scaleFactor"];
+		nLevels = fSettings["ORBextractor.nLevels"];
+		iniThFAST = fSettings["ORBextractor.iniThFAST"];
+		minThFAST = fSettings["ORBextractor.minThFAST"];
+	}
+
+	int nFrames = (int)rgbFiles.size();
+	if (argc > 4)
+		nFrames = min(nFrames, atoi(argv[4]));
+	if (nFrames == 0)
+	{
+		cerr << "No frames found in: " << argv[2] << endl;
+		return 1;
+	}
+
+	ORBextractor extractor(nFeatures, scaleFactor, nLevels, iniThFAST, minThFAST);
+	ORBextractorReference reference(nFeatures, scaleFactor, nLevels, iniThFAST, minThFAST);
+
+	vector<double> levelTimes(nLevels, 0.0), refLevelTimes(nLevels, 0.0);
+	double totalTime = 0.0, refTotalTime = 0.0;
+	int nMismatches = 0, nProcessed = 0;
+
+	cout << fixed << setprecision(3);
+	cout << "frame  keypoints  reference(ms)  new(ms)  speedup" << endl;
+
+	for (int i = 0; i < nFrames; i++)
+	{
+		cv::Mat image = cv::imread(sequencePath + "/" + rgbFiles[i], CV_LOAD_IMAGE_UNCHANGED);
+		if (image.empty())
+		{
+			cerr << "Failed to load image at: " << sequencePath + "/" + rgbFiles[i] << endl;
+			continue;
+		}
+		if (image.channels() == 3)
+			cv::cvtColor(image, image, CV_BGR2GRAY);
+		else if (image.channels() == 4)
+			cv::cvtColor(image, image, CV_BGRA2GRAY);
+
+		vector<cv::KeyPoint> refKeys, keys;
+		cv::Mat refDesc, desc;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		reference.detectReference(image, refKeys, refDesc);
+		double refTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		start = chrono::steady_clock::now();
+		extractor.detect(image, cv::Mat(), keys, desc);
+		double time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		int mismatch = findMismatch(keys, desc, refKeys, refDesc);
+		if (mismatch >= 0)
+		{
+			nMismatches++;
+			cerr << "Frame " << i << " (" << rgbFiles[i] << ") differs at keypoint " << mismatch
+				<< ", " << keys.size() << " keypoints against " << refKeys.size() << endl;
+		}
+
+		for (int level = 0; level < nLevels; level++)
+		{
+			levelTimes[level] += extractor.mvLevelTimes[level];
+			refLevelTimes[level] += reference.mvLevelTimes[level];
+		}
+		totalTime += time;
+		refTotalTime += refTime;
+		nProcessed++;
+
+		cout << setw(5) << i << setw(11) << keys.size() << setw(15) << refTime << setw(9) << time
+			<< setw(9) << refTime / time << endl;
+	}
+
+	if (nProcessed == 0)
+		return 1;
+
+	cout << endl << "level  reference(ms)  new(ms)  speedup" << endl;
+	for (int level = 0; level < nLevels; level++)
+	{
+		cout << setw(5) << level << setw(15) << refLevelTimes[level] / nProcessed
+			<< setw(9) << levelTimes[level] / nProcessed
+			<< setw(9) << refLevelTimes[level] / levelTimes[level] << endl;
+	}
+
+	cout << endl << "frames: " << nProcessed << ", mismatched frames: " << nMismatches << endl;
+	cout << "mean per frame, reference: " << refTotalTime / nProcessed << " ms, new: "
+		<< totalTime / nProcessed << " ms, speedup: " << refTotalTime / totalTime << endl;
+
+	return nMismatches == 0 ? 0 : 2;
+}
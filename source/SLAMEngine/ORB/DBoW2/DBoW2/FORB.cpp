@@ -13,12 +13,17 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstring>
 #ifdef _WIN32
 #include <stdint.h>
 #else
 #include <stdint-gcc.h>
 #endif
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "FORB.h"
 
 using namespace std;
@@ -27,6 +32,19 @@ namespace DBoW2 {
 
 // --------------------------------------------------------------------------
 
+static inline int PopCount(uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  return (int)__popcnt64(v);
+#elif defined(_MSC_VER)
+  return (int)(__popcnt((unsigned int)v) + __popcnt((unsigned int)(v >> 32)));
+#else
+  return __builtin_popcountll(v);
+#endif
+}
+
+// --------------------------------------------------------------------------
+
 const int FORB::L=32;
 
 void FORB::meanValue(const std::vector<FORB::pDescriptor> &descriptors, 
@@ -104,6 +122,24 @@ int FORB::distance(const FORB::TDescriptor &a,
   return dist;
 }
 
+// --------------------------------------------------------------------------
+
+int FORB::distance(const unsigned char *a, const unsigned char *b)
+{
+  // the descriptors need not be aligned, so the words are copied out
+  int dist = 0;
+
+  for(int i = 0; i < FORB::L; i += 8)
+  {
+    uint64_t va, vb;
+    memcpy(&va, a + i, 8);
+    memcpy(&vb, b + i, 8);
+    dist += PopCount(va ^ vb);
+  }
+
+  return dist;
+}
+
 // --------------------------------------------------------------------------
   
 std::string FORB::toString(const FORB::TDescriptor &a)
@@ -140,6 +176,21 @@ void FORB::fromString(FORB::TDescriptor &a, const std::string &s)
 
 // --------------------------------------------------------------------------
 
+void FORB::toArray(const FORB::TDescriptor &a, unsigned char *p)
+{
+  memcpy(p, a.ptr<unsigned char>(), FORB::L);
+}
+
+// --------------------------------------------------------------------------
+
+void FORB::fromArray(FORB::TDescriptor &a, const unsigned char *p)
+{
+  a.create(1, FORB::L, CV_8U);
+  memcpy(a.ptr<unsigned char>(), p, FORB::L);
+}
+
+// --------------------------------------------------------------------------
+
 void FORB::toMat32F(const std::vector<TDescriptor> &descriptors, 
   cv::Mat &mat)
 {
@@ -46,6 +46,14 @@ public:
    */
   static int distance(const TDescriptor &a, const TDescriptor &b);
 
+  /**
+   * Calculates the distance between two descriptors of L bytes
+   * @param a
+   * @param b
+   * @return distance
+   */
+  static int distance(const unsigned char *a, const unsigned char *b);
+
   /**
    * Returns a string version of the descriptor
    * @param a descriptor
@@ -60,6 +68,20 @@ public:
    */
   static void fromString(TDescriptor &a, const std::string &s);
 
+  /**
+   * Copies the descriptor into L bytes
+   * @param a descriptor
+   * @param p (out) L bytes
+   */
+  static void toArray(const TDescriptor &a, unsigned char *p);
+
+  /**
+   * Returns a descriptor from L bytes
+   * @param a descriptor
+   * @param p L bytes
+   */
+  static void fromArray(TDescriptor &a, const unsigned char *p);
+
   /**
    * Returns a mat with the descriptors in float format
    * @param descriptors
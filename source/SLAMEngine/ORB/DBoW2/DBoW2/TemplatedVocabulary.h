@@ -33,6 +33,13 @@
 
 #include "../DUtils/Random.h"
 
+#include "MappedFile.h"
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/stat.h>
+
 using namespace std;
 
 namespace DBoW2 {
@@ -246,6 +253,29 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile.
+   * The file is memory-mapped and its arrays are copied into the nodes
+   * without parsing
+   * @param filename
+   * @param source_filename file the binary one was converted from, if it
+   *   exists its size and modification time must match the recorded ones
+   * @return false if the file is missing, not a binary vocabulary or
+   *   older than its source
+   */
+  bool loadFromBinaryFile(const std::string &filename,
+    const std::string &source_filename = std::string());
+
+  /**
+   * Saves the vocabulary into a binary file
+   * @param filename
+   * @param source_filename file the vocabulary was loaded from, its size
+   *   and modification time are recorded
+   * @return false if the file could not be written
+   */
+  bool saveToBinaryFile(const std::string &filename,
+    const std::string &source_filename = std::string()) const;
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -328,6 +358,17 @@ protected:
     inline bool isLeaf() const { return children.empty(); }
   };
 
+  /// Node of the flat tree, which stores the nodes in breadth-first order
+  struct FlatNode
+  {
+    /// Index of the first child in the flat tree
+    unsigned int first_child;
+    /// Number of children, which follow one another
+    unsigned int n_children;
+    /// Node id
+    NodeId id;
+  };
+
 protected:
 
   /**
@@ -361,6 +402,31 @@ protected:
    * @param id (out) word id
    */
   virtual void transform(const TDescriptor &feature, WordId &id) const;
+
+  /**
+   * Returns the word id associated to a feature by walking the flat tree
+   * @param feature F::L bytes of the feature
+   * @param id (out) word id
+   * @param weight (out) word weight
+   * @param nid (out) if given, id of the node "levelsup" levels up
+   * @param levelsup
+   */
+  void transformArray(const unsigned char *feature,
+    WordId &id, WordValue &weight, NodeId* nid, int levelsup) const;
+
+  /**
+   * Returns the word ids associated to a set of features, which are looked
+   * up in parallel
+   * @param features
+   * @param ids (out) word id of each feature
+   * @param weights (out) word weight of each feature
+   * @param nids (out) if given, id of the node "levelsup" levels up of each
+   *   feature
+   * @param levelsup
+   */
+  void transformAll(const std::vector<TDescriptor>& features,
+    vector<WordId> &ids, vector<WordValue> &weights, vector<NodeId> *nids,
+    int levelsup) const;
       
   /**
    * Creates a level in the tree, under the parent, by running kmeans with
@@ -393,6 +459,12 @@ protected:
    * Create the words of the vocabulary once the tree has been built
    */
   void createWords();
+
+  /**
+   * Creates the flat tree from the nodes. It must be called again whenever
+   * the structure of the tree changes
+   */
+  void createFlatTree();
   
   /**
    * Sets the weights of the nodes of tree according to the given features.
@@ -425,6 +497,13 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Tree nodes in breadth-first order, the root first
+  std::vector<FlatNode> m_flat_nodes;
+
+  /// Descriptors of the flat nodes, F::L bytes each, so the children of
+  /// a node are stored contiguously
+  std::vector<unsigned char> m_flat_descriptors;
   
 };
 
@@ -935,6 +1014,46 @@ void TemplatedVocabulary<TDescriptor,F>::createWords()
       }
     }
   }
+
+  createFlatTree();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createFlatTree()
+{
+  m_flat_nodes.clear();
+  m_flat_descriptors.clear();
+
+  if(m_nodes.empty()) return;
+
+  m_flat_nodes.reserve(m_nodes.size());
+  m_flat_descriptors.resize(m_nodes.size() * F::L, 0);
+
+  FlatNode root;
+  root.id = 0;
+  m_flat_nodes.push_back(root);
+
+  // the children are appended as their parent is visited, so the flat tree
+  // is in breadth-first order and the siblings are contiguous
+  for(size_t i = 0; i < m_flat_nodes.size(); ++i)
+  {
+    const vector<NodeId> &children = m_nodes[m_flat_nodes[i].id].children;
+
+    m_flat_nodes[i].first_child = (unsigned int)m_flat_nodes.size();
+    m_flat_nodes[i].n_children = (unsigned int)children.size();
+
+    for(size_t c = 0; c < children.size(); ++c)
+    {
+      FlatNode child;
+      child.id = children[c];
+
+      F::toArray(m_nodes[child.id].descriptor,
+        &m_flat_descriptors[m_flat_nodes.size() * F::L]);
+      m_flat_nodes.push_back(child);
+    }
+  }
 }
 
 // --------------------------------------------------------------------------
@@ -1077,20 +1196,19 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
 
-	typename vector<TDescriptor>::const_iterator fit;
+  vector<WordId> ids;
+  vector<WordValue> weights;
+  transformAll(features, ids, weights, NULL, 0);
 
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    for(fit = features.begin(); fit < features.end(); ++fit)
+    for(size_t i = 0; i < ids.size(); ++i)
     {
-      WordId id;
-      WordValue w; 
       // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w);
+      const WordValue w = weights[i];
       
       // not stopped
-      if(w > 0) v.addWeight(id, w);
+      if(w > 0) v.addWeight(ids[i], w);
     }
     
     if(!v.empty() && !must)
@@ -1104,16 +1222,13 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    for(fit = features.begin(); fit < features.end(); ++fit)
+    for(size_t i = 0; i < ids.size(); ++i)
     {
-      WordId id;
-      WordValue w;
       // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w);
+      const WordValue w = weights[i];
       
       // not stopped
-      if(w > 0) v.addIfNotExist(id, w);
+      if(w > 0) v.addIfNotExist(ids[i], w);
       
     } // if add_features
   } // if m_weighting == ...
@@ -1140,24 +1255,22 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   LNorm norm;
   bool must = m_scoring_object->mustNormalize(norm);
   
-  typename vector<TDescriptor>::const_iterator fit;
+  vector<WordId> ids;
+  vector<WordValue> weights;
+  vector<NodeId> nids;
+  transformAll(features, ids, weights, &nids, levelsup);
   
   if(m_weighting == TF || m_weighting == TF_IDF)
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
+    for(unsigned int i_feature = 0; i_feature < ids.size(); ++i_feature)
     {
-      WordId id;
-      NodeId nid;
-      WordValue w; 
       // w is the idf value if TF_IDF, 1 if TF
-      
-      transform(*fit, id, w, &nid, levelsup);
+      const WordValue w = weights[i_feature];
       
       if(w > 0) // not stopped
       { 
-        v.addWeight(id, w);
-        fv.addFeature(nid, i_feature);
+        v.addWeight(ids[i_feature], w);
+        fv.addFeature(nids[i_feature], i_feature);
       }
     }
     
@@ -1172,20 +1285,15 @@ void TemplatedVocabulary<TDescriptor,F>::transform(
   }
   else // IDF || BINARY
   {
-    unsigned int i_feature = 0;
-    for(fit = features.begin(); fit < features.end(); ++fit, ++i_feature)
+    for(unsigned int i_feature = 0; i_feature < ids.size(); ++i_feature)
     {
-      WordId id;
-      NodeId nid;
-      WordValue w;
       // w is idf if IDF, or 1 if BINARY
-      
-      transform(*fit, id, w, &nid, levelsup);
+      const WordValue w = weights[i_feature];
       
       if(w > 0) // not stopped
       {
-        v.addIfNotExist(id, w);
-        fv.addFeature(nid, i_feature);
+        v.addIfNotExist(ids[i_feature], w);
+        fv.addFeature(nids[i_feature], i_feature);
       }
     }
   } // if m_weighting == ...
@@ -1218,44 +1326,90 @@ template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature, 
   WordId &word_id, WordValue &weight, NodeId *nid, int levelsup) const
 { 
-  // propagate the feature down the tree
-  vector<NodeId> nodes;
-  typename vector<NodeId>::const_iterator nit;
+  vector<unsigned char> array(F::L);
+  F::toArray(feature, &array[0]);
+
+  transformArray(&array[0], word_id, weight, nid, levelsup);
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transformArray(
+  const unsigned char *feature, WordId &word_id, WordValue &weight,
+  NodeId *nid, int levelsup) const
+{
+  // propagate the feature down the tree, comparing it with the contiguous
+  // descriptors of the children of the current node
+  const size_t L = F::L;
 
   // level at which the node must be stored in nid, if given
   const int nid_level = m_L - levelsup;
   if(nid_level <= 0 && nid != NULL) *nid = 0; // root
 
-  NodeId final_id = 0; // root
+  unsigned int final_index = 0; // root
   int current_level = 0;
 
   do
   {
     ++current_level;
-    nodes = m_nodes[final_id].children;
-    final_id = nodes[0];
- 
-    double best_d = F::distance(feature, m_nodes[final_id].descriptor);
+    const FlatNode &node = m_flat_nodes[final_index];
+    const unsigned char *descriptor = &m_flat_descriptors[node.first_child * L];
+
+    final_index = node.first_child;
+    double best_d = F::distance(feature, descriptor);
 
-    for(nit = nodes.begin() + 1; nit != nodes.end(); ++nit)
+    for(unsigned int c = 1; c < node.n_children; ++c)
     {
-      NodeId id = *nit;
-      double d = F::distance(feature, m_nodes[id].descriptor);
+      descriptor += L;
+      double d = F::distance(feature, descriptor);
       if(d < best_d)
       {
         best_d = d;
-        final_id = id;
+        final_index = node.first_child + c;
       }
     }
-    
+
     if(nid != NULL && current_level == nid_level)
-      *nid = final_id;
-    
-  } while( !m_nodes[final_id].isLeaf() );
+      *nid = m_flat_nodes[final_index].id;
+
+  } while( m_flat_nodes[final_index].n_children > 0 );
 
   // turn node id into word id
-  word_id = m_nodes[final_id].word_id;
-  weight = m_nodes[final_id].weight;
+  const Node &word = m_nodes[m_flat_nodes[final_index].id];
+  word_id = word.word_id;
+  weight = word.weight;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::transformAll(
+  const std::vector<TDescriptor>& features, vector<WordId> &ids,
+  vector<WordValue> &weights, vector<NodeId> *nids, int levelsup) const
+{
+  const int N = (int)features.size();
+  const size_t L = F::L;
+
+  ids.resize(N);
+  weights.resize(N);
+  if(nids != NULL) nids->resize(N);
+  if(N == 0) return;
+
+  vector<unsigned char> arrays(N * L);
+
+  // each feature is looked up on its own, the results keep the feature order
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+  for(int i = 0; i < N; ++i)
+  {
+    unsigned char *array = &arrays[i * L];
+    F::toArray(features[i], array);
+
+    transformArray(array, ids[i], weights[i],
+      nids != NULL ? &(*nids)[i] : NULL, levelsup);
+  }
 }
 
 // --------------------------------------------------------------------------
@@ -1419,6 +1573,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
         }
     }
 
+    createFlatTree();
+
     return true;
 
 }
@@ -1450,6 +1606,185 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+// Binary vocabulary: a header of 32-bit fields, then per node (the root
+// excluded, in id order) the arrays of parent ids, word ids (-1 for inner
+// nodes), weights and descriptors of F::L bytes. The header records the
+// size and modification time of the text file it was converted from.
+static const unsigned int BINARY_VOCABULARY_MAGIC = 0x57426f44; // "DoBW"
+static const unsigned int BINARY_VOCABULARY_VERSION = 2;
+
+struct BinaryVocabularyHeader
+{
+  unsigned int magic, version;
+  int k, L, scoring, weighting;
+  unsigned int noNodes, noWords, descriptorLength;
+  unsigned int sourceSize, sourceTime;
+};
+
+/// Reads the size and modification time of a file, false if it does not exist
+static inline bool getBinaryVocabularySource(const std::string &filename,
+  unsigned int &size, unsigned int &time)
+{
+  struct stat fileStat;
+  if(filename.empty() || stat(filename.c_str(), &fileStat) != 0) return false;
+
+  size = (unsigned int)fileStat.st_size;
+  time = (unsigned int)fileStat.st_mtime;
+  return true;
+}
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename,
+  const std::string &source_filename)
+{
+  std::unique_ptr<Basis::MappedFile> file;
+  try
+  {
+    file.reset(new Basis::MappedFile(filename.c_str(), true));
+  }
+  catch(const std::runtime_error &)
+  {
+    return false;
+  }
+
+  const unsigned char *data = file->GetData();
+  const size_t size = file->GetSize();
+
+  BinaryVocabularyHeader header;
+  if(size < sizeof(header)) return false;
+  memcpy(&header, data, sizeof(header));
+
+  if(header.magic != BINARY_VOCABULARY_MAGIC || header.version != BINARY_VOCABULARY_VERSION ||
+    header.descriptorLength != (unsigned int)F::L)
+    return false;
+
+  // the text vocabulary was replaced since the conversion
+  unsigned int sourceSize, sourceTime;
+  if(getBinaryVocabularySource(source_filename, sourceSize, sourceTime) &&
+    (header.sourceSize != sourceSize || header.sourceTime != sourceTime))
+    return false;
+
+  if(header.k<0 || header.k>20 || header.L<1 || header.L>10 || header.scoring<0 || header.scoring>5 ||
+    header.weighting<0 || header.weighting>3)
+  {
+    std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << endl;
+    return false;
+  }
+
+  const size_t N = header.noNodes;
+  const size_t expected_size = sizeof(header) +
+    N * (sizeof(unsigned int) + sizeof(int) + sizeof(double) + F::L);
+  if(size != expected_size) return false;
+
+  const unsigned char *parents = data + sizeof(header);
+  const unsigned char *word_ids = parents + N * sizeof(unsigned int);
+  const unsigned char *weights = word_ids + N * sizeof(int);
+  const unsigned char *descriptors = weights + N * sizeof(double);
+
+  m_k = header.k;
+  m_L = header.L;
+  m_scoring = (ScoringType)header.scoring;
+  m_weighting = (WeightingType)header.weighting;
+  createScoringObject();
+
+  m_words.clear();
+  m_nodes.clear();
+  m_nodes.resize(N + 1);
+  m_words.resize(header.noWords, NULL);
+
+  // the children are counted first, so each list is allocated once
+  std::vector<unsigned int> vParents(N);
+  if(N > 0) memcpy(&vParents[0], parents, N * sizeof(unsigned int));
+
+  std::vector<unsigned int> noChildren(N + 1, 0);
+  for(size_t i = 0; i < N; ++i)
+  {
+    // a parent always precedes its children
+    if(vParents[i] > i) return false;
+    noChildren[vParents[i]]++;
+  }
+  for(size_t nid = 0; nid <= N; ++nid)
+    m_nodes[nid].children.reserve(noChildren[nid]);
+
+  for(size_t i = 0; i < N; ++i)
+  {
+    NodeId nid = (NodeId)(i + 1);
+    Node &node = m_nodes[nid];
+
+    node.id = nid;
+    node.parent = vParents[i];
+    m_nodes[node.parent].children.push_back(nid);
+
+    memcpy(&node.weight, weights + i * sizeof(double), sizeof(double));
+    F::fromArray(node.descriptor, descriptors + i * F::L);
+
+    int wid;
+    memcpy(&wid, word_ids + i * sizeof(int), sizeof(int));
+    if(wid >= 0)
+    {
+      if(wid >= (int)header.noWords) return false;
+      node.word_id = wid;
+      m_words[wid] = &node;
+    }
+  }
+
+  createFlatTree();
+
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename,
+  const std::string &source_filename) const
+{
+  ofstream f(filename.c_str(), ios_base::out | ios_base::binary);
+  if(!f.is_open()) return false;
+
+  const size_t N = m_nodes.empty() ? 0 : m_nodes.size() - 1;
+
+  BinaryVocabularyHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = BINARY_VOCABULARY_MAGIC;
+  header.version = BINARY_VOCABULARY_VERSION;
+  header.k = m_k;
+  header.L = m_L;
+  header.scoring = m_scoring;
+  header.weighting = m_weighting;
+  header.noNodes = (unsigned int)N;
+  header.noWords = (unsigned int)m_words.size();
+  header.descriptorLength = F::L;
+  getBinaryVocabularySource(source_filename, header.sourceSize, header.sourceTime);
+  f.write((const char*)&header, sizeof(header));
+
+  for(size_t i = 1; i <= N; ++i)
+    f.write((const char*)&m_nodes[i].parent, sizeof(unsigned int));
+
+  for(size_t i = 1; i <= N; ++i)
+  {
+    int wid = m_nodes[i].isLeaf() ? (int)m_nodes[i].word_id : -1;
+    f.write((const char*)&wid, sizeof(int));
+  }
+
+  for(size_t i = 1; i <= N; ++i)
+  {
+    double weight = m_nodes[i].weight;
+    f.write((const char*)&weight, sizeof(double));
+  }
+
+  std::vector<unsigned char> descriptor(F::L);
+  for(size_t i = 1; i <= N; ++i)
+  {
+    F::toArray(m_nodes[i].descriptor, &descriptor[0]);
+    f.write((const char*)&descriptor[0], F::L);
+  }
+
+  return f.good();
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1619,6 +1954,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  createFlatTree();
 }
 
 // --------------------------------------------------------------------------
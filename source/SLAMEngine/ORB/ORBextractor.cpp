@@ -23,6 +23,12 @@
 #include <opencv2/features2d/features2d.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <vector>
+#include <algorithm>
+#include <string.h>
+#include <emmintrin.h>
+#ifdef WITH_ORB_BENCHMARK
+#include <chrono>
+#endif
 
 #include "ORBextractor.h"
 
@@ -37,33 +43,83 @@ namespace SLAMRecon {
 	const int EDGE_THRESHOLD = 19;
 
 
-	static float IC_Angle(const Mat& image, Point2f pt, const vector<int> & u_max)
+	static bool CompareNodeSize(const pair<int, ExtractorNode*> &a, const pair<int, ExtractorNode*> &b)
 	{
-		int m_01 = 0, m_10 = 0;
+		return a.first < b.first;
+	}
+
+#ifdef WITH_ORB_BENCHMARK
+	static double ElapsedMs(const chrono::steady_clock::time_point &start)
+	{
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+#endif
 
+	static inline int sum_epi32(__m128i v)
+	{
+		v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(v);
+	}
+
+	static float IC_Angle(const Mat& image, Point2f pt, const vector<int> & u_max)
+	{
 		const uchar* center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+		int step = (int)image.step1();
+
+		// The lines of the patch are summed 32 pixels at a time, u from -15 to 16,
+		// the pixels beyond u_max of the line are masked out.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i u0 = _mm_setr_epi16(-15, -14, -13, -12, -11, -10, -9, -8);
+		const __m128i u1 = _mm_setr_epi16(-7, -6, -5, -4, -3, -2, -1, 0);
+		const __m128i u2 = _mm_setr_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+		const __m128i u3 = _mm_setr_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+		const __m128i abs0 = _mm_sub_epi16(zero, u0), abs1 = _mm_sub_epi16(zero, u1);
+
+		__m128i m_10 = zero, m_01 = zero;
 
 		// Treat the center line differently, v=0
-		for (int u = -HALF_PATCH_SIZE; u <= HALF_PATCH_SIZE; ++u)
-			m_10 += u * center[u];
+		{
+			const __m128i d = _mm_set1_epi16(HALF_PATCH_SIZE);
+			__m128i lo = _mm_loadu_si128((const __m128i*)(center - HALF_PATCH_SIZE));
+			__m128i hi = _mm_loadu_si128((const __m128i*)(center + 1));
+
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), u0));
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), u1));
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), u2));
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_andnot_si128(_mm_cmpgt_epi16(u3, d), _mm_unpackhi_epi8(hi, zero)), u3));
+		}
 
-		// Go line by line in the circuI853lar patch
-		int step = (int)image.step1();
+		// Go line by line in the circular patch
 		for (int v = 1; v <= HALF_PATCH_SIZE; ++v)
 		{
 			// Proceed over the two lines
-			int v_sum = 0;
-			int d = u_max[v];
-			for (int u = -d; u <= d; ++u)
-			{
-				int val_plus = center[u + v*step], val_minus = center[u - v*step];
-				v_sum += (val_plus - val_minus);
-				m_10 += u * (val_plus + val_minus);
-			}
-			m_01 += v * v_sum;
+			const __m128i d = _mm_set1_epi16((short)u_max[v]);
+			const __m128i mask0 = _mm_cmpgt_epi16(abs0, d), mask1 = _mm_cmpgt_epi16(abs1, d);
+			const __m128i mask2 = _mm_cmpgt_epi16(u2, d), mask3 = _mm_cmpgt_epi16(u3, d);
+
+			const uchar* plus = center + v*step - HALF_PATCH_SIZE;
+			const uchar* minus = center - v*step - HALF_PATCH_SIZE;
+			__m128i plusLo = _mm_loadu_si128((const __m128i*)plus), plusHi = _mm_loadu_si128((const __m128i*)(plus + 16));
+			__m128i minusLo = _mm_loadu_si128((const __m128i*)minus), minusHi = _mm_loadu_si128((const __m128i*)(minus + 16));
+
+			__m128i p0 = _mm_unpacklo_epi8(plusLo, zero), p1 = _mm_unpackhi_epi8(plusLo, zero);
+			__m128i p2 = _mm_unpacklo_epi8(plusHi, zero), p3 = _mm_unpackhi_epi8(plusHi, zero);
+			__m128i n0 = _mm_unpacklo_epi8(minusLo, zero), n1 = _mm_unpackhi_epi8(minusLo, zero);
+			__m128i n2 = _mm_unpacklo_epi8(minusHi, zero), n3 = _mm_unpackhi_epi8(minusHi, zero);
+
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_andnot_si128(mask0, _mm_add_epi16(p0, n0)), u0));
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_andnot_si128(mask1, _mm_add_epi16(p1, n1)), u1));
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_andnot_si128(mask2, _mm_add_epi16(p2, n2)), u2));
+			m_10 = _mm_add_epi32(m_10, _mm_madd_epi16(_mm_andnot_si128(mask3, _mm_add_epi16(p3, n3)), u3));
+
+			__m128i v_sum = _mm_add_epi16(
+				_mm_add_epi16(_mm_andnot_si128(mask0, _mm_sub_epi16(p0, n0)), _mm_andnot_si128(mask1, _mm_sub_epi16(p1, n1))),
+				_mm_add_epi16(_mm_andnot_si128(mask2, _mm_sub_epi16(p2, n2)), _mm_andnot_si128(mask3, _mm_sub_epi16(p3, n3))));
+			m_01 = _mm_add_epi32(m_01, _mm_madd_epi16(v_sum, _mm_set1_epi16((short)v)));
 		}
 
-		return fastAtan2((float)m_01, (float)m_10);
+		return fastAtan2((float)sum_epi32(m_01), (float)sum_epi32(m_10));
 	}
 
 
@@ -78,35 +134,41 @@ namespace SLAMRecon {
 		const uchar* center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
 		const int step = (int)img.step;
 
-#define GET_VALUE(idx) \
-    center[cvRound(pattern[idx].x*b + pattern[idx].y*a)*step + \
-            cvRound(pattern[idx].x*a - pattern[idx].y*b)]
-
+		// The rotated offsets of the 512 sampling points, four at a time. Like cvRound,
+		// _mm_cvtps_epi32 rounds half to even, and row*step + col is exact in float.
+		int offsets[512];
+		const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b), vstep = _mm_set1_ps((float)step);
+		for (int i = 0; i < 512; i += 4)
+		{
+			__m128 p0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(pattern + i)));
+			__m128 p1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(pattern + i + 2)));
+			__m128 x = _mm_cvtepi32_ps(_mm_castps_si128(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0))));
+			__m128 y = _mm_cvtepi32_ps(_mm_castps_si128(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+			__m128i row = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(x, vb), _mm_mul_ps(y, va)));
+			__m128i col = _mm_cvtps_epi32(_mm_sub_ps(_mm_mul_ps(x, va), _mm_mul_ps(y, vb)));
+			__m128 offset = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(row), vstep), _mm_cvtepi32_ps(col));
+			_mm_storeu_si128((__m128i*)(offsets + i), _mm_cvtps_epi32(offset));
+		}
 
-		for (int i = 0; i < 32; ++i, pattern += 16)
+		uchar t0[256], t1[256];
+		for (int i = 0; i < 256; ++i)
 		{
-			int t0, t1, val;
-			t0 = GET_VALUE(0); t1 = GET_VALUE(1);
-			val = t0 < t1;
-			t0 = GET_VALUE(2); t1 = GET_VALUE(3);
-			val |= (t0 < t1) << 1;
-			t0 = GET_VALUE(4); t1 = GET_VALUE(5);
-			val |= (t0 < t1) << 2;
-			t0 = GET_VALUE(6); t1 = GET_VALUE(7);
-			val |= (t0 < t1) << 3;
-			t0 = GET_VALUE(8); t1 = GET_VALUE(9);
-			val |= (t0 < t1) << 4;
-			t0 = GET_VALUE(10); t1 = GET_VALUE(11);
-			val |= (t0 < t1) << 5;
-			t0 = GET_VALUE(12); t1 = GET_VALUE(13);
-			val |= (t0 < t1) << 6;
-			t0 = GET_VALUE(14); t1 = GET_VALUE(15);
-			val |= (t0 < t1) << 7;
-
-			desc[i] = (uchar)val;
+			t0[i] = center[offsets[2 * i]];
+			t1[i] = center[offsets[2 * i + 1]];
 		}
 
-#undef GET_VALUE
+		// bit j of byte i is t0 < t1 of pair 8*i + j, 16 unsigned comparisons at a time
+		const __m128i delta = _mm_set1_epi8((char)-128);
+		for (int i = 0; i < 256; i += 16)
+		{
+			__m128i v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(t0 + i)), delta);
+			__m128i v1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(t1 + i)), delta);
+			int val = _mm_movemask_epi8(_mm_cmplt_epi8(v0, v1));
+
+			desc[i / 8] = (uchar)val;
+			desc[i / 8 + 1] = (uchar)(val >> 8);
+		}
 	}
 
 
@@ -644,7 +706,8 @@ namespace SLAMRecon {
 					vector<pair<int, ExtractorNode*> > vPrevSizeAndPointerToNode = vSizeAndPointerToNode;
 					vSizeAndPointerToNode.clear();
 
-					sort(vPrevSizeAndPointerToNode.begin(), vPrevSizeAndPointerToNode.end());
+					// ties keep the order the nodes were created in, not their addresses
+					stable_sort(vPrevSizeAndPointerToNode.begin(), vPrevSizeAndPointerToNode.end(), CompareNodeSize);
 					for (int j = vPrevSizeAndPointerToNode.size() - 1; j >= 0; j--)
 					{
 						ExtractorNode n1, n2, n3, n4;
@@ -725,22 +788,214 @@ namespace SLAMRecon {
 		return vResultKeys;
 	}
 
+	// Offsets of the FAST circle of radius 3, the first 9 repeated for the arcs across the start.
+	static void makeFASTOffsets(int pixel[25], int step)
+	{
+		static const int offsets[16][2] =
+		{
+			{ 0, 3 }, { 1, 3 }, { 2, 2 }, { 3, 1 }, { 3, 0 }, { 3, -1 }, { 2, -2 }, { 1, -3 },
+			{ 0, -3 }, { -1, -3 }, { -2, -2 }, { -3, -1 }, { -3, 0 }, { -3, 1 }, { -2, 2 }, { -1, 3 }
+		};
+
+		for (int k = 0; k < 16; k++)
+			pixel[k] = offsets[k][0] + offsets[k][1] * step;
+		for (int k = 16; k < 25; k++)
+			pixel[k] = pixel[k - 16];
+	}
+
+	// The score cv::FAST gives a corner, the highest threshold it is still a corner at minus one.
+	// The pixel is a corner at threshold iff its score is at least threshold.
+	static int FASTScore(const uchar* ptr, const int pixel[25])
+	{
+		const int v = ptr[0];
+		int d[25];
+		for (int k = 0; k < 25; k++)
+			d[k] = v - ptr[pixel[k]];
+
+		int a0 = 0, b0 = 0;
+		for (int k = 0; k < 16; k++)
+		{
+			int a = d[k], b = d[k];
+			for (int i = 1; i < 9; i++)
+			{
+				a = min(a, d[k + i]);
+				b = max(b, d[k + i]);
+			}
+			a0 = max(a0, a);
+			b0 = min(b0, b);
+		}
+
+		return max(a0, -b0) - 1;
+	}
+
+	// FAST-9 scores of the pixels in [minX, maxX) x [minY, maxY) that are corners at threshold,
+	// zero elsewhere. Candidates are found 16 pixels at a time, only they are scored.
+	static void computeFASTScores(const Mat& image, Mat& scores, int threshold, int minX, int maxX, int minY, int maxY)
+	{
+		scores.create(image.rows, image.cols, CV_8U);
+
+		int pixel[25];
+		makeFASTOffsets(pixel, (int)image.step);
+
+		const __m128i delta = _mm_set1_epi8((char)-128), t = _mm_set1_epi8((char)threshold), K16 = _mm_set1_epi8(8);
+
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int y = 0; y < image.rows; y++)
+		{
+			uchar* score = scores.ptr(y);
+			memset(score, 0, image.cols);
+
+			if (y < minY || y >= maxY)
+				continue;
+
+			const uchar* row = image.ptr(y);
+			int x = minX;
+
+			for (; x <= maxX - 16; x += 16)
+			{
+				const uchar* ptr = row + x;
+
+				// brighter above v0, darker below v1, compared as signed bytes
+				__m128i v0 = _mm_loadu_si128((const __m128i*)ptr);
+				__m128i v1 = _mm_xor_si128(_mm_subs_epu8(v0, t), delta);
+				v0 = _mm_xor_si128(_mm_adds_epu8(v0, t), delta);
+
+				// an arc of 9 covers two neighbouring pixels of the four at 0, 4, 8 and 12
+				__m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[0])), delta);
+				__m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[4])), delta);
+				__m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[8])), delta);
+				__m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[12])), delta);
+
+				__m128i m0 = _mm_and_si128(_mm_cmpgt_epi8(x0, v0), _mm_cmpgt_epi8(x1, v0));
+				__m128i m1 = _mm_and_si128(_mm_cmpgt_epi8(v1, x0), _mm_cmpgt_epi8(v1, x1));
+				m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x1, v0), _mm_cmpgt_epi8(x2, v0)));
+				m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x1), _mm_cmpgt_epi8(v1, x2)));
+				m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x2, v0), _mm_cmpgt_epi8(x3, v0)));
+				m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x2), _mm_cmpgt_epi8(v1, x3)));
+				m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x3, v0), _mm_cmpgt_epi8(x0, v0)));
+				m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x3), _mm_cmpgt_epi8(v1, x0)));
+
+				if (_mm_movemask_epi8(_mm_or_si128(m0, m1)) == 0)
+					continue;
+
+				// longest runs of brighter and darker pixels around the circle
+				__m128i zero = _mm_setzero_si128();
+				__m128i c0 = zero, c1 = zero, max0 = zero, max1 = zero;
+				for (int k = 0; k < 25; k++)
+				{
+					__m128i xk = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[k])), delta);
+					m0 = _mm_cmpgt_epi8(xk, v0);
+					m1 = _mm_cmpgt_epi8(v1, xk);
+					c0 = _mm_and_si128(_mm_sub_epi8(c0, m0), m0);
+					c1 = _mm_and_si128(_mm_sub_epi8(c1, m1), m1);
+					max0 = _mm_max_epu8(max0, c0);
+					max1 = _mm_max_epu8(max1, c1);
+				}
+
+				int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_max_epu8(max0, max1), K16));
+				for (int k = 0; mask != 0; k++, mask >>= 1)
+				{
+					if (mask & 1)
+						score[x + k] = (uchar)FASTScore(ptr + k, pixel);
+				}
+			}
+
+			for (; x < maxX; x++)
+			{
+				int s = FASTScore(row + x, pixel);
+				if (s >= threshold)
+					score[x] = (uchar)s;
+			}
+		}
+	}
+
+	// The keypoints cv::FAST with non-maximum suppression finds in the cell [iniX, maxX) x [iniY, maxY),
+	// from the scores at a threshold not above the one of the cell. Like cv::FAST the corners are
+	// detected 3 pixels inside the cell, and a corner outside does not suppress its neighbours.
+	static void detectCellCorners(const Mat& scores, int iniX, int maxX, int iniY, int maxY, int threshold, vector<KeyPoint>& keypoints)
+	{
+		keypoints.clear();
+
+		const int minX = iniX + 3, endX = maxX - 3;
+		const int minY = iniY + 3, endY = maxY - 3;
+
+		const __m128i th = _mm_set1_epi8((char)(threshold - 1)), zero = _mm_setzero_si128();
+
+		for (int y = minY; y < endY; y++)
+		{
+			const uchar* row = scores.ptr(y);
+
+			for (int x = minX; x < endX; x += 16)
+			{
+				// corners are the scores of at least threshold
+				int mask = 0;
+				if (x + 16 <= endX)
+					mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(_mm_loadu_si128((const __m128i*)(row + x)), th), zero)) & 0xffff;
+				else
+				{
+					for (int k = 0; k < endX - x; k++)
+						mask |= (row[x + k] >= threshold) << k;
+				}
+
+				for (int k = 0; mask != 0; k++, mask >>= 1)
+				{
+					if (!(mask & 1))
+						continue;
+
+					const int cx = x + k, s = row[cx];
+					bool isMax = true;
+					for (int dy = -1; dy <= 1 && isMax; dy++)
+					{
+						if (y + dy < minY || y + dy >= endY)
+							continue;
+						const uchar* neighbours = scores.ptr(y + dy);
+						for (int dx = -1; dx <= 1; dx++)
+						{
+							if ((dx == 0 && dy == 0) || cx + dx < minX || cx + dx >= endX)
+								continue;
+							if (neighbours[cx + dx] >= s)
+							{
+								isMax = false;
+								break;
+							}
+						}
+					}
+
+					if (isMax)
+						keypoints.push_back(KeyPoint(Point2f((float)(cx - iniX), (float)(y - iniY)), 7.f, -1, (float)s));
+				}
+			}
+		}
+	}
+
 	void ORBextractor::ComputeKeyPointsOctTree(vector<vector<KeyPoint> >& allKeypoints)
 	{
 		allKeypoints.resize(nlevels);
 
 		const float W = 30;
 
+		// FAST cells of all levels, detected in parallel.
+		struct FASTCell
+		{
+			int level;
+			int iniY, maxY, iniX, maxX;
+			int offsetX, offsetY;
+		};
+
+		vector<FASTCell> vCells;
+		vector<int> vFirstCells(nlevels + 1);
+
 		for (int level = 0; level < nlevels; ++level)
 		{
+			vFirstCells[level] = (int)vCells.size();
+
 			const int minBorderX = EDGE_THRESHOLD - 3;
 			const int minBorderY = minBorderX;
 			const int maxBorderX = mvImagePyramid[level].cols - EDGE_THRESHOLD + 3;
 			const int maxBorderY = mvImagePyramid[level].rows - EDGE_THRESHOLD + 3;
 
-			vector<cv::KeyPoint> vToDistributeKeys;
-			vToDistributeKeys.reserve(nfeatures * 10);
-
 			const float width = (maxBorderX - minBorderX);
 			const float height = (maxBorderY - minBorderY);
 
@@ -768,29 +1023,91 @@ namespace SLAMRecon {
 					if (maxX > maxBorderX)
 						maxX = maxBorderX;
 
-					vector<cv::KeyPoint> vKeysCell;
-					FAST(mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-						vKeysCell, iniThFAST, true);
+					FASTCell cell;
+					cell.level = level;
+					cell.iniY = iniY;
+					cell.maxY = maxY;
+					cell.iniX = iniX;
+					cell.maxX = maxX;
+					cell.offsetX = j*wCell;
+					cell.offsetY = i*hCell;
+					vCells.push_back(cell);
+				}
+			}
+		}
+		vFirstCells[nlevels] = (int)vCells.size();
 
-					if (vKeysCell.empty())
-					{
-						FAST(mvImagePyramid[level].rowRange(iniY, maxY).colRange(iniX, maxX),
-							vKeysCell, minThFAST, true);
-					}
+		// One pass over each level scores the corners at the lower threshold, the cells pick the
+		// corners of either threshold from the scores.
+		mvFASTScores.resize(nlevels);
+		for (int level = 0; level < nlevels; ++level)
+		{
+#ifdef WITH_ORB_BENCHMARK
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#endif
+			const int minBorder = EDGE_THRESHOLD - 3;
+			computeFASTScores(mvImagePyramid[level], mvFASTScores[level], min(iniThFAST, minThFAST),
+				minBorder + 3, mvImagePyramid[level].cols - minBorder - 3,
+				minBorder + 3, mvImagePyramid[level].rows - minBorder - 3);
+#ifdef WITH_ORB_BENCHMARK
+			mvLevelTimes[level] += ElapsedMs(start);
+#endif
+		}
 
-					if (!vKeysCell.empty())
-					{
-						for (vector<cv::KeyPoint>::iterator vit = vKeysCell.begin(); vit != vKeysCell.end(); vit++)
-						{
-							(*vit).pt.x += j*wCell;
-							(*vit).pt.y += i*hCell;
-							vToDistributeKeys.push_back(*vit);
-						}
-					}
+		vector<vector<cv::KeyPoint> > vCellKeys(vCells.size());
+#ifdef WITH_ORB_BENCHMARK
+		// the cells run in parallel, their times are added to the levels afterwards
+		vector<double> vCellTimes(vCells.size());
+#endif
 
-				}
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int c = 0; c < (int)vCells.size(); c++)
+		{
+#ifdef WITH_ORB_BENCHMARK
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#endif
+			const FASTCell &cell = vCells[c];
+
+			vector<cv::KeyPoint> &vKeysCell = vCellKeys[c];
+			detectCellCorners(mvFASTScores[cell.level], cell.iniX, cell.maxX, cell.iniY, cell.maxY, iniThFAST, vKeysCell);
+
+			if (vKeysCell.empty())
+			{
+				detectCellCorners(mvFASTScores[cell.level], cell.iniX, cell.maxX, cell.iniY, cell.maxY, minThFAST, vKeysCell);
 			}
 
+			for (vector<cv::KeyPoint>::iterator vit = vKeysCell.begin(); vit != vKeysCell.end(); vit++)
+			{
+				(*vit).pt.x += cell.offsetX;
+				(*vit).pt.y += cell.offsetY;
+			}
+#ifdef WITH_ORB_BENCHMARK
+			vCellTimes[c] = ElapsedMs(start);
+#endif
+		}
+
+		// The cells of a level are gathered in order, so the keypoints do not depend on the number of threads.
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int level = 0; level < nlevels; ++level)
+		{
+#ifdef WITH_ORB_BENCHMARK
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#endif
+			const int minBorderX = EDGE_THRESHOLD - 3;
+			const int minBorderY = minBorderX;
+			const int maxBorderX = mvImagePyramid[level].cols - EDGE_THRESHOLD + 3;
+			const int maxBorderY = mvImagePyramid[level].rows - EDGE_THRESHOLD + 3;
+
+			vector<cv::KeyPoint> vToDistributeKeys;
+			vToDistributeKeys.reserve(nfeatures * 10);
+
+			for (int c = vFirstCells[level]; c < vFirstCells[level + 1]; c++)
+				vToDistributeKeys.insert(vToDistributeKeys.end(), vCellKeys[c].begin(), vCellKeys[c].end());
+
 			vector<KeyPoint> & keypoints = allKeypoints[level];
 			keypoints.reserve(nfeatures);
 
@@ -808,11 +1125,16 @@ namespace SLAMRecon {
 				keypoints[i].octave = level;
 				keypoints[i].size = scaledPatchSize;
 			}
-		}
 
-		// compute orientations
-		for (int level = 0; level < nlevels; ++level)
-			computeOrientation(mvImagePyramid[level], allKeypoints[level], umax);
+			// compute orientations
+			computeOrientation(mvImagePyramid[level], keypoints, umax);
+
+#ifdef WITH_ORB_BENCHMARK
+			mvLevelTimes[level] += ElapsedMs(start);
+			for (int c = vFirstCells[level]; c < vFirstCells[level + 1]; c++)
+				mvLevelTimes[level] += vCellTimes[c];
+#endif
+		}
 	}
 
 	void ORBextractor::ComputeKeyPointsOld(vector<vector<KeyPoint> > &allKeypoints)
@@ -1016,14 +1338,20 @@ namespace SLAMRecon {
 		ComputePyramid(image);
 
 		vector < vector<KeyPoint> > allKeypoints;
+#ifdef WITH_ORB_BENCHMARK
+		mvLevelTimes.assign(nlevels, 0.0);
+#endif
 		ComputeKeyPointsOctTree(allKeypoints);
 		//ComputeKeyPointsOld(allKeypoints);
 
 		Mat descriptors;
 
-		int nkeypoints = 0;
+		// The descriptor rows of each level are known up front, so the levels are described in parallel.
+		vector<int> vLevelOffsets(nlevels + 1, 0);
 		for (int level = 0; level < nlevels; ++level)
-			nkeypoints += (int)allKeypoints[level].size();
+			vLevelOffsets[level + 1] = vLevelOffsets[level] + (int)allKeypoints[level].size();
+
+		int nkeypoints = vLevelOffsets[nlevels];
 		if (nkeypoints == 0)
 			_descriptors.release();
 		else
@@ -1032,12 +1360,14 @@ namespace SLAMRecon {
 			descriptors = _descriptors.getMat();
 		}
 
-		_keypoints.clear();
-		_keypoints.reserve(nkeypoints);
-
-		int offset = 0;
+#ifdef WITH_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
 		for (int level = 0; level < nlevels; ++level)
 		{
+#ifdef WITH_ORB_BENCHMARK
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#endif
 			vector<KeyPoint>& keypoints = allKeypoints[level];
 			int nkeypointsLevel = (int)keypoints.size();
 
@@ -1049,11 +1379,9 @@ namespace SLAMRecon {
 			GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
 
 			// Compute the descriptors
-			Mat desc = descriptors.rowRange(offset, offset + nkeypointsLevel);
+			Mat desc = descriptors.rowRange(vLevelOffsets[level], vLevelOffsets[level + 1]);
 			computeDescriptors(workingMat, keypoints, desc, pattern);
 
-			offset += nkeypointsLevel;
-
 			// Scale keypoint coordinates
 			if (level != 0)
 			{
@@ -1062,9 +1390,17 @@ namespace SLAMRecon {
 					keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
 					keypoint->pt *= scale;
 			}
-			// And add the keypoints to the output
-			_keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
+#ifdef WITH_ORB_BENCHMARK
+			mvLevelTimes[level] += ElapsedMs(start);
+#endif
 		}
+
+		// And add the keypoints to the output
+		_keypoints.clear();
+		_keypoints.reserve(nkeypoints);
+
+		for (int level = 0; level < nlevels; ++level)
+			_keypoints.insert(_keypoints.end(), allKeypoints[level].begin(), allKeypoints[level].end());
 	}
 
 	void ORBextractor::ComputePyramid(cv::Mat image)
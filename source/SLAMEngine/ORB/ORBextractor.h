@@ -86,6 +86,11 @@ namespace SLAMRecon
 
 		std::vector<cv::Mat> mvImagePyramid;
 
+#ifdef WITH_ORB_BENCHMARK
+		// Milliseconds the last detect spent on each level, without the pyramid
+		std::vector<double> mvLevelTimes;
+#endif
+
 	protected:
 
 		void ComputePyramid(cv::Mat image);
@@ -106,6 +111,9 @@ namespace SLAMRecon
 
 		std::vector<int> umax;
 
+		// FAST scores of each pyramid level at minThFAST
+		std::vector<cv::Mat> mvFASTScores;
+
 		std::vector<float> mvScaleFactor;
 		std::vector<float> mvInvScaleFactor;
 		std::vector<float> mvLevelSigma2;
@@ -23,6 +23,10 @@
 #include "../SLAM/KeyFrame.h"
 #include "ORBVocabulary.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace SLAMRecon {
 
 	
@@ -42,6 +46,8 @@ namespace SLAMRecon {
 	int ORBmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th) {
 
 		int nmatches = 0;
+		vector<int> vDists;
+		vector<size_t> vIndices2;
 
 		// Ϊ˼תһ
 		vector<int> rotHist[HISTO_LENGTH];
@@ -97,35 +103,32 @@ namespace SLAMRecon {
 
 					float radius = th*CurrentFrame.m_pPLevelInfo->m_vScaleFactors[nLastOctave];
 
-					vector<size_t> vIndices2;
-
 					if (bForward)
-						vIndices2 = CurrentFrame.GetFeaturesInArea(u, v, radius, nLastOctave);
+						CurrentFrame.GetFeaturesInArea(u, v, radius, vIndices2, nLastOctave);
 					else if (bBackward)
-						vIndices2 = CurrentFrame.GetFeaturesInArea(u, v, radius, 0, nLastOctave);
+						CurrentFrame.GetFeaturesInArea(u, v, radius, vIndices2, 0, nLastOctave);
 					else
-						vIndices2 = CurrentFrame.GetFeaturesInArea(u, v, radius, nLastOctave - 1, nLastOctave + 1);
+						CurrentFrame.GetFeaturesInArea(u, v, radius, vIndices2, nLastOctave - 1, nLastOctave + 1);
 
 					if (vIndices2.empty())
 						continue;
 
 					const cv::Mat dMP = pMP->GetDescriptor();
+					DescriptorDistances(dMP.ptr(), CurrentFrame.m_Descriptors, vIndices2, vDists);
 
 					int bestDist = 256;
 					int bestIdx2 = -1;
 
-					for (vector<size_t>::const_iterator vit = vIndices2.begin(), vend = vIndices2.end(); vit != vend; vit++) {
+					for (size_t k = 0; k < vIndices2.size(); k++) {
 
 						// òҵKeyPointѾƥMapPointʵϵMapPointʱMapPointǾͲд
 						// ƥϵʱMapPointǿԱƥµ
-						const size_t i2 = *vit;
+						const size_t i2 = vIndices2[k];
 						if (CurrentFrame.m_vpMapPoints[i2])
 							if (CurrentFrame.m_vpMapPoints[i2]->Observations() > 0)
 								continue;
 
-						const cv::Mat &d = CurrentFrame.m_Descriptors.row(i2);
-
-						const int dist = DescriptorDistance(dMP, d);
+						const int dist = vDists[k];
 
 						if (dist < bestDist) {
 							bestDist = dist;
@@ -175,6 +178,8 @@ namespace SLAMRecon {
 	int ORBmatcher::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th) {
 
 		int nmatches = 0;
+		vector<int> vDists;
+		vector<size_t> vIndices;
 
 		const bool bFactor = th != 1.0;
 
@@ -204,13 +209,13 @@ namespace SLAMRecon {
 				continue;
 
 			// ҵFrameڸ÷ΧڵKeyPointindexϣͬʱ޶ȡKeyPointLevel
-			const vector<size_t> vIndices =
-				F.GetFeaturesInArea(pMP->m_TrackProjX, pMP->m_TrackProjY, r*F.m_pPLevelInfo->m_vScaleFactors[nPredictedLevel], nPredictedLevel - 1, nPredictedLevel);
+			F.GetFeaturesInArea(pMP->m_TrackProjX, pMP->m_TrackProjY, r*F.m_pPLevelInfo->m_vScaleFactors[nPredictedLevel], vIndices, nPredictedLevel - 1, nPredictedLevel);
 
 			if (vIndices.empty())
 				continue;
 
 			const cv::Mat MPdescriptor = pMP->GetDescriptor();
+			DescriptorDistances(MPdescriptor.ptr(), F.m_Descriptors, vIndices, vDists);
 
 			int bestDist = 256;
 			int bestLevel = -1;
@@ -219,17 +224,15 @@ namespace SLAMRecon {
 			int bestIdx = -1;
 
 			// ΪMapPointõһƥKeyPoint
-			for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
-				const size_t idx = *vit;
+			for (size_t k = 0; k < vIndices.size(); k++) {
+				const size_t idx = vIndices[k];
 
 				// жϸindexϵMapPointǷѾƥĳϷMapPointˣƥϾͲдǲЩ½ʱMapPoint
 				if (F.m_vpMapPoints[idx])
 					if (F.m_vpMapPoints[idx]->Observations() > 0)
 						continue;
 
-				const cv::Mat &d = F.m_Descriptors.row(idx);
-
-				const int dist = DescriptorDistance(MPdescriptor, d);
+				const int dist = vDists[k];
 
 				if (dist < bestDist) {
 					bestDist2 = bestDist;
@@ -287,6 +290,7 @@ namespace SLAMRecon {
 		DBoW2::FeatureVector::const_iterator Fend = F.m_FeatVec.end();
 
 		int nmatches = 0;
+		vector<int> vDists;
 
 		// FeatureVectorĽб
 		while (KFit != KFend && Fit != Fend) {
@@ -295,10 +299,13 @@ namespace SLAMRecon {
 			if (KFit->first == Fit->first) {
 			
 				// KeyFrameϸNodeIdӦKeyPointMapPointindex 
-				const vector<unsigned int> vIndicesKF = KFit->second; 
+				const vector<unsigned int> &vIndicesKF = KFit->second; 
 
 				// FrameϸNodeIdӦKeyPointMapPointindex 
-				const vector<unsigned int> vIndicesF = Fit->second;
+				const vector<unsigned int> &vIndicesF = Fit->second;
+
+				// Hamming distances of all pairs of the node, row iKF of the tile is vDists[iKF*vIndicesF.size()]
+				DescriptorDistances(pKF->m_Descriptors, vIndicesKF, F.m_Descriptors, vIndicesF, vDists);
 
 				// indexбѯĳЧKeyFrameMapPoint˵Ƿһ֮ƥFrameϵMapPointKeyPointdescriptorһ
 				for (size_t iKF = 0; iKF < vIndicesKF.size(); iKF++) {
@@ -315,8 +322,6 @@ namespace SLAMRecon {
 						continue;
 
 					// MapPointӦKeyPointdescriptor256 bit
-					const cv::Mat &dKF = pKF->m_Descriptors.row(realIdxKF);
-
 					// FrameNodeIdϵеKeyPointKeyFramedescriptor֮Сĺ͵ڶСĺ
 
 					// һ256λdescriptor,һkeypoint˵Ϊ256
@@ -331,9 +336,7 @@ namespace SLAMRecon {
 						if (vpMapPointMatches[realIdxF]) // ýڵѾݣ˵Ѿҵ
 							continue;
 
-						const cv::Mat &dF = F.m_Descriptors.row(realIdxF);
-
-						const int dist = DescriptorDistance(dKF, dF); // 㺺
+						const int dist = vDists[iKF*vIndicesF.size() + iF]; // 㺺
 
 						if (dist < bestDist1) {
 							bestDist2 = bestDist1;
@@ -424,6 +427,7 @@ namespace SLAMRecon {
 		const float factor = 1.0f / HISTO_LENGTH;
 
 		int nmatches = 0;
+		vector<int> vDists;
 
 		DBoW2::FeatureVector::const_iterator f1it = vFeatVec1.begin();
 		DBoW2::FeatureVector::const_iterator f2it = vFeatVec2.begin();
@@ -434,6 +438,8 @@ namespace SLAMRecon {
 
 			if (f1it->first == f2it->first) {
 
+				DescriptorDistances(Descriptors1, f1it->second, Descriptors2, f2it->second, vDists);
+
 				// KeyFrame1ϵĳNodeIdµMapPointбӦKeyFrame2ͬNodeIdµMapPoint
 				for (size_t i1 = 0, iend1 = f1it->second.size(); i1 < iend1; i1++) {
 
@@ -446,8 +452,6 @@ namespace SLAMRecon {
 					if (pMP1->isBad())
 						continue;
 
-					const cv::Mat &d1 = Descriptors1.row(idx1);
-
 					int bestDist1 = 256;
 					int bestIdx2 = -1;
 					int bestDist2 = 256;
@@ -464,9 +468,7 @@ namespace SLAMRecon {
 						if (pMP2->isBad())
 							continue;
 
-						const cv::Mat &d2 = Descriptors2.row(idx2);
-
-						int dist = DescriptorDistance(d1, d2);
+						int dist = vDists[i1*iend2 + i2];
 
 						if (dist < bestDist1) {
 							bestDist2 = bestDist1;
@@ -533,6 +535,8 @@ namespace SLAMRecon {
 	int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set<MapPoint*> &sAlreadyFound, const float th, const int ORBdist) {
 
 		int nmatches = 0;
+		vector<int> vDists;
+		vector<size_t> vIndices2;
 
 		const cv::Mat Rcw = CurrentFrame.m_Transformation.rowRange(0, 3).colRange(0, 3);  // camera pose ŻŻ pose
 		const cv::Mat tcw = CurrentFrame.m_Transformation.rowRange(0, 3).col(3);
@@ -593,23 +597,22 @@ namespace SLAMRecon {
 					// Search in a windowڴ˰뾶ΧڲҺѡKeyPoint㣬descriptorsСһֵ˵õҲMatchϵMapPoint
 					const float radius = th*CurrentFrame.m_pPLevelInfo->m_vScaleFactors[nPredictedLevel];
 
-					const vector<size_t> vIndices2 = CurrentFrame.GetFeaturesInArea(u, v, radius, nPredictedLevel - 1, nPredictedLevel + 1);
+					CurrentFrame.GetFeaturesInArea(u, v, radius, vIndices2, nPredictedLevel - 1, nPredictedLevel + 1);
 					if (vIndices2.empty())
 						continue;
 
 					const cv::Mat dMP = pMP->GetDescriptor();
+					DescriptorDistances(dMP.ptr(), CurrentFrame.m_Descriptors, vIndices2, vDists);
 
 					int bestDist = 256;
 					int bestIdx2 = -1;
 
-					for (vector<size_t>::const_iterator vit = vIndices2.begin(); vit != vIndices2.end(); vit++) {
-						const size_t i2 = *vit;
+					for (size_t k = 0; k < vIndices2.size(); k++) {
+						const size_t i2 = vIndices2[k];
 						if (CurrentFrame.m_vpMapPoints[i2])
 							continue;
 
-						const cv::Mat &d = CurrentFrame.m_Descriptors.row(i2);
-
-						const int dist = DescriptorDistance(dMP, d);
+						const int dist = vDists[k];
 
 						if (dist < bestDist) {
 							bestDist = dist;
@@ -683,6 +686,7 @@ namespace SLAMRecon {
 		// Compare only ORB that share the same node
 
 		int nmatches = 0;
+		vector<int> vDists;
 		vector<bool> vbMatched2(pKF2->m_nKeys, false);
 		vector<int> vMatches12(pKF1->m_nKeys, -1);
 
@@ -703,6 +707,8 @@ namespace SLAMRecon {
 			// ͬһnode²Žм㣬ټ㸴Ӷ
 			if (f1it->first == f2it->first) {
 
+				DescriptorDistances(pKF1->m_Descriptors, f1it->second, pKF2->m_Descriptors, f2it->second, vDists);
+
 				for (size_t i1 = 0, iend1 = f1it->second.size(); i1 < iend1; i1++) {
 
 					const size_t idx1 = f1it->second[i1];
@@ -713,7 +719,6 @@ namespace SLAMRecon {
 						continue;
 
 					const cv::KeyPoint &kp1 = pKF1->m_vKeysUn[idx1];
-					const cv::Mat &d1 = pKF1->m_Descriptors.row(idx1);
 
 					int bestDist = TH_LOW;
 					int bestIdx2 = -1;
@@ -728,9 +733,7 @@ namespace SLAMRecon {
 							continue;
 
 				
-						const cv::Mat &d2 = pKF2->m_Descriptors.row(idx2);
-
-						const int dist = DescriptorDistance(d1, d2);
+						const int dist = vDists[i1*iend2 + i2];
 
 						if (dist > TH_LOW || dist > bestDist)
 							continue;
@@ -824,6 +827,8 @@ namespace SLAMRecon {
 		cv::Mat Ow = pKF->GetCameraCenter();
 
 		int nFused = 0;
+		vector<int> vDists;
+		vector<size_t> vIndices;
 
 		const int nMPs = vpMapPoints.size();
 
@@ -882,7 +887,7 @@ namespace SLAMRecon {
 			const float radius = th*pKF->m_pPLevelInfo->m_vScaleFactors[nPredictedLevel];
 
 
-			const vector<size_t> vIndices = pKF->GetFeaturesInArea(u, v, radius);
+			pKF->GetFeaturesInArea(u, v, radius, vIndices);
 
 			if (vIndices.empty())
 				continue;
@@ -890,11 +895,12 @@ namespace SLAMRecon {
 			// Match to the most similar keypoint in the radius
 
 			const cv::Mat dMP = pMP->GetDescriptor();
+			DescriptorDistances(dMP.ptr(), pKF->m_Descriptors, vIndices, vDists);
 
 			int bestDist = 256;
 			int bestIdx = -1;
-			for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
-				const size_t idx = *vit;
+			for (size_t k = 0; k < vIndices.size(); k++) {
+				const size_t idx = vIndices[k];
 
 				const cv::KeyPoint &kp = pKF->m_vKeysUn[idx];
 
@@ -913,9 +919,7 @@ namespace SLAMRecon {
 				if (e2*pKF->m_pPLevelInfo->m_vInvLevelSigma2[kpLevel] > 5.99)
 					continue;
 				
-				const cv::Mat &dKF = pKF->m_Descriptors.row(idx);
-
-				const int dist = DescriptorDistance(dMP, dKF);
+				const int dist = vDists[k];
 
 				if (dist<bestDist) {
 					bestDist = dist;
@@ -995,6 +999,8 @@ namespace SLAMRecon {
 		vector<int> vnMatch1(N1, -1);
 		// KeyFrame2MapPointͬʱƥЩMapPointƥϵKeyFrame1еKeyPointindex
 		vector<int> vnMatch2(N2, -1);
+		vector<int> vDists;
+		vector<size_t> vIndices;
 
 		// KeyFrame1MapPointͬʱƥЩMapPoint
 		// ҵKeyFrame2пƥϸMapPointKeyPoint
@@ -1048,19 +1054,20 @@ namespace SLAMRecon {
 			const float radius = th*pKF2->m_pPLevelInfo->m_vScaleFactors[nPredictedLevel];
 
 			// õ÷ΧڵKeyPointindexļ
-			const vector<size_t> vIndices = pKF2->GetFeaturesInArea(u, v, radius);
+			pKF2->GetFeaturesInArea(u, v, radius, vIndices);
 
 			if (vIndices.empty())
 				continue;
 
 			// MapPointҪ÷ΧKeyPointƥ䣬descriptorĺС
 			const cv::Mat dMP = pMP->GetDescriptor();
+			DescriptorDistances(dMP.ptr(), pKF2->m_Descriptors, vIndices, vDists);
 
 			// Ը÷ΧڵKeyPointбѰMapPointƥKeyPoint
 			int bestDist = INT_MAX;
 			int bestIdx = -1;
-			for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
-				const size_t idx = *vit;
+			for (size_t k = 0; k < vIndices.size(); k++) {
+				const size_t idx = vIndices[k];
 
 				const cv::KeyPoint &kp = pKF2->m_vKeysUn[idx];
 
@@ -1068,10 +1075,8 @@ namespace SLAMRecon {
 				if (kp.octave<nPredictedLevel - 1 || kp.octave>nPredictedLevel)
 					continue;
 
-				const cv::Mat &dKF = pKF2->m_Descriptors.row(idx);
-
 				// MapPointdescriptorKeyPointdescriptorĺ
-				const int dist = DescriptorDistance(dMP, dKF);
+				const int dist = vDists[k];
 
 				if (dist < bestDist) {
 					bestDist = dist;
@@ -1130,27 +1135,26 @@ namespace SLAMRecon {
 
 			const float radius = th*pKF1->m_pPLevelInfo->m_vScaleFactors[nPredictedLevel];
 
-			const vector<size_t> vIndices = pKF1->GetFeaturesInArea(u, v, radius);
+			pKF1->GetFeaturesInArea(u, v, radius, vIndices);
 
 			if (vIndices.empty())
 				continue;
 
 			const cv::Mat dMP = pMP->GetDescriptor();
+			DescriptorDistances(dMP.ptr(), pKF1->m_Descriptors, vIndices, vDists);
 
 			int bestDist = INT_MAX;
 			int bestIdx = -1;
-			for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
+			for (size_t k = 0; k < vIndices.size(); k++) {
 
-				const size_t idx = *vit;
+				const size_t idx = vIndices[k];
 
 				const cv::KeyPoint &kp = pKF1->m_vKeysUn[idx];
 
 				if (kp.octave<nPredictedLevel - 1 || kp.octave>nPredictedLevel)
 					continue;
 
-				const cv::Mat &dKF = pKF1->m_Descriptors.row(idx);
-
-				const int dist = DescriptorDistance(dMP, dKF);
+				const int dist = vDists[k];
 
 				if (dist < bestDist) {
 					bestDist = dist;
@@ -1204,6 +1208,8 @@ namespace SLAMRecon {
 		spAlreadyFound.erase(static_cast<MapPoint*>(NULL));
 
 		int nmatches = 0;
+		vector<int> vDists;
+		vector<size_t> vIndices;
 
 		// ѡMapPointѰµƥ
 		for (int iMP = 0, iendMP = vpPoints.size(); iMP < iendMP; iMP++) {
@@ -1264,7 +1270,7 @@ namespace SLAMRecon {
 			const float radius = th*pKF->m_pPLevelInfo->m_vScaleFactors[nPredictedLevel];
 
 			// // õ÷ΧڵKeyPointindexļ
-			const vector<size_t> vIndices = pKF->GetFeaturesInArea(u, v, radius);
+			pKF->GetFeaturesInArea(u, v, radius, vIndices);
 
 			if (vIndices.empty())
 				continue;
@@ -1272,11 +1278,12 @@ namespace SLAMRecon {
 			// ǰĺܶ෽һMapPointKeyPoint,ͬʱһֵ
 			// ΪMapPointKeyPointӦMapPointƥˣȻҪѾƥϵMapPoint
 			const cv::Mat dMP = pMP->GetDescriptor();
+			DescriptorDistances(dMP.ptr(), pKF->m_Descriptors, vIndices, vDists);
 
 			int bestDist = 256;
 			int bestIdx = -1;
-			for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
-				const size_t idx = *vit;
+			for (size_t k = 0; k < vIndices.size(); k++) {
+				const size_t idx = vIndices[k];
 				if (vpMatched[idx])
 					continue;
 
@@ -1285,9 +1292,7 @@ namespace SLAMRecon {
 				if (kpLevel<nPredictedLevel - 1 || kpLevel>nPredictedLevel)
 					continue;
 
-				const cv::Mat &dKF = pKF->m_Descriptors.row(idx);
-
-				const int dist = DescriptorDistance(dMP, dKF);
+				const int dist = vDists[k];
 
 				if (dist < bestDist) {
 					bestDist = dist;
@@ -1324,6 +1329,8 @@ namespace SLAMRecon {
 		const set<MapPoint*> spAlreadyFound = pKF->GetMapPoints();
 
 		int nFused = 0;
+		vector<int> vDists;
+		vector<size_t> vIndices;
 
 		const int nPoints = vpPoints.size();
 
@@ -1386,7 +1393,7 @@ namespace SLAMRecon {
 			const float radius = th*pKF->m_pPLevelInfo->m_vScaleFactors[nPredictedLevel];
 
 			// // õ÷ΧڵKeyPointindexļ
-			const vector<size_t> vIndices = pKF->GetFeaturesInArea(u, v, radius);
+			pKF->GetFeaturesInArea(u, v, radius, vIndices);
 
 			if (vIndices.empty())
 				continue;
@@ -1394,20 +1401,19 @@ namespace SLAMRecon {
 			// ǰĺܶ෽һMapPointKeyPoint,ͬʱһֵ
 			// ΪMapPointKeyPointӦMapPointƥˣȻҪѾƥϵMapPoint
 			const cv::Mat dMP = pMP->GetDescriptor();
+			DescriptorDistances(dMP.ptr(), pKF->m_Descriptors, vIndices, vDists);
 
 			int bestDist = 256;
 			int bestIdx = -1;
-			for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
-				const size_t idx = *vit;
+			for (size_t k = 0; k < vIndices.size(); k++) {
+				const size_t idx = vIndices[k];
 				
 				const int &kpLevel = pKF->m_vKeysUn[idx].octave;
 
 				if (kpLevel<nPredictedLevel - 1 || kpLevel>nPredictedLevel)
 					continue;
 
-				const cv::Mat &dKF = pKF->m_Descriptors.row(idx);
-
-				const int dist = DescriptorDistance(dMP, dKF);
+				const int dist = vDists[k];
 
 				if (dist < bestDist) {
 					bestDist = dist;
@@ -1469,23 +1475,63 @@ namespace SLAMRecon {
 	}
 
 
-	// Bit set count operation from
-	// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+	// Number of set bits of a 64 bit word, a single popcnt instruction
+	static inline int PopCount(uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+		return (int)__popcnt64(v);
+#elif defined(_MSC_VER)
+		return (int)(__popcnt((unsigned int)v) + __popcnt((unsigned int)(v >> 32)));
+#else
+		return __builtin_popcountll(v);
+#endif
+	}
+
 	int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b) {
+		return DescriptorDistance(a.ptr(), b.ptr());
+	}
+
+	int ORBmatcher::DescriptorDistance(const uchar *a, const uchar *b) {
+
+		const uint64_t *pa = (const uint64_t*)a;
+		const uint64_t *pb = (const uint64_t*)b;
+
+		return PopCount(pa[0] ^ pb[0]) + PopCount(pa[1] ^ pb[1]) + PopCount(pa[2] ^ pb[2]) + PopCount(pa[3] ^ pb[3]);
+	}
 
-		const int *pa = a.ptr<int32_t>();
-		const int *pb = b.ptr<int32_t>();
+	void ORBmatcher::DescriptorDistances(const uchar *pQuery, const cv::Mat &descriptors, const vector<size_t> &vIndices, vector<int> &vDists) {
 
-		int dist = 0;
+		// the query stays in registers for all candidates
+		const uint64_t *pq = (const uint64_t*)pQuery;
+		const uint64_t q0 = pq[0], q1 = pq[1], q2 = pq[2], q3 = pq[3];
 
-		for (int i = 0; i < 8; i++, pa++, pb++) {
-			unsigned  int v = *pa ^ *pb;
-			v = v - ((v >> 1) & 0x55555555);
-			v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-			dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+		vDists.resize(vIndices.size());
+
+		for (size_t i = 0; i < vIndices.size(); i++) {
+			const uint64_t *pd = descriptors.ptr<uint64_t>((int)vIndices[i]);
+			vDists[i] = PopCount(q0 ^ pd[0]) + PopCount(q1 ^ pd[1]) + PopCount(q2 ^ pd[2]) + PopCount(q3 ^ pd[3]);
 		}
+	}
+
+	void ORBmatcher::DescriptorDistances(const cv::Mat &descriptors1, const vector<unsigned int> &vIndices1,
+		const cv::Mat &descriptors2, const vector<unsigned int> &vIndices2, vector<int> &vDists) {
+
+		const size_t N1 = vIndices1.size();
+		const size_t N2 = vIndices2.size();
 
-		return dist;
+		vDists.resize(N1*N2);
+		if (vDists.empty())
+			return;
+
+		for (size_t i1 = 0; i1 < N1; i1++) {
+			const uint64_t *pq = descriptors1.ptr<uint64_t>((int)vIndices1[i1]);
+			const uint64_t q0 = pq[0], q1 = pq[1], q2 = pq[2], q3 = pq[3];
+
+			int *pDists = &vDists[i1*N2];
+			for (size_t i2 = 0; i2 < N2; i2++) {
+				const uint64_t *pd = descriptors2.ptr<uint64_t>((int)vIndices2[i2]);
+				pDists[i2] = PopCount(q0 ^ pd[0]) + PopCount(q1 ^ pd[1]) + PopCount(q2 ^ pd[2]) + PopCount(q3 ^ pd[3]);
+			}
+		}
 	}
 	
 	bool ORBmatcher::CheckDistEpipolarLine(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const cv::Mat &F12, const KeyFrame* pKF2) {
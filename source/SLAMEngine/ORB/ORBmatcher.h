@@ -89,6 +89,15 @@ namespace SLAMRecon {
 		
 		// ORB descriptor256λ֮ĺ 
 		static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
+		static int DescriptorDistance(const uchar *a, const uchar *b);
+
+		// Hamming distances of one descriptor to the rows vIndices of descriptors, vDists[i] is the distance to row vIndices[i]
+		static void DescriptorDistances(const uchar *pQuery, const cv::Mat &descriptors, const vector<size_t> &vIndices, vector<int> &vDists);
+
+		// Hamming distances of the rows vIndices1 of descriptors1 to the rows vIndices2 of descriptors2,
+		// vDists[i1*vIndices2.size() + i2] is the distance of row vIndices1[i1] to row vIndices2[i2]
+		static void DescriptorDistances(const cv::Mat &descriptors1, const vector<unsigned int> &vIndices1,
+			const cv::Mat &descriptors2, const vector<unsigned int> &vIndices2, vector<int> &vDists);
 
 		// ҪLoop ClosingComputeSim3
 		// pKF1pKF2KeyFramevpMatches12SearchByBoWKeyFrame֮MapPointĹϵԼй˹ˣֵֻȥһЩƥ쳣ֵ
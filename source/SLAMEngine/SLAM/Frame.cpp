@@ -38,16 +38,56 @@ namespace SLAMRecon {
 	Frame::Frame(const Frame &frame) 
 		: m_nFId(frame.m_nFId), m_rgbImg(frame.m_rgbImg.clone()), m_pReferenceKF(frame.m_pReferenceKF), m_pORBvocabulary(frame.m_pORBvocabulary), m_ORBextractor(frame.m_ORBextractor),
 		m_nKeys(frame.m_nKeys), m_vKeys(frame.m_vKeys), m_vKeysUn(frame.m_vKeysUn), m_vpMapPoints(frame.m_vpMapPoints), m_vbOutlier(frame.m_vbOutlier),
-		m_Descriptors(frame.m_Descriptors.clone()), m_BowVec(frame.m_BowVec), m_FeatVec(frame.m_FeatVec), m_vfDepth(frame.m_vfDepth), m_vuRight(frame.m_vuRight), m_fThDepth(frame.m_fThDepth)
+		m_Descriptors(frame.m_Descriptors.clone()), m_BowVec(frame.m_BowVec), m_FeatVec(frame.m_FeatVec), m_vfDepth(frame.m_vfDepth), m_vuRight(frame.m_vuRight), m_fThDepth(frame.m_fThDepth),
+		m_GridStarts(frame.m_GridStarts), m_GridIndices(frame.m_GridIndices), m_GridX(frame.m_GridX), m_GridY(frame.m_GridY), m_GridOctaves(frame.m_GridOctaves)
 	{
-		for (int i = 0; i < FRAME_GRID_COLS; i++)
-			for (int j = 0; j < FRAME_GRID_ROWS; j++)
-				m_Grid[i][j] = frame.m_Grid[i][j];
-
 		if (!frame.m_Transformation.empty())
 			SetPose(frame.m_Transformation);
 	}
 
+	Frame::Frame(Frame &&frame) {
+		*this = std::move(frame);
+	}
+
+	Frame& Frame::operator=(Frame &&frame) {
+		if (this == &frame)
+			return *this;
+
+		m_nFId = frame.m_nFId;
+		m_rgbImg = frame.m_rgbImg;
+		m_pReferenceKF = frame.m_pReferenceKF;
+		m_pORBvocabulary = frame.m_pORBvocabulary;
+		m_ORBextractor = frame.m_ORBextractor;
+		m_nKeys = frame.m_nKeys;
+		m_vKeys = std::move(frame.m_vKeys);
+		m_vKeysUn = std::move(frame.m_vKeysUn);
+		m_vpMapPoints = std::move(frame.m_vpMapPoints);
+		m_vbOutlier = std::move(frame.m_vbOutlier);
+		m_Descriptors = frame.m_Descriptors;
+		m_BowVec.swap(frame.m_BowVec);
+		m_FeatVec.swap(frame.m_FeatVec);
+		m_vuRight = std::move(frame.m_vuRight);
+		m_vfDepth = std::move(frame.m_vfDepth);
+		m_fThDepth = frame.m_fThDepth;
+		m_Transformation = frame.m_Transformation;
+		m_GridStarts = std::move(frame.m_GridStarts);
+		m_GridIndices = std::move(frame.m_GridIndices);
+		m_GridX = std::move(frame.m_GridX);
+		m_GridY = std::move(frame.m_GridY);
+		m_GridOctaves = std::move(frame.m_GridOctaves);
+		m_R = frame.m_R;
+		m_t = frame.m_t;
+		m_C = frame.m_C;
+
+		return *this;
+	}
+
+	Frame& Frame::operator=(const Frame &frame) {
+		if (this != &frame)
+			*this = Frame(frame);
+		return *this;
+	}
+
 	Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth, ORBextractor* extractor, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, float m_bf, float m_fThDepth)
 		:m_ORBextractor(extractor), m_pORBvocabulary(voc), m_fThDepth(m_fThDepth)
 	{
@@ -235,55 +275,57 @@ namespace SLAMRecon {
 	}
 
 	vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const float  &r, const int minLevel, const int maxLevel) const {
-		 
-		vector<size_t> vIndices; 
-		vIndices.reserve(m_nKeys);
-		 
+		vector<size_t> vIndices;
+		GetFeaturesInArea(x, y, r, vIndices, minLevel, maxLevel);
+		return vIndices;
+	}
+
+	void Frame::GetFeaturesInArea(const float &x, const float &y, const float &r, vector<size_t> &vIndices, const int minLevel, const int maxLevel) const {
+
+		vIndices.clear();
+
+		if (m_GridStarts.empty())
+			return;
+
 		const int nMinCellX = max(0, (int)floor((x - m_pCameraInfo->m_nMinX - r)*m_pGridInfo->m_fGridElementWidthInv)); 
 		if (nMinCellX >= FRAME_GRID_COLS)
-			return vIndices;
+			return;
 
 		const int nMaxCellX = min((int)FRAME_GRID_COLS - 1, (int)ceil((x - m_pCameraInfo->m_nMinX + r)*m_pGridInfo->m_fGridElementWidthInv));
 		if (nMaxCellX < 0)
-			return vIndices;
+			return;
 
 		const int nMinCellY = max(0, (int)floor((y - m_pCameraInfo->m_nMinY - r)*m_pGridInfo->m_fGridElementHeightInv));
 		if (nMinCellY >= FRAME_GRID_ROWS)
-			return vIndices;
+			return;
 
 		const int nMaxCellY = min((int)FRAME_GRID_ROWS - 1, (int)ceil((y - m_pCameraInfo->m_nMinY + r)*m_pGridInfo->m_fGridElementHeightInv));
 		if (nMaxCellY < 0)
-			return vIndices;
+			return;
 		 
 		const bool bCheckLevels = (minLevel>0) || (maxLevel >= 0);
 		 
 		for (int ix = nMinCellX; ix <= nMaxCellX; ix++) { 
-			for (int iy = nMinCellY; iy <= nMaxCellY; iy++) { 
-				 
-				const vector<size_t> vCell = m_Grid[ix][iy];
-				if (vCell.empty())
-					continue;
-				 
-				for (size_t j = 0, jend = vCell.size(); j < jend; j++) {
-
-					const cv::KeyPoint &kpUn = m_vKeysUn[vCell[j]];
-					 
-					if (bCheckLevels) { 
-						if (kpUn.octave < minLevel)
-							continue; 
-						if (maxLevel >= 0)
-							if (kpUn.octave > maxLevel)
-								continue;
-					}
-					 
-					const float distx = kpUn.pt.x - x;
-					const float disty = kpUn.pt.y - y;
-					if (fabs(distx) < r && fabs(disty) < r)
-						vIndices.push_back(vCell[j]);
+
+			// the cells nMinCellY to nMaxCellY of the column are one run of the grid
+			const unsigned int kend = m_GridStarts[ix*FRAME_GRID_ROWS + nMaxCellY + 1];
+
+			for (unsigned int k = m_GridStarts[ix*FRAME_GRID_ROWS + nMinCellY]; k < kend; k++) {
+
+				if (bCheckLevels) { 
+					if (m_GridOctaves[k] < minLevel)
+						continue; 
+					if (maxLevel >= 0)
+						if (m_GridOctaves[k] > maxLevel)
+							continue;
 				}
+				 
+				const float distx = m_GridX[k] - x;
+				const float disty = m_GridY[k] - y;
+				if (fabs(distx) < r && fabs(disty) < r)
+					vIndices.push_back(m_GridIndices[k]);
 			}
 		}
-		return vIndices;
 	}
 
 	bool Frame::IsInImage(const float &x, const float &y) const {
@@ -351,17 +393,41 @@ namespace SLAMRecon {
 	}
 
 	void Frame::AssignFeaturesToGrid() { 
-		int nReserve = 0.5f*m_nKeys / (FRAME_GRID_COLS*FRAME_GRID_ROWS); 
+		const int nCells = FRAME_GRID_COLS*FRAME_GRID_ROWS;
+
+		// Count the keypoints of each cell, keypoints outside the grid get cell -1.
+		vector<int> vCells(m_nKeys, -1);
+		m_GridStarts.assign(nCells + 1, 0);
 
-		for (unsigned int i = 0; i < FRAME_GRID_COLS; i++)
-			for (unsigned int j = 0; j < FRAME_GRID_ROWS; j++)
-				m_Grid[i][j].reserve(nReserve);
-		 
 		for (int i = 0; i < m_nKeys; i++) {
-			const cv::KeyPoint &kp = m_vKeysUn[i];
 			int nGridPosX, nGridPosY;
-			if (PosInGrid(kp, nGridPosX, nGridPosY))
-				m_Grid[nGridPosX][nGridPosY].push_back(i);
+			if (PosInGrid(m_vKeysUn[i], nGridPosX, nGridPosY)) {
+				vCells[i] = nGridPosX*FRAME_GRID_ROWS + nGridPosY;
+				m_GridStarts[vCells[i] + 1]++;
+			}
+		}
+
+		for (int c = 0; c < nCells; c++)
+			m_GridStarts[c + 1] += m_GridStarts[c];
+
+		const unsigned int nInGrid = m_GridStarts[nCells];
+		m_GridIndices.resize(nInGrid);
+		m_GridX.resize(nInGrid);
+		m_GridY.resize(nInGrid);
+		m_GridOctaves.resize(nInGrid);
+
+		// The keypoints of a cell stay in ascending order.
+		vector<unsigned int> vNext(m_GridStarts.begin(), m_GridStarts.end() - 1);
+		for (int i = 0; i < m_nKeys; i++) {
+			if (vCells[i] < 0)
+				continue;
+
+			const unsigned int k = vNext[vCells[i]]++;
+			const cv::KeyPoint &kp = m_vKeysUn[i];
+			m_GridIndices[k] = i;
+			m_GridX[k] = kp.pt.x;
+			m_GridY[k] = kp.pt.y;
+			m_GridOctaves[k] = kp.octave;
 		}
 	}
 
@@ -43,6 +43,11 @@ namespace SLAMRecon {
 		
 		// Copy constructor.
 		Frame(const Frame &frame);
+
+		// Move constructor and assignments, moving a frame only hands over its buffers.
+		Frame(Frame &&frame);
+		Frame& operator=(Frame &&frame);
+		Frame& operator=(const Frame &frame);
 		
 		// Constructor for RGB-D cameras.
 		Frame(const cv::Mat &imGray, const cv::Mat &imDepth, ORBextractor* extractor, ORBVocabulary* voc, cv::Mat &K, cv::Mat &distCoef, float m_bf, float m_fThDepth);
@@ -80,6 +85,9 @@ namespace SLAMRecon {
 		
 		// Returns the feature indexes in area. (x,y) is the center coordinate and r is the radius of this area.
 		vector<size_t> GetFeaturesInArea(const float &x, const float  &y, const float  &r, const int minLevel = -1, const int maxLevel = -1) const;
+
+		// The same into vIndices, which keeps its memory from one query to the next.
+		void GetFeaturesInArea(const float &x, const float &y, const float &r, vector<size_t> &vIndices, const int minLevel = -1, const int maxLevel = -1) const;
 		
 		//Check (x,y) is in the image.
 		bool IsInImage(const float &x, const float &y) const;
@@ -138,8 +146,14 @@ namespace SLAMRecon {
 		static CameraInfo* m_pCameraInfo;
 		
 		// Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
+		// The keypoints of cell c = x*FRAME_GRID_ROWS + y are m_GridIndices[m_GridStarts[c]] to m_GridIndices[m_GridStarts[c + 1] - 1],
+		// so the cells of a grid column are consecutive. The undistorted position and octave of each keypoint are kept alongside.
 		static GridInfo* m_pGridInfo;
-		std::vector<size_t> m_Grid[FRAME_GRID_COLS][FRAME_GRID_ROWS]; 
+		std::vector<unsigned int> m_GridStarts;
+		std::vector<unsigned int> m_GridIndices;
+		std::vector<float> m_GridX;
+		std::vector<float> m_GridY;
+		std::vector<int> m_GridOctaves;
 		
 		// Only initialize once for pyramid info, camera calibration matrix, and so on.
 		static bool m_bInitialComputations;
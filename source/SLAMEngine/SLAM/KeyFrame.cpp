@@ -37,7 +37,7 @@ namespace SLAMRecon {
 	KeyFrame::KeyFrame() :Frame() {}
 
 	KeyFrame::KeyFrame(Frame& frame) 
-		: Frame(frame), m_nTrackReferenceForFrame(0), m_nFuseTargetForKF(0), mnRelocQuery(0), mnRelocWords(0), mRelocScore(0),
+		: Frame(frame), m_nTrackReferenceForFrame(0), m_nFuseTargetForKF(0),
 		m_bNotErase(false), m_bToBeErased(false), m_bBad(false), m_FirstFusion(true)
 	{
 		m_nKFId = m_nKFNextId++;
@@ -75,14 +75,6 @@ namespace SLAMRecon {
 		 
 		long unsigned int m_nKFId;
 		
-		// Variables used by the keyframe database
-		long unsigned int mnRelocQuery; 
-		int mnRelocWords; 
-		float mRelocScore; 
-		long unsigned int m_nLoopQuery;  
-		int m_nLoopWords; 
-		float m_LoopScore; 
-		
 		// Variables used by the tracking
 		long unsigned int m_nTrackReferenceForFrame; 
 		long unsigned int m_nFuseTargetForKF;     
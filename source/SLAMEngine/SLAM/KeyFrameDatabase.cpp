@@ -24,7 +24,7 @@ using namespace std;
 
 namespace SLAMRecon{
 	KeyFrameDatabase::KeyFrameDatabase(const ORBVocabulary* voc, CovisibilityGraph* cograph)
-		:m_pVoc(voc), m_pCoGraph(cograph)
+		:m_pVoc(voc), m_pCoGraph(cograph), m_nEntries(0), m_nErasedEntries(0)
 	{
 		m_vInvertedFile.resize(voc->size());
 	}
@@ -35,108 +35,162 @@ namespace SLAMRecon{
 
 	void KeyFrameDatabase::add(KeyFrame* pKF) {
 		unique_lock<mutex> lock(m_DBMutex);
-		
+
+		const unsigned int nId = (unsigned int)pKF->m_nKFId;
+		if (nId >= m_vpKeyFrames.size()) {
+			m_vpKeyFrames.resize(nId + 1, static_cast<KeyFrame*>(NULL));
+			m_vnEntries.resize(nId + 1, 0);
+		}
+
+		if (m_vpKeyFrames[nId] == pKF)
+			return;
+
+		// The keyframe was erased before, its old entries must go first
+		if (m_vnEntries[nId] > 0)
+			Compact();
+
 		for (DBoW2::BowVector::const_iterator vit = pKF->m_BowVec.begin(), vend = pKF->m_BowVec.end(); vit != vend; vit++)
-			m_vInvertedFile[vit->first].push_back(pKF);
+			m_vInvertedFile[vit->first].push_back(nId);
+
+		m_vpKeyFrames[nId] = pKF;
+		m_vnEntries[nId] = (int)pKF->m_BowVec.size();
+		m_nEntries += pKF->m_BowVec.size();
 	}
 
 	void KeyFrameDatabase::erase(KeyFrame* pKF) {
 		unique_lock<mutex> lock(m_DBMutex); 
-		for (DBoW2::BowVector::const_iterator vit = pKF->m_BowVec.begin(), vend = pKF->m_BowVec.end(); vit != vend; vit++) { 
-			list<KeyFrame*> &lKFs = m_vInvertedFile[vit->first]; 
-			for (list<KeyFrame*>::iterator lit = lKFs.begin(), lend = lKFs.end(); lit != lend; lit++) {
-				if (pKF == *lit) {
-					lKFs.erase(lit);
-					break;
-				}
-			}
-		}
+
+		const unsigned int nId = (unsigned int)pKF->m_nKFId;
+		if (nId >= m_vpKeyFrames.size() || m_vpKeyFrames[nId] != pKF)
+			return;
+
+		// The entries are left in the inverted file and skipped, until a quarter of them are erased
+		m_vpKeyFrames[nId] = static_cast<KeyFrame*>(NULL);
+		m_nErasedEntries += m_vnEntries[nId];
+
+		if (4 * m_nErasedEntries > m_nEntries)
+			Compact();
 	}
 
 	void KeyFrameDatabase::clear() {
+		unique_lock<mutex> lock(m_DBMutex);
+
 		m_vInvertedFile.clear();
 		m_vInvertedFile.resize(m_pVoc->size());
+		m_vpKeyFrames.clear();
+		m_vnEntries.clear();
+		m_nEntries = 0;
+		m_nErasedEntries = 0;
+	}
+
+	void KeyFrameDatabase::Compact() {
+		for (size_t i = 0; i < m_vInvertedFile.size(); i++) {
+			vector<unsigned int> &vKFIds = m_vInvertedFile[i];
+
+			// The order of the remaining keyframes is kept
+			vector<unsigned int>::iterator vend = vKFIds.begin();
+			for (vector<unsigned int>::iterator vit = vKFIds.begin(); vit != vKFIds.end(); vit++) {
+				if (m_vpKeyFrames[*vit] != NULL)
+					*vend++ = *vit;
+			}
+			vKFIds.erase(vend, vKFIds.end());
+		}
+
+		for (size_t nId = 0; nId < m_vpKeyFrames.size(); nId++) {
+			if (m_vpKeyFrames[nId] == NULL)
+				m_vnEntries[nId] = 0;
+		}
+
+		m_nEntries -= m_nErasedEntries;
+		m_nErasedEntries = 0;
 	}
 
 	vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
 	{
-		list<KeyFrame*> lKFsSharingWords; 
+		// Number of words each keyframe shares with the frame, by keyframe id
+		vector<int> vnCommonWords;
+		vector<KeyFrame*> vpKFsSharingWords; 
 		{
 			unique_lock<mutex> lock(m_DBMutex);
 
+			vnCommonWords.assign(m_vpKeyFrames.size(), 0);
+
 			for (DBoW2::BowVector::const_iterator vit = F->m_BowVec.begin(), vend = F->m_BowVec.end(); vit != vend; vit++) {
 
-				list<KeyFrame*> &lKFs = m_vInvertedFile[vit->first];
+				const vector<unsigned int> &vKFIds = m_vInvertedFile[vit->first];
 
-				for (list<KeyFrame*>::iterator lit = lKFs.begin(), lend = lKFs.end(); lit != lend; lit++) {
+				for (vector<unsigned int>::const_iterator kit = vKFIds.begin(), kend = vKFIds.end(); kit != kend; kit++) {
 
-					KeyFrame* pKFi = *lit; 
-					if (pKFi->mnRelocQuery != F->m_nFId) {
-						pKFi->mnRelocWords = 0;
-						pKFi->mnRelocQuery = F->m_nFId;
-						lKFsSharingWords.push_back(pKFi);
-					}
-					pKFi->mnRelocWords++;
+					KeyFrame* pKFi = m_vpKeyFrames[*kit];
+					if (pKFi == NULL)
+						continue;
+
+					if (vnCommonWords[*kit]++ == 0)
+						vpKFsSharingWords.push_back(pKFi);
 				}
 			}
 		} 
-		if (lKFsSharingWords.empty())
+		if (vpKFsSharingWords.empty())
 			return vector<KeyFrame*>();
-		cout << "lKFsSharingWords.size() " << lKFsSharingWords.size() << endl;
+		cout << "vpKFsSharingWords.size() " << vpKFsSharingWords.size() << endl;
 		 
 		int maxCommonWords = 0;
-		for (list<KeyFrame*>::iterator lit = lKFsSharingWords.begin(), lend = lKFsSharingWords.end(); lit != lend; lit++) {
-			if ((*lit)->mnRelocWords > maxCommonWords)
-				maxCommonWords = (*lit)->mnRelocWords;
+		for (vector<KeyFrame*>::iterator vit = vpKFsSharingWords.begin(), vend = vpKFsSharingWords.end(); vit != vend; vit++) {
+			if (vnCommonWords[(*vit)->m_nKFId] > maxCommonWords)
+				maxCommonWords = vnCommonWords[(*vit)->m_nKFId];
 		}
 		 
 		int minCommonWords = maxCommonWords*0.8f;
 
-
-		int nscores = 0;  
-		list<pair<float, KeyFrame*> > lScoreAndMatch;  
-		 
-		for (list<KeyFrame*>::iterator lit = lKFsSharingWords.begin(), lend = lKFsSharingWords.end(); lit != lend; lit++) {
-
-			KeyFrame* pKFi = *lit;
-
-			if (pKFi->mnRelocWords > minCommonWords) {
-				nscores++;
-				float si = m_pVoc->score(F->m_BowVec, pKFi->m_BowVec); 
-				pKFi->mRelocScore = si;  
-				lScoreAndMatch.push_back(make_pair(si, pKFi));
-			}
+		vector<KeyFrame*> vpKFsToScore;
+		for (vector<KeyFrame*>::iterator vit = vpKFsSharingWords.begin(), vend = vpKFsSharingWords.end(); vit != vend; vit++) {
+			if (vnCommonWords[(*vit)->m_nKFId] > minCommonWords)
+				vpKFsToScore.push_back(*vit);
 		}
 		 
-		if (lScoreAndMatch.empty())
+		if (vpKFsToScore.empty())
 			return vector<KeyFrame*>();
-		cout << "lScoreAndMatch.size() " << lScoreAndMatch.size() << endl;
-		 
-
-		list<pair<float, KeyFrame*> > lAccScoreAndMatch;  
+		cout << "vpKFsToScore.size() " << vpKFsToScore.size() << endl;
+
+		vector<float> vScores(vpKFsToScore.size());
+		const int nKFsToScore = (int)vpKFsToScore.size();
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < nKFsToScore; i++)
+			vScores[i] = (float)m_pVoc->score(F->m_BowVec, vpKFsToScore[i]->m_BowVec);
+
+		// Scores by keyframe id, 0 for the keyframes that were not scored
+		vector<float> vRelocScores(vnCommonWords.size(), 0);
+		for (int i = 0; i < nKFsToScore; i++)
+			vRelocScores[vpKFsToScore[i]->m_nKFId] = vScores[i];
+
+		vector<pair<float, KeyFrame*> > vAccScoreAndMatch;  
+		vAccScoreAndMatch.reserve(nKFsToScore);
 		float bestAccScore = 0;
 
-		for (list<pair<float, KeyFrame*> >::iterator it = lScoreAndMatch.begin(), itend = lScoreAndMatch.end(); it != itend; it++) {
-			KeyFrame* pKFi = it->second;
+		for (int i = 0; i < nKFsToScore; i++) {
+			KeyFrame* pKFi = vpKFsToScore[i];
 			 
 			vector<KeyFrame*> vpNeighs = m_pCoGraph->GetBestCovisibilityKeyFrames(pKFi,10);
 
-			float bestScore = it->first;
+			float bestScore = vScores[i];
 			float accScore = bestScore;
 			KeyFrame* pBestKF = pKFi;
 			for (vector<KeyFrame*>::iterator vit = vpNeighs.begin(), vend = vpNeighs.end(); vit != vend; vit++) {
 				KeyFrame* pKF2 = *vit;
 
-				if (pKF2->mnRelocQuery != F->m_nFId)
+				if (pKF2->m_nKFId >= vnCommonWords.size() || vnCommonWords[pKF2->m_nKFId] == 0)
 					continue;
 
-				accScore += pKF2->mRelocScore;
-				if (pKF2->mRelocScore > bestScore) {
+				const float score2 = vRelocScores[pKF2->m_nKFId];
+				accScore += score2;
+				if (score2 > bestScore) {
 					pBestKF = pKF2;
-					bestScore = pKF2->mRelocScore;
+					bestScore = score2;
 				}
 			}
-			lAccScoreAndMatch.push_back(make_pair(accScore, pBestKF));
+			vAccScoreAndMatch.push_back(make_pair(accScore, pBestKF));
 			if (accScore > bestAccScore)
 				bestAccScore = accScore;
 		}
@@ -145,8 +199,8 @@ namespace SLAMRecon{
 
 		set<KeyFrame*> spAlreadyAddedKF;  
 		vector<KeyFrame*> vpRelocCandidates;  
-		vpRelocCandidates.reserve(lAccScoreAndMatch.size());
-		for (list<pair<float, KeyFrame*> >::iterator it = lAccScoreAndMatch.begin(), itend = lAccScoreAndMatch.end(); it != itend; it++) {
+		vpRelocCandidates.reserve(vAccScoreAndMatch.size());
+		for (vector<pair<float, KeyFrame*> >::iterator it = vAccScoreAndMatch.begin(), itend = vAccScoreAndMatch.end(); it != itend; it++) {
 			const float &si = it->first;
 			if (si > minScoreToRetain) {
 				KeyFrame* pKFi = it->second;
@@ -163,66 +217,79 @@ namespace SLAMRecon{
 	vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore) {
 		 
 		set<KeyFrame*> spConnectedKeyFrames = m_pCoGraph->GetConnectedKeyFrames(pKF);
-		list<KeyFrame*> lKFsSharingWords;
+
+		// Number of words each keyframe shares with the keyframe, by keyframe id, -1 for the connected keyframes
+		vector<int> vnCommonWords;
+		vector<KeyFrame*> vpKFsSharingWords;
 		{
 			unique_lock<mutex> lock(m_DBMutex);
 
+			vnCommonWords.assign(m_vpKeyFrames.size(), 0);
+			for (set<KeyFrame*>::iterator sit = spConnectedKeyFrames.begin(), send = spConnectedKeyFrames.end(); sit != send; sit++) {
+				if ((*sit)->m_nKFId < vnCommonWords.size())
+					vnCommonWords[(*sit)->m_nKFId] = -1;
+			}
+
 			for (DBoW2::BowVector::const_iterator vit = pKF->m_BowVec.begin(), vend = pKF->m_BowVec.end(); vit != vend; vit++) {
 
-				list<KeyFrame*> &lKFs = m_vInvertedFile[vit->first];
+				const vector<unsigned int> &vKFIds = m_vInvertedFile[vit->first];
 
-				for (list<KeyFrame*>::iterator lit = lKFs.begin(), lend = lKFs.end(); lit != lend; lit++) {
-					KeyFrame* pKFi = *lit;
-					if (pKFi->m_nLoopQuery != pKF->m_nKFId) {
-						pKFi->m_nLoopWords = 0;
-						if (!spConnectedKeyFrames.count(pKFi)) {
-							pKFi->m_nLoopQuery = pKF->m_nKFId;
-							lKFsSharingWords.push_back(pKFi);
-						}
-					}
-					pKFi->m_nLoopWords++;
+				for (vector<unsigned int>::const_iterator kit = vKFIds.begin(), kend = vKFIds.end(); kit != kend; kit++) {
+					KeyFrame* pKFi = m_vpKeyFrames[*kit];
+					if (pKFi == NULL || vnCommonWords[*kit] < 0)
+						continue;
+
+					if (vnCommonWords[*kit]++ == 0)
+						vpKFsSharingWords.push_back(pKFi);
 				}
 			}
 		}
 		 
-		if (lKFsSharingWords.empty())
+		if (vpKFsSharingWords.empty())
 			return vector<KeyFrame*>();
 
-		cout << "lKFsSharingWords.size() " << lKFsSharingWords.size() << endl;
+		cout << "vpKFsSharingWords.size() " << vpKFsSharingWords.size() << endl;
 		 
 		int maxCommonWords = 0;
-		for (list<KeyFrame*>::iterator lit = lKFsSharingWords.begin(), lend = lKFsSharingWords.end(); lit != lend; lit++) {
-			if ((*lit)->m_nLoopWords > maxCommonWords)
-				maxCommonWords = (*lit)->m_nLoopWords;
+		for (vector<KeyFrame*>::iterator vit = vpKFsSharingWords.begin(), vend = vpKFsSharingWords.end(); vit != vend; vit++) {
+			if (vnCommonWords[(*vit)->m_nKFId] > maxCommonWords)
+				maxCommonWords = vnCommonWords[(*vit)->m_nKFId];
 		} 
 		int minCommonWords = maxCommonWords*0.8f;
 
-		int nscores = 0;  
-		list<pair<float, KeyFrame*> > lScoreAndMatch;  
-		 
-		for (list<KeyFrame*>::iterator lit = lKFsSharingWords.begin(), lend = lKFsSharingWords.end(); lit != lend; lit++) {
-			KeyFrame* pKFi = *lit;
-
-			if (pKFi->m_nLoopWords > minCommonWords) {
-				nscores++;
-
-				float si = m_pVoc->score(pKF->m_BowVec, pKFi->m_BowVec);  
+		vector<KeyFrame*> vpKFsToScore;
+		for (vector<KeyFrame*>::iterator vit = vpKFsSharingWords.begin(), vend = vpKFsSharingWords.end(); vit != vend; vit++) {
+			if (vnCommonWords[(*vit)->m_nKFId] > minCommonWords)
+				vpKFsToScore.push_back(*vit);
+		}
 
-				pKFi->m_LoopScore = si;   
-				if (si >= minScore)  
-					lScoreAndMatch.push_back(make_pair(si, pKFi));
-			}
+		vector<float> vScores(vpKFsToScore.size());
+		const int nKFsToScore = (int)vpKFsToScore.size();
+#ifdef WITH_OPENMP
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < nKFsToScore; i++)
+			vScores[i] = (float)m_pVoc->score(pKF->m_BowVec, vpKFsToScore[i]->m_BowVec);
+
+		// Scores by keyframe id, also of the keyframes below minScore, which still count for their neighbours
+		vector<float> vLoopScores(vnCommonWords.size(), 0);
+		vector<pair<float, KeyFrame*> > vScoreAndMatch;
+		for (int i = 0; i < nKFsToScore; i++) {
+			vLoopScores[vpKFsToScore[i]->m_nKFId] = vScores[i];
+			if (vScores[i] >= minScore)  
+				vScoreAndMatch.push_back(make_pair(vScores[i], vpKFsToScore[i]));
 		}
 		 
-		if (lScoreAndMatch.empty())
+		if (vScoreAndMatch.empty())
 			return vector<KeyFrame*>();
 
-		cout << "lScoreAndMatch.size() " << lScoreAndMatch.size() << endl;
+		cout << "vScoreAndMatch.size() " << vScoreAndMatch.size() << endl;
 		  
-		list<pair<float, KeyFrame*> > lAccScoreAndMatch;  
+		vector<pair<float, KeyFrame*> > vAccScoreAndMatch;  
+		vAccScoreAndMatch.reserve(vScoreAndMatch.size());
 		float bestAccScore = minScore;  
 
-		for (list<pair<float, KeyFrame*> >::iterator it = lScoreAndMatch.begin(), itend = lScoreAndMatch.end(); it != itend; it++) {
+		for (vector<pair<float, KeyFrame*> >::iterator it = vScoreAndMatch.begin(), itend = vScoreAndMatch.end(); it != itend; it++) {
 			KeyFrame* pKFi = it->second;
 			 
 			vector<KeyFrame*> vpNeighs = m_pCoGraph->GetBestCovisibilityKeyFrames(pKFi, 10);
@@ -232,16 +299,17 @@ namespace SLAMRecon{
 			KeyFrame* pBestKF = pKFi;
 			for (vector<KeyFrame*>::iterator vit = vpNeighs.begin(), vend = vpNeighs.end(); vit != vend; vit++) {
 				KeyFrame* pKF2 = *vit;
-				if (pKF2->m_nLoopQuery == pKF->m_nKFId && pKF2->m_nLoopWords > minCommonWords) {
-					accScore += pKF2->m_LoopScore;
-					if (pKF2->m_LoopScore > bestScore) {
+				if (pKF2->m_nKFId < vnCommonWords.size() && vnCommonWords[pKF2->m_nKFId] > minCommonWords) {
+					const float score2 = vLoopScores[pKF2->m_nKFId];
+					accScore += score2;
+					if (score2 > bestScore) {
 						pBestKF = pKF2;
-						bestScore = pKF2->m_LoopScore;
+						bestScore = score2;
 					}
 				}
 			}
 
-			lAccScoreAndMatch.push_back(make_pair(accScore, pBestKF));
+			vAccScoreAndMatch.push_back(make_pair(accScore, pBestKF));
 			if (accScore > bestAccScore)
 				bestAccScore = accScore;
 		}
@@ -250,9 +318,9 @@ namespace SLAMRecon{
 
 		set<KeyFrame*> spAlreadyAddedKF;  
 		vector<KeyFrame*> vpLoopCandidates;  
-		vpLoopCandidates.reserve(lAccScoreAndMatch.size());
+		vpLoopCandidates.reserve(vAccScoreAndMatch.size());
 
-		for (list<pair<float, KeyFrame*> >::iterator it = lAccScoreAndMatch.begin(), itend = lAccScoreAndMatch.end(); it != itend; it++) {
+		for (vector<pair<float, KeyFrame*> >::iterator it = vAccScoreAndMatch.begin(), itend = vAccScoreAndMatch.end(); it != itend; it++) {
 			if (it->first > minScoreToRetain) {
 				KeyFrame* pKFi = it->second;
 				if (!spAlreadyAddedKF.count(pKFi)) {
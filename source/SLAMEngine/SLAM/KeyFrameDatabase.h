@@ -22,7 +22,6 @@
 #define _KEY_FRAME_DATABASE_H_
 
 #include <vector>
-#include <list>
 #include "../ORB/ORBVocabulary.h"
 #include "CovisibilityGraph.h"
 #include "KeyFrame.h"
@@ -50,14 +49,27 @@ namespace SLAMRecon{
 		std::vector<KeyFrame *> DetectLoopCandidates(KeyFrame* pKF, float minScore);
 
 	protected:
+
+		// Drops the entries of erased keyframes from the inverted file
+		void Compact();
 		
 		// Associated vocabulary
 		const ORBVocabulary* m_pVoc;
 		 
 		CovisibilityGraph* m_pCoGraph;
 		
-		// Inverted file
-		std::vector<list<KeyFrame*> > m_vInvertedFile;
+		// Inverted file, the ids of the keyframes that contain each word
+		std::vector<std::vector<unsigned int> > m_vInvertedFile;
+
+		// Keyframes by id, NULL if not in the database. The ids of erased keyframes stay in the inverted file until it is compacted
+		std::vector<KeyFrame*> m_vpKeyFrames;
+
+		// Number of entries of each keyframe in the inverted file
+		std::vector<int> m_vnEntries;
+
+		// Number of entries in the inverted file, and of those that belong to erased keyframes
+		size_t m_nEntries;
+		size_t m_nErasedEntries;
 		 
 		std::mutex m_DBMutex;
 	};
@@ -25,7 +25,11 @@ using namespace cv;
 namespace SLAMRecon {
 	
 
+	// Frames the Tracking may run ahead of the fusion.
+	static const int nFramePosesQueueSize = 64;
+
 	Map::Map():
+		m_FramePoses(nFramePosesQueueSize),
 		m_nMaxKFid(0){
 
 	}
@@ -100,12 +104,14 @@ namespace SLAMRecon {
 
 
 		//
-		m_lRelativeFramePoses.clear();
-		m_lpReferences.clear();
-		m_lbLost.clear();
-		m_lbKF.clear();
-		m_lpFIdAndPoses.clear();
-		m_modifiedKeyFrames.clear();
+		m_vRelativeFramePoses.clear();
+		m_vpReferences.clear();
+		m_vbLost.clear();
+		m_vbKF.clear();
+		m_mKFChildFrames.clear();
+		m_FramePoses.Clear();
+		m_dModifiedKeyFrames.clear();
+		m_sModifiedKeyFrames.clear();
 		m_CurFramePose = Mat();
 	}
 
@@ -124,61 +130,59 @@ namespace SLAMRecon {
 
 
 	void Map::addIdAndPose(int fId, Mat pose) {
-		unique_lock<mutex> lock(m_MutexFIdAndPoses);
-		pair<int, Mat> fIdAndPose(fId, pose);
-		m_lpFIdAndPoses.push_back(fIdAndPose);
-	}
-	pair<int, Mat>  Map::getIdAndPose(){
-		unique_lock<mutex> lock(m_MutexFIdAndPoses);
-		pair<int, Mat> fIdAndPose(-1, cv::Mat::eye(0, 0, CV_32F));
-		if (m_lpFIdAndPoses.empty())
-			return fIdAndPose;
-		fIdAndPose = m_lpFIdAndPoses.front();
-		if (fIdAndPose.first == 0)
-			cout << m_lpFIdAndPoses.size() << endl;
-		m_lpFIdAndPoses.pop_front();
-		
-		return fIdAndPose;
+		FramePose framePose;
+		framePose.fId = fId;
+		framePose.pose = pose;
+		framePose.addedTime = chrono::steady_clock::now();
+		m_FramePoses.Push(framePose);
+	}
+
+	bool Map::getIdAndPose(FramePose &framePose, int maxWait) {
+		return m_FramePoses.Pop(framePose, chrono::milliseconds(maxWait));
+	}
+
+	void Map::closeIdAndPoses() {
+		m_FramePoses.Close();
 	}
 
 	void Map::addModifiedKeyFrame(KeyFrame* pKF) {
 		unique_lock<mutex> lock(m_MutexModifiedKeyFrames);
-		for (list<KeyFrame*>::iterator lit = m_modifiedKeyFrames.begin(); lit != m_modifiedKeyFrames.end();) {
-			if ((*lit)->m_nKFId == pKF->m_nKFId){
-				lit = m_modifiedKeyFrames.erase(lit); 
-			}
-			else{
-				++lit;
-			}
-		}
-		m_modifiedKeyFrames.push_back(pKF);
+		if (m_sModifiedKeyFrames.insert(pKF).second)
+			m_dModifiedKeyFrames.push_back(pKF);
+		lock.unlock();
+
+		// the fusion waiting for a frame collects the correction right away
+		m_FramePoses.Wake();
 	}
 
 
 	KeyFrame* Map::getModifiedKeyFrame() {
 		unique_lock<mutex> lock(m_MutexModifiedKeyFrames);
-		if (m_modifiedKeyFrames.empty())
+		if (m_dModifiedKeyFrames.empty())
 			return NULL;
-		KeyFrame* pKF = m_modifiedKeyFrames.front();
-		m_modifiedKeyFrames.pop_front();
+		KeyFrame* pKF = m_dModifiedKeyFrames.front();
+		m_dModifiedKeyFrames.pop_front();
+		m_sModifiedKeyFrames.erase(pKF);
 		return pKF;
 	}
 
 
 	void Map::addRelativeInfo(Mat RelativeFramePose, KeyFrame* pReferenceKF, bool bLost, bool bKF) {
 		unique_lock<mutex> lock(m_MutexRelativeInfo);
-		m_lRelativeFramePoses.push_back(RelativeFramePose);
-		m_lpReferences.push_back(pReferenceKF);
-		m_lbLost.push_back(bLost);
-		m_lbKF.push_back(bKF);
+		m_mKFChildFrames[pReferenceKF].push_back((int)m_vRelativeFramePoses.size());
+		m_vRelativeFramePoses.push_back(RelativeFramePose);
+		m_vpReferences.push_back(pReferenceKF);
+		m_vbLost.push_back(bLost);
+		m_vbKF.push_back(bKF);
 	}
 
 	void Map::addLastRelativeInfo(bool bLost) {
 		unique_lock<mutex> lock(m_MutexRelativeInfo);
-		m_lRelativeFramePoses.push_back(m_lRelativeFramePoses.back());
-		m_lpReferences.push_back(m_lpReferences.back());
-		m_lbLost.push_back(bLost);
-		m_lbKF.push_back(m_lbKF.back());
+		m_mKFChildFrames[m_vpReferences.back()].push_back((int)m_vRelativeFramePoses.size());
+		m_vRelativeFramePoses.push_back(m_vRelativeFramePoses.back());
+		m_vpReferences.push_back(m_vpReferences.back());
+		m_vbLost.push_back(bLost);
+		m_vbKF.push_back(m_vbKF.back());
 	}
 
 	std::list<std::pair<int, Mat> > Map::getFramesByKF(KeyFrame* pKF, SpanningTree *pSpanTree) {
@@ -186,22 +190,29 @@ namespace SLAMRecon {
 
 		list<std::pair<int, Mat> > lIdPoses;
 
-		list<KeyFrame*>::iterator lRit = m_lpReferences.begin();
-		list<bool>::iterator lbKF = m_lbKF.begin();
+		unordered_map<KeyFrame*, vector<int> >::iterator mit = m_mKFChildFrames.find(pKF);
+		if (mit == m_mKFChildFrames.end())
+			return lIdPoses;
 
-		int idCount = 0;
-		for (list<Mat>::iterator lit = m_lRelativeFramePoses.begin(), lend = m_lRelativeFramePoses.end(); lit != lend; lit++, lRit++, lbKF++) {
-
-			KeyFrame* pKF2 = *lRit;
-			if (pKF2->m_nKFId == pKF->m_nKFId) {
-				pair<int, Mat> pairtemp(idCount, (*lit)); 
-				lIdPoses.push_back(pairtemp);
-			}
-			idCount++;
+		const vector<int> &vChildFrames = mit->second;
+		for (size_t i = 0; i < vChildFrames.size(); i++) {
+			int fId = vChildFrames[i];
+			lIdPoses.push_back(make_pair(fId, m_vRelativeFramePoses[fId]));
 		}
 		return lIdPoses;
 	}
 
+	bool Map::getRelativeInfo(int fId, KeyFrame* &pReferenceKF, Mat &RelativeFramePose) {
+		unique_lock<mutex> lock(m_MutexRelativeInfo);
+
+		if (fId < 0 || fId >= (int)m_vRelativeFramePoses.size())
+			return false;
+
+		RelativeFramePose = m_vRelativeFramePoses[fId].clone();
+		pReferenceKF = m_vpReferences[fId];
+		return true;
+	}
+
 	void Map::setCurFramePose(cv::Mat curFramePose) {
 		unique_lock<mutex> lock(m_MutexCurFramePose);
 		if (!curFramePose.empty())
@@ -25,6 +25,11 @@
 #include <memory>
 #include <mutex>
 #include <set>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include "SPSCQueue.h"
 #include "MapPoint.h"
 #include "KeyFrame.h"
 #include "SpanningTree.h"
@@ -34,6 +39,13 @@ namespace SLAMRecon {
 	class KeyFrame;
 	class Frame; 
 
+	// A tracked frame handed to the fusion, its depth image is the one of the same id in the depth history.
+	struct FramePose {
+		int fId;
+		cv::Mat pose;
+		std::chrono::steady_clock::time_point addedTime;
+	};
+
 	class Map {
 
 	public:
@@ -72,17 +84,23 @@ namespace SLAMRecon {
 		std::vector<KeyFrame*> m_vpKeyFrameOrigins;
 		 
 		std::mutex m_MutexMapUpdate;
-		std::list<cv::Mat> m_lRelativeFramePoses;
-		std::list<KeyFrame*> m_lpReferences;  
-		std::list<bool> m_lbLost;  
-		std::list<bool> m_lbKF;
+		// Indexed by frame id.
+		std::vector<cv::Mat> m_vRelativeFramePoses;
+		std::vector<KeyFrame*> m_vpReferences;  
+		std::vector<bool> m_vbLost;  
+		std::vector<bool> m_vbKF;
 	private:
 		std::mutex m_MutexRelativeInfo;
+
+		// Ids of the frames referencing each KeyFrame, in ascending order.
+		std::unordered_map<KeyFrame*, std::vector<int> > m_mKFChildFrames;
 		 
-		std::list<std::pair<int, cv::Mat> > m_lpFIdAndPoses;
-		std::mutex m_MutexFIdAndPoses;
+		// Tracking is the only producer and the fusion the only consumer.
+		Basis::SPSCQueue<FramePose> m_FramePoses;
 		 
-		std::list<KeyFrame*> m_modifiedKeyFrames;
+		// A KeyFrame modified again while queued keeps its place.
+		std::deque<KeyFrame*> m_dModifiedKeyFrames;
+		std::unordered_set<KeyFrame*> m_sModifiedKeyFrames;
 		std::mutex m_MutexModifiedKeyFrames;
 
 
@@ -90,9 +108,14 @@ namespace SLAMRecon {
 		void addRelativeInfo(cv::Mat RelativeFramePose, KeyFrame* pReferenceKF, bool bLost, bool bKF);
 		void addLastRelativeInfo(bool bLost); 
 		std::list<std::pair<int, cv::Mat> > getFramesByKF(KeyFrame* pKF, SpanningTree *pSpanTree);
+		bool getRelativeInfo(int fId, KeyFrame* &pReferenceKF, cv::Mat &RelativeFramePose);
 		  
+		// Blocks while the fusion is too far behind.
 		void addIdAndPose(int fId, cv::Mat pose);
-		std::pair<int, cv::Mat>  Map::getIdAndPose();
+		// Waits at most maxWait ms for the next frame, returns false if none came or the fusion was woken by a modified KeyFrame.
+		bool getIdAndPose(FramePose &framePose, int maxWait);
+		// No frame is added after this, a Tracking blocked in addIdAndPose returns.
+		void closeIdAndPoses();
 
 		void addModifiedKeyFrame(KeyFrame* pKF);
 		KeyFrame* getModifiedKeyFrame();
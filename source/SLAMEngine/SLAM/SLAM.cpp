@@ -35,16 +35,30 @@ namespace SLAMRecon {
 		//Load ORB Vocabulary
 		cout << "Loading ORB Vocabulary. This could take a while..." << endl;
 
+		// The binary vocabulary next to the text one loads in a fraction of the time,
+		// it is converted from the text one on the first start and whenever the text one changes.
+		string strBinVocFile = strVocFile;
+		size_t nExtension = strVocFile.find_last_of('.');
+		if (nExtension != string::npos && nExtension > strVocFile.find_last_of("/\\") + 1)
+			strBinVocFile = strVocFile.substr(0, nExtension);
+		strBinVocFile += ".bin";
+
 		m_pORBVocabulary = new ORBVocabulary();
-		bool bVocLoad = m_pORBVocabulary->loadFromTextFile(strVocFile);
-		// bool bVocLoad = true;
+		string strLoadedVocFile = strBinVocFile;
+		bool bVocLoad = m_pORBVocabulary->loadFromBinaryFile(strBinVocFile, strVocFile);
+		if (!bVocLoad) {
+			strLoadedVocFile = strVocFile;
+			bVocLoad = m_pORBVocabulary->loadFromTextFile(strVocFile);
+			if (bVocLoad && !m_pORBVocabulary->saveToBinaryFile(strBinVocFile, strVocFile))
+				cerr << "Failed to write the binary vocabulary at: " << strBinVocFile << endl;
+		}
 		if (!bVocLoad)
 		{
 			cerr << "Wrong path to vocabulary. " << endl;
 			cerr << "Falied to open at: " << strVocFile << endl;
 			exit(-1);
 		}
-		cout << "Vocabulary loaded!" << endl;
+		cout << "Vocabulary loaded from: " << strLoadedVocFile << endl;
 
 		//
 		/*m_pCoGraph = new CovisibilityGraph();
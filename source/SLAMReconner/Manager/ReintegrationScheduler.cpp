@@ -0,0 +1,265 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#include "ReintegrationScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace cv;
+
+static Matrix4f toMatrix4f(const Mat &pose)
+{
+	return Matrix4f(pose.at<float>(0, 0), pose.at<float>(1, 0), pose.at<float>(2, 0), pose.at<float>(3, 0),
+		pose.at<float>(0, 1), pose.at<float>(1, 1), pose.at<float>(2, 1), pose.at<float>(3, 1),
+		pose.at<float>(0, 2), pose.at<float>(1, 2), pose.at<float>(2, 2), pose.at<float>(3, 2),
+		pose.at<float>(0, 3), pose.at<float>(1, 3), pose.at<float>(2, 3), pose.at<float>(3, 3));
+}
+
+ReintegrationScheduler::ReintegrationScheduler(FusionEngine *fusionEngine, const FELibSettings *settings, const FERGBDCalib *calib, ShortImagesBlock *depthBlock, Vector2i depthImageSize, UChar4Image *rgbImage, Map *pMap, SpanningTree *pSpanTree)
+{
+	this->fusionEngine = fusionEngine;
+	this->depthBlock = depthBlock;
+	this->rgbImage = rgbImage;
+	m_pMap = pMap;
+	m_pSpanTree = pSpanTree;
+
+	depthImage = new ShortImage(depthImageSize, true, true);
+
+	minDelta = settings->minReintegrationDelta;
+	maxDepth = settings->sceneParams.viewFrustum_max;
+
+	lastIntegratedFrameId = -1;
+
+	superFrameStore = NULL;
+	depthWeight = NULL;
+	if (settings->useSuperFrames) {
+		superFrameStore = new SuperFrameStore(calib, depthImageSize, settings->sceneParams.mu);
+		depthWeight = new ShortImage(depthImageSize, true, false);
+	}
+	superFrameSize = settings->superFrameSize;
+
+	openFirstFrameId = -1;
+	openLastFrameId = -1;
+	noOpenFrames = 0;
+	pOpenKF = NULL;
+}
+
+ReintegrationScheduler::~ReintegrationScheduler()
+{
+	delete depthImage;
+	if (depthWeight != NULL) delete depthWeight;
+	if (superFrameStore != NULL) delete superFrameStore;
+}
+
+Mat ReintegrationScheduler::getKeyFramePose(KeyFrame *pKF)
+{
+	Mat pose = Mat::eye(4, 4, CV_32F);
+
+	// a culled keyframe moves with its parent
+	while (pKF->isBad()) {
+		pose = pose*pKF->m_Tcp;
+		pKF = m_pSpanTree->GetParent(pKF);
+	}
+
+	return pose*pKF->GetPose();
+}
+
+float ReintegrationScheduler::getPoseDelta(const Mat &oldPose, const Mat &newPose) const
+{
+	Mat correction = newPose*oldPose.inv();
+
+	float cosAngle = (correction.at<float>(0, 0) + correction.at<float>(1, 1) + correction.at<float>(2, 2) - 1.0f) * 0.5f;
+	float angle = acosf(std::max(-1.0f, std::min(1.0f, cosAngle)));
+
+	// a rotation moves the points at the far end of the view frustum the most
+	return (float)cv::norm(correction.rowRange(0, 3).col(3)) + angle * maxDepth;
+}
+
+void ReintegrationScheduler::rankPendingFrames()
+{
+	rankedFrames.clear();
+	rankedFrames.reserve(pendingFrames.size());
+
+	for (map<int, PendingFrame>::iterator it = pendingFrames.begin(); it != pendingFrames.end();) {
+		Mat pose = it->second.relativePose*getKeyFramePose(it->second.pKF);
+		float delta = getPoseDelta(integratedPoses[it->first], pose);
+
+		if (delta < minDelta) {
+			it = pendingFrames.erase(it);
+			continue;
+		}
+
+		rankedFrames.push_back(make_pair(delta, it->first));
+		++it;
+	}
+
+	sort(rankedFrames.begin(), rankedFrames.end());
+}
+
+void ReintegrationScheduler::fuseIntoSuperFrame(int frameId, const Mat &pose, ShortImage *rawDepthImage)
+{
+	KeyFrame *pKF;
+	Mat relativePose;
+	if (!m_pMap->getRelativeInfo(frameId, pKF, relativePose)) return;
+
+	if (openFirstFrameId >= 0 && (pKF != pOpenKF || noOpenFrames >= superFrameSize))
+		closeSuperFrame();
+
+	if (openFirstFrameId < 0) {
+		openFirstFrameId = frameId;
+		pOpenKF = pKF;
+		openKeyFramePose = relativePose.inv()*pose;
+		noOpenFrames = 0;
+	}
+
+	superFrameStore->fuseFrame(rawDepthImage, relativePose);
+	openLastFrameId = frameId;
+	noOpenFrames++;
+}
+
+void ReintegrationScheduler::closeSuperFrame()
+{
+	SuperFrame superFrame;
+	superFrame.superFrameId = superFrameStore->closeSuperFrame();
+	superFrame.pKF = pOpenKF;
+	superFrames[openFirstFrameId] = superFrame;
+
+	// the blocks to repeal the super-frame from are those its frames were integrated into
+	fusionEngine->MergeVisibleLists(openFirstFrameId, openFirstFrameId, openLastFrameId);
+
+	if (openLastFrameId >= (int)superFrameOfFrame.size()) superFrameOfFrame.resize(openLastFrameId + 1, -1);
+
+	bool isPending = false;
+	for (int frameId = openFirstFrameId; frameId <= openLastFrameId; frameId++) {
+		superFrameOfFrame[frameId] = openFirstFrameId;
+		if (pendingFrames.erase(frameId) > 0) isPending = true;
+		integratedPoses[frameId].release();
+
+		if (frameId != (int)pOpenKF->m_nFId) depthBlock->dropImage(frameId);
+	}
+
+	integratedPoses[openFirstFrameId] = openKeyFramePose;
+
+	// a pending correction of one of the frames now moves the whole super-frame
+	if (isPending) {
+		PendingFrame pendingFrame;
+		pendingFrame.relativePose = Mat::eye(4, 4, CV_32F);
+		pendingFrame.pKF = pOpenKF;
+		pendingFrames[openFirstFrameId] = pendingFrame;
+		rankPendingFrames();
+	}
+
+	openFirstFrameId = -1;
+}
+
+void ReintegrationScheduler::frameIntegrated(int frameId, const Mat &pose, ShortImage *rawDepthImage)
+{
+	if (frameId >= (int)integratedPoses.size()) integratedPoses.resize(frameId + 1);
+	integratedPoses[frameId] = pose.clone();
+	lastIntegratedFrameId = frameId;
+
+	if (superFrameStore != NULL) fuseIntoSuperFrame(frameId, pose, rawDepthImage);
+
+	// frames lost by the tracking are never integrated
+	while (!deferredFrames.empty() && deferredFrames.begin()->first < frameId)
+		deferredFrames.erase(deferredFrames.begin());
+
+	map<int, PendingFrame>::iterator it = deferredFrames.find(frameId);
+	if (it == deferredFrames.end()) return;
+
+	// the keyframe was corrected after this frame was tracked
+	PendingFrame pendingFrame = it->second;
+	deferredFrames.erase(it);
+
+	float delta = getPoseDelta(pose, pendingFrame.relativePose*getKeyFramePose(pendingFrame.pKF));
+	if (delta < minDelta) return;
+
+	pendingFrames[frameId] = pendingFrame;
+	pair<float, int> rankedFrame(delta, frameId);
+	rankedFrames.insert(lower_bound(rankedFrames.begin(), rankedFrames.end(), rankedFrame), rankedFrame);
+}
+
+void ReintegrationScheduler::collectCorrections()
+{
+	bool hasCorrections = false;
+
+	for (KeyFrame *pKF = m_pMap->getModifiedKeyFrame(); pKF != NULL; pKF = m_pMap->getModifiedKeyFrame()) {
+		list<pair<int, Mat> > lIdPoses = m_pMap->getFramesByKF(pKF, m_pSpanTree);
+
+		for (list<pair<int, Mat> >::iterator lit = lIdPoses.begin(), lend = lIdPoses.end(); lit != lend; lit++) {
+			PendingFrame pendingFrame;
+			pendingFrame.relativePose = lit->second;
+			pendingFrame.pKF = pKF;
+
+			int frameId = lit->first;
+
+			// the super-frame in the keyframe camera moves with the keyframe
+			if (frameId < (int)superFrameOfFrame.size() && superFrameOfFrame[frameId] >= 0) {
+				pendingFrame.relativePose = Mat::eye(4, 4, CV_32F);
+				pendingFrames[superFrameOfFrame[frameId]] = pendingFrame;
+				continue;
+			}
+
+			if (frameId > lastIntegratedFrameId)
+				deferredFrames[frameId] = pendingFrame;
+			else if (frameId < (int)integratedPoses.size() && !integratedPoses[frameId].empty())
+				pendingFrames[frameId] = pendingFrame;
+		}
+
+		hasCorrections = true;
+	}
+
+	// the poses of frames already queued may have changed as well
+	if (hasCorrections) rankPendingFrames();
+}
+
+bool ReintegrationScheduler::hasPendingFrames() const
+{
+	return !rankedFrames.empty();
+}
+
+int ReintegrationScheduler::reintegrate(float budget)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int noReintegratedFrames = 0;
+
+	while (!rankedFrames.empty()) {
+		if (noReintegratedFrames > 0 && chrono::duration<float, milli>(chrono::steady_clock::now() - start).count() >= budget)
+			break;
+
+		int frameId = rankedFrames.back().second;
+		rankedFrames.pop_back();
+
+		map<int, PendingFrame>::iterator it = pendingFrames.find(frameId);
+		if (it == pendingFrames.end()) continue;
+
+		PendingFrame pendingFrame = it->second;
+		pendingFrames.erase(it);
+
+		if (!rankedFrames.empty()) depthBlock->prefetchImage(rankedFrames.back().second);
+
+		// the keyframe may have moved again since the frame was ranked
+		Mat &oldPose = integratedPoses[frameId];
+		Mat newPose = pendingFrame.relativePose*getKeyFramePose(pendingFrame.pKF);
+		if (getPoseDelta(oldPose, newPose) < minDelta) continue;
+
+		map<int, SuperFrame>::iterator sit = superFrames.find(frameId);
+		if (sit != superFrames.end()) {
+			if (!superFrameStore->readSuperFrame(sit->second.superFrameId, depthImage, depthWeight)) continue;
+
+			fusionEngine->ReprocessFrame(rgbImage, depthImage, depthWeight, frameId, toMatrix4f(oldPose), toMatrix4f(newPose));
+		}
+		else {
+			if (!depthBlock->readImageToCpu(frameId, depthImage)) continue;
+
+			fusionEngine->ReprocessFrame(rgbImage, depthImage, frameId, toMatrix4f(oldPose), toMatrix4f(newPose));
+		}
+
+		FESafeCall(cudaThreadSynchronize());
+
+		oldPose = newPose;
+		noReintegratedFrames++;
+	}
+
+	return noReintegratedFrames;
+}
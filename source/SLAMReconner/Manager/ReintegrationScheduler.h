@@ -0,0 +1,100 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _REINTEGRATIONSCHEDULER_H
+#define _REINTEGRATIONSCHEDULER_H
+
+#include "SlamReconKits.h"
+#include "SuperFrameStore.h"
+
+#include <map>
+#include <vector>
+
+// class to reintegrate the frames whose keyframes were corrected by the SLAM.
+//
+// The corrections of all modified keyframes are coalesced per frame and
+// ranked by how far they move the surface, corrections below
+// FELibSettings::minReintegrationDelta are dropped. The fusion thread
+// calls reintegrate() between live frames with a time budget, so a large
+// loop closure is worked off over the following frames instead of
+// stalling the live view.
+//
+// With FELibSettings::useSuperFrames the consecutive frames of a keyframe
+// are fused into super-frames of at most FELibSettings::superFrameSize
+// frames. Once a super-frame is closed, only the depth of the keyframe
+// itself is kept in the depth history, and a correction reintegrates the
+// super-frame in place of its frames. The first time that happens the
+// frames integrated live are only approximately repealed.
+class ReintegrationScheduler
+{
+public:
+	ReintegrationScheduler(FusionEngine *fusionEngine, const FELibSettings *settings, const FERGBDCalib *calib, ShortImagesBlock *depthBlock, Vector2i depthImageSize, UChar4Image *rgbImage, Map *pMap, SpanningTree *pSpanTree);
+	~ReintegrationScheduler();
+
+	// record the pose a live frame was integrated with, and fuse its raw depth image into the open super-frame
+	void frameIntegrated(int frameId, const cv::Mat &pose, ShortImage *rawDepthImage);
+
+	// queue the frames of all keyframes modified since the last call
+	void collectCorrections();
+
+	bool hasPendingFrames() const;
+
+	// reintegrate the largest corrections first, for at most budget milliseconds but at least one frame, returns the number of frames reintegrated
+	int reintegrate(float budget);
+
+private:
+	struct PendingFrame
+	{
+		cv::Mat relativePose;
+		KeyFrame *pKF;
+	};
+
+	struct SuperFrame
+	{
+		int superFrameId;
+		KeyFrame *pKF;
+	};
+
+	cv::Mat getKeyFramePose(KeyFrame *pKF);
+
+	// distance in metres a surface point moves at most when the frame pose changes from oldPose to newPose
+	float getPoseDelta(const cv::Mat &oldPose, const cv::Mat &newPose) const;
+
+	void rankPendingFrames();
+
+	void fuseIntoSuperFrame(int frameId, const cv::Mat &pose, ShortImage *rawDepthImage);
+	void closeSuperFrame();
+
+	FusionEngine *fusionEngine;
+	ShortImagesBlock *depthBlock;
+	UChar4Image *rgbImage;
+	ShortImage *depthImage, *depthWeight;
+
+	Map *m_pMap;
+	SpanningTree *m_pSpanTree;
+
+	float minDelta, maxDepth;
+
+	// pose each frame is currently integrated with, empty for frames not integrated
+	std::vector<cv::Mat> integratedPoses;
+	int lastIntegratedFrameId;
+
+	// corrected frames by id, frames not yet integrated live wait in deferredFrames
+	std::map<int, PendingFrame> pendingFrames, deferredFrames;
+
+	// pending frame ids by ascending correction, the next frame is at the back
+	std::vector<std::pair<float, int> > rankedFrames;
+
+	// NULL unless super-frames are used
+	SuperFrameStore *superFrameStore;
+	int superFrameSize;
+
+	// closed super-frames by the id of their first frame, which stands for all of their frames from then on
+	std::map<int, SuperFrame> superFrames;
+	std::vector<int> superFrameOfFrame;
+
+	// the super-frame being fused, the keyframe pose is the one its first frame was integrated with
+	int openFirstFrameId, openLastFrameId, noOpenFrames;
+	KeyFrame *pOpenKF;
+	cv::Mat openKeyFramePose;
+};
+
+#endif // _REINTEGRATIONSCHEDULER_H
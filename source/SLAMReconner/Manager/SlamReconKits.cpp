@@ -66,7 +66,7 @@ bool SlamReconKits::initKits(int device, int method)
 	FELibSettings *internalSettings = new FELibSettings();
 	FERGBDCalib *calib = new FERGBDCalib();
 	calib->intrinsics_d = kInfo.intrinsics;
-	FusionEngine *fusionEngine = new FusionEngine(internalSettings, calib, dataEnginePtr->getRGBImageSize(), dataEnginePtr->getDepthImageSize());
+	FusionEngine *fusionEngine = FusionEngine::Make(internalSettings, calib, dataEnginePtr->getRGBImageSize(), dataEnginePtr->getDepthImageSize());
 	FusionComponent *fusionComponent = new FusionComponent(fusionEngine, internalSettings, calib);
 	fusionCompoPtr = FusionComponent::Ptr(fusionComponent);
 
@@ -1,11 +1,16 @@
 // Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
 #include "SlamReconManager.h"
+#include "ReintegrationScheduler.h"
 
 #include <QFileDialog>
+#include <chrono>
 #include <thread>
 
 using namespace cv;
 
+// ms the idle fusion sleeps at most, bounds how late a reset is noticed
+static const int fusionWaitTimeout = 100;
+
 SlamReconManager::SlamReconManager() : m_bInit(false), m_ShutdowmFlag(false), m_FusionFlag(false)
 {
 	srkPtr = NULL;
@@ -127,92 +132,40 @@ void SlamReconManager::fusionProcess() {
 		return;
 	}
 
-	Sleep(5);
-
 	ShortImagesBlock* depthBlock = dataEngine->getDepthImagesBlock();
-	pair<int, Mat> fIdAndPose;
-
-	fIdAndPose = m_pMap->getIdAndPose();
-	int flag = fIdAndPose.first;
+	FramePose framePose;
 
 	UChar4Image *inputRGBImage = dataEngine->getCurrentRgbImage();
 	ShortImage *inputRawDepthImage = new ShortImage(dataEngine->getDepthImageSize(), true, true);
 
+	const FELibSettings *settings = srkPtr->fusionCompoPtr->internalSettings;
+	ReintegrationScheduler scheduler(fusionEngine, settings, srkPtr->fusionCompoPtr->calib, depthBlock, dataEngine->getDepthImageSize(), inputRGBImage, m_pMap, m_pSpanTree);
+
 	cout << endl << "fusionThread " << endl;
 
 	while (!resetFlag) {
-		if (flag == -1){
-			KeyFrame *pKF = m_pMap->getModifiedKeyFrame();
-
-			if (pKF != NULL){
-				cout << "Refusion KeyFrame Id: " << pKF->m_nKFId << " it's frame is " << pKF->m_nFId << endl;
-
-				Mat pose = Mat::eye(4, 4, CV_32F);
-				Mat oldpose = Mat::eye(4, 4, CV_32F);
-
-				while (pKF->isBad()) {
-					pose = pose*pKF->m_Tcp;
-					oldpose = oldpose*pKF->m_Tcp;
-					pKF = m_pSpanTree->GetParent(pKF);
-				}
-
-				pose = pose*pKF->GetPose();
-				oldpose = oldpose*pKF->m_oldCameraPose;
-
-
-				Mat errorpose = pose - oldpose;
-				double error = errorpose.dot(errorpose);
-
-				if (error > 0.001) {
-					list<pair<int, Mat> > lIdPoses = m_pMap->getFramesByKF(pKF, m_pSpanTree);
-
-					for (list<pair<int, Mat> >::iterator lit = lIdPoses.begin(), lend = lIdPoses.end(); lit != lend; lit++) {
-						pair<int, Mat> modifyFIdAndPose = *lit;
-
-						depthBlock->readImageToCpu(modifyFIdAndPose.first, inputRawDepthImage);
-
-						cout << "Refusion frame: " << modifyFIdAndPose.first << endl;
+		scheduler.collectCorrections();
 
-						Mat framePose = modifyFIdAndPose.second * pose;
-						Mat frameOldPose = modifyFIdAndPose.second * oldpose;
+		// corrected frames are worked off while no live frame is waiting, otherwise the thread sleeps until one arrives
+		int maxWait = scheduler.hasPendingFrames() ? 0 : fusionWaitTimeout;
 
-						Matrix4f newMt(framePose.at<float>(0, 0), framePose.at<float>(1, 0), framePose.at<float>(2, 0), framePose.at<float>(3, 0),
-							framePose.at<float>(0, 1), framePose.at<float>(1, 1), framePose.at<float>(2, 1), framePose.at<float>(3, 1),
-							framePose.at<float>(0, 2), framePose.at<float>(1, 2), framePose.at<float>(2, 2), framePose.at<float>(3, 2),
-							framePose.at<float>(0, 3), framePose.at<float>(1, 3), framePose.at<float>(2, 3), framePose.at<float>(3, 3));
-
-						Matrix4f oldMt(frameOldPose.at<float>(0, 0), frameOldPose.at<float>(1, 0), frameOldPose.at<float>(2, 0), frameOldPose.at<float>(3, 0),
-							frameOldPose.at<float>(0, 1), frameOldPose.at<float>(1, 1), frameOldPose.at<float>(2, 1), frameOldPose.at<float>(3, 1),
-							frameOldPose.at<float>(0, 2), frameOldPose.at<float>(1, 2), frameOldPose.at<float>(2, 2), frameOldPose.at<float>(3, 2),
-							frameOldPose.at<float>(0, 3), frameOldPose.at<float>(1, 3), frameOldPose.at<float>(2, 3), frameOldPose.at<float>(3, 3));
-
-						fusionEngine->ReprocessFrame(inputRGBImage, inputRawDepthImage, modifyFIdAndPose.first, oldMt, newMt);
-
-					}
-					pKF->m_oldCameraPose = pKF->GetPose();
-				}
-
-				fIdAndPose = m_pMap->getIdAndPose();
-				flag = fIdAndPose.first;
-
-				continue;
+		if (!m_pMap->getIdAndPose(framePose, maxWait)){
+			if (scheduler.hasPendingFrames()){
+				// no live frame is waiting, the budget only bounds how late the next one is picked up
+				if (scheduler.reintegrate(settings->reintegrationBudget) > 0)
+					emit updateFusionView();
 			}
-			else{
-				if (m_ShutdowmFlag){
-					cout << "The fusion is down!!!" << endl;
-					break;
-				}
-				else {
-					fIdAndPose = m_pMap->getIdAndPose();
-					flag = fIdAndPose.first;
-					continue;
-				}
+			else if (m_ShutdowmFlag){
+				cout << "The fusion is down!!!" << endl;
+				break;
 			}
+			continue;
 		}
 
-		cout << "first fusion frame: " << fIdAndPose.first << endl;
+		float latency = chrono::duration<float, milli>(chrono::steady_clock::now() - framePose.addedTime).count();
+		cout << "fusion frame: " << framePose.fId << ", latency: " << latency << " ms" << endl;
 
-		Mat pose = fIdAndPose.second;
+		Mat pose = framePose.pose;
 
 		if (pose.empty())
 			continue;
@@ -223,22 +176,29 @@ void SlamReconManager::fusionProcess() {
 			pose.at<float>(0, 3), pose.at<float>(1, 3), pose.at<float>(2, 3), pose.at<float>(3, 3));
 
 		{
-			depthBlock->readImageToCpu(fIdAndPose.first, inputRawDepthImage);
+			depthBlock->readImageToCpu(framePose.fId, inputRawDepthImage);
 		}
 
-		fusionEngine->ProcessFrame(inputRGBImage, inputRawDepthImage, fIdAndPose.first, mt);
+		fusionEngine->ProcessFrame(inputRGBImage, inputRawDepthImage, framePose.fId, mt);
 
 		FESafeCall(cudaThreadSynchronize());
 
-		emit updateFusionView();
-
-		fIdAndPose = m_pMap->getIdAndPose();
-		flag = fIdAndPose.first;
+		scheduler.frameIntegrated(framePose.fId, pose, inputRawDepthImage);
 
-		Sleep(1);
+		// work off corrected frames between the live frames
+		if (scheduler.hasPendingFrames())
+			scheduler.reintegrate(settings->reintegrationBudget);
 
+		emit updateFusionView();
 	}
 
+	// a Tracking blocked on the full queue must not wait for a fusion that is gone
+	m_pMap->closeIdAndPoses();
+
+	// the free view is refreshed at display rate and may lag behind the last frames
+	fusionEngine->renderFreeView();
+	emit updateFusionView();
+
 	m_FusionFlag = true;
 }
 
@@ -287,6 +247,9 @@ void SlamReconManager::slamReconProcess()
 
 	slamEngine->Shutdown(m_ShutdowmFlag);
 
+	// wakes the fusion waiting for the next frame
+	srkPtr->slamCompoPtr->m_pMap->closeIdAndPoses();
+
 	cout << "m_ShutdowmFlag is" << m_ShutdowmFlag << endl;
 
 	while (!m_FusionFlag)
@@ -342,12 +305,9 @@ void SlamReconManager::saveMeshForSLAMRecon()
 	vector<KeyFrame*> vpKFs = m_pMap->GetAllKeyFrames();
 	sort(vpKFs.begin(), vpKFs.end(), KeyFrame::lId);
 	Mat Two = vpKFs[0]->GetPoseInverse();
-	list<KeyFrame*>::iterator lRit = m_pMap->m_lpReferences.begin();
-
-	list<bool>::iterator lbKF = m_pMap->m_lbKF.begin();
-	for (list<Mat>::iterator lit = m_pMap->m_lRelativeFramePoses.begin(), lend = m_pMap->m_lRelativeFramePoses.end(); lit != lend; lit++, lRit++, lbKF++) {
-		bool bKF = *lbKF;
-		KeyFrame* pKF = *lRit;
+	for (size_t i = 0; i < m_pMap->m_vRelativeFramePoses.size(); i++) {
+		bool bKF = m_pMap->m_vbKF[i];
+		KeyFrame* pKF = m_pMap->m_vpReferences[i];
 
 		Mat Trw = Mat::eye(4, 4, CV_32F);
 
@@ -361,7 +321,7 @@ void SlamReconManager::saveMeshForSLAMRecon()
 
 		Trw = Trw*pKF->GetPose()*Two;
 
-		Mat Tcw = (*lit)*Trw;
+		Mat Tcw = m_pMap->m_vRelativeFramePoses[i]*Trw;
 		Mat Rwc = Tcw.rowRange(0, 3).colRange(0, 3).t();
 		Mat twc = -Rwc*Tcw.rowRange(0, 3).col(3);
 
@@ -389,7 +349,8 @@ void SlamReconManager::saveMeshForSLAMRecon()
 	fusionEngine->resetScene();
 
 	for (int i = 0; i <= dataEngine->getCurrentFrameId(); i++){
-		depthBlock->readImageToCpu(i, inputRawDepthImage);
+		// with super-frames only the depth of the keyframes is kept
+		if (!depthBlock->readImageToCpu(i, inputRawDepthImage)) continue;
 		fusionEngine->ProcessFrame(inputRGBImage, inputRawDepthImage, i, allCameraPoses[i]);
 
 		FESafeCall(cudaThreadSynchronize());
@@ -0,0 +1,118 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#include "SuperFrameStore.h"
+
+#include <cmath>
+
+using namespace cv;
+
+// super-frames are few, so their segments are small
+static const int superFramesSegmentSize = 4;
+
+SuperFrameStore::SuperFrameStore(const FERGBDCalib *calib, Vector2i depthImageSize, float tolerance)
+{
+	imgSize = depthImageSize;
+	projParams = calib->intrinsics_d.projectionParamsSimple.all;
+	disparityCalib = calib->disparityCalib;
+	this->tolerance = tolerance;
+
+	depthSum.assign(imgSize.x * imgSize.y, 0.0f);
+	depthCount.assign(imgSize.x * imgSize.y, 0);
+
+	rawDepth = new ShortImage(imgSize, true, false);
+	rawWeight = new ShortImage(imgSize, true, false);
+	depthBlock = new ShortImagesBlock(imgSize, superFramesSegmentSize, IMAGES_CACHED_SEGMENTS);
+	weightBlock = new ShortImagesBlock(imgSize, superFramesSegmentSize, IMAGES_CACHED_SEGMENTS);
+
+	noSuperFrames = 0;
+}
+
+SuperFrameStore::~SuperFrameStore()
+{
+	delete rawDepth;
+	delete rawWeight;
+	delete depthBlock;
+	delete weightBlock;
+}
+
+float SuperFrameStore::rawToDepth(short raw) const
+{
+	if (disparityCalib.type == FEDisparityCalib::TRAFO_KINECT) {
+		float disparity = disparityCalib.params.x - (float)raw;
+		return disparity == 0 ? 0.0f : 8.0f * disparityCalib.params.y * projParams.x / disparity;
+	}
+
+	return (raw <= 0 || raw > 32000) ? 0.0f : (float)raw * disparityCalib.params.x + disparityCalib.params.y;
+}
+
+short SuperFrameStore::depthToRaw(float depth) const
+{
+	if (disparityCalib.type == FEDisparityCalib::TRAFO_KINECT)
+		return (short)floorf(disparityCalib.params.x - 8.0f * disparityCalib.params.y * projParams.x / depth + 0.5f);
+
+	return (short)floorf((depth - disparityCalib.params.y) / disparityCalib.params.x + 0.5f);
+}
+
+void SuperFrameStore::fuseFrame(ShortImage *rawDepthImage, const Mat &relativePose)
+{
+	// from the frame camera to the keyframe camera
+	Mat Tkc = relativePose.inv();
+	Matx33f R = Tkc.rowRange(0, 3).colRange(0, 3);
+	Vec3f t = Tkc.rowRange(0, 3).col(3);
+
+	const short *raw = rawDepthImage->GetData(MEMORYDEVICE_CPU);
+
+	for (int y = 0; y < imgSize.y; y++) for (int x = 0; x < imgSize.x; x++) {
+		float z = rawToDepth(raw[x + y * imgSize.x]);
+		if (z <= 0) continue;
+
+		Vec3f pt_frame(z * (x - projParams.z) / projParams.x, z * (y - projParams.w) / projParams.y, z);
+		Vec3f pt_keyframe = R * pt_frame + t;
+		if (pt_keyframe[2] <= 0) continue;
+
+		int u = (int)floorf(projParams.x * pt_keyframe[0] / pt_keyframe[2] + projParams.z + 0.5f);
+		int v = (int)floorf(projParams.y * pt_keyframe[1] / pt_keyframe[2] + projParams.w + 0.5f);
+		if (u < 0 || u >= imgSize.x || v < 0 || v >= imgSize.y) continue;
+
+		int locId = u + v * imgSize.x;
+		float depth = pt_keyframe[2];
+
+		if (depthCount[locId] > 0) {
+			float mean = depthSum[locId] / depthCount[locId];
+
+			// a farther surface is hidden by the fused one
+			if (depth > mean + tolerance) continue;
+
+			if (depth < mean - tolerance) {
+				depthSum[locId] = 0.0f;
+				depthCount[locId] = 0;
+			}
+		}
+
+		depthSum[locId] += depth;
+		depthCount[locId]++;
+	}
+}
+
+int SuperFrameStore::closeSuperFrame()
+{
+	short *depth = rawDepth->GetData(MEMORYDEVICE_CPU);
+	short *weight = rawWeight->GetData(MEMORYDEVICE_CPU);
+
+	for (int locId = 0; locId < imgSize.x * imgSize.y; locId++) {
+		depth[locId] = depthCount[locId] > 0 ? depthToRaw(depthSum[locId] / depthCount[locId]) : 0;
+		weight[locId] = depth[locId] > 0 ? depthCount[locId] : 0;
+	}
+
+	depthBlock->saveImageToBlock(noSuperFrames, rawDepth);
+	weightBlock->saveImageToBlock(noSuperFrames, rawWeight);
+
+	depthSum.assign(depthSum.size(), 0.0f);
+	depthCount.assign(depthCount.size(), 0);
+
+	return noSuperFrames++;
+}
+
+bool SuperFrameStore::readSuperFrame(int superFrameId, ShortImage *rawDepthImage, ShortImage *rawDepthWeight)
+{
+	return depthBlock->readImageToCpu(superFrameId, rawDepthImage) && weightBlock->readImageToCpu(superFrameId, rawDepthWeight);
+}
@@ -0,0 +1,50 @@
+// Copyright 2016-2017 Interdisciplinary Research Center in Shandong University and the authors of SLAMRecon.
+#ifndef _SUPERFRAMESTORE_H
+#define _SUPERFRAMESTORE_H
+
+#include "SlamReconKits.h"
+
+#include <vector>
+
+// class to fuse the depth images of consecutive frames into super-frames.
+//
+// A super-frame is a depth image in the camera of a keyframe. Each frame is
+// forward projected into it with its pose relative to the keyframe and
+// averaged per pixel with the depths within the tolerance, a closer surface
+// replaces a farther one. The number of frames fused into a pixel is kept as
+// its weight, so the super-frame can be repealed and reintegrated in place
+// of its frames. Closed super-frames are compressed like the depth history.
+class SuperFrameStore
+{
+public:
+	SuperFrameStore(const FERGBDCalib *calib, Vector2i depthImageSize, float tolerance);
+	~SuperFrameStore();
+
+	// fuse the raw depth image of a frame into the open super-frame, relativePose maps the keyframe camera to the frame camera
+	void fuseFrame(ShortImage *rawDepthImage, const cv::Mat &relativePose);
+
+	// store the open super-frame and start an empty one, returns the id of the stored super-frame
+	int closeSuperFrame();
+
+	// read the raw depth and the weight of a stored super-frame
+	bool readSuperFrame(int superFrameId, ShortImage *rawDepthImage, ShortImage *rawDepthWeight);
+
+private:
+	float rawToDepth(short raw) const;
+	short depthToRaw(float depth) const;
+
+	Vector2i imgSize;
+	Vector4f projParams;
+	FEDisparityCalib disparityCalib;
+	float tolerance;
+
+	// sum of the depths and number of frames of each pixel of the open super-frame
+	std::vector<float> depthSum;
+	std::vector<short> depthCount;
+
+	ShortImage *rawDepth, *rawWeight;
+	ShortImagesBlock *depthBlock, *weightBlock;
+	int noSuperFrames;
+};
+
+#endif // _SUPERFRAMESTORE_H